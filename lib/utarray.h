@@ -47,6 +47,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define utarray_oom() exit(-1)
 #endif
 
+#ifndef utarray_malloc
+#define utarray_malloc(sz) malloc(sz)         /* malloc fcn                  */
+#endif
+#ifndef utarray_realloc
+#define utarray_realloc(ptr,sz) realloc(ptr,sz) /* realloc fcn               */
+#endif
+#ifndef utarray_memfree
+#define utarray_memfree(ptr) free(ptr)        /* free fcn                    */
+#endif
+
 typedef void (ctor_f)(void *dst, const void *src);
 typedef void (dtor_f)(void *elt);
 typedef void (init_f)(void *elt);
@@ -76,13 +86,13 @@ typedef struct {
         (a)->icd.dtor(utarray_eltptr(a,_ut_i));                               \
       }                                                                       \
     }                                                                         \
-    free((a)->d);                                                             \
+    utarray_memfree((a)->d);                                                  \
   }                                                                           \
   (a)->n=0;                                                                   \
 } while(0)
 
 #define utarray_new(a,_icd) do {                                              \
-  (a) = (UT_array*)malloc(sizeof(UT_array));                                  \
+  (a) = (UT_array*)utarray_malloc(sizeof(UT_array));                          \
   if ((a) == NULL) {                                                          \
     utarray_oom();                                                            \
   }                                                                           \
@@ -91,14 +101,14 @@ typedef struct {
 
 #define utarray_free(a) do {                                                  \
   utarray_done(a);                                                            \
-  free(a);                                                                    \
+  utarray_memfree(a);                                                         \
 } while(0)
 
 #define utarray_reserve(a,by) do {                                            \
   if (((a)->i+(by)) > (a)->n) {                                               \
     char *utarray_tmp;                                                        \
     while (((a)->i+(by)) > (a)->n) { (a)->n = ((a)->n ? (2*(a)->n) : 8); }    \
-    utarray_tmp=(char*)realloc((a)->d, (a)->n*(a)->icd.sz);                   \
+    utarray_tmp=(char*)utarray_realloc((a)->d, (a)->n*(a)->icd.sz);           \
     if (utarray_tmp == NULL) {                                                \
       utarray_oom();                                                          \
     }                                                                         \
@@ -0,0 +1,650 @@
+/*
+ * Decoding of Frames of encapsulated Pixel Data.
+ */
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef HAVE_LIBJPEG
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+
+#include "dicom.h"
+#include "pdicom.h"
+
+/**
+ * Maximum number of codecs that can be registered.
+ */
+#define MAX_CODECS 32
+
+
+struct CodecEntry {
+    char transfer_syntax_uid[DCM_CAPACITY_UI + 1];
+    const DcmCodec *codec;
+};
+
+
+/**
+ * Context of a codec that is not in use by any thread.
+ */
+struct DecoderContext {
+    struct DecoderContext *next;
+    const DcmCodec *codec;
+    void *context;
+};
+
+
+struct _DcmDecoder {
+    struct DecoderContext *idle;
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_t mutex;
+#endif
+};
+
+
+static uint32_t decode_uint32(const unsigned char *data)
+{
+    return ((uint32_t) data[0] |
+            ((uint32_t) data[1] << 8) |
+            ((uint32_t) data[2] << 16) |
+            ((uint32_t) data[3] << 24));
+}
+
+
+// RLE Lossless, as specified in Part 5, Annex G
+
+/**
+ * Decode a PackBits segment into every `stride`-th byte of the output.
+ */
+static bool decode_rle_segment(const unsigned char *data,
+                               size_t length,
+                               unsigned char *output,
+                               size_t num_pixels,
+                               size_t stride)
+{
+    size_t position = 0;
+    size_t i = 0;
+
+    while (i < num_pixels && position < length) {
+        int header = (signed char) data[position++];
+        if (header >= 0) {
+            size_t count = (size_t) header + 1;
+            if (position + count > length) {
+                return false;
+            }
+            for (; count > 0 && i < num_pixels; count--) {
+                output[i++ * stride] = data[position++];
+            }
+        } else if (header != -128) {
+            size_t count = (size_t) (1 - header);
+            if (position >= length) {
+                return false;
+            }
+            unsigned char value = data[position++];
+            for (; count > 0 && i < num_pixels; count--) {
+                output[i++ * stride] = value;
+            }
+        }
+    }
+    return i == num_pixels;
+}
+
+
+static bool decode_rle(void *context,
+                       const DcmFrame *frame,
+                       char *buffer,
+                       size_t size)
+{
+    (void) context;
+    (void) size;
+    const unsigned char *data = (const unsigned char *) dcm_frame_get_value(
+        frame);
+    size_t length = dcm_frame_get_length(frame);
+    uint16_t bits_allocated = dcm_frame_get_bits_allocated(frame);
+    uint16_t samples_per_pixel = dcm_frame_get_samples_per_pixel(frame);
+    uint32_t i;
+
+    if (bits_allocated % 8 != 0) {
+        dcm_log_error("Decoding of RLE Frame #%u failed. "
+                      "Bits Allocated %u is not supported.",
+                      dcm_frame_get_number(frame), bits_allocated);
+        return false;
+    }
+    // The header holds the number of segments and 15 segment offsets
+    uint32_t sample_size = bits_allocated / 8;
+    uint32_t num_segments = length >= 64 ? decode_uint32(data) : 0;
+    if (num_segments == 0 ||
+        num_segments > 15 ||
+        num_segments != samples_per_pixel * sample_size) {
+        dcm_log_error("Decoding of RLE Frame #%u failed. "
+                      "Header is malformed.",
+                      dcm_frame_get_number(frame));
+        return false;
+    }
+
+    // Segments hold the most significant bytes of samples first, which
+    // are put into Little Endian order
+    size_t num_pixels = (size_t) dcm_frame_get_rows(frame) *
+                        dcm_frame_get_columns(frame);
+    size_t stride = (size_t) samples_per_pixel * sample_size;
+    for (i = 0; i < num_segments; i++) {
+        size_t start = decode_uint32(data + 4 + 4 * i);
+        size_t end = i + 1 < num_segments ?
+                     decode_uint32(data + 8 + 4 * i) : length;
+        uint32_t sample = i / sample_size;
+        uint32_t byte = sample_size - 1 - i % sample_size;
+        if (start < 64 || start > end || end > length ||
+            !decode_rle_segment(data + start,
+                                end - start,
+                                (unsigned char *) buffer +
+                                sample * sample_size + byte,
+                                num_pixels,
+                                stride)) {
+            dcm_log_error("Decoding of RLE Frame #%u failed. "
+                          "Segment #%u is malformed.",
+                          dcm_frame_get_number(frame), i + 1);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static const DcmCodec rle_codec = {
+    .decode = decode_rle,
+};
+
+
+#ifdef HAVE_LIBJPEG
+// JPEG Baseline, decoded with libjpeg
+
+struct JpegContext {
+    struct jpeg_decompress_struct info;
+    struct jpeg_error_mgr error;
+    jmp_buf jump;
+};
+
+
+static void jpeg_error_exit(j_common_ptr info)
+{
+    // The error manager is embedded in the context of the decoder
+    struct JpegContext *context = (struct JpegContext *) (
+        (char *) info->err - offsetof(struct JpegContext, error));
+    char message[JMSG_LENGTH_MAX];
+    info->err->format_message(info, message);
+    dcm_log_error("Decoding of JPEG Frame failed. %s", message);
+    longjmp(context->jump, 1);
+}
+
+
+static void jpeg_output_message(j_common_ptr info)
+{
+    (void) info;
+}
+
+
+static void *create_jpeg_context(void)
+{
+    struct JpegContext *context = DCM_NEW(struct JpegContext);
+    if (context == NULL) {
+        return NULL;
+    }
+    context->info.err = jpeg_std_error(&context->error);
+    context->error.error_exit = jpeg_error_exit;
+    context->error.output_message = jpeg_output_message;
+    if (setjmp(context->jump)) {
+        dcm_heap_free(context);
+        return NULL;
+    }
+    jpeg_create_decompress(&context->info);
+    return context;
+}
+
+
+static void destroy_jpeg_context(void *context)
+{
+    struct JpegContext *jpeg = (struct JpegContext *) context;
+    jpeg_destroy_decompress(&jpeg->info);
+    dcm_heap_free(jpeg);
+}
+
+
+static bool decode_jpeg(void *context,
+                        const DcmFrame *frame,
+                        char *buffer,
+                        size_t size)
+{
+    (void) size;
+    struct JpegContext *jpeg = (struct JpegContext *) context;
+    struct jpeg_decompress_struct *info = &jpeg->info;
+    uint16_t samples_per_pixel = dcm_frame_get_samples_per_pixel(frame);
+
+    if (setjmp(jpeg->jump)) {
+        // The context is reset and can decode the next Frame
+        jpeg_abort_decompress(info);
+        return false;
+    }
+    jpeg_mem_src(info,
+                 (unsigned char *) dcm_frame_get_value(frame),
+                 dcm_frame_get_length(frame));
+    jpeg_read_header(info, TRUE);
+    // Color images are converted from YBR to RGB
+    info->out_color_space = samples_per_pixel == 3 ? JCS_RGB : JCS_GRAYSCALE;
+    jpeg_start_decompress(info);
+    if (info->output_width != dcm_frame_get_columns(frame) ||
+        info->output_height != dcm_frame_get_rows(frame) ||
+        info->output_components != samples_per_pixel ||
+        dcm_frame_get_bits_allocated(frame) != 8) {
+        dcm_log_error("Decoding of JPEG Frame #%u failed. "
+                      "Image does not match the description of the Frame.",
+                      dcm_frame_get_number(frame));
+        jpeg_abort_decompress(info);
+        return false;
+    }
+
+    size_t row_length = (size_t) info->output_width * samples_per_pixel;
+    while (info->output_scanline < info->output_height) {
+        JSAMPROW row = (JSAMPROW) (buffer +
+                                   info->output_scanline * row_length);
+        jpeg_read_scanlines(info, &row, 1);
+    }
+    jpeg_finish_decompress(info);
+    return true;
+}
+
+
+static const DcmCodec jpeg_codec = {
+    .create_context = create_jpeg_context,
+    .decode = decode_jpeg,
+    .destroy_context = destroy_jpeg_context,
+};
+#endif
+
+
+static const struct CodecEntry builtin_codecs[] = {
+    {"1.2.840.10008.1.2.5", &rle_codec},
+#ifdef HAVE_LIBJPEG
+    {"1.2.840.10008.1.2.4.50", &jpeg_codec},
+#endif
+};
+
+
+static struct {
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_t mutex;
+#endif
+    struct CodecEntry entries[MAX_CODECS];
+    uint32_t num_entries;
+} codec_registry = {
+#ifdef HAVE_PTHREAD_H
+    PTHREAD_MUTEX_INITIALIZER,
+#endif
+    {{"", NULL}},
+    0
+};
+
+
+static void registry_lock(void)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&codec_registry.mutex);
+#endif
+}
+
+
+static void registry_unlock(void)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_unlock(&codec_registry.mutex);
+#endif
+}
+
+
+bool dcm_codec_register(const char *transfer_syntax_uid,
+                        const DcmCodec *codec)
+{
+    assert(transfer_syntax_uid);
+    assert(codec);
+    uint32_t i;
+
+    if (codec->decode == NULL) {
+        dcm_log_error("Registration of codec failed. "
+                      "Codec lacks a function for decoding.");
+        return false;
+    }
+    if (strlen(transfer_syntax_uid) > DCM_CAPACITY_UI) {
+        dcm_log_error("Registration of codec failed. "
+                      "Transfer Syntax UID '%s' is too long.",
+                      transfer_syntax_uid);
+        return false;
+    }
+
+    registry_lock();
+    for (i = 0; i < codec_registry.num_entries; i++) {
+        struct CodecEntry *entry = &codec_registry.entries[i];
+        if (strcmp(entry->transfer_syntax_uid, transfer_syntax_uid) == 0) {
+            entry->codec = codec;
+            registry_unlock();
+            return true;
+        }
+    }
+    if (codec_registry.num_entries == MAX_CODECS) {
+        registry_unlock();
+        dcm_log_error("Registration of codec failed. "
+                      "No more than %d codecs can be registered.",
+                      MAX_CODECS);
+        return false;
+    }
+    struct CodecEntry *entry =
+        &codec_registry.entries[codec_registry.num_entries];
+    strcpy(entry->transfer_syntax_uid, transfer_syntax_uid);
+    entry->codec = codec;
+    codec_registry.num_entries += 1;
+    registry_unlock();
+    return true;
+}
+
+
+const DcmCodec *dcm_codec_find(const char *transfer_syntax_uid)
+{
+    assert(transfer_syntax_uid);
+    const DcmCodec *codec = NULL;
+    uint32_t i;
+
+    // Registered codecs take precedence over the built-in ones
+    registry_lock();
+    for (i = 0; i < codec_registry.num_entries; i++) {
+        const struct CodecEntry *entry = &codec_registry.entries[i];
+        if (strcmp(entry->transfer_syntax_uid, transfer_syntax_uid) == 0) {
+            codec = entry->codec;
+            break;
+        }
+    }
+    registry_unlock();
+    if (codec) {
+        return codec;
+    }
+
+    for (i = 0; i < sizeof(builtin_codecs) / sizeof(builtin_codecs[0]); i++) {
+        const struct CodecEntry *entry = &builtin_codecs[i];
+        if (strcmp(entry->transfer_syntax_uid, transfer_syntax_uid) == 0) {
+            return entry->codec;
+        }
+    }
+    return NULL;
+}
+
+
+size_t dcm_frame_get_decoded_length(const DcmFrame *frame)
+{
+    assert(frame);
+    uint64_t num_bits = (uint64_t) dcm_frame_get_rows(frame) *
+                        dcm_frame_get_columns(frame) *
+                        dcm_frame_get_samples_per_pixel(frame) *
+                        dcm_frame_get_bits_allocated(frame);
+    return (size_t) ((num_bits + 7) / 8);
+}
+
+
+/**
+ * Find the codec of a Frame and check that the output fits into a buffer.
+ */
+static bool prepare_decode(const DcmFrame *frame,
+                           size_t size,
+                           const DcmCodec **codec)
+{
+    const char *transfer_syntax_uid = dcm_frame_get_transfer_syntax_uid(frame);
+    size_t length = dcm_frame_get_decoded_length(frame);
+    if (size < length) {
+        dcm_log_error("Decoding of Frame #%u failed. "
+                      "Buffer of %zu bytes is smaller than %zu bytes.",
+                      dcm_frame_get_number(frame), size, length);
+        return false;
+    }
+
+    *codec = NULL;
+    if (!dcm_is_encapsulated_transfer_syntax(transfer_syntax_uid)) {
+        return true;
+    }
+    *codec = dcm_codec_find(transfer_syntax_uid);
+    if (*codec == NULL) {
+        dcm_log_error("Decoding of Frame #%u failed. "
+                      "No codec is available for Transfer Syntax '%s'.",
+                      dcm_frame_get_number(frame), transfer_syntax_uid);
+        return false;
+    }
+    return true;
+}
+
+
+static bool decode_native(const DcmFrame *frame, char *buffer, size_t size)
+{
+    // Native Frames only need to be brought into the decoded layout
+    size_t length = dcm_frame_get_decoded_length(frame);
+    if (dcm_frame_get_bits_allocated(frame) == 1 &&
+        dcm_frame_get_length(frame) >= length) {
+        memcpy(buffer, dcm_frame_get_value(frame), length);
+        return true;
+    }
+    return dcm_frame_convert(frame, DCM_CONVERT_DEFAULT, buffer, size);
+}
+
+
+bool dcm_frame_decode(const DcmFrame *frame, char *buffer, size_t size)
+{
+    assert(frame);
+    assert(buffer);
+    const DcmCodec *codec;
+
+    if (!prepare_decode(frame, size, &codec)) {
+        return false;
+    }
+    if (codec == NULL) {
+        return decode_native(frame, buffer, size);
+    }
+
+    void *context = NULL;
+    if (codec->create_context) {
+        context = codec->create_context();
+        if (context == NULL) {
+            dcm_log_error("Decoding of Frame #%u failed. "
+                          "Could not create codec context.",
+                          dcm_frame_get_number(frame));
+            return false;
+        }
+    }
+    dcm_trace_start("decode_frame", NULL);
+    bool result = codec->decode(context, frame, buffer, size);
+    dcm_trace_end("decode_frame", NULL);
+    if (context && codec->destroy_context) {
+        codec->destroy_context(context);
+    }
+    return result;
+}
+
+
+DcmDecoder *dcm_decoder_create(void)
+{
+    DcmDecoder *decoder = DCM_NEW(DcmDecoder);
+    if (decoder == NULL) {
+        dcm_log_error("Creation of decoder failed. "
+                      "Could not allocate memory.");
+        return NULL;
+    }
+    decoder->idle = NULL;
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_init(&decoder->mutex, NULL);
+#endif
+    return decoder;
+}
+
+
+static void decoder_lock(DcmDecoder *decoder)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&decoder->mutex);
+#else
+    (void) decoder;
+#endif
+}
+
+
+static void decoder_unlock(DcmDecoder *decoder)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_unlock(&decoder->mutex);
+#else
+    (void) decoder;
+#endif
+}
+
+
+/**
+ * Take an idle context of a codec or create one.
+ */
+static struct DecoderContext *acquire_context(DcmDecoder *decoder,
+                                              const DcmCodec *codec)
+{
+    decoder_lock(decoder);
+    struct DecoderContext **link = &decoder->idle;
+    while (*link && (*link)->codec != codec) {
+        link = &(*link)->next;
+    }
+    struct DecoderContext *entry = *link;
+    if (entry) {
+        *link = entry->next;
+    }
+    decoder_unlock(decoder);
+    if (entry) {
+        return entry;
+    }
+
+    entry = DCM_NEW(struct DecoderContext);
+    if (entry == NULL) {
+        dcm_log_error("Decoding of Frame failed. "
+                      "Could not allocate memory.");
+        return NULL;
+    }
+    entry->codec = codec;
+    entry->context = NULL;
+    if (codec->create_context) {
+        entry->context = codec->create_context();
+        if (entry->context == NULL) {
+            dcm_log_error("Decoding of Frame failed. "
+                          "Could not create codec context.");
+            dcm_heap_free(entry);
+            return NULL;
+        }
+    }
+    return entry;
+}
+
+
+static void release_context(DcmDecoder *decoder,
+                            struct DecoderContext *entry)
+{
+    decoder_lock(decoder);
+    entry->next = decoder->idle;
+    decoder->idle = entry;
+    decoder_unlock(decoder);
+}
+
+
+bool dcm_decoder_decode(DcmDecoder *decoder,
+                        const DcmFrame *frame,
+                        char *buffer,
+                        size_t size)
+{
+    assert(decoder);
+    assert(frame);
+    assert(buffer);
+    const DcmCodec *codec;
+
+    if (!prepare_decode(frame, size, &codec)) {
+        return false;
+    }
+    if (codec == NULL) {
+        return decode_native(frame, buffer, size);
+    }
+
+    struct DecoderContext *entry = acquire_context(decoder, codec);
+    if (entry == NULL) {
+        return false;
+    }
+    dcm_trace_start("decode_frame", NULL);
+    bool result = codec->decode(entry->context, frame, buffer, size);
+    dcm_trace_end("decode_frame", NULL);
+    release_context(decoder, entry);
+    return result;
+}
+
+
+struct DecodeBatch {
+    DcmDecoder *decoder;
+    const DcmFrame *const *frames;
+    char *const *buffers;
+    size_t size;
+    atomic_bool failed;
+};
+
+
+static void decode_batch_frame(void *arg, uint32_t index)
+{
+    struct DecodeBatch *batch = (struct DecodeBatch *) arg;
+    if (!dcm_decoder_decode(batch->decoder,
+                            batch->frames[index],
+                            batch->buffers[index],
+                            batch->size)) {
+        atomic_store(&batch->failed, true);
+    }
+}
+
+
+bool dcm_decoder_decode_frames(DcmDecoder *decoder,
+                               const DcmFrame *const *frames,
+                               uint32_t num_frames,
+                               char *const *buffers,
+                               size_t size)
+{
+    assert(decoder);
+    assert(frames);
+    assert(buffers);
+
+    struct DecodeBatch batch;
+    batch.decoder = decoder;
+    batch.frames = frames;
+    batch.buffers = buffers;
+    batch.size = size;
+    atomic_init(&batch.failed, false);
+    dcm_run_parallel(num_frames, decode_batch_frame, &batch);
+    return !atomic_load(&batch.failed);
+}
+
+
+void dcm_decoder_destroy(DcmDecoder *decoder)
+{
+    if (decoder) {
+        while (decoder->idle) {
+            struct DecoderContext *entry = decoder->idle;
+            decoder->idle = entry->next;
+            if (entry->context && entry->codec->destroy_context) {
+                entry->codec->destroy_context(entry->context);
+            }
+            dcm_heap_free(entry);
+        }
+#ifdef HAVE_PTHREAD_H
+        pthread_mutex_destroy(&decoder->mutex);
+#endif
+        dcm_heap_free(decoder);
+    }
+}
@@ -2,6 +2,9 @@
  * Implementation of Part 5 of the DICOM standard: Data Structures and Encoding.
  */
 #include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -9,15 +12,35 @@
 #include <string.h>
 #include <inttypes.h>
 
-#include "../lib/utarray.h"
-#include "../lib/uthash.h"
+#include "config.h"
 
 #include "dicom.h"
+#include "pdicom.h"
+
+#define utarray_malloc(sz) dcm_heap_malloc(sz)
+#define utarray_realloc(ptr, sz) dcm_heap_realloc(ptr, sz)
+#define utarray_memfree(ptr) dcm_heap_free(ptr)
+#include "../lib/utarray.h"
+
+/**
+ * Size of the character strings that are stored within a Data Element,
+ * including the terminating null character.
+ */
+#define INLINE_STRING_SIZE 16
+
+/**
+ * Item of a query step that selects all Items of a Sequence.
+ */
+#define QUERY_ALL_ITEMS -1
 
 
 struct _DcmElement {
     uint32_t tag;
     char vr[3];
+    // Element and value are owned by the arena of the enclosing Data Set
+    bool in_arena;
+    // String Pool that owns the character string values, if any
+    DcmStringPool *pool;
     uint32_t length;
     uint32_t vm;
     union {
@@ -37,22 +60,46 @@ struct _DcmElement {
         // Sequence value (multiplicity 1)
         DcmSequence *sq;
     } value;
-    void *value_pointer;
-    char **value_pointer_array;
-    DcmSequence *sequence_pointer;
-    UT_hash_handle hh;
+    // Single numbers and short strings are stored here rather than in
+    // separately allocated memory, with the value pointing to the storage
+    union {
+        float fl;
+        double fd;
+        int16_t ss;
+        int32_t sl;
+        int64_t sv;
+        uint16_t us;
+        uint32_t ul;
+        uint64_t uv;
+        struct {
+            char *pointer;
+            char chars[INLINE_STRING_SIZE];
+        } str;
+    } storage;
+    // Set while the value has not yet been read from its source
+    DcmElementSource *_Atomic source;
+    size_t source_offset;
+    uint32_t source_length;
 };
 
 
 struct _DcmSequence {
     UT_array *items;
     bool is_locked;
+    bool in_arena;
 };
 
 
 struct _DcmDataSet {
-    DcmElement *elements;
+    // Attribute Tags in ascending order, kept apart from the Data Elements
+    // so that lookups scan a dense array
+    uint32_t *tags;
+    DcmElement **elements;
+    uint32_t num_elements;
+    uint32_t capacity;
     bool is_locked;
+    // Arena from which the Data Set and its content were allocated, if any
+    DcmArena *arena;
 };
 
 
@@ -70,6 +117,22 @@ struct _DcmFrame {
     uint16_t planar_configuration;
     const char *photometric_interpretation;
     const char *transfer_syntax_uid;
+    // Set for Frames that reference memory they do not own
+    void *owner;
+    void (*release)(void *owner);
+};
+
+
+struct QueryStep {
+    uint32_t tag;
+    // Zero-based index of the selected Sequence Item or QUERY_ALL_ITEMS
+    int64_t item;
+};
+
+
+struct _DcmQuery {
+    uint32_t num_steps;
+    struct QueryStep *steps;
 };
 
 
@@ -87,7 +150,6 @@ struct SequenceItem {
 static bool is_vr_string(const char *vr) {
     if (strcmp(vr, "AE") == 0 ||
         strcmp(vr, "AS") == 0 ||
-        strcmp(vr, "AT") == 0 ||
         strcmp(vr, "CS") == 0 ||
         strcmp(vr, "DA") == 0 ||
         strcmp(vr, "DS") == 0 ||
@@ -113,7 +175,9 @@ static bool is_vr_bytes(const char *vr) {
     if (strcmp(vr, "OB") == 0 ||
         strcmp(vr, "OD") == 0 ||
         strcmp(vr, "OF") == 0 ||
+        strcmp(vr, "OL") == 0 ||
         strcmp(vr, "OV") == 0 ||
+        strcmp(vr, "OW") == 0 ||
         strcmp(vr, "UC") == 0 ||
         strcmp(vr, "UN") == 0) {
         return true;
@@ -123,22 +187,6 @@ static bool is_vr_bytes(const char *vr) {
 }
 
 
-static struct SequenceItem *create_sequence_item(DcmDataSet *dataset)
-{
-    assert(dataset);
-
-    struct SequenceItem *item = DCM_NEW(struct SequenceItem);
-    if (item == NULL) {
-        dcm_log_error("Creation of Sequence Item failed."
-                      "Could not allocate memory.");
-        return NULL;
-    }
-    item->dataset = dataset;
-    item->dataset->is_locked = true;
-    return item;
-}
-
-
 static void copy_sequence_item_icd(void *_dst_item, const void *_src_item)
 {
     struct SequenceItem *dst_item = (struct SequenceItem *) _dst_item;
@@ -171,18 +219,15 @@ static UT_icd sequence_item_icd = {
 };
 
 
-static int compare_tags(const void *a, const void *b)
-{
-   return ( *(uint32_t*)a - *(uint32_t*)b );
-}
-
-
 // Data Elements
 
 static DcmElement *create_element(uint32_t tag, const char *vr, uint32_t length)
 {
     dcm_log_debug("Create Data Element '%08X'.", tag);
-    DcmElement *element = DCM_NEW(DcmElement);
+    DcmArena *arena = dcm_arena_current();
+    DcmElement *element = arena ?
+                          dcm_arena_alloc(arena, sizeof(DcmElement)) :
+                          DCM_NEW(DcmElement);
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed."
                       "Could not allocate memory for Data Element '%08X'.",
@@ -199,37 +244,192 @@ static DcmElement *create_element(uint32_t tag, const char *vr, uint32_t length)
     element->length = length;
     element->vm = 0;
     element->value.str_multi = NULL;
-    element->value_pointer = NULL;
-    element->value_pointer_array = NULL;
-    element->sequence_pointer = NULL;
+    element->in_arena = arena != NULL;
+    element->pool = NULL;
+    atomic_init(&element->source, NULL);
+    element->source_offset = 0;
+    element->source_length = 0;
+    return element;
+}
+
+
+static bool is_value_inline(const DcmElement *element)
+{
+    return (const void *) element->value.bytes ==
+           (const void *) &element->storage;
+}
+
+
+/**
+ * Move the value of a Data Element into another one.
+ */
+static void move_value(DcmElement *destination, const DcmElement *source)
+{
+    destination->length = source->length;
+    destination->vm = source->vm;
+    destination->value = source->value;
+    destination->storage = source->storage;
+    destination->pool = source->pool;
+    if (is_value_inline(source)) {
+        destination->value.bytes = (char *) &destination->storage;
+        if (source->storage.str.pointer == source->storage.str.chars) {
+            destination->storage.str.pointer = destination->storage.str.chars;
+        }
+    }
+}
+
+
+DcmElement *dcm_element_create_lazy(uint32_t tag,
+                                    const char *vr,
+                                    uint32_t length,
+                                    DcmElementSource *source,
+                                    size_t offset)
+{
+    DcmElement *element = create_element(tag, vr, length);
+    if (element == NULL) {
+        return NULL;
+    }
+    element->source_offset = offset;
+    element->source_length = length;
+    dcm_element_source_retain(source);
+    atomic_store(&element->source, source);
     return element;
 }
 
 
+static bool load_element(const DcmElement *element)
+{
+    // The value is read on first access, which does not change the
+    // Data Element from the point of view of the caller
+    DcmElement *pending = (DcmElement *) element;
+    DcmElementSource *source = atomic_load(&pending->source);
+    if (source == NULL) {
+        return true;
+    }
+
+    dcm_element_source_lock(source);
+    if (atomic_load(&pending->source) == NULL) {
+        // Read by another thread in the meantime
+        dcm_element_source_unlock(source);
+        return true;
+    }
+    DcmElement *loaded = dcm_element_source_load(source,
+                                                 pending->tag,
+                                                 pending->vr,
+                                                 pending->source_length,
+                                                 pending->source_offset);
+    if (loaded == NULL) {
+        dcm_element_source_unlock(source);
+        dcm_log_error("Reading of Data Element '%08X' failed.", pending->tag);
+        return false;
+    }
+    assert(loaded->in_arena == pending->in_arena);
+    move_value(pending, loaded);
+    if (!loaded->in_arena) {
+        dcm_heap_free(loaded);
+    }
+    atomic_store(&pending->source, NULL);
+    dcm_element_source_unlock(source);
+    dcm_element_source_release(source);
+    return true;
+}
+
+
 void dcm_element_destroy(DcmElement *element)
 {
     uint32_t i;
 
     if (element) {
         dcm_log_debug("Destroy Data Element '%08X'.", element->tag);
-        if(element->sequence_pointer) {
-            dcm_sequence_destroy(element->sequence_pointer);
+        DcmElementSource *source = atomic_load(&element->source);
+        if (source) {
+            dcm_element_source_release(source);
         }
-        if(element->value_pointer) {
-            free(element->value_pointer);
+        if (strcmp(element->vr, "SQ") == 0) {
+            if (element->value.sq) {
+                dcm_sequence_destroy(element->value.sq);
+            }
         }
-        if(element->value_pointer_array) {
-            for (i = 0; i < element->vm; i++) {
-                free(element->value_pointer_array[i]);
+        if (element->in_arena) {
+            // Released along with the arena
+            return;
+        }
+        if (is_vr_string(element->vr)) {
+            if (element->value.str_multi && element->pool == NULL) {
+                for (i = 0; i < element->vm; i++) {
+                    if (element->value.str_multi[i] !=
+                            element->storage.str.chars) {
+                        dcm_heap_free(element->value.str_multi[i]);
+                    }
+                }
+            }
+            if (element->value.str_multi && !is_value_inline(element)) {
+                dcm_heap_free(element->value.str_multi);
+            }
+            dcm_string_pool_release(element->pool);
+        } else if (strcmp(element->vr, "SQ") != 0) {
+            if (!is_value_inline(element)) {
+                dcm_heap_free(element->value.bytes);
             }
-            free(element->value_pointer_array);
         }
-        free(element);
+        dcm_heap_free(element);
         element = NULL;
     }
 }
 
 
+void dcm_element_intern(DcmElement *element, DcmStringPool *pool)
+{
+    uint32_t i;
+
+    if (element->in_arena ||
+        element->pool ||
+        element->value.str_multi == NULL ||
+        !is_vr_string(element->vr) ||
+        strcmp(element->vr, "LT") == 0 ||
+        strcmp(element->vr, "ST") == 0 ||
+        strcmp(element->vr, "UR") == 0 ||
+        strcmp(element->vr, "UT") == 0 ||
+        (element->vm == 1 &&
+         element->value.str_multi[0] == element->storage.str.chars)) {
+        return;
+    }
+
+    // Values are only replaced once all of them have been pooled
+    const char *single;
+    const char **pooled = element->vm == 1 ?
+                          &single :
+                          dcm_heap_malloc(element->vm * sizeof(char *));
+    if (pooled == NULL) {
+        return;
+    }
+    for (i = 0; i < element->vm; i++) {
+        char *value = element->value.str_multi[i];
+        if (value == element->storage.str.chars) {
+            pooled[i] = value;
+        } else {
+            pooled[i] = dcm_string_pool_intern(pool, value);
+            if (pooled[i] == NULL) {
+                break;
+            }
+        }
+    }
+    if (i == element->vm) {
+        for (i = 0; i < element->vm; i++) {
+            if (element->value.str_multi[i] != element->storage.str.chars) {
+                dcm_heap_free(element->value.str_multi[i]);
+            }
+            element->value.str_multi[i] = (char *) pooled[i];
+        }
+        dcm_string_pool_retain(pool);
+        element->pool = pool;
+    }
+    if (pooled != &single) {
+        dcm_heap_free(pooled);
+    }
+}
+
+
 uint16_t dcm_element_get_group_number(const DcmElement *element)
 {
     assert(element);
@@ -251,6 +451,13 @@ uint32_t dcm_element_get_tag(const DcmElement *element)
 }
 
 
+const char *dcm_element_get_vr(const DcmElement *element)
+{
+    assert(element);
+    return element->vr;
+}
+
+
 bool dcm_element_check_vr(const DcmElement *element, const char *vr)
 {
     assert(element);
@@ -274,6 +481,9 @@ DcmElement *dcm_element_clone(const DcmElement *element)
     uint32_t i;
 
     dcm_log_debug("Clone Data Element '%08X'.", element->tag);
+    if (!load_element(element)) {
+        return NULL;
+    }
     DcmElement *clone = DCM_NEW(DcmElement);
     if (clone == NULL) {
         dcm_log_error("Cloning of Data Element '%08X' failed."
@@ -304,181 +514,182 @@ DcmElement *dcm_element_clone(const DcmElement *element)
                     dcm_element_destroy(clone);
                     return NULL;
                 }
+                // The Sequence takes ownership of the cloned Item
                 dcm_sequence_append(seq, cloned_item);
-                dcm_dataset_destroy(cloned_item);
             }
             clone->value.sq = seq;
-            clone->sequence_pointer = seq;
         }
     } else if (is_vr_string(element->vr)) {
         if (element->value.str_multi) {
-            clone->value.str_multi = malloc(element->vm * sizeof(char *));
+            clone->value.str_multi = dcm_heap_malloc(element->vm *
+                                                     sizeof(char *));
             if (clone->value.str_multi == NULL) {
                 dcm_log_error("Cloning of Data Element failed."
                               "Could not allocate memory for value of clone "
                               "clone of Data Element '%08X'.",
                               element->tag);
-                free(clone);
+                dcm_heap_free(clone);
                 return NULL;
             }
             for (i = 0; i < element->vm; i++) {
-                clone->value.str_multi[i] = strdup(element->value.str_multi[i]);
+                clone->value.str_multi[i] = dcm_strdup(
+                    element->value.str_multi[i]
+                );
                 if (clone->value.str_multi[i] == NULL) {
                     dcm_log_error("Cloning of Data Element failed."
                                   "Could not allocate memory for value of clone "
                                   "clone of Data Element '%08X'.",
                                   element->tag);
                     // FIXME: free memory allocated for previous values
-                    free(clone->value.str_multi);
-                    free(clone);
+                    dcm_heap_free(clone->value.str_multi);
+                    dcm_heap_free(clone);
                     return NULL;
                 }
             }
-            clone->value_pointer_array = clone->value.str_multi;
         }
     } else if (is_vr_bytes(element->vr)) {
         if (element->value.bytes) {
-            clone->value.bytes = malloc(element->length);
+            clone->value.bytes = dcm_heap_malloc(element->length);
             if (clone->value.bytes == NULL) {
                 dcm_log_error("Cloning of Data Element failed."
                               "Could not allocate memory for value of clone "
                               "clone of Data Element '%08X'.",
                               element->tag);
-                free(clone);
+                dcm_heap_free(clone);
                 return NULL;
             }
             memcpy(clone->value.bytes,
                    element->value.bytes,
                    element->length);
-            clone->value_pointer = clone->value.bytes;
         }
     } else if (strcmp(element->vr, "FL") == 0) {
         if (element->value.fl_multi) {
-            clone->value.fl_multi = malloc(element->vm * sizeof(float));
+            clone->value.fl_multi = dcm_heap_malloc(element->vm *
+                                                    sizeof(float));
             if (clone->value.fl_multi == NULL) {
                 dcm_log_error("Cloning of Data Element failed."
                               "Could not allocate memory for value of clone "
                               "clone of Data Element '%08X'.",
                               element->tag);
-                free(clone);
+                dcm_heap_free(clone);
                 return NULL;
             }
             for (i = 0; i < element->vm; i++) {
                 clone->value.fl_multi[i] = element->value.fl_multi[i];
             }
-            clone->value_pointer = clone->value.fl_multi;
         }
     } else if (strcmp(element->vr, "FD") == 0) {
         if (element->value.fd_multi) {
-            clone->value.fd_multi = malloc(element->vm * sizeof(double));
+            clone->value.fd_multi = dcm_heap_malloc(element->vm *
+                                                    sizeof(double));
             if (clone->value.fd_multi == NULL) {
                 dcm_log_error("Cloning of Data Element failed."
                               "Could not allocate memory for value of clone "
                               "clone of Data Element '%08X'.",
                               element->tag);
-                free(clone);
+                dcm_heap_free(clone);
                 return NULL;
             }
             for (i = 0; i < element->vm; i++) {
                 clone->value.fd_multi[i] = element->value.fd_multi[i];
             }
-            clone->value_pointer = clone->value.fd_multi;
         }
     } else if (strcmp(element->vr, "SS") == 0) {
         if (element->value.ss_multi) {
-            clone->value.ss_multi = malloc(element->vm * sizeof(int16_t));
+            clone->value.ss_multi = dcm_heap_malloc(element->vm *
+                                                    sizeof(int16_t));
             if (clone->value.ss_multi == NULL) {
                 dcm_log_error("Cloning of Data Element failed."
                               "Could not allocate memory for value of clone "
                               "clone of Data Element '%08X'.",
                               element->tag);
-                free(clone);
+                dcm_heap_free(clone);
                 return NULL;
             }
             for (i = 0; i < element->vm; i++) {
                 clone->value.ss_multi[i] = element->value.ss_multi[i];
             }
-            clone->value_pointer = clone->value.ss_multi;
         }
     } else if (strcmp(element->vr, "SL") == 0) {
         if (element->value.sl_multi) {
-            clone->value.sl_multi = malloc(element->vm * sizeof(int32_t));
+            clone->value.sl_multi = dcm_heap_malloc(element->vm *
+                                                    sizeof(int32_t));
             if (clone->value.sl_multi == NULL) {
                 dcm_log_error("Cloning of Data Element failed."
                               "Could not allocate memory for value of clone "
                               "clone of Data Element '%08X'.",
                               element->tag);
-                free(clone);
+                dcm_heap_free(clone);
                 return NULL;
             }
             for (i = 0; i < element->vm; i++) {
                 clone->value.sl_multi[i] = element->value.sl_multi[i];
             }
-            clone->value_pointer = clone->value.sl_multi;
         }
     } else if (strcmp(element->vr, "SV") == 0) {
         if (element->value.sv_multi) {
-            clone->value.sv_multi = malloc(element->vm * sizeof(int64_t));
+            clone->value.sv_multi = dcm_heap_malloc(element->vm *
+                                                    sizeof(int64_t));
             if (clone->value.sv_multi == NULL) {
                 dcm_log_error("Cloning of Data Element failed."
                               "Could not allocate memory for value of clone "
                               "clone of Data Element '%08X'.",
                               element->tag);
-                free(clone);
+                dcm_heap_free(clone);
                 return NULL;
             }
             for (i = 0; i < element->vm; i++) {
                 clone->value.sv_multi[i] = element->value.sv_multi[i];
             }
-            clone->value_pointer = clone->value.sv_multi;
         }
     } else if (strcmp(element->vr, "US") == 0) {
         if (element->value.us_multi) {
-            clone->value.us_multi = malloc(element->vm * sizeof(uint16_t));
+            clone->value.us_multi = dcm_heap_malloc(element->vm *
+                                                    sizeof(uint16_t));
             if (clone->value.us_multi == NULL) {
                 dcm_log_error("Cloning of Data Element failed."
                               "Could not allocate memory for value of clone "
                               "clone of Data Element '%08X'.",
                               element->tag);
-                free(clone);
+                dcm_heap_free(clone);
                 return NULL;
             }
             for (i = 0; i < element->vm; i++) {
                 clone->value.us_multi[i] = element->value.us_multi[i];
             }
-            clone->value_pointer = clone->value.us_multi;
         }
-    } else if (strcmp(element->vr, "UL") == 0) {
+    } else if (strcmp(element->vr, "AT") == 0 ||
+               strcmp(element->vr, "UL") == 0) {
         if (element->value.ul_multi) {
-            clone->value.ul_multi = malloc(element->vm * sizeof(uint32_t));
+            clone->value.ul_multi = dcm_heap_malloc(element->vm *
+                                                    sizeof(uint32_t));
             if (clone->value.ul_multi == NULL) {
                 dcm_log_error("Cloning of Data Element failed."
                               "Could not allocate memory for value of clone "
                               "clone of Data Element '%08X'.",
                               element->tag);
-                free(clone);
+                dcm_heap_free(clone);
                 return NULL;
             }
             for (i = 0; i < element->vm; i++) {
                 clone->value.ul_multi[i] = element->value.ul_multi[i];
             }
-            clone->value_pointer = clone->value.ul_multi;
         }
     } else if (strcmp(element->vr, "UV") == 0) {
         if (element->value.uv_multi) {
-            clone->value.uv_multi = malloc(element->vm * sizeof(uint64_t));
+            clone->value.uv_multi = dcm_heap_malloc(element->vm *
+                                                    sizeof(uint64_t));
             if (clone->value.uv_multi == NULL) {
                 dcm_log_error("Cloning of Data Element failed."
                               "Could not allocate memory for value of clone "
                               "clone of Data Element '%08X'.",
                               element->tag);
-                free(clone);
+                dcm_heap_free(clone);
                 return NULL;
             }
             for (i = 0; i < element->vm; i++) {
                 clone->value.uv_multi[i] = element->value.uv_multi[i];
             }
-            clone->value_pointer = clone->value.uv_multi;
         }
     }
 
@@ -563,52 +774,60 @@ static bool set_value_str_multi(DcmElement *element,
         if (values) {
             for (i = 0; i < vm; i++) {
                 if (values[i]) {
-                    free(values[i]);
+                    dcm_free(values[i]);
                 }
             }
-            free(values);
+            dcm_free(values);
         }
         return false;
     }
     element->value.str_multi = values;
-    element->value_pointer_array = values;
     element->vm = vm;
     return true;
 }
 
 
-static DcmElement *create_element_str(uint32_t tag,
-                                      const char *vr,
-                                      char *value,
-                                      uint32_t capacity)
+static DcmElement *create_element_str_value(uint32_t tag,
+                                            const char *vr,
+                                            char *value,
+                                            uint32_t capacity,
+                                            bool copy_short)
 {
-    char **values = malloc(sizeof(char *));
-    if (values == NULL) {
-        dcm_log_error("Creation of Data Element failed. "
-                      "Could not allocate memory.");
-        free(value);
-        return NULL;
-    }
-    values[0] = value;
-
     uint32_t length = strlen(value);
     DcmElement *element = create_element(tag, vr, length);
     if (element == NULL) {
-        free(value);
-        if (values[0]) {
-            free(values[0]);
-        }
-        free(values);
+        dcm_free(value);
         return NULL;
     }
-    if (!set_value_str_multi(element, values, 1, capacity)) {
-        free(value);
+    if (!check_value_str_multi(element, &value, 1, capacity)) {
+        dcm_free(value);
         dcm_element_destroy(element);
         return NULL;
     }
+
+    // The array of values is not allocated and short values, of which the
+    // caller has no copy, are stored within the Data Element
+    if (copy_short && length < INLINE_STRING_SIZE) {
+        memcpy(element->storage.str.chars, value, length + 1);
+        dcm_free(value);
+        element->storage.str.pointer = element->storage.str.chars;
+    } else {
+        element->storage.str.pointer = value;
+    }
+    element->value.str_multi = &element->storage.str.pointer;
+    element->vm = 1;
     return element;
 }
 
+
+static DcmElement *create_element_str(uint32_t tag,
+                                      const char *vr,
+                                      char *value,
+                                      uint32_t capacity)
+{
+    return create_element_str_value(tag, vr, value, capacity, false);
+}
+
 static DcmElement *create_element_str_multi(uint32_t tag,
                                             const char *vr,
                                             char **values,
@@ -619,6 +838,12 @@ static DcmElement *create_element_str_multi(uint32_t tag,
     uint32_t length;
     char *v;
 
+    if (vm == 1) {
+        v = values[0];
+        dcm_free(values);
+        return create_element_str_value(tag, vr, v, capacity, true);
+    }
+
     length = 0;
     for (i = 0; i < vm; i++) {
         v = values[i];
@@ -632,9 +857,9 @@ static DcmElement *create_element_str_multi(uint32_t tag,
     DcmElement *element = create_element(tag, vr, length);
     if (element == NULL) {
         for (i = 0; i < vm; i++) {
-            free(values[i]);
+            dcm_free(values[i]);
         }
-        free(values);
+        dcm_free(values);
         return NULL;
     }
 
@@ -675,17 +900,36 @@ DcmElement *dcm_element_create_AS_multi(uint32_t tag,
 }
 
 
-DcmElement *dcm_element_create_AT(uint32_t tag, char *value)
+DcmElement *dcm_element_create_AT(uint32_t tag, uint32_t value)
 {
-    return create_element_str(tag, "AT", value, DCM_CAPACITY_AT);
+    DcmElement *element = create_element(tag, "AT", sizeof(uint32_t));
+    if (element == NULL) {
+        dcm_log_error("Creation of Data Element failed. "
+                      "Could not allocate memory.");
+        return NULL;
+    }
+    element->storage.ul = value;
+    element->value.ul_multi = &element->storage.ul;
+    element->vm = 1;
+    return element;
 }
 
 
 DcmElement *dcm_element_create_AT_multi(uint32_t tag,
-                                        char **values,
+                                        uint32_t *values,
                                         uint32_t vm)
 {
-    return create_element_str_multi(tag, "AT", values, vm, DCM_CAPACITY_AT);
+    uint32_t length = vm * sizeof(uint32_t);
+    DcmElement *element = create_element(tag, "AT", length);
+    if (element == NULL) {
+        dcm_log_error("Creation of Data Element failed. "
+                      "Could not allocate memory.");
+        dcm_free(values);
+        return NULL;
+    }
+    element->value.ul_multi = values;
+    element->vm = vm;
+    return element;
 }
 
 
@@ -815,6 +1059,15 @@ static char *get_value_str_multi(const DcmElement *element, uint32_t index)
 }
 
 
+const char *dcm_element_get_value_string(const DcmElement *element,
+                                         uint32_t index)
+{
+    assert(element);
+    assert(is_vr_string(element->vr));
+    return get_value_str_multi(element, index);
+}
+
+
 const char *dcm_element_get_value_AE(const DcmElement *element, uint32_t index)
 {
     assert(element);
@@ -831,11 +1084,12 @@ const char *dcm_element_get_value_AS(const DcmElement *element, uint32_t index)
 }
 
 
-const char *dcm_element_get_value_AT(const DcmElement *element, uint32_t index)
+uint32_t dcm_element_get_value_AT(const DcmElement *element, uint32_t index)
 {
     assert(element);
     assert_vr(element, "AT");
-    return get_value_str_multi(element, index);
+    assert_value_index(element, index);
+    return element->value.ul_multi[index];
 }
 
 
@@ -1074,7 +1328,7 @@ static inline void print_element_value_AE(const DcmElement *element,
 static inline void print_element_value_AT(const DcmElement *element,
                                           uint32_t index)
 {
-    printf("%s", element->value.str_multi[index]);
+    printf("%08X", element->value.ul_multi[index]);
 }
 
 
@@ -1146,23 +1400,14 @@ static inline void print_element_value_UI(const DcmElement *element,
 
 DcmElement *dcm_element_create_FD(uint32_t tag, double value)
 {
-    uint32_t length = sizeof(double);
-    double *values = malloc(sizeof(double));
-    if (values == NULL) {
-        dcm_log_error("Creation of Data Element failed. "
-                      "Could not allocate memory.");
-        return NULL;
-    }
-    values[0] = value;
-    DcmElement *element = create_element(tag, "FD", length);
+    DcmElement *element = create_element(tag, "FD", sizeof(double));
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
         return NULL;
     }
-    element->value.fd_multi = values;
-    element->value_pointer = values;
+    element->storage.fd = value;
+    element->value.fd_multi = &element->storage.fd;
     element->vm = 1;
     return element;
 }
@@ -1177,11 +1422,10 @@ DcmElement *dcm_element_create_FD_multi(uint32_t tag,
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
+        dcm_free(values);
         return NULL;
     }
     element->value.fd_multi = values;
-    element->value_pointer = values;
     element->vm = vm;
     return element;
 }
@@ -1189,23 +1433,14 @@ DcmElement *dcm_element_create_FD_multi(uint32_t tag,
 
 DcmElement *dcm_element_create_FL(uint32_t tag, float value)
 {
-    uint32_t length = sizeof(double);
-    float *values = malloc(sizeof(float));
-    if (values == NULL) {
-        dcm_log_error("Creation of Data Element failed. "
-                      "Could not allocate memory.");
-        return NULL;
-    }
-    values[0] = value;
-    DcmElement *element = create_element(tag, "FL", length);
+    DcmElement *element = create_element(tag, "FL", sizeof(float));
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
         return NULL;
     }
-    element->value.fl_multi = values;
-    element->value_pointer = values;
+    element->storage.fl = value;
+    element->value.fl_multi = &element->storage.fl;
     element->vm = 1;
     return element;
 }
@@ -1220,11 +1455,10 @@ DcmElement *dcm_element_create_FL_multi(uint32_t tag,
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
+        dcm_free(values);
         return NULL;
     }
     element->value.fl_multi = values;
-    element->value_pointer = values;
     element->vm = vm;
     return element;
 }
@@ -1260,23 +1494,14 @@ DcmElement *dcm_element_create_IS_multi(uint32_t tag,
 
 DcmElement *dcm_element_create_SS(uint32_t tag, int16_t value)
 {
-    uint32_t length = sizeof(int16_t);
-    int16_t *values = malloc(sizeof(int16_t));
-    if (values == NULL) {
-        dcm_log_error("Creation of Data Element failed. "
-                      "Could not allocate memory.");
-        return NULL;
-    }
-    values[0] = value;
-    DcmElement *element = create_element(tag, "SS", length);
+    DcmElement *element = create_element(tag, "SS", sizeof(int16_t));
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
         return NULL;
     }
-    element->value.ss_multi = values;
-    element->value_pointer = values;
+    element->storage.ss = value;
+    element->value.ss_multi = &element->storage.ss;
     element->vm = 1;
     return element;
 }
@@ -1291,11 +1516,10 @@ DcmElement *dcm_element_create_SS_multi(uint32_t tag,
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
+        dcm_free(values);
         return NULL;
     }
     element->value.ss_multi = values;
-    element->value_pointer = values;
     element->vm = vm;
     return element;
 }
@@ -1303,23 +1527,14 @@ DcmElement *dcm_element_create_SS_multi(uint32_t tag,
 
 DcmElement *dcm_element_create_SL(uint32_t tag, int32_t value)
 {
-    uint32_t length = sizeof(int32_t);
-    int32_t *values = malloc(sizeof(int32_t));
-    if (values == NULL) {
-        dcm_log_error("Creation of Data Element failed. "
-                      "Could not allocate memory.");
-        return NULL;
-    }
-    values[0] = value;
-    DcmElement *element = create_element(tag, "SL", length);
+    DcmElement *element = create_element(tag, "SL", sizeof(int32_t));
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
         return NULL;
     }
-    element->value.sl_multi = values;
-    element->value_pointer = values;
+    element->storage.sl = value;
+    element->value.sl_multi = &element->storage.sl;
     element->vm = 1;
     return element;
 }
@@ -1334,11 +1549,10 @@ DcmElement *dcm_element_create_SL_multi(uint32_t tag,
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
+        dcm_free(values);
         return NULL;
     }
     element->value.sl_multi = values;
-    element->value_pointer = values;
     element->vm = vm;
     return element;
 }
@@ -1346,23 +1560,14 @@ DcmElement *dcm_element_create_SL_multi(uint32_t tag,
 
 DcmElement *dcm_element_create_SV(uint32_t tag, int64_t value)
 {
-    uint32_t length = sizeof(int64_t);
-    int64_t *values = malloc(sizeof(int64_t));
-    if (values == NULL) {
-        dcm_log_error("Creation of Data Element failed. "
-                      "Could not allocate memory.");
-        return NULL;
-    }
-    values[0] = value;
-    DcmElement *element = create_element(tag, "SV", length);
+    DcmElement *element = create_element(tag, "SV", sizeof(int64_t));
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
         return NULL;
     }
-    element->value.sv_multi = values;
-    element->value_pointer = values;
+    element->storage.sv = value;
+    element->value.sv_multi = &element->storage.sv;
     element->vm = 1;
     return element;
 }
@@ -1377,11 +1582,10 @@ DcmElement *dcm_element_create_SV_multi(uint32_t tag,
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
+        dcm_free(values);
         return NULL;
     }
     element->value.sv_multi = values;
-    element->value_pointer = values;
     element->vm = vm;
     return element;
 }
@@ -1389,23 +1593,14 @@ DcmElement *dcm_element_create_SV_multi(uint32_t tag,
 
 DcmElement *dcm_element_create_UL(uint32_t tag, uint32_t value)
 {
-    uint32_t length = sizeof(uint32_t);
-    uint32_t *values = malloc(sizeof(uint32_t));
-    if (values == NULL) {
-        dcm_log_error("Creation of Data Element failed. "
-                      "Could not allocate memory.");
-        return NULL;
-    }
-    values[0] = value;
-    DcmElement *element = create_element(tag, "UL", length);
+    DcmElement *element = create_element(tag, "UL", sizeof(uint32_t));
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
         return NULL;
     }
-    element->value.ul_multi = values;
-    element->value_pointer = values;
+    element->storage.ul = value;
+    element->value.ul_multi = &element->storage.ul;
     element->vm = 1;
     return element;
 }
@@ -1420,11 +1615,10 @@ DcmElement *dcm_element_create_UL_multi(uint32_t tag,
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
+        dcm_free(values);
         return NULL;
     }
     element->value.ul_multi = values;
-    element->value_pointer = values;
     element->vm = vm;
     return element;
 }
@@ -1432,23 +1626,14 @@ DcmElement *dcm_element_create_UL_multi(uint32_t tag,
 
 DcmElement *dcm_element_create_US(uint32_t tag, uint16_t value)
 {
-    uint32_t length = sizeof(uint16_t);
-    uint16_t *values = malloc(sizeof(uint16_t));
-    if (values == NULL) {
-        dcm_log_error("Creation of Data Element failed. "
-                      "Could not allocate memory.");
-        return NULL;
-    }
-    values[0] = value;
-    DcmElement *element = create_element(tag, "US", length);
+    DcmElement *element = create_element(tag, "US", sizeof(uint16_t));
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
         return NULL;
     }
-    element->value.us_multi = values;
-    element->value_pointer = values;
+    element->storage.us = value;
+    element->value.us_multi = &element->storage.us;
     element->vm = 1;
     return element;
 }
@@ -1462,11 +1647,10 @@ DcmElement *dcm_element_create_US_multi(uint32_t tag,
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
+        dcm_free(values);
         return NULL;
     }
     element->value.us_multi = values;
-    element->value_pointer = values;
     element->vm = vm;
     return element;
 }
@@ -1474,23 +1658,14 @@ DcmElement *dcm_element_create_US_multi(uint32_t tag,
 
 DcmElement *dcm_element_create_UV(uint32_t tag, uint64_t value)
 {
-    uint32_t length = sizeof(uint64_t);
-    uint64_t *values = malloc(sizeof(uint64_t));
-    if (values == NULL) {
-        dcm_log_error("Creation of Data Element failed. "
-                      "Could not allocate memory.");
-        return NULL;
-    }
-    values[0] = value;
-    DcmElement *element = create_element(tag, "UV", length);
+    DcmElement *element = create_element(tag, "UV", sizeof(uint64_t));
     if (element == NULL) {
         dcm_log_error("Creation of Data Element failed. "
                       "Could not allocate memory.");
-        free(values);
         return NULL;
     }
-    element->value.uv_multi = values;
-    element->value_pointer = values;
+    element->storage.uv = value;
+    element->value.uv_multi = &element->storage.uv;
     element->vm = 1;
     return element;
 }
@@ -1503,11 +1678,10 @@ DcmElement *dcm_element_create_UV_multi(uint32_t tag,
     uint32_t length = vm * sizeof(uint64_t);
     DcmElement *element = create_element(tag, "UV", length);
     if (element == NULL) {
-        free(values);
+        dcm_free(values);
         return NULL;
     }
     element->value.uv_multi = values;
-    element->value_pointer = values;
     element->vm = vm;
     return element;
 }
@@ -1598,7 +1772,6 @@ static void set_value_bytes(DcmElement *element, char *value)
     assert(element);
     assert(value);
     element->value.bytes = value;
-    element->value_pointer = value;
 }
 
 
@@ -1612,7 +1785,7 @@ DcmElement *dcm_element_create_OB(uint32_t tag, char *value, uint32_t length)
 {
     DcmElement *element = create_element(tag, "OB", length);
     if (element == NULL) {
-        free(value);
+        dcm_free(value);
         return NULL;
     }
     set_value_bytes(element, value);
@@ -1625,7 +1798,7 @@ DcmElement *dcm_element_create_OD(uint32_t tag, char *value, uint32_t length)
 {
     DcmElement *element = create_element(tag, "OD", length);
     if (element == NULL) {
-        free(value);
+        dcm_free(value);
         return NULL;
     }
     set_value_bytes(element, value);
@@ -1638,7 +1811,7 @@ DcmElement *dcm_element_create_OF(uint32_t tag, char *value, uint32_t length)
 {
     DcmElement *element = create_element(tag, "OF", length);
     if (element == NULL) {
-        free(value);
+        dcm_free(value);
         return NULL;
     }
     set_value_bytes(element, value);
@@ -1651,7 +1824,7 @@ DcmElement *dcm_element_create_OL(uint32_t tag, char *value, uint32_t length)
 {
     DcmElement *element = create_element(tag, "OL", length);
     if (element == NULL) {
-        free(value);
+        dcm_free(value);
         return NULL;
     }
     set_value_bytes(element, value);
@@ -1664,7 +1837,7 @@ DcmElement *dcm_element_create_OV(uint32_t tag, char *value, uint32_t length)
 {
     DcmElement *element = create_element(tag, "OV", length);
     if (element == NULL) {
-        free(value);
+        dcm_free(value);
         return NULL;
     }
     set_value_bytes(element, value);
@@ -1677,7 +1850,7 @@ DcmElement *dcm_element_create_OW(uint32_t tag, char *value, uint32_t length)
 {
     DcmElement *element = create_element(tag, "OW", length);
     if (element == NULL) {
-        free(value);
+        dcm_free(value);
         return NULL;
     }
     set_value_bytes(element, value);
@@ -1690,7 +1863,7 @@ DcmElement *dcm_element_create_UC(uint32_t tag, char *value, uint32_t length)
 {
     DcmElement *element = create_element(tag, "UC", length);
     if (element == NULL) {
-        free(value);
+        dcm_free(value);
         return NULL;
     }
     set_value_bytes(element, value);
@@ -1703,7 +1876,7 @@ DcmElement *dcm_element_create_UN(uint32_t tag, char *value, uint32_t length)
 {
     DcmElement *element = create_element(tag, "UN", length);
     if (element == NULL) {
-        free(value);
+        dcm_free(value);
         return NULL;
     }
     set_value_bytes(element, value);
@@ -1729,9 +1902,8 @@ DcmElement *dcm_element_create_UT(uint32_t tag, char *value)
 DcmElement *dcm_element_create_SQ(uint32_t tag, DcmSequence *value)
 {
     uint32_t length;
-    uint32_t i;
+    uint32_t i, j;
     DcmDataSet *item;
-    DcmElement *elem;
 
     uint32_t seq_length = dcm_sequence_count(value);
     length = 0;
@@ -1742,8 +1914,8 @@ DcmElement *dcm_element_create_SQ(uint32_t tag, DcmSequence *value)
             dcm_sequence_destroy(value);
             return NULL;
         }
-        for (elem = item->elements; elem; elem = elem->hh.next) {
-            length += elem->length;
+        for (j = 0; j < item->num_elements; j++) {
+            length += item->elements[j]->length;
         }
     }
 
@@ -1754,7 +1926,6 @@ DcmElement *dcm_element_create_SQ(uint32_t tag, DcmSequence *value)
         return NULL;
     }
     element->value.sq = value;
-    element->sequence_pointer = value;
     element->vm = 1;
 
     return element;
@@ -1893,14 +2064,24 @@ void dcm_element_print(const DcmElement *element, uint8_t indentation)
 DcmDataSet *dcm_dataset_create(void)
 {
     dcm_log_debug("Create Data Set.");
-    DcmDataSet *dataset = DCM_NEW(DcmDataSet);
+    DcmArena *arena = dcm_arena_current();
+    DcmDataSet *dataset = arena ?
+                          dcm_arena_alloc(arena, sizeof(DcmDataSet)) :
+                          DCM_NEW(DcmDataSet);
     if (dataset == NULL) {
         dcm_log_error("Creation of Data Set failed. "
                       "Could not allocate memory.");
         return NULL;
     }
+    dataset->tags = NULL;
     dataset->elements = NULL;
+    dataset->num_elements = 0;
+    dataset->capacity = 0;
     dataset->is_locked = false;
+    dataset->arena = arena;
+    if (arena) {
+        dcm_arena_retain(arena);
+    }
     return dataset;
 }
 
@@ -1917,7 +2098,9 @@ DcmDataSet *dcm_dataset_clone(const DcmDataSet *dataset)
 
     DcmElement *element;
     DcmElement *cloned_element;
-    for(element = dataset->elements; element; element = element->hh.next) {
+    uint32_t i;
+    for (i = 0; i < dataset->num_elements; i++) {
+        element = dataset->elements[i];
         cloned_element = dcm_element_clone(element);
         if (cloned_element == NULL) {
             dcm_log_error("Cloning of Data Set failed. "
@@ -1939,10 +2122,83 @@ DcmDataSet *dcm_dataset_clone(const DcmDataSet *dataset)
 }
 
 
+/**
+ * Find the position of a Tag in a Data Set.
+ *
+ * :return: Whether the Tag was found at the position or should be inserted
+ *          there
+ */
+static bool find_tag(const DcmDataSet *dataset, uint32_t tag, uint32_t *index)
+{
+    uint32_t low = 0;
+    uint32_t high = dataset->num_elements;
+
+    // Parsed Data Sets are built in ascending order of Tags
+    if (high > 0 && dataset->tags[high - 1] < tag) {
+        *index = high;
+        return false;
+    }
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (dataset->tags[middle] < tag) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *index = low;
+    return low < dataset->num_elements && dataset->tags[low] == tag;
+}
+
+
+static DcmElement *find_element(const DcmDataSet *dataset, uint32_t tag)
+{
+    uint32_t index;
+    if (find_tag(dataset, tag, &index)) {
+        return dataset->elements[index];
+    }
+    return NULL;
+}
+
+
+/**
+ * Resize the arrays of a Data Set, allocating them from its arena, if any.
+ */
+static bool resize_dataset(DcmDataSet *dataset, uint32_t capacity)
+{
+    DcmArena *previous = dcm_arena_enter(dataset->arena);
+    uint32_t *tags = dcm_malloc(capacity * sizeof(uint32_t));
+    DcmElement **elements = dcm_malloc(capacity * sizeof(DcmElement *));
+    if (tags == NULL || elements == NULL) {
+        dcm_free(tags);
+        dcm_free(elements);
+        dcm_arena_leave(previous);
+        return false;
+    }
+    if (dataset->num_elements > 0) {
+        memcpy(tags,
+               dataset->tags,
+               dataset->num_elements * sizeof(uint32_t));
+        memcpy(elements,
+               dataset->elements,
+               dataset->num_elements * sizeof(DcmElement *));
+    }
+    dcm_free(dataset->tags);
+    dcm_free(dataset->elements);
+    dcm_arena_leave(previous);
+
+    dataset->tags = tags;
+    dataset->elements = elements;
+    dataset->capacity = capacity;
+    return true;
+}
+
+
 bool dcm_dataset_insert(DcmDataSet *dataset, DcmElement *element)
 {
     assert(dataset);
     assert(element);
+    uint32_t index;
 
     dcm_log_debug("Insert Data Element '%08X' into Data Set.", element->tag);
     if (dataset->is_locked) {
@@ -1953,9 +2209,7 @@ bool dcm_dataset_insert(DcmDataSet *dataset, DcmElement *element)
         return false;
     }
 
-    DcmElement *matched_element;
-    HASH_FIND_INT(dataset->elements, &element->tag, matched_element);
-    if (matched_element) {
+    if (find_tag(dataset, element->tag, &index)) {
         dcm_log_warning("Inserting Data Element '%08X' into Data Set failed. "
                         "Element already exists.",
                         element->tag);
@@ -1963,7 +2217,29 @@ bool dcm_dataset_insert(DcmDataSet *dataset, DcmElement *element)
         return false;
     }
 
-    HASH_ADD_INT(dataset->elements, tag, element);
+    if (dataset->num_elements == dataset->capacity) {
+        uint32_t capacity = dataset->capacity ? 2 * dataset->capacity : 8;
+        if (!resize_dataset(dataset, capacity)) {
+            dcm_log_error("Inserting Data Element '%08X' into Data Set "
+                          "failed. Could not allocate memory.",
+                          element->tag);
+            dcm_element_destroy(element);
+            return false;
+        }
+    }
+
+    uint32_t num_following = dataset->num_elements - index;
+    if (num_following > 0) {
+        memmove(&dataset->tags[index + 1],
+                &dataset->tags[index],
+                num_following * sizeof(uint32_t));
+        memmove(&dataset->elements[index + 1],
+                &dataset->elements[index],
+                num_following * sizeof(DcmElement *));
+    }
+    dataset->tags[index] = element->tag;
+    dataset->elements[index] = element;
+    dataset->num_elements += 1;
 
     return true;
 }
@@ -1972,6 +2248,7 @@ bool dcm_dataset_insert(DcmDataSet *dataset, DcmElement *element)
 bool dcm_dataset_remove(DcmDataSet *dataset, uint32_t tag)
 {
     assert(dataset);
+    uint32_t index;
 
     dcm_log_debug("Remove Data Element '%08X' from Data Set.", tag);
     if (dataset->is_locked) {
@@ -1981,15 +2258,24 @@ bool dcm_dataset_remove(DcmDataSet *dataset, uint32_t tag)
         exit(1);
     }
 
-    DcmElement *matched_element = dcm_dataset_get(dataset, tag);
-    if (matched_element == NULL) {
+    if (!find_tag(dataset, tag, &index)) {
         dcm_log_warning("Removing Data Element '%08X' from Data Set failed. "
                         "Could not find Data Element.",
                         tag);
         return false;
     }
 
-    HASH_DEL(dataset->elements, matched_element);
+    DcmElement *matched_element = dataset->elements[index];
+    uint32_t num_following = dataset->num_elements - index - 1;
+    if (num_following > 0) {
+        memmove(&dataset->tags[index],
+                &dataset->tags[index + 1],
+                num_following * sizeof(uint32_t));
+        memmove(&dataset->elements[index],
+                &dataset->elements[index + 1],
+                num_following * sizeof(DcmElement *));
+    }
+    dataset->num_elements -= 1;
     dcm_element_destroy(matched_element);
 
     return true;
@@ -2002,11 +2288,12 @@ DcmElement *dcm_dataset_get_clone(const DcmDataSet *dataset, uint32_t tag)
     DcmElement *element;
 
     dcm_log_debug("Copy Data Element '%08X' from Data Set.", tag);
-    HASH_FIND_INT(dataset->elements, &tag, element);
+    element = find_element(dataset, tag);
     if (element == NULL) {
         dcm_log_warning("Getting Data Element '%08X' from Data Set failed. "
                         "Could not find Data Element.",
                         tag);
+        return NULL;
     }
     return dcm_element_clone(element);
 }
@@ -2018,11 +2305,15 @@ DcmElement *dcm_dataset_get(const DcmDataSet *dataset, uint32_t tag)
     DcmElement *element;
 
     dcm_log_debug("Get Data Element '%08X' from Data Set.", tag);
-    HASH_FIND_INT(dataset->elements, &tag, element);
+    element = find_element(dataset, tag);
     if (element == NULL) {
         dcm_log_warning("Getting Data Element '%08X' from Data Set failed. "
                         "Could not find Data Element.",
                         tag);
+        return NULL;
+    }
+    if (!load_element(element)) {
+        return NULL;
     }
 
     return element;
@@ -2033,10 +2324,12 @@ void dcm_dataset_foreach(const DcmDataSet *dataset,
                          void (*fn)(const DcmElement *element))
 {
     assert(dataset);
-    DcmElement *element;
+    uint32_t i;
 
-    for(element = dataset->elements; element; element = element->hh.next) {
-        fn(element);
+    for (i = 0; i < dataset->num_elements; i++) {
+        if (load_element(dataset->elements[i])) {
+            fn(dataset->elements[i]);
+        }
     }
 }
 
@@ -2045,11 +2338,8 @@ bool dcm_dataset_contains(const DcmDataSet *dataset, uint32_t tag)
 {
     assert(dataset);
 
-    const DcmElement *matched_element = dcm_dataset_get(dataset, tag);
-    if (matched_element == NULL) {
-        return false;
-    }
-    return true;
+    // Look up the Data Element without reading a value that is not yet loaded
+    return find_element(dataset, tag) != NULL;
 }
 
 
@@ -2057,24 +2347,21 @@ uint32_t dcm_dataset_count(const DcmDataSet *dataset)
 {
     assert(dataset);
 
-    uint32_t num_users = HASH_COUNT(dataset->elements);
-    return num_users;
+    return dataset->num_elements;
 }
 
 
 void dcm_dataset_copy_tags(const DcmDataSet *dataset, uint32_t *tags, uint32_t n)
 {
     assert(dataset);
-    uint32_t i;
-    DcmElement *element;
 
-    i = 0;
-    for(element = dataset->elements; element; element = element->hh.next) {
-        tags[i] = element->tag;
-        i += 1;
+    // Tags are kept in ascending order
+    if (n > dataset->num_elements) {
+        n = dataset->num_elements;
+    }
+    if (n > 0) {
+        memcpy(tags, dataset->tags, n * sizeof(uint32_t));
     }
-
-    qsort(tags, n, sizeof(uint32_t), compare_tags);
 }
 
 
@@ -2084,26 +2371,24 @@ void dcm_dataset_print(const DcmDataSet *dataset, uint8_t indentation)
     uint32_t i;
     DcmElement *element;
 
-    uint32_t n = dcm_dataset_count(dataset);
-    uint32_t *tags = DCM_ARRAY_ZEROS(n, uint32_t);
-    if (tags == NULL) {
-        dcm_log_error("Printing Data Set failed. "
-                      "Could not allocated memory.");
-        return;
-    }
-    dcm_dataset_copy_tags(dataset, tags, n);
-
-    for(i = 0; i < n; i++) {
-        element = dcm_dataset_get(dataset, tags[i]);
-        dcm_element_print(element, indentation);
+    for (i = 0; i < dataset->num_elements; i++) {
+        element = dcm_dataset_get(dataset, dataset->tags[i]);
+        if (element) {
+            dcm_element_print(element, indentation);
+        }
     }
-
-    free(tags);
 }
 
 
 void dcm_dataset_lock(DcmDataSet *dataset)
 {
+    // Locked Data Sets no longer grow and release unused capacity
+    if (!dataset->is_locked &&
+        dataset->arena == NULL &&
+        dataset->num_elements > 0 &&
+        dataset->num_elements < dataset->capacity) {
+        resize_dataset(dataset, dataset->num_elements);
+    }
     dataset->is_locked = true;
 }
 
@@ -2116,14 +2401,20 @@ bool dcm_dataset_is_locked(const DcmDataSet *dataset)
 
 void dcm_dataset_destroy(DcmDataSet *dataset)
 {
-    DcmElement *element, *tmp;
+    uint32_t i;
 
     if (dataset) {
-        HASH_ITER(hh, dataset->elements, element, tmp) {
-            HASH_DEL(dataset->elements, element);
-            dcm_element_destroy(element);
+        for (i = 0; i < dataset->num_elements; i++) {
+            dcm_element_destroy(dataset->elements[i]);
         }
-        free(dataset);
+        if (dataset->arena) {
+            // The arrays are released along with the arena
+            dcm_arena_release(dataset->arena);
+            return;
+        }
+        dcm_heap_free(dataset->tags);
+        dcm_heap_free(dataset->elements);
+        dcm_heap_free(dataset);
         dataset = NULL;
     }
 }
@@ -2133,7 +2424,10 @@ void dcm_dataset_destroy(DcmDataSet *dataset)
 
 DcmSequence *dcm_sequence_create(void)
 {
-    DcmSequence *seq = DCM_NEW(DcmSequence);
+    DcmArena *arena = dcm_arena_current();
+    DcmSequence *seq = arena ?
+                       dcm_arena_alloc(arena, sizeof(DcmSequence)) :
+                       DCM_NEW(DcmSequence);
     if (seq == NULL) {
         dcm_log_error("Creation of Sequence failed. "
                       "Could not allocate memory.");
@@ -2145,11 +2439,14 @@ DcmSequence *dcm_sequence_create(void)
     if (items == NULL) {
         dcm_log_error("Creation of Sequence failed. "
                       "Could not allocate memory.");
-        free(seq);
+        if (arena == NULL) {
+            dcm_heap_free(seq);
+        }
         return NULL;
     }
     seq->items = items;
     seq->is_locked = false;
+    seq->in_arena = arena != NULL;
 
     return seq;
 }
@@ -2171,13 +2468,12 @@ bool dcm_sequence_append(DcmSequence *seq, DcmDataSet *item)
     /**
      * The SequenceItem is just a thin wrapper around a DcmDataSet object as a
      * handle for utarray. Under the hood, utarray frees the memory of the
-     * DcmDataSet object when the array item gets destroyed. However, utarray
-     * does not free the memory of the item handle. Therefore, we need to free
-     * the memory of the item handle after the item was added to the array.
+     * DcmDataSet object when the array item gets destroyed. The handle itself
+     * is copied into the array and can thus live on the stack.
      */
-    struct SequenceItem *item_handle = create_sequence_item(item);
-    utarray_push_back(seq->items, item_handle);
-    free(item_handle);
+    struct SequenceItem item_handle = {item};
+    item->is_locked = true;
+    utarray_push_back(seq->items, &item_handle);
 
     return true;
 }
@@ -2271,57 +2567,947 @@ void dcm_sequence_destroy(DcmSequence *seq)
     if (seq) {
         utarray_free(seq->items);
         seq->items = NULL;
-        free(seq);
+        if (!seq->in_arena) {
+            dcm_heap_free(seq);
+        }
         seq = NULL;
     }
 }
 
 
-// Frames
+// Encoding
 
-DcmFrame *dcm_frame_create(uint32_t number,
-                           const char *data,
-                           uint32_t length,
-                           uint16_t rows,
-                           uint16_t columns,
-                           uint16_t samples_per_pixel,
-                           uint16_t bits_allocated,
-                           uint16_t bits_stored,
-                           uint16_t pixel_representation,
-                           uint16_t planar_configuration,
-                           const char *photometric_interpretation,
-                           const char *transfer_syntax_uid)
+/**
+ * Whether the Value Length of a Value Representation is encoded with four
+ * rather than two bytes in Explicit VR Transfer Syntaxes.
+ */
+static bool is_vr_long(const char *vr)
+{
+    if (strcmp(vr, "OB") == 0 ||
+        strcmp(vr, "OD") == 0 ||
+        strcmp(vr, "OF") == 0 ||
+        strcmp(vr, "OL") == 0 ||
+        strcmp(vr, "OV") == 0 ||
+        strcmp(vr, "OW") == 0 ||
+        strcmp(vr, "SQ") == 0 ||
+        strcmp(vr, "SV") == 0 ||
+        strcmp(vr, "UC") == 0 ||
+        strcmp(vr, "UN") == 0 ||
+        strcmp(vr, "UR") == 0 ||
+        strcmp(vr, "UT") == 0 ||
+        strcmp(vr, "UV") == 0) {
+        return true;
+    } else {
+        return false;
+    }
+}
+
+
+/**
+ * Size of the individual values of numeric Value Representations.
+ */
+static size_t get_vr_number_size(const char *vr)
+{
+    if (strcmp(vr, "SS") == 0 || strcmp(vr, "US") == 0) {
+        return 2;
+    } else if (strcmp(vr, "FL") == 0 ||
+               strcmp(vr, "SL") == 0 ||
+               strcmp(vr, "UL") == 0) {
+        return 4;
+    } else if (strcmp(vr, "FD") == 0 ||
+               strcmp(vr, "SV") == 0 ||
+               strcmp(vr, "UV") == 0) {
+        return 8;
+    } else {
+        return 0;
+    }
+}
+
+
+static void encode_uint16(char *data, uint16_t value)
+{
+    unsigned char *bytes = (unsigned char *) data;
+    bytes[0] = (unsigned char) value;
+    bytes[1] = (unsigned char) (value >> 8);
+}
+
+
+static void encode_uint32(char *data, uint32_t value)
+{
+    encode_uint16(data, (uint16_t) value);
+    encode_uint16(data + 2, (uint16_t) (value >> 16));
+}
+
+
+bool dcm_element_encode_header(uint32_t tag,
+                               const char *vr,
+                               uint32_t length,
+                               bool implicit,
+                               DcmWriteFunction write,
+                               void *writer)
+{
+    char header[12];
+
+    encode_uint16(header, (uint16_t) (tag >> 16));
+    encode_uint16(header + 2, (uint16_t) tag);
+    if (implicit || vr == NULL) {
+        encode_uint32(header + 4, length);
+        return write(writer, header, 8);
+    }
+
+    header[4] = vr[0];
+    header[5] = vr[1];
+    if (is_vr_long(vr)) {
+        header[6] = '\0';
+        header[7] = '\0';
+        encode_uint32(header + 8, length);
+        return write(writer, header, 12);
+    }
+    if (length > UINT16_MAX) {
+        dcm_log_error("Encoding of Data Element '%08X' failed. "
+                      "Value of length %u is too long for "
+                      "Value Representation '%s'.",
+                      tag, length, vr);
+        return false;
+    }
+    encode_uint16(header + 6, (uint16_t) length);
+    return write(writer, header, 8);
+}
+
+
+static bool encode_string_value(const DcmElement *element,
+                                bool implicit,
+                                DcmWriteFunction write,
+                                void *writer)
+{
+    size_t length = 0;
+    uint32_t i;
+
+    for (i = 0; i < element->vm; i++) {
+        length += strlen(element->value.str_multi[i]) + (i > 0);
+    }
+    length += length % 2;
+    if (length > UINT32_MAX - 1) {
+        dcm_log_error("Encoding of Data Element '%08X' failed. "
+                      "Value is too long.",
+                      element->tag);
+        return false;
+    }
+
+    // Short values, which are by far the most common, are encoded on the stack
+    char stack_buffer[256];
+    char *buffer = stack_buffer;
+    if (length > sizeof(stack_buffer)) {
+        buffer = dcm_heap_malloc(length);
+        if (buffer == NULL) {
+            dcm_log_error("Encoding of Data Element '%08X' failed. "
+                          "Could not allocate memory for value.",
+                          element->tag);
+            return false;
+        }
+    }
+
+    size_t n = 0;
+    for (i = 0; i < element->vm; i++) {
+        const char *value = element->value.str_multi[i];
+        if (i > 0) {
+            buffer[n++] = '\\';
+        }
+        size_t value_length = strlen(value);
+        memcpy(buffer + n, value, value_length);
+        n += value_length;
+    }
+    if (n < length) {
+        // Unique Identifiers are padded with a null character
+        buffer[n] = strcmp(element->vr, "UI") == 0 ? '\0' : ' ';
+    }
+
+    bool result = dcm_element_encode_header(element->tag,
+                                            element->vr,
+                                            (uint32_t) length,
+                                            implicit,
+                                            write,
+                                            writer) &&
+                  write(writer, buffer, length);
+    if (buffer != stack_buffer) {
+        dcm_heap_free(buffer);
+    }
+    return result;
+}
+
+
+static bool encode_number_value(const DcmElement *element,
+                                size_t size,
+                                bool implicit,
+                                DcmWriteFunction write,
+                                void *writer)
+{
+    uint32_t length = element->value.bytes ? element->vm * (uint32_t) size : 0;
+    if (!dcm_element_encode_header(element->tag,
+                                   element->vr,
+                                   length,
+                                   implicit,
+                                   write,
+                                   writer)) {
+        return false;
+    }
+    if (length == 0) {
+        return true;
+    }
+#ifdef WORDS_BIGENDIAN
+    // Values are held in the byte order of the host
+    char *buffer = dcm_heap_malloc(length);
+    if (buffer == NULL) {
+        dcm_log_error("Encoding of Data Element '%08X' failed. "
+                      "Could not allocate memory for value.",
+                      element->tag);
+        return false;
+    }
+    size_t i, j;
+    for (i = 0; i < length; i += size) {
+        for (j = 0; j < size; j++) {
+            buffer[i + j] = element->value.bytes[i + size - 1 - j];
+        }
+    }
+    bool result = write(writer, buffer, length);
+    dcm_heap_free(buffer);
+    return result;
+#else
+    return write(writer, element->value.bytes, length);
+#endif
+}
+
+
+static bool encode_tag_value(const DcmElement *element,
+                             bool implicit,
+                             DcmWriteFunction write,
+                             void *writer)
+{
+    uint32_t length = element->value.ul_multi ? element->vm * 4 : 0;
+    if (!dcm_element_encode_header(element->tag,
+                                   element->vr,
+                                   length,
+                                   implicit,
+                                   write,
+                                   writer)) {
+        return false;
+    }
+    // Attribute Tags are encoded as group number followed by element number
+    uint32_t i;
+    for (i = 0; i < length / 4; i++) {
+        char bytes[4];
+        encode_uint16(bytes, (uint16_t) (element->value.ul_multi[i] >> 16));
+        encode_uint16(bytes + 2, (uint16_t) element->value.ul_multi[i]);
+        if (!write(writer, bytes, sizeof(bytes))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static bool encode_bytes_value(const DcmElement *element,
+                               bool implicit,
+                               DcmWriteFunction write,
+                               void *writer)
+{
+    uint32_t length = element->value.bytes ? element->length : 0;
+    if (length == UINT32_MAX) {
+        dcm_log_error("Encoding of Data Element '%08X' failed. "
+                      "Value is too long.",
+                      element->tag);
+        return false;
+    }
+    uint32_t padding = length % 2;
+    if (!dcm_element_encode_header(element->tag,
+                                   element->vr,
+                                   length + padding,
+                                   implicit,
+                                   write,
+                                   writer)) {
+        return false;
+    }
+    if (length > 0 && !write(writer, element->value.bytes, length)) {
+        return false;
+    }
+    // Unlimited Characters are padded with a space, other values with zero
+    const char *pad = strcmp(element->vr, "UC") == 0 ? " " : "";
+    return padding == 0 || write(writer, pad, 1);
+}
+
+
+static bool encode_sequence_value(const DcmElement *element,
+                                  bool implicit,
+                                  DcmWriteFunction write,
+                                  void *writer)
+{
+    // Sequences and their Items are encoded with undefined length, so that
+    // their content is written in a single pass
+    if (!dcm_element_encode_header(element->tag,
+                                   element->vr,
+                                   0xFFFFFFFF,
+                                   implicit,
+                                   write,
+                                   writer)) {
+        return false;
+    }
+    uint32_t i;
+    uint32_t num_items = element->value.sq ?
+                         dcm_sequence_count(element->value.sq) : 0;
+    for (i = 0; i < num_items; i++) {
+        // Item, Item Delimitation and Sequence Delimitation Tags
+        struct SequenceItem *item = utarray_eltptr(element->value.sq->items, i);
+        if (!dcm_element_encode_header(0xFFFEE000, NULL, 0xFFFFFFFF,
+                                       implicit, write, writer) ||
+            !dcm_dataset_encode(item->dataset, implicit, 0, 0xFFFFFFFF,
+                                write, writer) ||
+            !dcm_element_encode_header(0xFFFEE00D, NULL, 0,
+                                       implicit, write, writer)) {
+            return false;
+        }
+    }
+    return dcm_element_encode_header(0xFFFEE0DD, NULL, 0,
+                                     implicit, write, writer);
+}
+
+
+static bool encode_element(const DcmElement *element,
+                           bool implicit,
+                           DcmWriteFunction write,
+                           void *writer)
+{
+    if (!load_element(element)) {
+        return false;
+    }
+
+    size_t size = get_vr_number_size(element->vr);
+    if (strcmp(element->vr, "SQ") == 0) {
+        return encode_sequence_value(element, implicit, write, writer);
+    } else if (is_vr_string(element->vr)) {
+        return encode_string_value(element, implicit, write, writer);
+    } else if (strcmp(element->vr, "AT") == 0) {
+        return encode_tag_value(element, implicit, write, writer);
+    } else if (size > 0) {
+        return encode_number_value(element, size, implicit, write, writer);
+    } else if (is_vr_bytes(element->vr)) {
+        return encode_bytes_value(element, implicit, write, writer);
+    }
+
+    dcm_log_error("Encoding of Data Element '%08X' failed. "
+                  "Value Representation '%s' is not supported.",
+                  element->tag, element->vr);
+    return false;
+}
+
+
+bool dcm_dataset_encode(const DcmDataSet *dataset,
+                        bool implicit,
+                        uint32_t first_tag,
+                        uint32_t last_tag,
+                        DcmWriteFunction write,
+                        void *writer)
+{
+    assert(dataset);
+    uint32_t i;
+
+    // Data Elements are held in ascending order of their tags, which is the
+    // order in which they must be encoded
+    for (i = 0; i < dataset->num_elements; i++) {
+        uint32_t tag = dataset->tags[i];
+        if (tag < first_tag) {
+            continue;
+        }
+        if (tag > last_tag) {
+            break;
+        }
+        if (!encode_element(dataset->elements[i], implicit, write, writer)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Queries
+
+static bool parse_query_step(const char *path,
+                             const char *segment,
+                             size_t length,
+                             struct QueryStep *step)
+{
+    char name[64];
+    char *end;
+
+    size_t name_length = strcspn(segment, "[.");
+    if (name_length > length) {
+        name_length = length;
+    }
+    if (name_length == 0 || name_length >= sizeof(name)) {
+        dcm_log_error("Creation of Query failed. "
+                      "Path '%s' contains an invalid Attribute.", path);
+        return false;
+    }
+    memcpy(name, segment, name_length);
+    name[name_length] = '\0';
+
+    // Attributes are given either by Keyword or by Tag as hexadecimal number
+    if (name_length == 8 && strspn(name, "0123456789abcdefABCDEF") == 8) {
+        step->tag = (uint32_t) strtoul(name, NULL, 16);
+    } else if (!dcm_dict_lookup_tag(name, &step->tag)) {
+        dcm_log_error("Creation of Query failed. "
+                      "Path '%s' contains unknown Keyword '%s'.",
+                      path, name);
+        return false;
+    }
+
+    step->item = QUERY_ALL_ITEMS;
+    if (name_length == length) {
+        return true;
+    }
+    const char *index = segment + name_length + 1;
+    const char *last = segment + length - 1;
+    if (*last != ']' || index == last) {
+        dcm_log_error("Creation of Query failed. "
+                      "Path '%s' contains an invalid Item index.", path);
+        return false;
+    }
+    if (index[0] == '*' && index + 1 == last) {
+        return true;
+    }
+    if (!isdigit((unsigned char) index[0])) {
+        dcm_log_error("Creation of Query failed. "
+                      "Path '%s' contains an invalid Item index.", path);
+        return false;
+    }
+    step->item = (int64_t) strtoul(index, &end, 10);
+    if (end != last || step->item > UINT32_MAX) {
+        dcm_log_error("Creation of Query failed. "
+                      "Path '%s' contains an invalid Item index.", path);
+        return false;
+    }
+    return true;
+}
+
+
+DcmQuery *dcm_query_create(const char *path)
+{
+    uint32_t i;
+    const char *c;
+
+    uint32_t num_steps = 1;
+    for (c = path; *c; c++) {
+        if (*c == '.') {
+            num_steps += 1;
+        }
+    }
+
+    DcmQuery *query = DCM_NEW(DcmQuery);
+    if (query == NULL) {
+        dcm_log_error("Creation of Query failed. "
+                      "Could not allocate memory.");
+        return NULL;
+    }
+    query->steps = DCM_ARRAY_ZEROS(num_steps, struct QueryStep);
+    if (query->steps == NULL) {
+        dcm_log_error("Creation of Query failed. "
+                      "Could not allocate memory.");
+        dcm_heap_free(query);
+        return NULL;
+    }
+    query->num_steps = num_steps;
+
+    const char *segment = path;
+    for (i = 0; i < num_steps; i++) {
+        size_t length = strcspn(segment, ".");
+        if (!parse_query_step(path, segment, length, &query->steps[i])) {
+            dcm_query_destroy(query);
+            return NULL;
+        }
+        segment += length + 1;
+    }
+
+    const char *last = strrchr(path, '.');
+    if (strchr(last ? last : path, '[')) {
+        dcm_log_error("Creation of Query failed. "
+                      "The last Attribute of path '%s' cannot be indexed.",
+                      path);
+        dcm_query_destroy(query);
+        return NULL;
+    }
+
+    return query;
+}
+
+
+/**
+ * Call a function for each Data Element that is selected by a query.
+ */
+static void evaluate_query(const DcmQuery *query,
+                           uint32_t step,
+                           const DcmDataSet *dataset,
+                           void (*visit)(const DcmElement *element,
+                                         uint32_t index,
+                                         void *context),
+                           void *context,
+                           uint32_t *count)
+{
+    uint32_t i;
+
+    DcmElement *element = find_element(dataset, query->steps[step].tag);
+    if (element == NULL || !load_element(element)) {
+        return;
+    }
+    if (step + 1 == query->num_steps) {
+        visit(element, *count, context);
+        *count += 1;
+        return;
+    }
+
+    if (strcmp(element->vr, "SQ") != 0 || element->value.sq == NULL) {
+        return;
+    }
+    UT_array *items = element->value.sq->items;
+    uint32_t first = 0;
+    uint32_t last = utarray_len(items);
+    if (query->steps[step].item != QUERY_ALL_ITEMS) {
+        first = (uint32_t) query->steps[step].item;
+        if (first >= last) {
+            return;
+        }
+        last = first + 1;
+    }
+    for (i = first; i < last; i++) {
+        struct SequenceItem *item = utarray_eltptr(items, i);
+        evaluate_query(query, step + 1, item->dataset, visit, context, count);
+    }
+}
+
+
+struct ElementResults {
+    const DcmElement **elements;
+    uint32_t capacity;
+};
+
+
+static void collect_element(const DcmElement *element,
+                            uint32_t index,
+                            void *context)
+{
+    struct ElementResults *results = (struct ElementResults *) context;
+    if (index < results->capacity) {
+        results->elements[index] = element;
+    }
+}
+
+
+uint32_t dcm_query_evaluate(const DcmQuery *query,
+                            const DcmDataSet *dataset,
+                            const DcmElement **elements,
+                            uint32_t capacity)
+{
+    assert(query);
+    assert(dataset);
+    uint32_t count = 0;
+
+    struct ElementResults results = {elements, capacity};
+    evaluate_query(query, 0, dataset, collect_element, &results, &count);
+    return count;
+}
+
+
+/**
+ * Parse a decimal string of Value Representation DS or IS.
+ *
+ * Numbers with up to 15 significant digits and a decimal exponent of at most
+ * 22 are exactly representable as mantissa and power of ten, so that a
+ * single multiplication or division rounds them correctly. All other strings
+ * are left to strtod().
+ */
+static double parse_decimal(const char *string)
+{
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char *c = string;
+    uint64_t mantissa = 0;
+    int num_digits = 0;
+    int exponent = 0;
+    bool negative = false;
+    bool has_digits = false;
+    char *end;
+
+    while (*c == ' ') {
+        c++;
+    }
+    if (*c == '+' || *c == '-') {
+        negative = *c == '-';
+        c++;
+    }
+    for (; *c >= '0' && *c <= '9'; c++) {
+        has_digits = true;
+        if (mantissa == 0 && *c == '0') {
+            continue;
+        }
+        if (num_digits == 15) {
+            goto fallback;
+        }
+        mantissa = mantissa * 10 + (uint64_t) (*c - '0');
+        num_digits += 1;
+    }
+    if (*c == '.') {
+        for (c++; *c >= '0' && *c <= '9'; c++) {
+            has_digits = true;
+            if (mantissa == 0 && *c == '0') {
+                exponent -= 1;
+                continue;
+            }
+            if (num_digits == 15) {
+                goto fallback;
+            }
+            mantissa = mantissa * 10 + (uint64_t) (*c - '0');
+            num_digits += 1;
+            exponent -= 1;
+        }
+    }
+    if (!has_digits) {
+        goto fallback;
+    }
+    if (*c == 'e' || *c == 'E') {
+        int sign = 1;
+        int value = 0;
+        c++;
+        if (*c == '+' || *c == '-') {
+            sign = *c == '-' ? -1 : 1;
+            c++;
+        }
+        if (*c < '0' || *c > '9') {
+            goto fallback;
+        }
+        for (; *c >= '0' && *c <= '9'; c++) {
+            if (value > 1000) {
+                goto fallback;
+            }
+            value = value * 10 + (*c - '0');
+        }
+        exponent += sign * value;
+    }
+    while (*c == ' ') {
+        c++;
+    }
+    if (*c != '\0') {
+        goto fallback;
+    }
+
+    double number = (double) mantissa;
+    if (mantissa != 0) {
+        if (exponent < -22 || exponent > 22) {
+            goto fallback;
+        }
+        if (exponent < 0) {
+            number /= powers[-exponent];
+        } else {
+            number *= powers[exponent];
+        }
+    }
+    return negative ? -number : number;
+
+fallback:
+    number = strtod(string, &end);
+    return end == string ? NAN : number;
+}
+
+
+/**
+ * Get the first value of a Data Element as number.
+ */
+static double get_number(const DcmElement *element)
+{
+    if (element->vm == 0 || element->value.bytes == NULL) {
+        return NAN;
+    }
+    if (strcmp(element->vr, "FD") == 0) {
+        return element->value.fd_multi[0];
+    } else if (strcmp(element->vr, "FL") == 0) {
+        return element->value.fl_multi[0];
+    } else if (strcmp(element->vr, "SS") == 0) {
+        return element->value.ss_multi[0];
+    } else if (strcmp(element->vr, "SL") == 0) {
+        return element->value.sl_multi[0];
+    } else if (strcmp(element->vr, "SV") == 0) {
+        return (double) element->value.sv_multi[0];
+    } else if (strcmp(element->vr, "US") == 0) {
+        return element->value.us_multi[0];
+    } else if (strcmp(element->vr, "UL") == 0) {
+        return element->value.ul_multi[0];
+    } else if (strcmp(element->vr, "UV") == 0) {
+        return (double) element->value.uv_multi[0];
+    } else if (strcmp(element->vr, "DS") == 0 ||
+               strcmp(element->vr, "IS") == 0) {
+        return parse_decimal(element->value.str_multi[0]);
+    }
+    return NAN;
+}
+
+
+struct NumberResults {
+    double *values;
+    uint32_t capacity;
+};
+
+
+static void collect_number(const DcmElement *element,
+                           uint32_t index,
+                           void *context)
+{
+    struct NumberResults *results = (struct NumberResults *) context;
+    if (index < results->capacity) {
+        results->values[index] = get_number(element);
+    }
+}
+
+
+uint32_t dcm_query_evaluate_numbers(const DcmQuery *query,
+                                    const DcmDataSet *dataset,
+                                    double *values,
+                                    uint32_t capacity)
+{
+    assert(query);
+    assert(dataset);
+    uint32_t count = 0;
+
+    struct NumberResults results = {values, capacity};
+    evaluate_query(query, 0, dataset, collect_number, &results, &count);
+    return count;
+}
+
+
+/**
+ * Get the first value of the first Data Element selected by a Query.
+ */
+static bool query_first_number(const DcmQuery *query,
+                               const DcmDataSet *dataset,
+                               double *value)
+{
+    uint32_t count = 0;
+
+    struct NumberResults results = {value, 1};
+    evaluate_query(query, 0, dataset, collect_number, &results, &count);
+    return count > 0;
+}
+
+
+/**
+ * Get the Item of a Functional Groups Sequence.
+ */
+static DcmDataSet *get_functional_groups(const DcmDataSet *dataset,
+                                         uint32_t tag,
+                                         uint32_t index)
+{
+    DcmElement *element = find_element(dataset, tag);
+    if (element == NULL ||
+        !load_element(element) ||
+        strcmp(element->vr, "SQ") != 0 ||
+        element->value.sq == NULL ||
+        index >= utarray_len(element->value.sq->items)) {
+        return NULL;
+    }
+    struct SequenceItem *item = utarray_eltptr(element->value.sq->items,
+                                               index);
+    return item->dataset;
+}
+
+
+/**
+ * Columns that receive the values of Functional Group Attributes, either as
+ * numbers or as integers.
+ */
+struct FrameColumns {
+    double *const *numbers;
+    int32_t *const *integers;
+};
+
+
+static void store_frame_value(const struct FrameColumns *columns,
+                              uint32_t query_index,
+                              uint32_t frame_index,
+                              double value)
+{
+    if (columns->numbers) {
+        columns->numbers[query_index][frame_index] = value;
+    } else if (!(value >= INT32_MIN && value <= INT32_MAX)) {
+        // Negated comparisons also reject NaN
+        columns->integers[query_index][frame_index] = INT32_MIN;
+    } else {
+        columns->integers[query_index][frame_index] = (int32_t) value;
+    }
+}
+
+
+/**
+ * Evaluate all Queries for each Frame in a single pass over the Per-frame
+ * Functional Groups Sequence.
+ */
+static uint32_t get_frame_values(const DcmDataSet *dataset,
+                                 const DcmQuery *const *queries,
+                                 uint32_t num_queries,
+                                 const struct FrameColumns *columns,
+                                 uint32_t capacity)
+{
+    uint32_t i, j;
+    double value;
+
+    uint32_t num_frames = 0;
+    DcmElement *element = find_element(dataset, 0x52009230);
+    if (element &&
+        load_element(element) &&
+        strcmp(element->vr, "SQ") == 0 &&
+        element->value.sq) {
+        num_frames = utarray_len(element->value.sq->items);
+    } else {
+        // All frames share their Functional Groups
+        element = find_element(dataset, 0x00280008);
+        if (element && load_element(element)) {
+            value = get_number(element);
+            if (value >= 1 && value <= UINT32_MAX) {
+                num_frames = (uint32_t) value;
+            }
+        }
+    }
+    uint32_t num_values = num_frames < capacity ? num_frames : capacity;
+    if (num_values == 0 || num_queries == 0) {
+        return num_frames;
+    }
+
+    double *shared_values = DCM_ARRAY_ZEROS(num_queries, double);
+    if (shared_values == NULL) {
+        dcm_log_error("Extraction of frame values failed. "
+                      "Could not allocate memory.");
+        return 0;
+    }
+    const DcmDataSet *shared = get_functional_groups(dataset, 0x52009229, 0);
+    for (j = 0; j < num_queries; j++) {
+        shared_values[j] = NAN;
+        if (shared) {
+            query_first_number(queries[j], shared, &shared_values[j]);
+        }
+    }
+
+    for (i = 0; i < num_values; i++) {
+        const DcmDataSet *item = get_functional_groups(dataset, 0x52009230, i);
+        for (j = 0; j < num_queries; j++) {
+            if (item == NULL ||
+                !query_first_number(queries[j], item, &value)) {
+                value = shared_values[j];
+            }
+            store_frame_value(columns, j, i, value);
+        }
+    }
+    dcm_heap_free(shared_values);
+
+    return num_frames;
+}
+
+
+uint32_t dcm_dataset_get_frame_numbers(const DcmDataSet *dataset,
+                                       const DcmQuery *const *queries,
+                                       uint32_t num_queries,
+                                       double *const *columns,
+                                       uint32_t capacity)
+{
+    assert(dataset);
+    assert(queries);
+    assert(columns);
+
+    struct FrameColumns frame_columns = {columns, NULL};
+    return get_frame_values(dataset,
+                            queries,
+                            num_queries,
+                            &frame_columns,
+                            capacity);
+}
+
+
+uint32_t dcm_dataset_get_frame_integers(const DcmDataSet *dataset,
+                                        const DcmQuery *const *queries,
+                                        uint32_t num_queries,
+                                        int32_t *const *columns,
+                                        uint32_t capacity)
+{
+    assert(dataset);
+    assert(queries);
+    assert(columns);
+
+    struct FrameColumns frame_columns = {NULL, columns};
+    return get_frame_values(dataset,
+                            queries,
+                            num_queries,
+                            &frame_columns,
+                            capacity);
+}
+
+
+void dcm_query_destroy(DcmQuery *query)
+{
+    if (query) {
+        dcm_heap_free(query->steps);
+        dcm_heap_free(query);
+    }
+}
+
+
+// Frames
+
+static bool check_frame(const char *data,
+                        uint32_t length,
+                        uint16_t bits_allocated,
+                        uint16_t bits_stored,
+                        uint16_t pixel_representation,
+                        uint16_t planar_configuration)
 {
     if (data == NULL || length == 0) {
         dcm_log_error("Constructing Frame Item failed. "
                       "Pixel data cannot be empty.");
-        return NULL;
+        return false;
     }
     if (!(bits_allocated == 1 || bits_allocated % 8 == 0)) {
         dcm_log_error("Constructing Frame Item failed. "
                       "Wrong number of bits allocated.");
-        free((char *)data);
-        return NULL;
+        return false;
     }
-    if (!(bits_stored == 1 || bits_stored % 8 == 0)) {
+    // Stored bits need not fill whole bytes, such as 12 bits in 16
+    if (bits_stored == 0 || bits_stored > bits_allocated) {
         dcm_log_error("Constructing Frame Item failed. "
                       "Wrong number of bits stored.");
-        free((char *)data);
-        return NULL;
+        return false;
     }
     if (!(pixel_representation == 0 || pixel_representation == 1)) {
         dcm_log_error("Constructing Frame Item failed. "
                       "Wrong pixel representation.");
-        free((char *)data);
-        return NULL;
+        return false;
     }
     if (!(planar_configuration == 0 || planar_configuration == 1)) {
         dcm_log_error("Constructing Frame Item failed. "
                       "Wrong planar configuration.");
-        free((char *)data);
-        return NULL;
+        return false;
     }
+    return true;
+}
+
 
+static DcmFrame *create_frame(uint32_t number,
+                              const char *data,
+                              uint32_t length,
+                              uint16_t rows,
+                              uint16_t columns,
+                              uint16_t samples_per_pixel,
+                              uint16_t bits_allocated,
+                              uint16_t bits_stored,
+                              uint16_t pixel_representation,
+                              uint16_t planar_configuration,
+                              const char *photometric_interpretation,
+                              const char *transfer_syntax_uid)
+{
     DcmFrame *frame = DCM_NEW(DcmFrame);
     if (frame == NULL) {
         dcm_log_error("Constructing Frame Item failed. "
@@ -2341,6 +3527,96 @@ DcmFrame *dcm_frame_create(uint32_t number,
     frame->planar_configuration = planar_configuration;
     frame->photometric_interpretation = photometric_interpretation;
     frame->transfer_syntax_uid = transfer_syntax_uid;
+    frame->owner = NULL;
+    frame->release = NULL;
+
+    return frame;
+}
+
+
+DcmFrame *dcm_frame_create(uint32_t number,
+                           const char *data,
+                           uint32_t length,
+                           uint16_t rows,
+                           uint16_t columns,
+                           uint16_t samples_per_pixel,
+                           uint16_t bits_allocated,
+                           uint16_t bits_stored,
+                           uint16_t pixel_representation,
+                           uint16_t planar_configuration,
+                           const char *photometric_interpretation,
+                           const char *transfer_syntax_uid)
+{
+    if (!check_frame(data,
+                     length,
+                     bits_allocated,
+                     bits_stored,
+                     pixel_representation,
+                     planar_configuration)) {
+        dcm_heap_free((char *)data);
+        return NULL;
+    }
+
+    return create_frame(number,
+                        data,
+                        length,
+                        rows,
+                        columns,
+                        samples_per_pixel,
+                        bits_allocated,
+                        bits_stored,
+                        pixel_representation,
+                        planar_configuration,
+                        photometric_interpretation,
+                        transfer_syntax_uid);
+}
+
+
+DcmFrame *dcm_frame_create_view(uint32_t number,
+                                const char *data,
+                                uint32_t length,
+                                uint16_t rows,
+                                uint16_t columns,
+                                uint16_t samples_per_pixel,
+                                uint16_t bits_allocated,
+                                uint16_t bits_stored,
+                                uint16_t pixel_representation,
+                                uint16_t planar_configuration,
+                                const char *photometric_interpretation,
+                                const char *transfer_syntax_uid,
+                                void *owner,
+                                void (*release)(void *owner))
+{
+    assert(release);
+
+    if (!check_frame(data,
+                     length,
+                     bits_allocated,
+                     bits_stored,
+                     pixel_representation,
+                     planar_configuration)) {
+        release(owner);
+        return NULL;
+    }
+
+    DcmFrame *frame = create_frame(number,
+                                   data,
+                                   length,
+                                   rows,
+                                   columns,
+                                   samples_per_pixel,
+                                   bits_allocated,
+                                   bits_stored,
+                                   pixel_representation,
+                                   planar_configuration,
+                                   photometric_interpretation,
+                                   transfer_syntax_uid);
+    if (frame == NULL) {
+        release(owner);
+        return NULL;
+    }
+    frame->owner = owner;
+    frame->release = release;
 
     return frame;
 }
@@ -2426,19 +3702,297 @@ const char *dcm_frame_get_value(const DcmFrame *frame)
 }
 
 
+/**
+ * Check that a Frame holds native samples that can be converted.
+ */
+static bool check_native_frame(const DcmFrame *frame,
+                               uint16_t max_bits_allocated,
+                               size_t *num_samples)
+{
+    if (dcm_is_encapsulated_transfer_syntax(frame->transfer_syntax_uid)) {
+        dcm_log_error("Converting Frame #%u failed. "
+                      "Pixel Data is encapsulated.",
+                      frame->number);
+        return false;
+    }
+    if ((frame->bits_allocated != 8 &&
+         frame->bits_allocated != 16 &&
+         frame->bits_allocated != 32) ||
+        frame->bits_allocated > max_bits_allocated) {
+        dcm_log_error("Converting Frame #%u failed. "
+                      "Bits Allocated %u is not supported.",
+                      frame->number, frame->bits_allocated);
+        return false;
+    }
+    if (frame->bits_stored == 0 ||
+        frame->bits_stored > frame->bits_allocated ||
+        frame->high_bit >= frame->bits_allocated ||
+        frame->high_bit + 1 < frame->bits_stored) {
+        dcm_log_error("Converting Frame #%u failed. "
+                      "Bits Stored %u and High Bit %u do not fit into "
+                      "Bits Allocated %u.",
+                      frame->number,
+                      frame->bits_stored,
+                      frame->high_bit,
+                      frame->bits_allocated);
+        return false;
+    }
+    *num_samples = (size_t) frame->rows * frame->columns *
+                   frame->samples_per_pixel;
+    if (frame->length < *num_samples * (frame->bits_allocated / 8)) {
+        dcm_log_error("Converting Frame #%u failed. "
+                      "Frame is shorter than its image description implies.",
+                      frame->number);
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Transpose a matrix of samples, which turns color planes into pixels
+ * and vice versa.
+ *
+ * The loops are kept free of function calls and aliasing, so that the
+ * compiler is able to vectorize them.
+ */
+#define DEFINE_TRANSPOSE(name, type)                                        \
+static void name(const char *restrict source,                               \
+                 char *restrict destination,                                \
+                 size_t num_rows,                                           \
+                 size_t num_columns)                                        \
+{                                                                           \
+    size_t row, column;                                                     \
+    for (row = 0; row < num_rows; row++) {                                  \
+        for (column = 0; column < num_columns; column++) {                  \
+            type value;                                                     \
+            memcpy(&value,                                                  \
+                   source + (row * num_columns + column) * sizeof(type),   \
+                   sizeof(type));                                           \
+            memcpy(destination + (column * num_rows + row) * sizeof(type), \
+                   &value,                                                  \
+                   sizeof(type));                                           \
+        }                                                                   \
+    }                                                                       \
+}
+
+DEFINE_TRANSPOSE(transpose_uint8, uint8_t)
+DEFINE_TRANSPOSE(transpose_uint16, uint16_t)
+DEFINE_TRANSPOSE(transpose_uint32, uint32_t)
+
+
+static void swap_bytes(unsigned char *restrict bytes,
+                       size_t num_samples,
+                       size_t sample_size)
+{
+    size_t i;
+
+    if (sample_size == 2) {
+        for (i = 0; i < num_samples; i++) {
+            unsigned char byte = bytes[2 * i];
+            bytes[2 * i] = bytes[2 * i + 1];
+            bytes[2 * i + 1] = byte;
+        }
+    } else if (sample_size == 4) {
+        for (i = 0; i < num_samples; i++) {
+            unsigned char byte0 = bytes[4 * i];
+            unsigned char byte1 = bytes[4 * i + 1];
+            bytes[4 * i] = bytes[4 * i + 3];
+            bytes[4 * i + 1] = bytes[4 * i + 2];
+            bytes[4 * i + 2] = byte1;
+            bytes[4 * i + 3] = byte0;
+        }
+    }
+}
+
+
+/**
+ * Keep the stored bits of Little Endian samples and shift signed samples
+ * by half of their range, which amounts to flipping their sign bit.
+ */
+static void make_unsigned(unsigned char *restrict bytes,
+                          size_t num_samples,
+                          const DcmFrame *frame)
+{
+    unsigned shift = frame->high_bit + 1 - frame->bits_stored;
+    uint32_t mask = (uint32_t) (((uint64_t) 1 << frame->bits_stored) - 1);
+    uint32_t sign = frame->pixel_representation == 1 ?
+                    (uint32_t) 1 << (frame->bits_stored - 1) : 0;
+    size_t i;
+
+    if (frame->bits_allocated == 8) {
+        for (i = 0; i < num_samples; i++) {
+            uint32_t value = bytes[i];
+            bytes[i] = (unsigned char) (((value >> shift) & mask) ^ sign);
+        }
+    } else if (frame->bits_allocated == 16) {
+        for (i = 0; i < num_samples; i++) {
+            uint32_t value = bytes[2 * i] | ((uint32_t) bytes[2 * i + 1] << 8);
+            value = ((value >> shift) & mask) ^ sign;
+            bytes[2 * i] = (unsigned char) value;
+            bytes[2 * i + 1] = (unsigned char) (value >> 8);
+        }
+    } else {
+        for (i = 0; i < num_samples; i++) {
+            uint32_t value = ((uint32_t) bytes[4 * i] |
+                              ((uint32_t) bytes[4 * i + 1] << 8) |
+                              ((uint32_t) bytes[4 * i + 2] << 16) |
+                              ((uint32_t) bytes[4 * i + 3] << 24));
+            value = ((value >> shift) & mask) ^ sign;
+            bytes[4 * i] = (unsigned char) value;
+            bytes[4 * i + 1] = (unsigned char) (value >> 8);
+            bytes[4 * i + 2] = (unsigned char) (value >> 16);
+            bytes[4 * i + 3] = (unsigned char) (value >> 24);
+        }
+    }
+}
+
+
+bool dcm_frame_convert(const DcmFrame *frame,
+                       uint32_t flags,
+                       char *buffer,
+                       size_t size)
+{
+    assert(frame);
+    assert(buffer);
+    size_t num_samples;
+
+    if (!check_native_frame(frame, 32, &num_samples)) {
+        return false;
+    }
+    size_t sample_size = frame->bits_allocated / 8;
+    size_t length = num_samples * sample_size;
+    if (size < length) {
+        dcm_log_error("Converting Frame #%u failed. "
+                      "Buffer of %zu bytes is smaller than %zu bytes.",
+                      frame->number, size, length);
+        return false;
+    }
+
+    size_t num_pixels = (size_t) frame->rows * frame->columns;
+    bool is_planar = frame->samples_per_pixel > 1 &&
+                     frame->planar_configuration == 1;
+    bool want_planar = frame->samples_per_pixel > 1 &&
+                       (flags & DCM_CONVERT_PLANAR);
+    if (is_planar == want_planar) {
+        memcpy(buffer, frame->data, length);
+    } else {
+        // Planes of samples become pixels of samples and vice versa
+        size_t num_rows = is_planar ? frame->samples_per_pixel : num_pixels;
+        size_t num_columns = is_planar ? num_pixels : frame->samples_per_pixel;
+        if (sample_size == 1) {
+            transpose_uint8(frame->data, buffer, num_rows, num_columns);
+        } else if (sample_size == 2) {
+            transpose_uint16(frame->data, buffer, num_rows, num_columns);
+        } else {
+            transpose_uint32(frame->data, buffer, num_rows, num_columns);
+        }
+    }
+
+    if (flags & DCM_CONVERT_UNSIGNED) {
+        make_unsigned((unsigned char *) buffer, num_samples, frame);
+    }
+    if (flags & DCM_CONVERT_SWAP_BYTES) {
+        swap_bytes((unsigned char *) buffer, num_samples, sample_size);
+    }
+    return true;
+}
+
+
+bool dcm_frame_apply_window(const DcmFrame *frame,
+                            double center,
+                            double width,
+                            uint8_t *buffer,
+                            size_t size)
+{
+    assert(frame);
+    assert(buffer);
+    size_t num_samples;
+    size_t i;
+
+    if (!check_native_frame(frame, 16, &num_samples)) {
+        return false;
+    }
+    if (!(width >= 1.0)) {
+        dcm_log_error("Applying window to Frame #%u failed. "
+                      "Window Width must be at least 1.",
+                      frame->number);
+        return false;
+    }
+    if (size < num_samples) {
+        dcm_log_error("Applying window to Frame #%u failed. "
+                      "Buffer of %zu bytes is smaller than %zu bytes.",
+                      frame->number, size, num_samples);
+        return false;
+    }
+
+    // Stored values are looked up in a table that holds the mapped value
+    // of each of them, which makes the cost per sample independent of the
+    // window function
+    size_t num_values = (size_t) 1 << frame->bits_stored;
+    uint8_t *table = dcm_heap_malloc(num_values);
+    if (table == NULL) {
+        dcm_log_error("Applying window to Frame #%u failed. "
+                      "Could not allocate memory for lookup table.",
+                      frame->number);
+        return false;
+    }
+    bool is_signed = frame->pixel_representation == 1;
+    double lower = center - 0.5 - (width - 1.0) / 2.0;
+    double upper = center - 0.5 + (width - 1.0) / 2.0;
+    for (i = 0; i < num_values; i++) {
+        // Table indices are the stored values with their sign bit flipped
+        double value = is_signed ?
+                       (double) i - (double) (num_values / 2) :
+                       (double) i;
+        if (value <= lower) {
+            table[i] = 0;
+        } else if (value > upper) {
+            table[i] = 255;
+        } else {
+            double mapped = ((value - (center - 0.5)) / (width - 1.0) + 0.5);
+            table[i] = (uint8_t) (mapped * 255.0 + 0.5);
+        }
+    }
+
+    unsigned shift = frame->high_bit + 1 - frame->bits_stored;
+    uint32_t mask = (uint32_t) (num_values - 1);
+    uint32_t sign = is_signed ? (uint32_t) (num_values / 2) : 0;
+    const unsigned char *bytes = (const unsigned char *) frame->data;
+    if (frame->bits_allocated == 8) {
+        for (i = 0; i < num_samples; i++) {
+            buffer[i] = table[((bytes[i] >> shift) & mask) ^ sign];
+        }
+    } else {
+        for (i = 0; i < num_samples; i++) {
+            uint32_t value = bytes[2 * i] | ((uint32_t) bytes[2 * i + 1] << 8);
+            buffer[i] = table[((value >> shift) & mask) ^ sign];
+        }
+    }
+    dcm_heap_free(table);
+    return true;
+}
+
+
 void dcm_frame_destroy(DcmFrame *frame)
 {
     if (frame) {
+        if (frame->release) {
+            // The memory is owned by someone else
+            frame->release(frame->owner);
+            dcm_heap_free(frame);
+            return;
+        }
         if (frame->data) {
-            free((char*)frame->data);
+            dcm_heap_free((char*)frame->data);
         }
         if (frame->photometric_interpretation) {
-            free((char*)frame->photometric_interpretation);
+            dcm_heap_free((char*)frame->photometric_interpretation);
         }
         if (frame->transfer_syntax_uid) {
-            free((char*)frame->transfer_syntax_uid);
+            dcm_heap_free((char*)frame->transfer_syntax_uid);
         }
-        free(frame);
+        dcm_heap_free(frame);
         frame = NULL;
     }
 }
@@ -2453,7 +4007,7 @@ DcmBOT *dcm_bot_create(ssize_t *offsets, uint32_t num_frames)
         dcm_log_error("Constructing Basic Offset Table failed. "
                       "Expected offsets of %ld Frame Items.",
                       num_frames);
-        free(offsets);
+        dcm_heap_free(offsets);
         return NULL;
     }
 
@@ -2466,7 +4020,7 @@ DcmBOT *dcm_bot_create(ssize_t *offsets, uint32_t num_frames)
     if (bot == NULL) {
         dcm_log_error("Constructing Basic Offset Table failed. "
                       "Could not allocate memory.");
-        free(offsets);
+        dcm_heap_free(offsets);
         return NULL;
     }
     bot->num_frames = num_frames;
@@ -2501,7 +4055,7 @@ uint32_t dcm_bot_get_num_frames(const DcmBOT *bot)
 ssize_t dcm_bot_get_frame_offset(const DcmBOT *bot, uint32_t number)
 {
     assert(bot);
-    assert(number > 0 && number < bot->num_frames);
+    assert(number > 0 && number <= bot->num_frames);
     uint32_t index = number - 1;
     return bot->offsets[index];
 }
@@ -2511,9 +4065,9 @@ void dcm_bot_destroy(DcmBOT *bot)
 {
     if (bot) {
         if (bot->offsets) {
-            free(bot->offsets);
+            dcm_heap_free(bot->offsets);
         }
-        free(bot);
+        dcm_heap_free(bot);
         bot = NULL;
     }
 }
@@ -2,6 +2,7 @@
 /*
  * Implementation of Part 6 of the DICOM standard: Data Dictionary.
  */
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -9,29 +10,19 @@
 #include <string.h>
 
 #include "dicom.h"
-
-#include "../lib/uthash.h"
+#include "pdicom.h"
 
 
 struct _DcmAttribute {
     uint32_t tag;
     char vr[3];
-    char keyword[63];
-};
-
-
-struct _DcmAttribute_hash_entry {
-    /* The first three items are identical to _DcmAttribute, so we can cast
-     * pointers from one to another.
-     */
-    uint32_t tag;
-    char vr[3];
-    char keyword[63];
-
-    UT_hash_handle hh;
+    char keyword[64];
 };
 
 
+/*
+ * Attributes in ascending order of Tags, which is relied upon for lookups.
+ */
 static const struct _DcmAttribute attribute_table[] = {
     {0X00000000, "UL", "CommandGroupLength"},
     {0X00000001, "UL", "CommandLengthToEnd"},
@@ -4919,63 +4910,121 @@ static const struct _DcmAttribute attribute_table[] = {
 };
 
 
-static const int n_attributes = sizeof(attribute_table) /
-                                sizeof(struct _DcmAttribute);
+static const uint32_t n_attributes = sizeof(attribute_table) /
+                                     sizeof(struct _DcmAttribute);
+
+
+/*
+ * Value Representations in alphabetical order.
+ */
+static const char *const vr_table[] = {
+    "AE", "AS", "AT", "CS", "DA", "DS", "DT", "FD", "FL", "IS", "LO", "LT",
+    "OB", "OD", "OF", "OL", "OV", "OW", "PN", "SH", "SL", "SQ", "SS", "ST",
+    "SV", "TM", "UC", "UI", "UL", "UN", "UR", "US", "UT", "UV",
+};
+
+
+static const uint32_t n_vrs = sizeof(vr_table) / sizeof(const char *);
 
 
 static const struct _DcmAttribute *attribute_from_tag(uint32_t tag)
 {
-    static struct _DcmAttribute_hash_entry *dictionary = NULL;
+    // Binary search that narrows the range without branching on the
+    // outcome of each comparison
+    const struct _DcmAttribute *base = attribute_table;
+    uint32_t n = n_attributes;
+    while (n > 1) {
+        uint32_t half = n / 2;
+        base = base[half].tag <= tag ? base + half : base;
+        n -= half;
+    }
 
-    struct _DcmAttribute_hash_entry *entry;
+    return base->tag == tag ? base : NULL;
+}
 
-    if (!dictionary) {
-        int i;
 
-        for (i = 0; i < n_attributes; i++) {
-            HASH_FIND_INT(dictionary, &attribute_table[i].tag, entry);
-            if (entry) {
-                dcm_log_critical("Encoutered duplicate entry in Data "
-                                 "Dictionary for Attribute '%08x'.",
-                                 attribute_table[i].tag);
-                exit(1);
-            }
+/*
+ * Number of slots of the hash table that maps Keywords to Attributes,
+ * a power of two comfortably greater than the number of Attributes.
+ */
+#define KEYWORD_INDEX_SIZE 8192
 
-            entry = DCM_NEW(struct _DcmAttribute_hash_entry);
-            *((struct _DcmAttribute *)entry) = attribute_table[i];
-            HASH_ADD_INT(dictionary, tag, entry);
-        }
-    }
 
-    HASH_FIND_INT(dictionary, &tag, entry);
+// Built on first use and shared by all threads
+static _Atomic(uint16_t *) keyword_index = NULL;
+
 
-    return (const struct _DcmAttribute *)entry;
+static uint32_t hash_keyword(const char *keyword)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (; *keyword; keyword++) {
+        hash ^= (unsigned char) *keyword;
+        hash *= 16777619u;
+    }
+    return hash;
 }
 
 
-static const struct _DcmAttribute *attribute_from_vr(const char *vr)
+static const uint16_t *get_keyword_index(void)
 {
-    static struct _DcmAttribute_hash_entry *dictionary = NULL;
+    uint16_t *index = atomic_load_explicit(&keyword_index,
+                                           memory_order_acquire);
+    if (index) {
+        return index;
+    }
 
-    struct _DcmAttribute_hash_entry *entry;
+    // Slots hold the position of the Attribute in the table plus one
+    index = dcm_calloc(KEYWORD_INDEX_SIZE, sizeof(uint16_t));
+    if (index == NULL) {
+        return NULL;
+    }
+    uint32_t i;
+    for (i = 0; i < n_attributes; i++) {
+        if (attribute_table[i].keyword[0] == '\0') {
+            // Retired Attributes without Keyword
+            continue;
+        }
+        uint32_t slot = hash_keyword(attribute_table[i].keyword);
+        while (index[slot % KEYWORD_INDEX_SIZE]) {
+            slot += 1;
+        }
+        index[slot % KEYWORD_INDEX_SIZE] = (uint16_t) (i + 1);
+    }
 
-    if (!dictionary) {
-        int i;
+    // Another thread may have built the index in the meantime
+    uint16_t *expected = NULL;
+    if (!atomic_compare_exchange_strong(&keyword_index, &expected, index)) {
+        dcm_heap_free(index);
+        return expected;
+    }
+    return index;
+}
 
-        for (i = 0; i < n_attributes; i++) {
-            HASH_FIND_STR(dictionary, attribute_table[i].vr, entry);
 
-            if (!entry) {
-                entry = DCM_NEW(struct _DcmAttribute_hash_entry);
-                *((struct _DcmAttribute *)entry) = attribute_table[i];
-                HASH_ADD_STR(dictionary, vr, entry);
-            }
+static const struct _DcmAttribute *attribute_from_keyword(const char *keyword)
+{
+    const uint16_t *index = get_keyword_index();
+    if (index == NULL) {
+        return NULL;
+    }
+
+    uint32_t slot = hash_keyword(keyword);
+    while (index[slot % KEYWORD_INDEX_SIZE]) {
+        const struct _DcmAttribute *attribute =
+            &attribute_table[index[slot % KEYWORD_INDEX_SIZE] - 1];
+        if (strcmp(attribute->keyword, keyword) == 0) {
+            return attribute;
         }
+        slot += 1;
     }
+    return NULL;
+}
 
-    HASH_FIND_STR(dictionary, vr, entry);
 
-    return (const struct _DcmAttribute *)entry;
+static int compare_vrs(const void *a, const void *b)
+{
+    return strcmp((const char *) a, *(const char *const *) b);
 }
 
 
@@ -5002,7 +5051,11 @@ bool dcm_is_valid_tag(uint32_t tag)
 
 bool dcm_is_valid_vr(const char *vr)
 {
-    return !vr || attribute_from_vr(vr);
+    return !vr || bsearch(vr,
+                          vr_table,
+                          n_vrs,
+                          sizeof(const char *),
+                          compare_vrs) != NULL;
 }
 
 
@@ -5027,3 +5080,16 @@ const char *dcm_dict_lookup_keyword(uint32_t tag)
     return attribute->keyword;
 }
 
+
+bool dcm_dict_lookup_tag(const char *keyword, uint32_t *tag)
+{
+    if (keyword == NULL || keyword[0] == '\0') {
+        return false;
+    }
+    const struct _DcmAttribute *attribute = attribute_from_keyword(keyword);
+    if (!attribute) {
+        return false;
+    }
+    *tag = attribute->tag;
+    return true;
+}
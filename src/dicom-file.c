@@ -2,15 +2,57 @@
  * Implementation of Part 10 of the DICOM standard: Media Storage and File
  * Format for Media Interchange.
  */
+// Large file support must be configured before any system header
+#include "config.h"
+
 #include <assert.h>
 #include <ctype.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
-
-#include "../lib/utarray.h"
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <inttypes.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 
 #include "dicom.h"
+#include "pdicom.h"
+
+#define uthash_malloc(sz) dcm_heap_malloc(sz)
+#define uthash_free(ptr, sz) dcm_heap_free(ptr)
+#include "../lib/uthash.h"
+
+/**
+ * Size of the buffer through which the Data Set is parsed from a stream.
+ */
+#define READ_BUFFER_SIZE 65536
+
+/**
+ * Identifies serialized offset indices and the version of their layout.
+ */
+#define OFFSET_INDEX_MAGIC "DCMOIX01"
+
+/**
+ * Size of the header of a serialized offset index, which is followed by
+ * the offset of each Frame as 64-bit value.
+ */
+#define OFFSET_INDEX_HEADER_SIZE 48
 
 
 enum SpecialTag {
@@ -19,6 +61,7 @@ enum SpecialTag {
     TAG_SQ_DELIM = 0xFFFEE0DD,
     TAG_TRAILING_PADDING = 0xFFFCFFFC,
     TAG_EXTENDED_OFFSET_TABLE = 0x7FE00001,
+    TAG_EXTENDED_OFFSET_TABLE_LENGTHS = 0x7FE00002,
     TAG_PIXEL_DATA = 0x7FE00010,
     TAG_FLOAT_PIXEL_DATA = 0x7FE00008,
     TAG_DOUBLE_PIXEL_DATA = 0x7FE00009,
@@ -38,6 +81,17 @@ struct PixelDescription {
 };
 
 
+/**
+ * Get the number of bytes of a Frame of native Pixel Data.
+ */
+static size_t get_native_frame_length(const struct PixelDescription *desc)
+{
+    uint64_t num_bits = (uint64_t) desc->rows * desc->columns *
+                        desc->samples_per_pixel * desc->bits_allocated;
+    return (size_t) ((num_bits + 7) / 8);
+}
+
+
 typedef struct ItemHeader {
     uint32_t tag;
     uint64_t length;
@@ -51,7 +105,7 @@ typedef struct ElementHeader {
 } EHeader;
 
 
-static IHeader *iheader_create(uint32_t tag, uint64_t length)
+static bool iheader_init(IHeader *header, uint32_t tag, uint64_t length)
 {
     if (!(tag == TAG_ITEM ||
           tag == TAG_ITEM_DELIM ||
@@ -59,18 +113,11 @@ static IHeader *iheader_create(uint32_t tag, uint64_t length)
         dcm_log_error("Constructing header of Item failed. "
                       "Encountered invalid Item Tag '%08X'.",
                       tag);
-        return NULL;
-    }
-    IHeader *header = malloc(sizeof(struct ItemHeader));
-    if (header == NULL) {
-        dcm_log_error("Constructing header of Item failed. "
-                      "Failed to allocate memory for header of Item '%08X'.",
-                      tag);
-        return NULL;
+        return false;
     }
     header->tag = tag;
     header->length = length;
-    return header;
+    return true;
 }
 
 
@@ -88,31 +135,17 @@ static uint64_t iheader_get_length(IHeader *item)
 }
 
 
-static void iheader_destroy(IHeader *item)
-{
-    if (item) {
-        free(item);
-        item = NULL;
-    }
-}
-
-
-static EHeader *eheader_create(uint32_t tag, const char *vr, uint64_t length)
+static bool eheader_init(EHeader *header,
+                         uint32_t tag,
+                         const char *vr,
+                         uint64_t length)
 {
     bool is_valid_tag = dcm_is_valid_tag(tag);
     if (!is_valid_tag) {
         dcm_log_error("Constructing header of Data Element failed. "
                       "Encountered invalid Tag: '%08X'.",
                       tag);
-        return NULL;
-    }
-    EHeader *header = malloc(sizeof(struct ElementHeader));
-    if (header == NULL) {
-        dcm_log_error("Constructing header of Data Element failed. "
-                      "Could not allocate memory for "
-                      "header of Data Element '%08X'.",
-                      tag);
-        return NULL;
+        return false;
     }
     header->tag = tag;
 
@@ -120,14 +153,13 @@ static EHeader *eheader_create(uint32_t tag, const char *vr, uint64_t length)
         dcm_log_error("Constructing header of Data Element failed. "
                       "Encountered invalid Value Representation: '%s'.",
                       vr);
-        free(header);
-        return NULL;
+        return false;
     }
     strncpy(header->vr, vr, 3);
     header->vr[2] = '\0';
 
     header->length = length;
-    return header;
+    return true;
 }
 
 
@@ -163,1401 +195,6594 @@ static uint64_t eheader_get_length(EHeader *header)
 }
 
 
-static void eheader_destroy(EHeader *header)
+/**
+ * Counters behind DcmStats, which are updated from several threads.
+ */
+struct Counters {
+    atomic_uint_fast64_t bytes_read;
+    atomic_uint_fast64_t num_reads;
+    atomic_uint_fast64_t num_seeks;
+    atomic_uint_fast64_t num_elements;
+    atomic_uint_fast64_t num_frames;
+    atomic_uint_fast64_t frame_read_latency[DCM_STATS_LATENCY_BUCKETS];
+};
+
+
+// Counters of all files together
+static struct Counters global_counters;
+
+
+#define COUNT(FILE, COUNTER, N)                                            \
+    do {                                                                   \
+        atomic_fetch_add_explicit(&((FILE)->counters->COUNTER),            \
+                                  (N), memory_order_relaxed);              \
+        atomic_fetch_add_explicit(&global_counters.COUNTER,                \
+                                  (N), memory_order_relaxed);              \
+    } while (0)
+
+
+static void init_counters(struct Counters *counters)
+{
+    uint32_t i;
+
+    atomic_init(&counters->bytes_read, 0);
+    atomic_init(&counters->num_reads, 0);
+    atomic_init(&counters->num_seeks, 0);
+    atomic_init(&counters->num_elements, 0);
+    atomic_init(&counters->num_frames, 0);
+    for (i = 0; i < DCM_STATS_LATENCY_BUCKETS; i++) {
+        atomic_init(&counters->frame_read_latency[i], 0);
+    }
+}
+
+
+static void copy_counters(const struct Counters *counters, DcmStats *stats)
 {
-    if (header) {
-        free(header);
-        header = NULL;
+    uint32_t i;
+
+    // The counters are read one by one and may thus be slightly apart
+    stats->bytes_read = atomic_load(&counters->bytes_read);
+    stats->num_reads = atomic_load(&counters->num_reads);
+    stats->num_seeks = atomic_load(&counters->num_seeks);
+    stats->num_elements = atomic_load(&counters->num_elements);
+    stats->num_allocations = 0;
+    stats->num_frames = atomic_load(&counters->num_frames);
+    for (i = 0; i < DCM_STATS_LATENCY_BUCKETS; i++) {
+        stats->frame_read_latency[i] =
+            atomic_load(&counters->frame_read_latency[i]);
     }
 }
 
 
+void dcm_get_stats(DcmStats *stats)
+{
+    copy_counters(&global_counters, stats);
+    stats->num_allocations = dcm_get_num_allocations();
+}
+
+
+/**
+ * Read-only memory mapping of the content of a file.
+ */
+struct FileMap {
+    const char *data;
+    size_t size;
+    // Whether the memory was mapped by the library and must be unmapped
+    bool is_owned;
+};
+
+
 struct _DcmFile {
-    FILE *fp;
+    // Source of the content, which is read by offset
+    const DcmIOMethods *io;
+    void *io_handle;
+    struct FileMap *map;
+    // Position of the stream used for parsing the Data Set
+    size_t position;
+    bool eof;
+    // Window of the file that is buffered unless the file is mapped
+    char *buffer;
+    size_t buffer_offset;
+    size_t buffer_length;
     DcmDataSet *meta;
+    uint32_t read_flags;
+    // Pool of the character string values that are read, if any
+    DcmStringPool *string_pool;
     size_t offset;
     char *transfer_syntax_uid;
     size_t pixel_data_offset;
+    // Offset of the first Frame Item relative to the beginning of the file
+    size_t first_frame_offset;
     uint64_t *extended_offset_table;
+    uint32_t num_extended_offsets;
+    // Identity of the file on disk, against which offset indices are checked
+    uint64_t file_size;
+    int64_t file_mtime;
+    // Frame offsets that were loaded from an offset index
+    ssize_t *index_offsets;
+    uint32_t index_num_frames;
+    // Pixel description of the Frames, shared by all Frame views
+    struct PixelDescription *desc;
+    // Held by the caller and by each Frame view that references the file
+    atomic_uint refcount;
+    // Unique among all files of the process, unlike the address of the file
+    uint32_t id;
+    // Set for files that were opened for writing
+    bool is_writable;
+    struct FileWriter *writer;
+    // Counters of the file, which a cursor shares with the file it reads
+    struct Counters *counters;
+    struct Counters own_counters;
+    // Cleared while Items are only located, such that each Data Element
+    // header is counted once
+    bool is_counting_elements;
+    // Offset at which the last read from the I/O methods ended
+    atomic_size_t next_read_offset;
+#ifdef HAVE_PTHREAD_H
+    // Serializes use of the stream by lazily read Data Elements
+    pthread_mutex_t stream_mutex;
+#endif
 };
 
 
-static uint32_t read_tag(FILE *fp, size_t *n)
+static uint64_t get_microseconds(void)
 {
-    uint16_t group_num, elem_num;
-    *n += fread(&group_num, 1, sizeof(group_num), fp);
-    *n += fread(&elem_num, 1, sizeof(elem_num), fp);
-    return ((uint32_t)group_num << 16) + elem_num;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000;
 }
 
 
-static char **parse_character_string(char *string, uint32_t *vm)
+/**
+ * Count a read of a Frame that started at the given time.
+ */
+static void count_frame_read(const DcmFile *file, uint64_t start)
 {
-    uint32_t i;
-    uint32_t n;
-    char **token_ptr;
-    char **parts;
-    char *token;
+    uint64_t elapsed = get_microseconds() - start;
+    uint32_t bucket = 0;
+    while (bucket < DCM_STATS_LATENCY_BUCKETS - 1 &&
+           elapsed >= (UINT64_C(1) << bucket)) {
+        bucket++;
+    }
+    COUNT(file, num_frames, 1);
+    COUNT(file, frame_read_latency[bucket], 1);
+}
 
-    UT_array *array;
-    utarray_new(array, &ut_str_icd);
 
-    if (strlen(string) == 0) {
-        token = "";
-        utarray_push_back(array, &token);
-        goto finish;
+static struct FileMap *file_map_create(const char *file_path)
+{
+#ifdef HAVE_MMAP
+    struct stat info;
+
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
     }
-    token = strtok(string, "\\");
-    while(token) {
-        utarray_push_back(array, &token);
-        token = strtok(NULL, "\\");
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+        // Pipes, devices and empty files cannot be mapped
+        close(fd);
+        return NULL;
     }
-    goto finish;
 
-finish:
-    n = utarray_len(array);
-    parts = malloc(n * sizeof(char *));
-    if (parts == NULL) {
-        dcm_log_error("Failed to parse character string. "
-                      "Could not allocate memory for array of substrings.");
-        free(string);
-        utarray_free(array);
+    void *data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
         return NULL;
     }
 
-    for (i = 0; i < n; i++) {
-        token_ptr = utarray_eltptr(array, i);
-        parts[i] = malloc(strlen(*token_ptr) + 1);
-        if (parts[i] == NULL) {
-            dcm_log_error("Failed to parse character string. "
-                          "Could not allocate memory for substring #%d.",
-                          i);
-            free(parts);
-            free(string);
-            utarray_free(array);
-            return NULL;
+    struct FileMap *map = DCM_NEW(struct FileMap);
+    if (map == NULL) {
+        munmap(data, (size_t) info.st_size);
+        return NULL;
+    }
+    map->data = data;
+    map->size = (size_t) info.st_size;
+    map->is_owned = true;
+    return map;
+#else
+    (void) file_path;
+    return NULL;
+#endif
+}
+
+
+static void file_map_destroy(struct FileMap *map)
+{
+    if (map) {
+#ifdef HAVE_MMAP
+        if (map->is_owned) {
+            munmap((void *) map->data, map->size);
         }
-        strcpy(parts[i], *token_ptr);
+#endif
+        dcm_heap_free(map);
+        map = NULL;
     }
+}
 
-    *vm = n;
-    utarray_free(array);
-    free(string);
-    return parts;
+
+/**
+ * Content of a file on disk, which is read through stdio.
+ */
+struct StdioHandle {
+    FILE *fp;
+};
+
+
+/**
+ * Seek to an absolute offset in a stdio stream.
+ *
+ * :return: Whether the offset could be represented and was reached
+ */
+static bool stdio_seek(FILE *fp, int64_t offset)
+{
+#ifdef HAVE_FSEEKO
+    off_t position = (off_t) offset;
+#else
+    long position = (long) offset;
+#endif
+    if (offset < 0 || (int64_t) position != offset) {
+        errno = EOVERFLOW;
+        return false;
+    }
+#ifdef HAVE_FSEEKO
+    return fseeko(fp, position, SEEK_SET) == 0;
+#else
+    return fseek(fp, position, SEEK_SET) == 0;
+#endif
 }
 
 
-static IHeader *read_item_header(FILE *fp, size_t *n)
+static int64_t stdio_read_at(void *handle,
+                             char *buffer,
+                             int64_t length,
+                             int64_t offset)
 {
-    uint32_t tag = read_tag(fp, n);
-    uint32_t length;
-    *n += fread(&length, 1, sizeof(length), fp);
-    return iheader_create(tag, length);
+    FILE *fp = ((struct StdioHandle *) handle)->fp;
+#ifdef HAVE_PREAD
+    int fd = fileno(fp);
+    while (true) {
+        ssize_t result = pread(fd, buffer, (size_t) length, (off_t) offset);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        return (int64_t) result;
+    }
+#else
+    // Without positional reads, concurrent use of the stream is not safe
+    if (!stdio_seek(fp, offset)) {
+        return -1;
+    }
+    return (int64_t) fread(buffer, 1, (size_t) length, fp);
+#endif
 }
 
 
-static EHeader *read_element_header(FILE *fp, size_t *n, bool implicit)
+static int64_t stdio_size(void *handle)
 {
-    char vr[3];
-    uint32_t length;
-    uint16_t short_length;
-    uint16_t reserved;
+    FILE *fp = ((struct StdioHandle *) handle)->fp;
+#ifdef HAVE_SYS_STAT_H
+    struct stat info;
+    if (fstat(fileno(fp), &info) == 0) {
+        return (int64_t) info.st_size;
+    }
+#endif
+#ifdef HAVE_FSEEKO
+    if (fseeko(fp, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    return (int64_t) ftello(fp);
+#else
+    if (fseek(fp, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    return (int64_t) ftell(fp);
+#endif
+}
 
-    uint32_t tag = read_tag(fp, n);
-    if (implicit) {
-        // Value Representation
-        const char *tmp = dcm_dict_lookup_vr(tag);
-        strncpy(vr, tmp, 2);
-        vr[2] = '\0';
 
-        // Value Length
-        *n += fread(&length, 1, sizeof(length), fp);
-    } else {
-        // Value Representation
-        *n += fread(&vr, 1, 2, fp);
-        vr[2] = '\0';
+static void stdio_close(void *handle)
+{
+    struct StdioHandle *stdio = (struct StdioHandle *) handle;
+    fclose(stdio->fp);
+    dcm_heap_free(stdio);
+}
 
-        // Value Length
-        if (strcmp(vr, "AE") == 0 ||
-            strcmp(vr, "AS") == 0 ||
-            strcmp(vr, "AT") == 0 ||
-            strcmp(vr, "CS") == 0 ||
-            strcmp(vr, "DA") == 0 ||
-            strcmp(vr, "DS") == 0 ||
-            strcmp(vr, "DT") == 0 ||
-            strcmp(vr, "FL") == 0 ||
-            strcmp(vr, "FD") == 0 ||
-            strcmp(vr, "IS") == 0 ||
-            strcmp(vr, "LO") == 0 ||
-            strcmp(vr, "LT") == 0 ||
-            strcmp(vr, "PN") == 0 ||
-            strcmp(vr, "SH") == 0 ||
-            strcmp(vr, "SL") == 0 ||
-            strcmp(vr, "SS") == 0 ||
-            strcmp(vr, "ST") == 0 ||
-            strcmp(vr, "TM") == 0 ||
-            strcmp(vr, "UI") == 0 ||
-            strcmp(vr, "UL") == 0 ||
-            strcmp(vr, "US") == 0) {
-            // These VRs have a short length of only two bytes
-            *n += fread(&short_length, 1, sizeof(short_length), fp);
-            length = (uint32_t) short_length;
-        } else {
-            // Other VRs have two reserved bytes before length of four bytes
-            *n += fread(&reserved, 1, sizeof(reserved), fp);
-            if (reserved != 0x0000) {
-                dcm_log_error("Reading of Data Element header failed. "
-                              "Unexpected value for reserved bytes "
-                              "of Data Element %08X with VR '%s'.",
-                              tag,
-                              vr);
-                return NULL;
-            }
-            *n += fread(&length, 1, sizeof(length), fp);
+
+/**
+ * Advise the operating system that a part of a file will be read soon.
+ */
+static void advise_will_need(int fd, int64_t offset, int64_t length)
+{
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+    posix_fadvise(fd, (off_t) offset, (off_t) length, POSIX_FADV_WILLNEED);
+#else
+    (void) fd;
+    (void) offset;
+    (void) length;
+#endif
+}
+
+
+static void stdio_prefetch(void *handle, int64_t offset, int64_t length)
+{
+    FILE *fp = ((struct StdioHandle *) handle)->fp;
+    advise_will_need(fileno(fp), offset, length);
+}
+
+
+static const DcmIOMethods stdio_methods = {
+    stdio_read_at, stdio_size, NULL, stdio_close, stdio_prefetch
+};
+
+
+#ifdef HAVE_UNISTD_H
+static int64_t fd_read_at(void *handle,
+                          char *buffer,
+                          int64_t length,
+                          int64_t offset)
+{
+    int fd = *(int *) handle;
+#ifdef HAVE_PREAD
+    while (true) {
+        ssize_t result = pread(fd, buffer, (size_t) length, (off_t) offset);
+        if (result < 0 && errno == EINTR) {
+            continue;
         }
+        return (int64_t) result;
+    }
+#else
+    // Without positional reads, concurrent use of the descriptor is not safe
+    if (lseek(fd, (off_t) offset, SEEK_SET) < 0) {
+        return -1;
     }
+    return (int64_t) read(fd, buffer, (size_t) length);
+#endif
+}
+
 
-    EHeader *header = eheader_create(tag, vr, length);
-    return header;
+static int64_t fd_size(void *handle)
+{
+    int fd = *(int *) handle;
+#ifdef HAVE_SYS_STAT_H
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        return (int64_t) info.st_size;
+    }
+#endif
+    (void) fd;
+    return -1;
 }
 
 
-static DcmElement *read_element(FILE *fp,
-                                EHeader *header,
-                                size_t *n,
-                                bool implicit)
+static void fd_close(void *handle)
 {
-    assert(header);
-    uint32_t i;
-    uint32_t vm;
-    uint32_t item_index;
-    uint32_t item_tag;
-    uint32_t item_length;
-    size_t n_seq;
-    size_t *n_seq_ptr = &n_seq;
-    size_t n_item;
-    size_t *n_item_ptr = &n_item;
-    DcmElement *element;
-    IHeader *item_iheader;
-    DcmDataSet *item_dataset;
-    EHeader *item_eheader;
-    DcmElement *item_element;
+    // The descriptor remains owned by the caller
+    dcm_heap_free(handle);
+}
 
-    uint32_t tag =  eheader_get_tag(header);
-    uint32_t length = eheader_get_length(header);
 
-    n_seq = 0;
-    n_item = 0;
-    item_index = 0;
+static void fd_prefetch(void *handle, int64_t offset, int64_t length)
+{
+    advise_will_need(*(int *) handle, offset, length);
+}
 
-    dcm_log_debug("Read Data Element '%08X'", tag);
 
-    vm = 1;
-    // Character strings
-    if (eheader_check_vr(header, "AE") ||
-        eheader_check_vr(header, "AS") ||
-        eheader_check_vr(header, "AT") ||
-        eheader_check_vr(header, "CS") ||
-        eheader_check_vr(header, "DA") ||
-        eheader_check_vr(header, "DS") ||  // Decimal String
-        eheader_check_vr(header, "DT") ||
-        eheader_check_vr(header, "IS") ||  // Integer String
-        eheader_check_vr(header, "LO") ||
-        eheader_check_vr(header, "LT") ||
-        eheader_check_vr(header, "PN") ||
-        eheader_check_vr(header, "SH") ||
-        eheader_check_vr(header, "ST") ||
-        eheader_check_vr(header, "TM") ||
-        eheader_check_vr(header, "UI") ||
-        eheader_check_vr(header, "UR") ||
-        eheader_check_vr(header, "UT")) {
-        char *value = malloc(length + 1);
-        if (value == NULL) {
-            dcm_log_error("Reading of Data Element failed. "
-                          "Could not allocate memory for "
-                          "value of Data Element '%08X'.",
-                          tag);
-            return NULL;
-        }
-        *n += fread(value, 1, length, fp);
-        if (length > 0) {
-            if (!eheader_check_vr(header, "UI")) {
-                if (isspace(value[length - 1])) {
-                    value[length - 1] = '\0';
-                }
-            }
-        }
-        value[length] = '\0';
+static const DcmIOMethods fd_methods = {
+    fd_read_at, fd_size, NULL, fd_close, fd_prefetch
+};
+#endif
 
-        // Parse value and create array of strings
-        char **strings = parse_character_string(value, &vm);
 
-        if (eheader_check_vr(header, "AE")) {
-            return dcm_element_create_AE_multi(tag, strings, vm);
-        } else if (eheader_check_vr(header, "AS")) {
-            return dcm_element_create_AS_multi(tag, strings, vm);
-        } else if (eheader_check_vr(header, "AT")) {
-            return dcm_element_create_AT_multi(tag, strings, vm);
-        } else if (eheader_check_vr(header, "CS")) {
-            return dcm_element_create_CS_multi(tag, strings, vm);
-        } else if (eheader_check_vr(header, "DA")) {
-            return dcm_element_create_DA_multi(tag, strings, vm);
-        } else if (eheader_check_vr(header, "DS")) {
-            return dcm_element_create_DS_multi(tag, strings, vm);
-        } else if (eheader_check_vr(header, "DT")) {
-            return dcm_element_create_DT_multi(tag, strings, vm);
-        } else if (eheader_check_vr(header, "IS")) {
-            return dcm_element_create_IS_multi(tag, strings, vm);
-        } else if (eheader_check_vr(header, "LO")) {
-            return dcm_element_create_LO_multi(tag, strings, vm);
-        } else if (eheader_check_vr(header, "PN")) {
-            return dcm_element_create_PN_multi(tag, strings, vm);
-        } else if (eheader_check_vr(header, "SH")) {
-            return dcm_element_create_SH_multi(tag, strings, vm);
-        } else if (eheader_check_vr(header, "ST")) {
-            // This VM shall always have VM 1.
-            if (vm > 1) {
-                dcm_log_error("Reading of Data Element failed. "
-                              "Encountered unexpected Value Multiplicity %d "
-                              "for Data Element '%08X'.",
-                              vm, tag);
-                for (i = 0; i < vm; i++) {
-                    free(strings[i]);
-                }
-                free(strings);
-                return NULL;
-            }
-            char *str = strings[0];
-            free(strings);
-            return dcm_element_create_ST(tag, str);
-        } else if (eheader_check_vr(header, "TM")) {
-            return dcm_element_create_TM_multi(tag, strings, vm);
-        } else if (eheader_check_vr(header, "UI")) {
-            return dcm_element_create_UI_multi(tag, strings, vm);
-        } else if (eheader_check_vr(header, "LT")) {
-            // This VM shall always have VM 1.
-            if (vm > 1) {
-                dcm_log_error("Reading of Data Element failed. "
-                              "Encountered unexpected Value Multiplicity %d "
-                              "for Data Element '%08X'.",
-                              vm, tag);
-                for (i = 0; i < vm; i++) {
-                    free(strings[i]);
-                }
-                free(strings);
-                return NULL;
-            }
-            char *str = strings[0];
-            free(strings);
-            return dcm_element_create_LT(tag, str);
-        } else if (eheader_check_vr(header, "UR")) {
-            // This VM shall always have VM 1.
-            if (vm > 1) {
-                dcm_log_error("Reading of Data Element failed. "
-                              "Encountered unexpected Value Multiplicity %d "
-                              "for Data Element '%08X'.",
-                              vm, tag);
-                for (i = 0; i < vm; i++) {
-                    free(strings[i]);
-                }
-                free(strings);
-                return NULL;
-            }
-            char *str = strings[0];
-            free(strings);
-            return dcm_element_create_UR(tag, str);
-        } else if (eheader_check_vr(header, "UT")) {
-            // This VM shall always have VM 1.
-            if (vm > 1) {
-                dcm_log_error("Reading of Data Element failed. "
-                              "Encountered unexpected Value Multiplicity %d "
-                              "for Data Element '%08X'.",
-                              vm, tag);
-                for (i = 0; i < vm; i++) {
-                    free(strings[i]);
-                }
-                free(strings);
-                return NULL;
-            }
-            char *str = strings[0];
-            free(strings);
-            return dcm_element_create_UT(tag, str);
-        } else {
-            dcm_log_error("Reading of Data Element failed. "
-                          "Encountered unexpected Value Representation "
-                          "for Data Element '%08X'.",
-                          tag);
-            for (i = 0; i < vm; i++) {
-                free(strings[i]);
-            }
-            free(strings);
-            return NULL;
+/**
+ * Content that is already in memory.
+ */
+struct MemoryHandle {
+    const char *data;
+    size_t size;
+};
+
+
+static int64_t memory_read_at(void *handle,
+                              char *buffer,
+                              int64_t length,
+                              int64_t offset)
+{
+    struct MemoryHandle *memory = (struct MemoryHandle *) handle;
+    if ((uint64_t) offset >= memory->size) {
+        return 0;
+    }
+    size_t available = memory->size - (size_t) offset;
+    if ((uint64_t) length < available) {
+        available = (size_t) length;
+    }
+    memcpy(buffer, memory->data + offset, available);
+    return (int64_t) available;
+}
+
+
+static int64_t memory_size(void *handle)
+{
+    return (int64_t) ((struct MemoryHandle *) handle)->size;
+}
+
+
+static const char *memory_map(void *handle, int64_t *size)
+{
+    struct MemoryHandle *memory = (struct MemoryHandle *) handle;
+    *size = (int64_t) memory->size;
+    return memory->data;
+}
+
+
+static void memory_close(void *handle)
+{
+    dcm_heap_free(handle);
+}
+
+
+// Content in memory needs no prefetching
+static const DcmIOMethods memory_methods = {
+    memory_read_at, memory_size, memory_map, memory_close, NULL
+};
+
+
+/**
+ * Read from an absolute offset without using the position of the stream.
+ *
+ * Unlike file_read(), this does not modify any state of the file and may thus
+ * be called concurrently for the same file from multiple threads, provided
+ * that the I/O methods allow concurrent reads.
+ */
+static size_t file_pread(const DcmFile *file,
+                         void *buffer,
+                         size_t length,
+                         size_t offset)
+{
+    if (file->map) {
+        if (offset >= file->map->size) {
+            return 0;
         }
-    } else if (eheader_check_vr(header, "SQ")) {
-        vm = 1;
-        DcmSequence *value = dcm_sequence_create();
-        if (value == NULL) {
-            dcm_log_error("Reading of Data Element failed. "
-                          "Could not construct Sequence for "
-                          "Data Element '%08X'.");
-            return NULL;
+        size_t available = file->map->size - offset;
+        if (length > available) {
+            length = available;
         }
-        if (length == 0) {
-            return dcm_element_create_SQ(tag, value);
-        } else if (length == 0xFFFFFFFF) {
-            dcm_log_debug("Sequence of Data Element '%08X' "
-                          "has undefined length.",
-                          tag);
-        } else {
-            dcm_log_debug("Sequence of Data Element '%08X' "
-                          "has defined length %d.",
-                          tag, length);
+        memcpy(buffer, file->map->data + offset, length);
+        return length;
+    }
+    size_t previous_end = atomic_exchange_explicit(
+        &((DcmFile *) file)->next_read_offset,
+        offset + length,
+        memory_order_relaxed
+    );
+    if (previous_end != offset) {
+        COUNT(file, num_seeks, 1);
+    }
+    size_t n = 0;
+    while (n < length) {
+        int64_t result = file->io->read_at(file->io_handle,
+                                           (char *) buffer + n,
+                                           (int64_t) (length - n),
+                                           (int64_t) (offset + n));
+        COUNT(file, num_reads, 1);
+        if (result <= 0) {
+            break;
         }
+        n += (size_t) result;
+    }
+    COUNT(file, bytes_read, n);
+    return n;
+}
 
-        n_seq = 0;
-        while (n_seq < length) {
-            dcm_log_debug("Read Item #%d of Data Element '%08X'.",
-                          item_index, tag);
-            item_iheader = read_item_header(fp, n_seq_ptr);
-            if (item_iheader == NULL) {
-                dcm_log_error("Reading of Data Element failed. "
-                              "Could not construct Item #%d of "
-                              "Data Element '%08X'.", item_index, tag);
-                iheader_destroy(item_iheader);
-                dcm_sequence_destroy(value);
-                return NULL;
-            }
-            item_tag = iheader_get_tag(item_iheader);
-            item_length = iheader_get_length(item_iheader);
-            if (item_tag == TAG_SQ_DELIM) {
-                dcm_log_debug("Stop reading Data Element '%08X'. "
-                              "Encountered Sequence Delimination Tag.",
-                              tag);
-                iheader_destroy(item_iheader);
-                break;
-            }
-            if (item_tag != TAG_ITEM) {
-                dcm_log_error("Reading of Data Element failed. "
-                              "Expected tag '%08X' instead of '%08X' "
-                              "for Item #%d of Data Element '%08X'.",
-                              TAG_ITEM,
-                              item_tag,
-                              item_index,
-                              tag);
-                iheader_destroy(item_iheader);
-                dcm_sequence_destroy(value);
-                return NULL;
-            } else if (item_length == 0xFFFFFFFF) {
-                dcm_log_debug("Item #%d of Data Element '%08X' "
-                              "has undefined length.",
-                              item_index, tag);
+
+/**
+ * Make the bytes at the position of the stream available in memory.
+ *
+ * Returns a pointer to at most ``length`` contiguous bytes, which remains
+ * valid until the stream is read from again, and sets ``available`` to the
+ * number of bytes that precede the end of the file.
+ */
+static const char *file_peek(DcmFile *file, size_t length, size_t *available)
+{
+    if (file->map) {
+        size_t remaining = file->map->size - file->position;
+        *available = length < remaining ? length : remaining;
+        return file->map->data + file->position;
+    }
+
+    assert(length <= READ_BUFFER_SIZE);
+    if (file->position < file->buffer_offset ||
+        file->position + length > file->buffer_offset + file->buffer_length) {
+        file->buffer_offset = file->position;
+        file->buffer_length = file_pread(file,
+                                         file->buffer,
+                                         READ_BUFFER_SIZE,
+                                         file->position);
+    }
+    size_t start = file->position - file->buffer_offset;
+    size_t remaining = file->buffer_length > start ?
+                       file->buffer_length - start : 0;
+    *available = length < remaining ? length : remaining;
+    return file->buffer + start;
+}
+
+
+static void file_advance(DcmFile *file, size_t length, size_t available)
+{
+    file->position += available;
+    if (available < length) {
+        file->eof = true;
+    }
+}
+
+
+static size_t file_read(DcmFile *file, void *buffer, size_t length)
+{
+    size_t available;
+    if (file->map || length <= READ_BUFFER_SIZE) {
+        const char *data = file_peek(file, length, &available);
+        memcpy(buffer, data, available);
+    } else {
+        // Large values are read directly rather than through the buffer
+        available = file_pread(file, buffer, length, file->position);
+    }
+    file_advance(file, length, available);
+    return available;
+}
+
+
+static int file_seek(DcmFile *file, long offset, int whence)
+{
+    long position;
+    switch (whence) {
+        case SEEK_SET:
+            position = offset;
+            break;
+        case SEEK_CUR:
+            position = (long) file->position + offset;
+            break;
+        case SEEK_END:
+            if (file->map) {
+                position = (long) file->map->size + offset;
+            } else if (file->io->size != NULL &&
+                       file->io->size(file->io_handle) >= 0) {
+                position = (long) file->io->size(file->io_handle) + offset;
             } else {
-                dcm_log_debug("Item #%d of Data Element '%08X' "
-                              "has defined length %d.",
-                              item_index, tag, item_length);
+                return -1;
             }
+            break;
+        default:
+            return -1;
+    }
+    if (position < 0) {
+        return -1;
+    }
+    // Like fseek(), seeking past the end is allowed and clears EOF
+    file->position = (size_t) position;
+    if (file->map && file->position > file->map->size) {
+        file->position = file->map->size;
+    }
+    file->eof = false;
+    return 0;
+}
 
-            item_dataset = dcm_dataset_create();
-            if (item_dataset == NULL) {
-                dcm_log_error("Reading of Data Element failed. "
-                              "Could not construct Data Set for "
-                              "Item #%d of Data Element '%08X'.",
-                              item_index,
-                              tag);
-                iheader_destroy(item_iheader);
-                dcm_sequence_destroy(value);
+
+static long file_tell(const DcmFile *file)
+{
+    return (long) file->position;
+}
+
+
+static bool file_eof(const DcmFile *file)
+{
+    return file->eof;
+}
+
+
+/**
+ * Decode little endian values independent of the byte order of the host.
+ */
+static uint16_t decode_uint16(const char *data)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+    return (uint16_t) (bytes[0] | (bytes[1] << 8));
+}
+
+
+static uint32_t decode_uint32(const char *data)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+    return ((uint32_t) bytes[0] |
+            ((uint32_t) bytes[1] << 8) |
+            ((uint32_t) bytes[2] << 16) |
+            ((uint32_t) bytes[3] << 24));
+}
+
+
+static uint64_t decode_uint64(const char *data)
+{
+    return ((uint64_t) decode_uint32(data) |
+            ((uint64_t) decode_uint32(data + 4) << 32));
+}
+
+
+static void encode_uint32(char *data, uint32_t value)
+{
+    unsigned char *bytes = (unsigned char *) data;
+    bytes[0] = (unsigned char) value;
+    bytes[1] = (unsigned char) (value >> 8);
+    bytes[2] = (unsigned char) (value >> 16);
+    bytes[3] = (unsigned char) (value >> 24);
+}
+
+
+static void encode_uint64(char *data, uint64_t value)
+{
+    encode_uint32(data, (uint32_t) value);
+    encode_uint32(data + 4, (uint32_t) (value >> 32));
+}
+
+
+static uint32_t decode_tag(const char *data)
+{
+    return ((uint32_t) decode_uint16(data) << 16) + decode_uint16(data + 2);
+}
+
+
+static uint32_t read_tag(DcmFile *file, size_t *n)
+{
+    size_t available;
+    const char *data = file_peek(file, 4, &available);
+    file_advance(file, 4, available);
+    *n += available;
+    if (available < 4) {
+        return 0;
+    }
+    return decode_tag(data);
+}
+
+
+static char **parse_character_string(char *string, uint32_t *vm)
+{
+    uint32_t i;
+    uint32_t n;
+    char *token;
+    char **parts;
+
+    // Count the non-empty values, which are separated by backslashes
+    n = 0;
+    for (token = string; *token; token++) {
+        if (*token != '\\' && (token == string || token[-1] == '\\')) {
+            n += 1;
+        }
+    }
+    if (strlen(string) == 0) {
+        n = 1;
+    }
+
+    parts = dcm_malloc(n * sizeof(char *));
+    if (parts == NULL) {
+        dcm_log_error("Failed to parse character string. "
+                      "Could not allocate memory for array of substrings.");
+        dcm_free(string);
+        return NULL;
+    }
+
+    // Values of an arena and single values share the memory of the string
+    bool in_place = dcm_arena_current() != NULL || n == 1;
+    token = string;
+    for (i = 0; i < n; i++) {
+        while (*token == '\\') {
+            token++;
+        }
+        size_t length = strcspn(token, "\\");
+        if (in_place) {
+            parts[i] = token;
+        } else {
+            parts[i] = dcm_malloc(length + 1);
+            if (parts[i] == NULL) {
+                dcm_log_error("Failed to parse character string. "
+                              "Could not allocate memory for substring #%d.",
+                              i);
+                while (i > 0) {
+                    dcm_free(parts[--i]);
+                }
+                dcm_free(parts);
+                dcm_free(string);
                 return NULL;
             }
+            memcpy(parts[i], token, length);
+        }
+        token += length;
+        if (*token) {
+            *token++ = '\0';
+        }
+        parts[i][length] = '\0';
+    }
+
+    *vm = n;
+    if (!in_place) {
+        dcm_free(string);
+    }
+    return parts;
+}
+
+
+static bool read_item_header(DcmFile *file, size_t *n, IHeader *header)
+{
+    size_t available;
+    const char *data = file_peek(file, 8, &available);
+    file_advance(file, 8, available);
+    *n += available;
+    if (available < 8) {
+        dcm_log_error("Reading of Item header failed. "
+                      "Reached end of file.");
+        return false;
+    }
+    return iheader_init(header, decode_tag(data), decode_uint32(data + 4));
+}
+
+
+static uint32_t read_tag_at(const DcmFile *file, size_t offset)
+{
+    char buffer[4];
+    if (file_pread(file, buffer, sizeof(buffer), offset) != sizeof(buffer)) {
+        return 0;
+    }
+    return decode_tag(buffer);
+}
+
+
+static bool read_item_header_at(const DcmFile *file,
+                                size_t offset,
+                                IHeader *header)
+{
+    char buffer[8];
+    if (file_pread(file, buffer, sizeof(buffer), offset) != sizeof(buffer)) {
+        dcm_log_error("Reading of Item header failed. "
+                      "Reached end of file at offset %zu.", offset);
+        return false;
+    }
+    return iheader_init(header, decode_tag(buffer), decode_uint32(buffer + 4));
+}
+
+
+/**
+ * Whether the Value Length of a Value Representation is encoded in two
+ * bytes when the Value Representation is explicit.
+ */
+static bool has_short_length(const char *vr)
+{
+    return (strcmp(vr, "AE") == 0 ||
+            strcmp(vr, "AS") == 0 ||
+            strcmp(vr, "AT") == 0 ||
+            strcmp(vr, "CS") == 0 ||
+            strcmp(vr, "DA") == 0 ||
+            strcmp(vr, "DS") == 0 ||
+            strcmp(vr, "DT") == 0 ||
+            strcmp(vr, "FL") == 0 ||
+            strcmp(vr, "FD") == 0 ||
+            strcmp(vr, "IS") == 0 ||
+            strcmp(vr, "LO") == 0 ||
+            strcmp(vr, "LT") == 0 ||
+            strcmp(vr, "PN") == 0 ||
+            strcmp(vr, "SH") == 0 ||
+            strcmp(vr, "SL") == 0 ||
+            strcmp(vr, "SS") == 0 ||
+            strcmp(vr, "ST") == 0 ||
+            strcmp(vr, "TM") == 0 ||
+            strcmp(vr, "UI") == 0 ||
+            strcmp(vr, "UL") == 0 ||
+            strcmp(vr, "US") == 0);
+}
+
+
+static bool read_element_header(DcmFile *file,
+                                size_t *n,
+                                bool implicit,
+                                EHeader *header)
+{
+    char vr[3];
+    uint32_t length;
+    size_t available;
+
+    // Tag and Value Length are followed by VR and reserved bytes if explicit
+    const size_t max_header_length = implicit ? 8 : 12;
+    const char *data = file_peek(file, max_header_length, &available);
+    if (available < 8) {
+        file_advance(file, max_header_length, available);
+        *n += available;
+        dcm_log_error("Reading of Data Element header failed. "
+                      "Reached end of file.");
+        return false;
+    }
+
+    uint32_t tag = decode_tag(data);
+    size_t header_length = 8;
+    if (file->is_counting_elements) {
+        COUNT(file, num_elements, 1);
+    }
+    if (implicit) {
+        // Value Representation
+        const char *tmp = dcm_dict_lookup_vr(tag);
+        strncpy(vr, tmp, 2);
+        vr[2] = '\0';
+
+        // Value Length
+        length = decode_uint32(data + 4);
+    } else {
+        // Value Representation
+        memcpy(vr, data + 4, 2);
+        vr[2] = '\0';
+
+        // Value Length
+        if (has_short_length(vr)) {
+            // These VRs have a short length of only two bytes
+            length = (uint32_t) decode_uint16(data + 6);
+        } else {
+            // Other VRs have two reserved bytes before length of four bytes
+            header_length = 12;
+            if (available < header_length) {
+                file_advance(file, header_length, available);
+                *n += available;
+                dcm_log_error("Reading of Data Element header failed. "
+                              "Reached end of file.");
+                return false;
+            }
+            uint16_t reserved = decode_uint16(data + 6);
+            if (reserved != 0x0000) {
+                dcm_log_error("Reading of Data Element header failed. "
+                              "Unexpected value for reserved bytes "
+                              "of Data Element %08X with VR '%s'.",
+                              tag,
+                              vr);
+                return false;
+            }
+            length = decode_uint32(data + 8);
+        }
+    }
+    file_advance(file, header_length, header_length);
+    *n += header_length;
+
+    return eheader_init(header, tag, vr, length);
+}
+
+
+/**
+ * Read a single numeric value, which is then stored within the Data Element.
+ */
+static bool read_numeric_value(DcmFile *file,
+                               size_t *n,
+                               void *value,
+                               size_t value_size)
+{
+    char bytes[8];
+    assert(value_size <= sizeof(bytes));
+
+    if (file_read(file, bytes, value_size) != value_size) {
+        dcm_log_error("Reading of Data Element failed. "
+                      "Could not read value.");
+        return false;
+    }
+    *n += value_size;
+
+#ifdef WORDS_BIGENDIAN
+    // Values are stored in little endian byte order
+    size_t j;
+    for (j = 0; j < value_size / 2; j++) {
+        char tmp = bytes[j];
+        bytes[j] = bytes[value_size - 1 - j];
+        bytes[value_size - 1 - j] = tmp;
+    }
+#endif
+
+    memcpy(value, bytes, value_size);
+    return true;
+}
+
+
+/**
+ * Read an array of numeric values in a single pass.
+ *
+ * Any trailing bytes of the value that do not form a complete number are
+ * skipped, such that the stream is positioned behind the Data Element.
+ */
+static void *read_numeric_values(DcmFile *file,
+                                 size_t *n,
+                                 uint32_t length,
+                                 size_t value_size,
+                                 uint32_t *vm)
+{
+    *vm = length / value_size;
+    size_t values_length = *vm * value_size;
+    char *values = dcm_malloc(values_length);
+    if (values == NULL) {
+        dcm_log_error("Reading of Data Element failed. "
+                      "Could not allocate memory.");
+        return NULL;
+    }
+    *n += file_read(file, values, values_length);
+    if (values_length < length) {
+        file_seek(file, (long) (length - values_length), SEEK_CUR);
+        *n += length - values_length;
+    }
+
+#ifdef WORDS_BIGENDIAN
+    // Values are stored in little endian byte order
+    size_t i, j;
+    for (i = 0; i < values_length; i += value_size) {
+        for (j = 0; j < value_size / 2; j++) {
+            char tmp = values[i + j];
+            values[i + j] = values[i + value_size - 1 - j];
+            values[i + value_size - 1 - j] = tmp;
+        }
+    }
+#endif
+
+    return values;
+}
+
+
+static DcmDataSet *read_item(DcmFile *file,
+                             uint32_t tag,
+                             uint32_t item_index,
+                             uint32_t item_length,
+                             size_t *n,
+                             bool implicit);
+static bool read_sequence_parallel(DcmFile *file,
+                                   uint32_t tag,
+                                   uint32_t length,
+                                   bool implicit,
+                                   DcmSequence *seq,
+                                   size_t *n,
+                                   bool *is_read,
+                                   bool *is_serial);
+
+
+static DcmElement *read_element(DcmFile *file,
+                                EHeader *header,
+                                size_t *n,
+                                bool implicit)
+{
+    assert(header);
+    uint32_t i;
+    uint32_t vm;
+    uint32_t item_index;
+    uint32_t item_tag;
+    uint32_t item_length;
+    size_t n_seq;
+    size_t *n_seq_ptr = &n_seq;
+    size_t n_item;
+    size_t *n_item_ptr = &n_item;
+    DcmElement *element;
+    IHeader item_iheader;
+    DcmDataSet *item_dataset;
+
+    uint32_t tag =  eheader_get_tag(header);
+    uint32_t length = eheader_get_length(header);
+
+    n_seq = 0;
+    n_item = 0;
+    item_index = 0;
+
+    dcm_log_debug("Read Data Element '%08X'", tag);
+
+    vm = 1;
+    // Character strings
+    if (eheader_check_vr(header, "AE") ||
+        eheader_check_vr(header, "AS") ||
+        eheader_check_vr(header, "CS") ||
+        eheader_check_vr(header, "DA") ||
+        eheader_check_vr(header, "DS") ||  // Decimal String
+        eheader_check_vr(header, "DT") ||
+        eheader_check_vr(header, "IS") ||  // Integer String
+        eheader_check_vr(header, "LO") ||
+        eheader_check_vr(header, "LT") ||
+        eheader_check_vr(header, "PN") ||
+        eheader_check_vr(header, "SH") ||
+        eheader_check_vr(header, "ST") ||
+        eheader_check_vr(header, "TM") ||
+        eheader_check_vr(header, "UI") ||
+        eheader_check_vr(header, "UR") ||
+        eheader_check_vr(header, "UT")) {
+        char *value = dcm_malloc(length + 1);
+        if (value == NULL) {
+            dcm_log_error("Reading of Data Element failed. "
+                          "Could not allocate memory for "
+                          "value of Data Element '%08X'.",
+                          tag);
+            return NULL;
+        }
+        *n += file_read(file, value, length);
+        if (length > 0) {
+            if (!eheader_check_vr(header, "UI")) {
+                if (isspace(value[length - 1])) {
+                    value[length - 1] = '\0';
+                }
+            }
+        }
+        value[length] = '\0';
+
+        // Parse value and create array of strings
+        char **strings = parse_character_string(value, &vm);
+
+        if (eheader_check_vr(header, "AE")) {
+            element = dcm_element_create_AE_multi(tag, strings, vm);
+        } else if (eheader_check_vr(header, "AS")) {
+            element = dcm_element_create_AS_multi(tag, strings, vm);
+        } else if (eheader_check_vr(header, "CS")) {
+            element = dcm_element_create_CS_multi(tag, strings, vm);
+        } else if (eheader_check_vr(header, "DA")) {
+            element = dcm_element_create_DA_multi(tag, strings, vm);
+        } else if (eheader_check_vr(header, "DS")) {
+            element = dcm_element_create_DS_multi(tag, strings, vm);
+        } else if (eheader_check_vr(header, "DT")) {
+            element = dcm_element_create_DT_multi(tag, strings, vm);
+        } else if (eheader_check_vr(header, "IS")) {
+            element = dcm_element_create_IS_multi(tag, strings, vm);
+        } else if (eheader_check_vr(header, "LO")) {
+            element = dcm_element_create_LO_multi(tag, strings, vm);
+        } else if (eheader_check_vr(header, "PN")) {
+            element = dcm_element_create_PN_multi(tag, strings, vm);
+        } else if (eheader_check_vr(header, "SH")) {
+            element = dcm_element_create_SH_multi(tag, strings, vm);
+        } else if (eheader_check_vr(header, "ST")) {
+            // This VM shall always have VM 1.
+            if (vm > 1) {
+                dcm_log_error("Reading of Data Element failed. "
+                              "Encountered unexpected Value Multiplicity %d "
+                              "for Data Element '%08X'.",
+                              vm, tag);
+                for (i = 0; i < vm; i++) {
+                    dcm_free(strings[i]);
+                }
+                dcm_free(strings);
+                return NULL;
+            }
+            char *str = strings[0];
+            dcm_free(strings);
+            return dcm_element_create_ST(tag, str);
+        } else if (eheader_check_vr(header, "TM")) {
+            element = dcm_element_create_TM_multi(tag, strings, vm);
+        } else if (eheader_check_vr(header, "UI")) {
+            element = dcm_element_create_UI_multi(tag, strings, vm);
+        } else if (eheader_check_vr(header, "LT")) {
+            // This VM shall always have VM 1.
+            if (vm > 1) {
+                dcm_log_error("Reading of Data Element failed. "
+                              "Encountered unexpected Value Multiplicity %d "
+                              "for Data Element '%08X'.",
+                              vm, tag);
+                for (i = 0; i < vm; i++) {
+                    dcm_free(strings[i]);
+                }
+                dcm_free(strings);
+                return NULL;
+            }
+            char *str = strings[0];
+            dcm_free(strings);
+            return dcm_element_create_LT(tag, str);
+        } else if (eheader_check_vr(header, "UR")) {
+            // This VM shall always have VM 1.
+            if (vm > 1) {
+                dcm_log_error("Reading of Data Element failed. "
+                              "Encountered unexpected Value Multiplicity %d "
+                              "for Data Element '%08X'.",
+                              vm, tag);
+                for (i = 0; i < vm; i++) {
+                    dcm_free(strings[i]);
+                }
+                dcm_free(strings);
+                return NULL;
+            }
+            char *str = strings[0];
+            dcm_free(strings);
+            return dcm_element_create_UR(tag, str);
+        } else if (eheader_check_vr(header, "UT")) {
+            // This VM shall always have VM 1.
+            if (vm > 1) {
+                dcm_log_error("Reading of Data Element failed. "
+                              "Encountered unexpected Value Multiplicity %d "
+                              "for Data Element '%08X'.",
+                              vm, tag);
+                for (i = 0; i < vm; i++) {
+                    dcm_free(strings[i]);
+                }
+                dcm_free(strings);
+                return NULL;
+            }
+            char *str = strings[0];
+            dcm_free(strings);
+            return dcm_element_create_UT(tag, str);
+        } else {
+            dcm_log_error("Reading of Data Element failed. "
+                          "Encountered unexpected Value Representation "
+                          "for Data Element '%08X'.",
+                          tag);
+            for (i = 0; i < vm; i++) {
+                dcm_free(strings[i]);
+            }
+            dcm_free(strings);
+            return NULL;
+        }
+        if (element && file->string_pool) {
+            dcm_element_intern(element, file->string_pool);
+        }
+        return element;
+    } else if (eheader_check_vr(header, "SQ")) {
+        vm = 1;
+        DcmSequence *value = dcm_sequence_create();
+        if (value == NULL) {
+            dcm_log_error("Reading of Data Element failed. "
+                          "Could not construct Sequence for "
+                          "Data Element '%08X'.");
+            return NULL;
+        }
+        if (length == 0) {
+            return dcm_element_create_SQ(tag, value);
+        } else if (length == 0xFFFFFFFF) {
+            dcm_log_debug("Sequence of Data Element '%08X' "
+                          "has undefined length.",
+                          tag);
+        } else {
+            dcm_log_debug("Sequence of Data Element '%08X' "
+                          "has defined length %d.",
+                          tag, length);
+        }
+
+        uint32_t read_flags = file->read_flags;
+        if (file->read_flags & DCM_READ_PARALLEL) {
+            bool is_read = false;
+            bool is_serial = false;
+            if (!read_sequence_parallel(file, tag, length, implicit,
+                                        value, n, &is_read, &is_serial)) {
+                dcm_sequence_destroy(value);
+                return NULL;
+            }
+            if (is_read) {
+                return dcm_element_create_SQ(tag, value);
+            }
+            // Sequences within the Items are smaller still
+            if (is_serial) {
+                file->read_flags &= ~DCM_READ_PARALLEL;
+            }
+        }
+
+        n_seq = 0;
+        while (n_seq < length) {
+            dcm_log_debug("Read Item #%d of Data Element '%08X'.",
+                          item_index, tag);
+            if (!read_item_header(file, n_seq_ptr, &item_iheader)) {
+                dcm_log_error("Reading of Data Element failed. "
+                              "Could not construct Item #%d of "
+                              "Data Element '%08X'.", item_index, tag);
+                goto sequence_failure;
+            }
+            item_tag = iheader_get_tag(&item_iheader);
+            item_length = iheader_get_length(&item_iheader);
+            if (item_tag == TAG_SQ_DELIM) {
+                dcm_log_debug("Stop reading Data Element '%08X'. "
+                              "Encountered Sequence Delimination Tag.",
+                              tag);
+                break;
+            }
+            if (item_tag != TAG_ITEM) {
+                dcm_log_error("Reading of Data Element failed. "
+                              "Expected tag '%08X' instead of '%08X' "
+                              "for Item #%d of Data Element '%08X'.",
+                              TAG_ITEM,
+                              item_tag,
+                              item_index,
+                              tag);
+                goto sequence_failure;
+            } else if (item_length == 0xFFFFFFFF) {
+                dcm_log_debug("Item #%d of Data Element '%08X' "
+                              "has undefined length.",
+                              item_index, tag);
+            } else {
+                dcm_log_debug("Item #%d of Data Element '%08X' "
+                              "has defined length %d.",
+                              item_index, tag, item_length);
+            }
+
+            n_item = 0;
+            item_dataset = read_item(file,
+                                     tag,
+                                     item_index,
+                                     item_length,
+                                     n_item_ptr,
+                                     implicit);
+            if (item_dataset == NULL) {
+                goto sequence_failure;
+            }
+            n_seq += n_item;
+            dcm_sequence_append(value, item_dataset);
+            item_index += 1;
+        }
+        file->read_flags = read_flags;
+        *n += n_seq;
+        return dcm_element_create_SQ(tag, value);
+
+    sequence_failure:
+        file->read_flags = read_flags;
+        dcm_sequence_destroy(value);
+        return NULL;
+    } else if (eheader_check_vr(header, "FD")) {
+        if (length == sizeof(double)) {
+            double value;
+            if (!read_numeric_value(file, n, &value, sizeof(value))) {
+                return NULL;
+            }
+            return dcm_element_create_FD(tag, value);
+        }
+        double *values = read_numeric_values(file, n, length, sizeof(double), &vm);
+        if (values == NULL) {
+            return NULL;
+        }
+        return dcm_element_create_FD_multi(tag, values, vm);
+    } else if (eheader_check_vr(header, "FL")) {
+        if (length == sizeof(float)) {
+            float value;
+            if (!read_numeric_value(file, n, &value, sizeof(value))) {
+                return NULL;
+            }
+            return dcm_element_create_FL(tag, value);
+        }
+        float *values = read_numeric_values(file, n, length, sizeof(float), &vm);
+        if (values == NULL) {
+            return NULL;
+        }
+        return dcm_element_create_FL_multi(tag, values, vm);
+    } else if (eheader_check_vr(header, "SS")) {
+        if (length == sizeof(int16_t)) {
+            int16_t value;
+            if (!read_numeric_value(file, n, &value, sizeof(value))) {
+                return NULL;
+            }
+            return dcm_element_create_SS(tag, value);
+        }
+        int16_t *values = read_numeric_values(file, n, length, sizeof(int16_t), &vm);
+        if (values == NULL) {
+            return NULL;
+        }
+        return dcm_element_create_SS_multi(tag, values, vm);
+    } else if (eheader_check_vr(header, "SL")) {
+        if (length == sizeof(int32_t)) {
+            int32_t value;
+            if (!read_numeric_value(file, n, &value, sizeof(value))) {
+                return NULL;
+            }
+            return dcm_element_create_SL(tag, value);
+        }
+        int32_t *values = read_numeric_values(file, n, length, sizeof(int32_t), &vm);
+        if (values == NULL) {
+            return NULL;
+        }
+        return dcm_element_create_SL_multi(tag, values, vm);
+    } else if (eheader_check_vr(header, "SV")) {
+        if (length == sizeof(int64_t)) {
+            int64_t value;
+            if (!read_numeric_value(file, n, &value, sizeof(value))) {
+                return NULL;
+            }
+            return dcm_element_create_SV(tag, value);
+        }
+        int64_t *values = read_numeric_values(file, n, length, sizeof(int64_t), &vm);
+        if (values == NULL) {
+            return NULL;
+        }
+        return dcm_element_create_SV_multi(tag, values, vm);
+    } else if (eheader_check_vr(header, "AT")) {
+        uint32_t *values = read_numeric_values(file,
+                                               n,
+                                               length,
+                                               sizeof(uint32_t),
+                                               &vm);
+        if (values == NULL) {
+            return NULL;
+        }
+        // The group number precedes the element number
+        for (i = 0; i < vm; i++) {
+            values[i] = (values[i] << 16) | (values[i] >> 16);
+        }
+        return dcm_element_create_AT_multi(tag, values, vm);
+    } else if (eheader_check_vr(header, "UL")) {
+        if (length == sizeof(uint32_t)) {
+            uint32_t value;
+            if (!read_numeric_value(file, n, &value, sizeof(value))) {
+                return NULL;
+            }
+            return dcm_element_create_UL(tag, value);
+        }
+        uint32_t *values = read_numeric_values(file, n, length, sizeof(uint32_t), &vm);
+        if (values == NULL) {
+            return NULL;
+        }
+        return dcm_element_create_UL_multi(tag, values, vm);
+    } else if (eheader_check_vr(header, "US")) {
+        if (length == sizeof(uint16_t)) {
+            uint16_t value;
+            if (!read_numeric_value(file, n, &value, sizeof(value))) {
+                return NULL;
+            }
+            return dcm_element_create_US(tag, value);
+        }
+        uint16_t *values = read_numeric_values(file, n, length, sizeof(uint16_t), &vm);
+        if (values == NULL) {
+            return NULL;
+        }
+        return dcm_element_create_US_multi(tag, values, vm);
+    } else if (eheader_check_vr(header, "UV")) {
+        if (length == sizeof(uint64_t)) {
+            uint64_t value;
+            if (!read_numeric_value(file, n, &value, sizeof(value))) {
+                return NULL;
+            }
+            return dcm_element_create_UV(tag, value);
+        }
+        uint64_t *values = read_numeric_values(file, n, length, sizeof(uint64_t), &vm);
+        if (values == NULL) {
+            return NULL;
+        }
+        return dcm_element_create_UV_multi(tag, values, vm);
+    } else {
+        vm = 1;
+        char *value = dcm_malloc(length);
+        if (value == NULL) {
+            dcm_log_error("Reading of Data Element failed. "
+                          "Could not allocate memory for "
+                          "value of Data Element '%08X'.",
+                          tag);
+            return NULL;
+        }
+        *n += file_read(file, value, length);
+
+        if (eheader_check_vr(header, "OB")) {
+            return dcm_element_create_OB(tag, value, length);
+        } else if (eheader_check_vr(header, "OD")) {
+            return dcm_element_create_OD(tag, value, length);
+        } else if (eheader_check_vr(header, "OF")) {
+            return dcm_element_create_OF(tag, value, length);
+        } else if (eheader_check_vr(header, "OL")) {
+            return dcm_element_create_OL(tag, value, length);
+        } else if (eheader_check_vr(header, "OV")) {
+            return dcm_element_create_OV(tag, value, length);
+        } else if (eheader_check_vr(header, "OW")) {
+            return dcm_element_create_OW(tag, value, length);
+        } else if (eheader_check_vr(header, "UC")) {
+            return dcm_element_create_UC(tag, value, length);
+        } else if (eheader_check_vr(header, "UN")) {
+            return dcm_element_create_UN(tag, value, length);
+        } else {
+            tag = eheader_get_tag(header);
+            dcm_log_error("Reading of Data Element failed. "
+                          "Data Element '%08X' has unexpected "
+                          "Value Representation.", tag);
+            return NULL;
+        }
+    }
+    return element;
+}
+
+
+/**
+ * Read the Data Elements of an Item of a Sequence after its Item header.
+ */
+static DcmDataSet *read_item(DcmFile *file,
+                             uint32_t tag,
+                             uint32_t item_index,
+                             uint32_t item_length,
+                             size_t *n,
+                             bool implicit)
+{
+    EHeader item_eheader;
+    size_t n_item = 0;
+
+    DcmDataSet *item_dataset = dcm_dataset_create();
+    if (item_dataset == NULL) {
+        dcm_log_error("Reading of Data Element failed. "
+                      "Could not construct Data Set for "
+                      "Item #%d of Data Element '%08X'.",
+                      item_index,
+                      tag);
+        return NULL;
+    }
+
+    while (n_item < item_length) {
+        if (read_tag(file, &n_item) == TAG_ITEM_DELIM) {
+            // Item with undefined length
+            dcm_log_debug("Stop reading Item #%d of "
+                          "Data Element '%08X'. "
+                          "Encountered Item Delimination Tag.",
+                          item_index, tag);
+            file_seek(file, 4, SEEK_CUR);
+            n_item += 4;
+            break;
+        } else {
+            file_seek(file, -4, SEEK_CUR);
+            n_item -= 4;
+        }
+
+        if (!read_element_header(file,
+                                 &n_item,
+                                 implicit,
+                                 &item_eheader)) {
+            dcm_log_error("Reading of Data Element failed. "
+                          "Could not read header of Item #%d "
+                          "of Data Element '%08X'.",
+                          item_index, tag);
+            dcm_dataset_destroy(item_dataset);
+            return NULL;
+        }
+
+        DcmElement *item_element = read_element(file,
+                                                &item_eheader,
+                                                &n_item,
+                                                implicit);
+        if (item_element == NULL) {
+            dcm_log_error("Reading of Data Element failed. "
+                          "Could not read value of Item #%d of "
+                          "Data Element '%08X'.",
+                          item_index, tag);
+            dcm_dataset_destroy(item_dataset);
+            return NULL;
+        }
+        if (!dcm_dataset_insert(item_dataset, item_element)) {
+            dcm_log_error("Inserting Item #%d of Data Element '%08X' "
+                          "into Data Set failed.", item_index, tag);
+            dcm_dataset_destroy(item_dataset);
+            return NULL;
+        }
+    }
+
+    *n += n_item;
+    return item_dataset;
+}
+
+
+/**
+ * Create a File that reads from the given source.
+ *
+ * The handle is closed if creation fails.
+ */
+static DcmFile *file_create(const DcmIOMethods *io,
+                            void *io_handle,
+                            struct FileMap *map)
+{
+    DcmFile *file = DCM_NEW(DcmFile);
+    if (file == NULL) {
+        dcm_log_error("Creation of file failed. "
+                      "Could not allocate memory for file.");
+        file_map_destroy(map);
+        if (io && io->close) {
+            io->close(io_handle);
+        }
+        return NULL;
+    }
+
+    file->io = io;
+    file->io_handle = io_handle;
+    file->map = map;
+    file->position = 0;
+    file->eof = false;
+    file->buffer = NULL;
+    file->buffer_offset = 0;
+    file->buffer_length = 0;
+    if (file->map == NULL && io && io->map) {
+        // Sources that are in memory as a whole are read like mappings
+        int64_t size = 0;
+        const char *data = io->map(io_handle, &size);
+        if (data && size > 0) {
+            file->map = DCM_NEW(struct FileMap);
+            if (file->map) {
+                file->map->data = data;
+                file->map->size = (size_t) size;
+                file->map->is_owned = false;
+            }
+        }
+    }
+    if (file->map == NULL) {
+        file->buffer = dcm_heap_malloc(READ_BUFFER_SIZE);
+        if (file->buffer == NULL) {
+            dcm_log_error("Creation of file failed. "
+                          "Could not allocate memory for read buffer.");
+            if (io && io->close) {
+                io->close(io_handle);
+            }
+            dcm_heap_free(file);
+            return NULL;
+        }
+    }
+
+    file->read_flags = DCM_READ_DEFAULT;
+    file->string_pool = NULL;
+    file->counters = &file->own_counters;
+    init_counters(file->counters);
+    file->is_counting_elements = true;
+    atomic_init(&file->next_read_offset, 0);
+    file->offset = 0;
+    file->pixel_data_offset = 0;
+    file->first_frame_offset = 0;
+    file->transfer_syntax_uid = NULL;
+    file->extended_offset_table = NULL;
+    file->num_extended_offsets = 0;
+    file->file_size = 0;
+    file->file_mtime = 0;
+    if (file->map) {
+        file->file_size = (uint64_t) file->map->size;
+    } else if (io->size && io->size(io_handle) >= 0) {
+        file->file_size = (uint64_t) io->size(io_handle);
+    }
+    file->index_offsets = NULL;
+    file->index_num_frames = 0;
+    file->desc = NULL;
+    atomic_init(&file->refcount, 1);
+    static atomic_uint next_file_id = 1;
+    file->id = atomic_fetch_add(&next_file_id, 1);
+    file->is_writable = false;
+    file->writer = NULL;
+#ifdef HAVE_PTHREAD_H
+    // Lazily read values may be loaded while the Data Set is being read
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&file->stream_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+#endif
+
+    return file;
+}
+
+
+DcmFile *dcm_file_create(const char *file_path, const char mode)
+{
+    struct FileMap *map = NULL;
+    struct StdioHandle *stdio = NULL;
+
+    if (mode != 'r' && mode != 'm' && mode != 'w') {
+        dcm_log_error("Creation of file failed. "
+                      "Wrong file mode specified.");
+        exit(1);
+    }
+
+    if (mode == 'm') {
+        map = file_map_create(file_path);
+        if (map == NULL) {
+            dcm_log_info("Could not map file into memory: %s. "
+                         "Falling back to buffered reading.",
+                         file_path);
+        }
+    }
+
+    if (map == NULL) {
+        char file_mode[3];
+        file_mode[0] = mode == 'w' ? 'w' : 'r';
+        file_mode[1] = 'b';
+        file_mode[2] = '\0';
+        stdio = DCM_NEW(struct StdioHandle);
+        if (stdio == NULL) {
+            dcm_log_error("Creation of file failed. "
+                          "Could not allocate memory for file.");
+            return NULL;
+        }
+        stdio->fp = fopen(file_path, file_mode);
+        if (stdio->fp == NULL) {
+            dcm_log_error("Could not open file: %s", file_path);
+            dcm_heap_free(stdio);
+            return NULL;
+        }
+    }
+
+    // Mappings are read directly, without I/O methods
+    DcmFile *file = file_create(map ? NULL : &stdio_methods, stdio, map);
+    if (file == NULL) {
+        return NULL;
+    }
+    file->is_writable = mode == 'w';
+#ifdef HAVE_SYS_STAT_H
+    struct stat info;
+    if (stat(file_path, &info) == 0) {
+        file->file_size = (uint64_t) info.st_size;
+        file->file_mtime = (int64_t) info.st_mtime;
+    }
+#endif
+
+    return file;
+}
+
+
+DcmFile *dcm_file_create_io(const DcmIOMethods *io, void *handle)
+{
+    assert(io);
+    if (io->read_at == NULL) {
+        dcm_log_error("Creation of file failed. "
+                      "I/O methods lack a function for reading.");
+        if (io->close) {
+            io->close(handle);
+        }
+        return NULL;
+    }
+    return file_create(io, handle, NULL);
+}
+
+
+DcmFile *dcm_file_create_memory(const char *data, size_t size)
+{
+    struct MemoryHandle *memory = DCM_NEW(struct MemoryHandle);
+    if (memory == NULL) {
+        dcm_log_error("Creation of file failed. "
+                      "Could not allocate memory for file.");
+        return NULL;
+    }
+    memory->data = data;
+    memory->size = size;
+    return file_create(&memory_methods, memory, NULL);
+}
+
+
+DcmFile *dcm_file_create_fd(int fd)
+{
+#ifdef HAVE_UNISTD_H
+    int *handle = DCM_NEW(int);
+    if (handle == NULL) {
+        dcm_log_error("Creation of file failed. "
+                      "Could not allocate memory for file.");
+        return NULL;
+    }
+    *handle = fd;
+    DcmFile *file = file_create(&fd_methods, handle, NULL);
+#ifdef HAVE_SYS_STAT_H
+    struct stat info;
+    if (file && fstat(fd, &info) == 0) {
+        file->file_mtime = (int64_t) info.st_mtime;
+    }
+#endif
+    return file;
+#else
+    (void) fd;
+    dcm_log_error("Creation of file failed. "
+                  "File descriptors are not supported on this platform.");
+    return NULL;
+#endif
+}
+
+
+static DcmDataSet *read_file_meta(DcmFile *file)
+{
+    const bool implicit = false;
+
+    size_t size;
+    size_t *n = &size;
+    uint8_t n_elem;
+    uint32_t tag;
+    uint16_t group_number;
+    EHeader header;
+    DcmElement *element;
+
+    DcmDataSet *file_meta = dcm_dataset_create();
+    if (file_meta == NULL) {
+        dcm_log_error("Reading of File Meta Information failed. "
+                      "Could not construct Data Set.");
+        return NULL;
+    }
+
+    size = 0;
+
+    // File Preamble
+    char preamble[129];
+    size += file_read(file, preamble, sizeof(preamble) - 1);
+    preamble[128] = '\0';
+
+    // DICOM Prefix
+    char prefix[5];
+    size += file_read(file, prefix, sizeof(prefix) - 1);
+    prefix[4] = '\0';
+    if (strcmp(prefix, "DICM") != 0) {
+        dcm_log_error("Reading of File Meta Information failed. "
+                      "Prefix 'DICM' not found.");
+        dcm_dataset_destroy(file_meta);
+        return NULL;
+    }
+
+    size = 0;
+
+    // File Meta Information Group Length
+    if (!read_element_header(file, n, implicit, &header)) {
+        dcm_log_error("Reading of File Meta Information failed. "
+                      "Header of Data Element 'Group Length' "
+                      "could not be read.");
+        dcm_dataset_destroy(file_meta);
+        return NULL;
+    }
+    element = read_element(file, &header, n, implicit);
+    if (element == NULL) {
+        dcm_log_error("Reading of File Meta Information failed. "
+                      "Value of Data Element 'Group Length' "
+                      "could not be read.");
+        dcm_dataset_destroy(file_meta);
+        return NULL;
+    }
+
+    uint32_t group_length = dcm_element_get_value_UL(element, 0);
+    dcm_element_destroy(element);
+
+    // File Meta Information Version
+    if (!read_element_header(file, n, implicit, &header)) {
+        dcm_log_error("Reading of File Meta Information failed. "
+                      "Header of Data Element 'File Meta Information Version' "
+                      "could not be read.");
+        dcm_dataset_destroy(file_meta);
+        return NULL;
+    }
+    element = read_element(file, &header, n, implicit);
+    if (element == NULL) {
+        dcm_log_error("Reading of File Meta Information failed. "
+                      "Value of Data Element 'File Meta Information Version' "
+                      "could not be read.");
+        dcm_dataset_destroy(file_meta);
+        return NULL;
+    }
+    dcm_element_destroy(element);
+
+    n_elem = 0;
+    while(true) {
+        if (!read_element_header(file, n, implicit, &header)) {
+            dcm_log_error("Reading of File Meta Information failed. "
+                          "Could not read header of Data Element #%d.",
+                          n_elem);
+            dcm_element_destroy(element);
+            dcm_dataset_destroy(file_meta);
+            return NULL;
+        }
+        tag = eheader_get_tag(&header);
+        group_number = eheader_get_group_number(&header);
+        if (group_number != 0x0002) {
+            break;
+        }
+
+        element = read_element(file, &header, n, implicit);
+        if (element == NULL) {
+            dcm_log_error("Reading File Meta Information failed. "
+                          "Could not read value of Data Element '%08X'.", tag);
+            dcm_dataset_destroy(file_meta);
+            return NULL;
+        }
+
+        if (!dcm_dataset_insert(file_meta, element)) {
+            dcm_log_error("Reading File Meta Information failed. "
+                          "Could not insert Data Element '%08X' into "
+                          "Data Set.", tag);
+            dcm_dataset_destroy(file_meta);
+            return NULL;
+        }
+
+        if (size >= group_length) {
+            break;
+        }
+        n_elem += 1;
+    }
+
+    file->offset = file_tell(file);
+
+    element = dcm_dataset_get(file_meta, 0x00020010);
+    const char *transfer_syntax_uid = dcm_element_get_value_UI(element, 0);
+    file->transfer_syntax_uid = dcm_strdup(transfer_syntax_uid);
+    if (file->transfer_syntax_uid == NULL) {
+        dcm_log_error("Reading of File Meta Information failed. "
+                      "Could not allocate memory for data element "
+                      "'Transfer Syntax UID'.");
+        file->offset = 0;  // reset state
+        dcm_dataset_destroy(file_meta);
+        return NULL;
+    }
+
+    dcm_dataset_lock(file_meta);
+    return file_meta;
+}
+
+
+static struct PixelDescription *create_pixel_description(const DcmDataSet *metadata);
+static void destroy_pixel_description(struct PixelDescription *desc);
+static void writer_destroy(struct FileWriter *writer);
+
+
+static void file_retain(const DcmFile *file)
+{
+    atomic_fetch_add(&((DcmFile *) file)->refcount, 1);
+}
+
+
+static void file_release(void *owner)
+{
+    DcmFile *file = (DcmFile *) owner;
+    if (atomic_fetch_sub(&file->refcount, 1) != 1) {
+        // Still referenced by Frame views
+        return;
+    }
+    if (file->desc) {
+        destroy_pixel_description(file->desc);
+    }
+    if (file->transfer_syntax_uid) {
+        dcm_heap_free(file->transfer_syntax_uid);
+    }
+    dcm_heap_free(file->extended_offset_table);
+    dcm_heap_free(file->index_offsets);
+    dcm_string_pool_release(file->string_pool);
+    writer_destroy(file->writer);
+    if (file->map) {
+        file_map_destroy(file->map);
+    }
+    if (file->io && file->io->close) {
+        file->io->close(file->io_handle);
+    }
+    dcm_heap_free(file->buffer);
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_destroy(&file->stream_mutex);
+#endif
+    dcm_heap_free(file);
+}
+
+
+static void file_lock_stream(DcmFile *file)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&file->stream_mutex);
+#else
+    (void) file;
+#endif
+}
+
+
+static void file_unlock_stream(DcmFile *file)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_unlock(&file->stream_mutex);
+#else
+    (void) file;
+#endif
+}
+
+
+// Lazily read Data Elements
+
+struct _DcmElementSource {
+    DcmFile *file;
+    // Arena of the Data Set, from which loaded values are allocated
+    DcmArena *arena;
+    bool implicit;
+    atomic_uint refcount;
+};
+
+
+static DcmElementSource *element_source_create(DcmFile *file, bool implicit)
+{
+    DcmElementSource *source = DCM_NEW(DcmElementSource);
+    if (source == NULL) {
+        return NULL;
+    }
+    file_retain(file);
+    source->file = file;
+    source->arena = dcm_arena_current();
+    if (source->arena) {
+        dcm_arena_retain(source->arena);
+    }
+    source->implicit = implicit;
+    atomic_init(&source->refcount, 1);
+    return source;
+}
+
+
+void dcm_element_source_retain(DcmElementSource *source)
+{
+    atomic_fetch_add(&source->refcount, 1);
+}
+
+
+void dcm_element_source_release(DcmElementSource *source)
+{
+    if (source && atomic_fetch_sub(&source->refcount, 1) == 1) {
+        if (source->arena) {
+            dcm_arena_release(source->arena);
+        }
+        file_release(source->file);
+        dcm_heap_free(source);
+    }
+}
+
+
+void dcm_element_source_lock(DcmElementSource *source)
+{
+    file_lock_stream(source->file);
+}
+
+
+void dcm_element_source_unlock(DcmElementSource *source)
+{
+    file_unlock_stream(source->file);
+}
+
+
+DcmElement *dcm_element_source_load(DcmElementSource *source,
+                                    uint32_t tag,
+                                    const char *vr,
+                                    uint32_t length,
+                                    size_t offset)
+{
+    DcmFile *file = source->file;
+    EHeader header;
+    size_t n = 0;
+
+    if (!eheader_init(&header, tag, vr, length)) {
+        return NULL;
+    }
+
+    // The value may be loaded while another Data Set is being read
+    size_t position = file->position;
+    bool eof = file->eof;
+    file_seek(file, (long) offset, SEEK_SET);
+
+    DcmArena *previous = dcm_arena_enter(source->arena);
+    DcmElement *element = read_element(file, &header, &n, source->implicit);
+    dcm_arena_leave(previous);
+
+    file->position = position;
+    file->eof = eof;
+
+    return element;
+}
+
+
+/**
+ * Skip the value of a Data Element without decoding it.
+ */
+static bool skip_value(DcmFile *file, EHeader *header, bool implicit);
+
+
+/**
+ * Skip the Data Elements of an Item with undefined length, up to and
+ * including the Item Delimiter.
+ */
+static bool skip_item(DcmFile *file, bool implicit)
+{
+    size_t n = 0;
+    EHeader element;
+
+    while (true) {
+        if (read_tag(file, &n) == TAG_ITEM_DELIM) {
+            file_seek(file, 4, SEEK_CUR);
+            return true;
+        }
+        file_seek(file, -4, SEEK_CUR);
+        if (file_eof(file) ||
+            !read_element_header(file, &n, implicit, &element) ||
+            !skip_value(file, &element, implicit)) {
+            return false;
+        }
+    }
+}
+
+
+static bool skip_value(DcmFile *file, EHeader *header, bool implicit)
+{
+    size_t n = 0;
+    IHeader item;
+
+    uint32_t length = eheader_get_length(header);
+    if (length != 0xFFFFFFFF) {
+        return file_seek(file, (long) length, SEEK_CUR) == 0;
+    }
+
+    // Items of a value with undefined length, up to the Sequence Delimiter
+    while (true) {
+        if (!read_item_header(file, &n, &item)) {
+            return false;
+        }
+        uint32_t item_tag = iheader_get_tag(&item);
+        uint32_t item_length = iheader_get_length(&item);
+        if (item_tag == TAG_SQ_DELIM) {
+            return true;
+        }
+        if (item_tag != TAG_ITEM) {
+            dcm_log_error("Skipping value of Data Element '%08X' failed. "
+                          "Expected tag '%08X' instead of '%08X'.",
+                          eheader_get_tag(header), TAG_ITEM, item_tag);
+            return false;
+        }
+        if (item_length != 0xFFFFFFFF) {
+            if (file_seek(file, (long) item_length, SEEK_CUR) != 0) {
+                return false;
+            }
+        } else if (!skip_item(file, implicit)) {
+            return false;
+        }
+    }
+}
+
+
+void dcm_file_destroy(DcmFile *file)
+{
+    if (file) {
+        file_release(file);
+    }
+}
+
+
+/**
+ * Selection of the Data Elements that are read from a Data Set.
+ */
+struct TagFilter {
+    // Sorted Attribute Tags of the wanted Data Elements or NULL for all
+    uint32_t *tags;
+    uint32_t num_tags;
+    // Reading stops at the first Data Element with a greater Tag
+    uint32_t max_tag;
+};
+
+
+static int compare_tags(const void *a, const void *b)
+{
+    uint32_t tag_a = *(const uint32_t *) a;
+    uint32_t tag_b = *(const uint32_t *) b;
+    return (tag_a > tag_b) - (tag_a < tag_b);
+}
+
+
+static bool tag_filter_matches(const struct TagFilter *filter, uint32_t tag)
+{
+    if (filter == NULL || filter->tags == NULL) {
+        return true;
+    }
+    return bsearch(&tag,
+                   filter->tags,
+                   filter->num_tags,
+                   sizeof(uint32_t),
+                   compare_tags) != NULL;
+}
+
+
+/**
+ * Keep the values of the Extended Offset Table whose header was just read,
+ * so that Frames can be located without scanning the Pixel Data Element.
+ */
+static bool read_extended_offset_table(DcmFile *file, EHeader *header)
+{
+    uint32_t i;
+
+    uint64_t length = eheader_get_length(header);
+    if (length == 0 || length % 8 != 0 || length / 8 > UINT32_MAX) {
+        return false;
+    }
+    uint32_t num_offsets = (uint32_t) (length / 8);
+    char *values = dcm_heap_malloc(length);
+    uint64_t *offsets = dcm_heap_malloc(num_offsets * sizeof(uint64_t));
+    if (values == NULL || offsets == NULL) {
+        dcm_heap_free(values);
+        dcm_heap_free(offsets);
+        return false;
+    }
+    size_t offset = (size_t) file_tell(file);
+    if (file_pread(file, values, length, offset) != length) {
+        dcm_heap_free(values);
+        dcm_heap_free(offsets);
+        return false;
+    }
+    for (i = 0; i < num_offsets; i++) {
+        offsets[i] = decode_uint64(values + i * 8);
+    }
+    dcm_heap_free(values);
+
+    dcm_heap_free(file->extended_offset_table);
+    file->extended_offset_table = offsets;
+    file->num_extended_offsets = num_offsets;
+    return true;
+}
+
+
+static DcmDataSet *read_metadata(DcmFile *file,
+                                 const struct TagFilter *filter)
+{
+    uint32_t tag;
+    uint16_t group_number;
+    size_t size = 0;
+    size_t *n = &size;
+    uint32_t n_elem;
+    bool implicit;
+    size_t available;
+    DcmElement *element;
+    EHeader header;
+
+    if (file->offset == 0) {
+        DcmDataSet *file_meta = read_file_meta(file);
+        if (file_meta == NULL) {
+            dcm_log_error("Reading metadata failed. "
+                          "Could not read File Meta Information.");
+            return NULL;
+        }
+        dcm_dataset_destroy(file_meta);
+    }
+    file_seek(file, file->offset, SEEK_SET);
+
+    implicit = false;
+    if (file->transfer_syntax_uid) {
+        if (strcmp(file->transfer_syntax_uid, "1.2.840.10008.1.2") == 0) {
+            implicit = true;
+        }
+    }
+
+    DcmDataSet *dataset = dcm_dataset_create();
+    if (dataset == NULL) {
+        dcm_log_error("Reading of Data Set failed. "
+                      "Could not construct Data Set.");
+        return NULL;
+    }
+
+    DcmElementSource *source = NULL;
+    if (file->read_flags & DCM_READ_LAZY) {
+        source = element_source_create(file, implicit);
+        if (source == NULL) {
+            dcm_log_error("Reading of Data Set failed. "
+                          "Could not allocate memory.");
+            dcm_dataset_destroy(dataset);
+            return NULL;
+        }
+    }
+
+    n_elem = 0;
+    while (!file_eof(file)) {
+        file_peek(file, 1, &available);
+        if (available == 0) {
+            dcm_log_info("Stop reading Data Set. Reached end of file.");
+            break;
+        }
+
+        if (!read_element_header(file, n, implicit, &header)) {
+            dcm_log_error("Reading of Data Set failed. "
+                          "Could not read header of Data Element #%d.",
+                          n_elem);
+            dcm_element_source_release(source);
+            dcm_dataset_destroy(dataset);
+            return NULL;
+        }
+
+        tag = eheader_get_tag(&header);
+        group_number = eheader_get_group_number(&header);
+        if (tag == TAG_TRAILING_PADDING) {
+            dcm_log_debug("Stop reading Data Set. "
+                          "Encountered Data Set Trailing Tag.");
+            break;
+        } else if (tag == TAG_PIXEL_DATA ||
+                   tag == TAG_FLOAT_PIXEL_DATA ||
+                   tag == TAG_DOUBLE_PIXEL_DATA) {
+            // Set file pointer to the first byte of the pixel data element
+            if (implicit) {
+                // Tag: 4 bytes, Value Length: 4 bytes
+                file_seek(file, -8L, SEEK_CUR);
+            } else {
+                // Tag: 4 bytes, VR: 2 bytes + 2 bytes, Value Length: 4 bytes
+                file_seek(file, -12L, SEEK_CUR);
+            }
+            file->pixel_data_offset = file_tell(file);
+            if (dcm_is_encapsulated_transfer_syntax(file->transfer_syntax_uid)) {
+                // Frame Items follow the Basic Offset Table Item
+                IHeader iheader;
+                if (read_item_header_at(file,
+                                        file->pixel_data_offset + 12,
+                                        &iheader)) {
+                    file->first_frame_offset = (file->pixel_data_offset +
+                                                12 + 8 +
+                                                iheader_get_length(&iheader));
+                }
+            } else {
+                file->first_frame_offset = (file->pixel_data_offset +
+                                            (implicit ? 8 : 12));
+            }
+            dcm_log_debug("Stop reading Data Set. "
+                          "Encountered Tag of Pixel Data Element.");
+            break;
+        }
+        if (group_number == 0x0002) {
+            dcm_log_error("Reading of Data Set failed. "
+                          "Encountered File Meta Information group.");
+            dcm_element_source_release(source);
+            dcm_dataset_destroy(dataset);
+            return NULL;
+        }
+        if (tag == TAG_EXTENDED_OFFSET_TABLE &&
+            !read_extended_offset_table(file, &header)) {
+            // The table is optional, Frames are located as without it
+            dcm_log_warning("Skipping Extended Offset Table. "
+                            "Table is empty or malformed.");
+            if (!skip_value(file, &header, implicit)) {
+                dcm_log_error("Reading of Data Set failed. "
+                              "Could not skip value of Data Element '%08X'.",
+                              tag);
+                dcm_element_source_release(source);
+                dcm_dataset_destroy(dataset);
+                return NULL;
+            }
+            continue;
+        }
+        if (filter && tag > filter->max_tag) {
+            dcm_log_debug("Stop reading Data Set. "
+                          "Encountered Tag greater than '%08X'.",
+                          filter->max_tag);
+            break;
+        }
+        if (!tag_filter_matches(filter, tag)) {
+            // Neither allocate the Data Element nor decode its value
+            if (!skip_value(file, &header, implicit)) {
+                dcm_log_error("Reading of Data Set failed. "
+                              "Could not skip value of Data Element '%08X'.",
+                              tag);
+                dcm_element_source_release(source);
+                dcm_dataset_destroy(dataset);
+                return NULL;
+            }
+            continue;
+        }
+
+        if (source) {
+            // Record where the value is and read it on first access
+            uint32_t length = (uint32_t) eheader_get_length(&header);
+            element = dcm_element_create_lazy(tag,
+                                              header.vr,
+                                              length,
+                                              source,
+                                              (size_t) file_tell(file));
+            if (element && !skip_value(file, &header, implicit)) {
+                dcm_element_destroy(element);
+                element = NULL;
+            }
+        } else {
+            element = read_element(file, &header, n, implicit);
+        }
+        if (element == NULL) {
+            dcm_log_error("Reading of Data Set failed. "
+                          "Could not read value of Data Element '%08X'.",
+                          tag);
+            dcm_element_source_release(source);
+            dcm_dataset_destroy(dataset);
+            return NULL;
+        }
+        if (!dcm_dataset_insert(dataset, element)) {
+            dcm_log_error("Inserting Data Element '%08X' into Data Set "
+                          "failed.", tag);
+            dcm_element_source_release(source);
+            dcm_dataset_destroy(dataset);
+            return NULL;
+        }
+
+        n_elem += 1;
+    }
+    // Each lazily read Data Element holds its own reference
+    dcm_element_source_release(source);
+
+    if (file->desc == NULL &&
+        filter == NULL &&
+        dcm_dataset_contains(dataset, 0x00280010)) {
+        // Shared by Frame views, which thus neither need the metadata
+        // nor own copies of the descriptive strings
+        file->desc = create_pixel_description(dataset);
+    }
+
+    dcm_dataset_lock(dataset);
+    return dataset;
+}
+
+
+/**
+ * Read a Data Set, allocating it from an arena if requested by the flags.
+ */
+static DcmDataSet *read_dataset(DcmFile *file,
+                                const char *name,
+                                DcmDataSet *(*read)(DcmFile *,
+                                                    const struct TagFilter *),
+                                const struct TagFilter *filter)
+{
+    if (!(file->read_flags & DCM_READ_ARENA)) {
+        dcm_trace_start(name, file);
+        file_lock_stream(file);
+        DcmDataSet *dataset = read(file, filter);
+        file_unlock_stream(file);
+        dcm_trace_end(name, file);
+        return dataset;
+    }
+
+    DcmArena *arena = dcm_arena_create();
+    if (arena == NULL) {
+        dcm_log_error("Reading of Data Set failed. "
+                      "Could not allocate memory.");
+        return NULL;
+    }
+    DcmArena *previous = dcm_arena_enter(arena);
+    dcm_trace_start(name, file);
+    file_lock_stream(file);
+    DcmDataSet *dataset = read(file, filter);
+    file_unlock_stream(file);
+    dcm_trace_end(name, file);
+    dcm_arena_leave(previous);
+    // The Data Set and its nested Data Sets hold their own references
+    dcm_arena_release(arena);
+
+    return dataset;
+}
+
+
+static DcmDataSet *read_all_file_meta(DcmFile *file,
+                                      const struct TagFilter *filter)
+{
+    (void) filter;
+    return read_file_meta(file);
+}
+
+
+DcmDataSet *dcm_file_read_file_meta(DcmFile *file)
+{
+    return read_dataset(file, "read_file_meta", read_all_file_meta, NULL);
+}
+
+
+DcmDataSet *dcm_file_read_metadata(DcmFile *file)
+{
+    return read_dataset(file, "read_metadata", read_metadata, NULL);
+}
+
+
+DcmDataSet *dcm_file_read_metadata_tags(DcmFile *file,
+                                        const uint32_t *tags,
+                                        uint32_t num_tags,
+                                        uint32_t max_tag)
+{
+    struct TagFilter filter = {NULL, num_tags, max_tag};
+
+    if (tags) {
+        filter.tags = DCM_ARRAY_ZEROS(num_tags, uint32_t);
+        if (filter.tags == NULL && num_tags > 0) {
+            dcm_log_error("Reading of Data Set failed. "
+                          "Could not allocate memory.");
+            return NULL;
+        }
+        memcpy(filter.tags, tags, num_tags * sizeof(uint32_t));
+        qsort(filter.tags, num_tags, sizeof(uint32_t), compare_tags);
+        if (num_tags > 0 && filter.tags[num_tags - 1] < filter.max_tag) {
+            // No wanted Data Element can follow the greatest wanted Tag
+            filter.max_tag = filter.tags[num_tags - 1];
+        }
+    }
+
+    DcmDataSet *dataset = read_dataset(file,
+                                       "read_metadata",
+                                       read_metadata,
+                                       &filter);
+    dcm_heap_free(filter.tags);
+
+    return dataset;
+}
+
+
+/**
+ * Maximum size of the chunks in which values are passed to parse handlers.
+ */
+#define PARSE_CHUNK_SIZE 16384
+
+
+/**
+ * State of a call to dcm_file_parse().
+ */
+struct Parser {
+    DcmFile *file;
+    const DcmParseHandlers *handlers;
+    void *user_data;
+    // Set if a handler asked to stop
+    bool is_stopped;
+};
+
+
+/**
+ * Record whether a handler asked to continue.
+ */
+static bool parser_continue(struct Parser *parser, bool result)
+{
+    if (!result) {
+        parser->is_stopped = true;
+    }
+    return result;
+}
+
+
+static bool parse_value(struct Parser *parser, uint32_t tag, uint32_t length)
+{
+    size_t available;
+
+    while (length > 0) {
+        uint32_t size = length < PARSE_CHUNK_SIZE ? length : PARSE_CHUNK_SIZE;
+        const char *data = file_peek(parser->file, size, &available);
+        file_advance(parser->file, size, available);
+        if (available < size) {
+            dcm_log_error("Parsing of Data Element '%08X' failed. "
+                          "Reached end of file.", tag);
+            return false;
+        }
+        if (parser->handlers->value_chunk &&
+            !parser_continue(parser,
+                             parser->handlers->value_chunk(parser->user_data,
+                                                           data,
+                                                           size))) {
+            return false;
+        }
+        length -= size;
+    }
+    return true;
+}
+
+
+static bool parse_element(struct Parser *parser,
+                          EHeader *header,
+                          bool implicit);
+
+
+static bool parse_items(struct Parser *parser,
+                        uint32_t tag,
+                        uint32_t length,
+                        bool implicit)
+{
+    IHeader iheader;
+    EHeader eheader;
+    const DcmParseHandlers *handlers = parser->handlers;
+    size_t n_seq = 0;
+    uint32_t index;
+
+    for (index = 0; n_seq < length; index++) {
+        if (!read_item_header(parser->file, &n_seq, &iheader)) {
+            return false;
+        }
+        uint32_t item_tag = iheader_get_tag(&iheader);
+        uint32_t item_length = iheader_get_length(&iheader);
+        if (item_tag == TAG_SQ_DELIM) {
+            break;
+        }
+        if (item_tag != TAG_ITEM) {
+            dcm_log_error("Parsing of Data Element '%08X' failed. "
+                          "Expected tag '%08X' instead of '%08X' "
+                          "for Item #%d.", tag, TAG_ITEM, item_tag, index);
+            return false;
+        }
+        if (handlers->item_start &&
+            !parser_continue(parser,
+                             handlers->item_start(parser->user_data,
+                                                  index,
+                                                  item_length))) {
+            return false;
+        }
+
+        long start = file_tell(parser->file);
+        while ((size_t) (file_tell(parser->file) - start) < item_length) {
+            size_t n = 0;
+            if (read_tag(parser->file, &n) == TAG_ITEM_DELIM) {
+                file_seek(parser->file, 4, SEEK_CUR);
+                break;
+            }
+            file_seek(parser->file, -4, SEEK_CUR);
+            if (file_eof(parser->file) ||
+                !read_element_header(parser->file, &n, implicit, &eheader)) {
+                dcm_log_error("Parsing of Data Element '%08X' failed. "
+                              "Could not read header of Item #%d.",
+                              tag, index);
+                return false;
+            }
+            if (!parse_element(parser, &eheader, implicit)) {
+                return false;
+            }
+        }
+        n_seq += (size_t) (file_tell(parser->file) - start);
+
+        if (handlers->item_end &&
+            !parser_continue(parser,
+                             handlers->item_end(parser->user_data, index))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static bool parse_fragments(struct Parser *parser, uint32_t tag)
+{
+    IHeader iheader;
+    const DcmParseHandlers *handlers = parser->handlers;
+    size_t n = 0;
+    uint32_t index;
+
+    for (index = 0; ; index++) {
+        if (!read_item_header(parser->file, &n, &iheader)) {
+            return false;
+        }
+        uint32_t item_tag = iheader_get_tag(&iheader);
+        uint32_t item_length = iheader_get_length(&iheader);
+        if (item_tag == TAG_SQ_DELIM) {
+            return true;
+        }
+        if (item_tag != TAG_ITEM || item_length == 0xFFFFFFFF) {
+            dcm_log_error("Parsing of Data Element '%08X' failed. "
+                          "Fragment #%d is invalid.", tag, index);
+            return false;
+        }
+        if (handlers->fragment_start &&
+            !parser_continue(parser,
+                             handlers->fragment_start(parser->user_data,
+                                                      index,
+                                                      item_length))) {
+            return false;
+        }
+        if (!parse_value(parser, tag, item_length)) {
+            return false;
+        }
+    }
+}
+
+
+static bool parse_element(struct Parser *parser,
+                          EHeader *header,
+                          bool implicit)
+{
+    const DcmParseHandlers *handlers = parser->handlers;
+    uint32_t tag = eheader_get_tag(header);
+    uint32_t length = eheader_get_length(header);
+
+    if (eheader_check_vr(header, "SQ") ||
+        (length == 0xFFFFFFFF &&
+         tag != TAG_PIXEL_DATA &&
+         tag != TAG_FLOAT_PIXEL_DATA &&
+         tag != TAG_DOUBLE_PIXEL_DATA)) {
+        if (handlers->sequence_start &&
+            !parser_continue(parser,
+                             handlers->sequence_start(parser->user_data,
+                                                      tag,
+                                                      length))) {
+            return false;
+        }
+        // Items of values with other Value Representations, such as UN,
+        // are encoded with Implicit VR
+        if (!parse_items(parser,
+                         tag,
+                         length,
+                         implicit || !eheader_check_vr(header, "SQ"))) {
+            return false;
+        }
+        return !handlers->sequence_end ||
+               parser_continue(parser,
+                               handlers->sequence_end(parser->user_data, tag));
+    }
+
+    if (handlers->element_start &&
+        !parser_continue(parser,
+                         handlers->element_start(parser->user_data,
+                                                 tag,
+                                                 header->vr,
+                                                 length))) {
+        return false;
+    }
+    if (length == 0xFFFFFFFF) {
+        if (!parse_fragments(parser, tag)) {
+            return false;
+        }
+    } else if (!parse_value(parser, tag, length)) {
+        return false;
+    }
+    return !handlers->element_end ||
+           parser_continue(parser,
+                           handlers->element_end(parser->user_data, tag));
+}
+
+
+static bool parse_file(DcmFile *file,
+                       const DcmParseHandlers *handlers,
+                       void *user_data)
+{
+    EHeader header;
+    size_t available;
+    bool result = true;
+
+    assert(file);
+    assert(handlers);
+
+    file_lock_stream(file);
+    if (file->offset == 0) {
+        DcmDataSet *file_meta = read_file_meta(file);
+        if (file_meta == NULL) {
+            dcm_log_error("Parsing of Data Set failed. "
+                          "Could not read File Meta Information.");
+            file_unlock_stream(file);
+            return false;
+        }
+        dcm_dataset_destroy(file_meta);
+    }
+    file_seek(file, file->offset, SEEK_SET);
+
+    bool implicit = false;
+    if (file->transfer_syntax_uid &&
+        strcmp(file->transfer_syntax_uid, "1.2.840.10008.1.2") == 0) {
+        implicit = true;
+    }
+
+    struct Parser parser = {file, handlers, user_data, false};
+    while (!file_eof(file)) {
+        size_t n = 0;
+        file_peek(file, 1, &available);
+        if (available == 0) {
+            break;
+        }
+        if (!read_element_header(file, &n, implicit, &header)) {
+            dcm_log_error("Parsing of Data Set failed. "
+                          "Could not read header of Data Element.");
+            result = false;
+            break;
+        }
+        if (!parse_element(&parser, &header, implicit)) {
+            result = parser.is_stopped;
+            break;
+        }
+    }
+    file_unlock_stream(file);
+
+    return result;
+}
+
+
+bool dcm_file_parse(DcmFile *file,
+                    const DcmParseHandlers *handlers,
+                    void *user_data)
+{
+    dcm_trace_start("parse", file);
+    bool result = parse_file(file, handlers, user_data);
+    dcm_trace_end("parse", file);
+    return result;
+}
+
+
+void dcm_file_set_read_flags(DcmFile *file, uint32_t flags)
+{
+    file->read_flags = flags;
+}
+
+
+void dcm_file_set_string_pool(DcmFile *file, DcmStringPool *pool)
+{
+    if (pool) {
+        dcm_string_pool_retain(pool);
+    }
+    dcm_string_pool_release(file->string_pool);
+    file->string_pool = pool;
+}
+
+
+void dcm_file_get_stats(const DcmFile *file, DcmStats *stats)
+{
+    copy_counters(file->counters, stats);
+}
+
+
+/**
+ * Parse the value of Number of Frames, which is a positive Integer String.
+ */
+static bool parse_num_frames(const char *value, uint32_t *number_of_frames)
+{
+    char *end;
+    errno = 0;
+    long long number = strtoll(value, &end, 10);
+    while (*end == ' ') {
+        end++;
+    }
+    if (end == value ||
+        *end != '\0' ||
+        errno == ERANGE ||
+        number < 1 ||
+        number > UINT32_MAX) {
+        dcm_log_error("Getting value of Data Element 'Number of Frames' "
+                      "failed. Value '%s' is not a positive integer.",
+                      value);
+        return false;
+    }
+    *number_of_frames = (uint32_t) number;
+    return true;
+}
+
+
+static bool get_num_frames(const DcmDataSet *metadata,
+                           uint32_t *number_of_frames)
+{
+    const uint32_t tag = 0x00280008;
+
+    DcmElement *element = dcm_dataset_get(metadata, tag);
+    if (element == NULL) {
+        dcm_log_error("Getting value of Data Element 'Number of Frames' "
+                      "failed. Could not find Data Element with Tag '%08X'.",
+                      tag);
+        return false;
+    }
+
+    const char *value = dcm_element_get_value_IS(element, 0);
+    return parse_num_frames(value, number_of_frames);
+}
+
+
+/**
+ * Create a Basic Offset Table from Frame offsets that are known without
+ * reading the file, either from an offset index or the Extended Offset
+ * Table.
+ */
+static DcmBOT *create_known_bot(const DcmFile *file, uint32_t num_frames)
+{
+    uint32_t i;
+
+    if (file->index_offsets && file->index_num_frames == num_frames) {
+        dcm_log_debug("Use Frame offsets of offset index.");
+        ssize_t *offsets = dcm_heap_malloc(num_frames * sizeof(ssize_t));
+        if (offsets == NULL) {
+            return NULL;
+        }
+        memcpy(offsets, file->index_offsets, num_frames * sizeof(ssize_t));
+        return dcm_bot_create(offsets, num_frames);
+    }
+
+    if (file->extended_offset_table &&
+        file->num_extended_offsets == num_frames &&
+        dcm_is_encapsulated_transfer_syntax(file->transfer_syntax_uid)) {
+        dcm_log_info("Use Frame offsets of Extended Offset Table.");
+        ssize_t *offsets = dcm_heap_malloc(num_frames * sizeof(ssize_t));
+        if (offsets == NULL) {
+            return NULL;
+        }
+        for (i = 0; i < num_frames; i++) {
+            offsets[i] = (ssize_t) file->extended_offset_table[i];
+        }
+        return dcm_bot_create(offsets, num_frames);
+    }
+
+    return NULL;
+}
+
+
+static DcmBOT *read_bot(const DcmFile *file, const DcmDataSet *metadata)
+{
+    uint64_t value;
+    uint32_t i;
+
+    dcm_log_debug("Reading Basic Offset Table.");
+
+    if (!dcm_is_encapsulated_transfer_syntax(file->transfer_syntax_uid)) {
+        dcm_log_error("Reading Basic Offset Table failed. "
+                      "Data Set with transfer syntax '%s' shall not contain "
+                      "a Basic Offset Table because it is not encapsulated.",
+                      file->transfer_syntax_uid);
+        return NULL;
+    }
+
+    uint32_t num_frames;
+    if (!get_num_frames(metadata, &num_frames)) {
+        dcm_log_error("Reading Basic Offset Table failed. "
+                      "Could not get value of Data Element 'Number of Frames'.");
+        return NULL;
+    }
+    if (num_frames == 0) {
+        dcm_log_error("Reading Basic Offset Table failed. "
+                      "Value of Data Element 'Number of Frames' is malformed.");
+        return NULL;
+    }
+
+    DcmBOT *known_bot = create_known_bot(file, num_frames);
+    if (known_bot) {
+        return known_bot;
+    }
+
+    if (file->pixel_data_offset == 0) {
+        dcm_log_error("Reading Basic Offset Table failed. "
+                      "Could not determine offset of Pixel Data Element. "
+                      "Read metadata first.");
+        return NULL;
+    }
+    uint32_t eheader_tag = read_tag_at(file, file->pixel_data_offset);
+    if (!(eheader_tag == TAG_PIXEL_DATA ||
+          eheader_tag == TAG_FLOAT_PIXEL_DATA ||
+          eheader_tag == TAG_DOUBLE_PIXEL_DATA)) {
+        dcm_log_error("Reading Basic Offset Table failed. "
+                      "File pointer not positioned at Pixel Data Element.");
+        return NULL;
+    }
+
+    // The header of the BOT Item follows the header of the Pixel Data Element
+    size_t bot_offset = file->pixel_data_offset + 12;
+    IHeader iheader;
+    if (!read_item_header_at(file, bot_offset, &iheader)) {
+        dcm_log_error("Reading Basic Offset Table failed. "
+                      "Could not read header of Basic Offset Table Item.");
+        return NULL;
+    }
+    uint32_t item_tag = iheader_get_tag(&iheader);
+    if (item_tag != TAG_ITEM) {
+        dcm_log_error("Reading Basic Offset Table failed. "
+                      "Unexpected Tag found for Basic Offset Table Item.");
+        return NULL;
+    }
+
+    ssize_t *offsets = dcm_heap_malloc(num_frames * sizeof(ssize_t *));
+    if (offsets == NULL) {
+        dcm_log_error("Reading Basic Offset Table failed. "
+                      "Could not allocate memory for values of "
+                      "Basic Offset Table.");
+        return NULL;
+    }
+
+    // The BOT Item must be present, but the value is optional
+    uint32_t item_length = iheader_get_length(&iheader);
+    if (item_length > 0) {
+        dcm_log_info("Read Basic Offset Table value.");
+        if (item_length < num_frames * sizeof(uint32_t)) {
+            dcm_log_error("Reading Basic Offset Table failed. "
+                          "Basic Offset Table Item is too short for "
+                          "%u frames.", num_frames);
+            dcm_heap_free(offsets);
+            return NULL;
+        }
+        // Read all offset values from BOT Item value at once
+        size_t values_length = num_frames * sizeof(uint32_t);
+        char *values = dcm_heap_malloc(values_length);
+        if (values == NULL) {
+            dcm_log_error("Reading Basic Offset Table failed. "
+                          "Could not allocate memory for values of "
+                          "Basic Offset Table.");
+            dcm_heap_free(offsets);
+            return NULL;
+        }
+        if (file_pread(file, values, values_length, bot_offset + 8) !=
+                values_length) {
+            dcm_log_error("Reading Basic Offset Table failed. "
+                          "Could not read value of Basic Offset Table Item.");
+            dcm_heap_free(values);
+            dcm_heap_free(offsets);
+            return NULL;
+        }
+        for (i = 0; i < num_frames; i++) {
+            value = (uint64_t) decode_uint32(values + i * sizeof(uint32_t));
+            if (value == TAG_ITEM) {
+                dcm_log_error("Reading Basic Offset Table failed. "
+                              "Encountered unexpected Item Tag "
+                              "in Basic Offset Table.");
+                dcm_heap_free(values);
+                dcm_heap_free(offsets);
+                return NULL;
+            }
+            offsets[i] = value;
+        }
+        dcm_heap_free(values);
+    } else {
+        dcm_log_info("Basic Offset Table is empty.");
+        dcm_heap_free(offsets);
+        return NULL;
+    }
+
+    return dcm_bot_create(offsets, num_frames);
+}
+
+
+DcmBOT *dcm_file_read_bot(const DcmFile *file, const DcmDataSet *metadata)
+{
+    dcm_trace_start("read_bot", file);
+    DcmBOT *result = read_bot(file, metadata);
+    dcm_trace_end("read_bot", file);
+    return result;
+}
+
+
+static struct PixelDescription *create_pixel_description(const DcmDataSet *metadata)
+{
+    DcmElement *element;
+
+    struct PixelDescription *desc = dcm_heap_malloc(
+        sizeof(struct PixelDescription)
+    );
+    if (desc == NULL) {
+        dcm_log_error("Getting image pixel description failed. "
+                      "Could not allocate memory.");
+        return NULL;
+    }
+
+    element = dcm_dataset_get(metadata, 0x00280010);
+    if (element == NULL) {
+        dcm_log_error("Getting image pixel description failed. "
+                      "Could not get Data Element 'Rows'.");
+        dcm_heap_free(desc);
+        return NULL;
+    }
+    desc->rows = dcm_element_get_value_US(element, 0);
+
+    element = dcm_dataset_get(metadata, 0x00280011);
+    if (element == NULL) {
+        dcm_log_error("Getting image pixel description failed. "
+                      "Could not get Data Element 'Columns'.");
+        dcm_heap_free(desc);
+        return NULL;
+    }
+    desc->columns = dcm_element_get_value_US(element, 0);
+
+    element = dcm_dataset_get(metadata, 0x00280002);
+    if (element == NULL) {
+        dcm_log_error("Getting image pixel description failed. "
+                      "Could not get Data Element 'Samples per Pixel'.");
+        dcm_heap_free(desc);
+        return NULL;
+    }
+    desc->samples_per_pixel = dcm_element_get_value_US(element, 0);
+
+    element = dcm_dataset_get(metadata, 0x00280100);
+    if (element == NULL) {
+        dcm_log_error("Getting image pixel description failed. "
+                      "Could not get Data Element 'Bits Allocated'.");
+        dcm_heap_free(desc);
+        return NULL;
+    }
+    desc->bits_allocated = dcm_element_get_value_US(element, 0);
+
+    element = dcm_dataset_get(metadata, 0x00280101);
+    if (element == NULL) {
+        dcm_log_error("Getting image pixel description failed. "
+                      "Could not get Data Element 'Bits Stored'.");
+        dcm_heap_free(desc);
+        return NULL;
+    }
+    desc->bits_stored = dcm_element_get_value_US(element, 0);
+
+    element = dcm_dataset_get(metadata, 0x00280103);
+    if (element == NULL) {
+        dcm_log_error("Getting image pixel description failed. "
+                      "Could not get Data Element 'Pixel Representation'.");
+        dcm_heap_free(desc);
+        return NULL;
+    }
+    desc->pixel_representation = dcm_element_get_value_US(element, 0);
+
+    element = dcm_dataset_get(metadata, 0x00280006);
+    if (element == NULL) {
+        dcm_log_error("Getting image pixel description failed. "
+                      "Could not get Data Element 'Planar Configuration'.");
+        dcm_heap_free(desc);
+        return NULL;
+    }
+    desc->planar_configuration = dcm_element_get_value_US(element, 0);
+
+    element = dcm_dataset_get(metadata, 0x00280004);
+    if (element == NULL) {
+        dcm_log_error("Getting image pixel description failed. "
+                      "Could not get Data Element 'Photometric Interpretation'.");
+        dcm_heap_free(desc);
+        return NULL;
+    }
+    const char *photometric_interpretation = dcm_element_get_value_CS(element, 0);
+    desc->photometric_interpretation = dcm_strdup(photometric_interpretation);
+    if (desc->photometric_interpretation == NULL) {
+        dcm_log_error("Getting image pixel description failed. "
+                      "Could not allocate memory for value of "
+                      "Data Element 'Photometric Interpretation'.");
+        dcm_heap_free(desc);
+        return NULL;
+    }
+
+    return desc;
+}
+
+
+static void destroy_pixel_description(struct PixelDescription *desc)
+{
+    if (desc) {
+        if (desc->photometric_interpretation) {
+            dcm_heap_free(desc->photometric_interpretation);
+        }
+        dcm_heap_free(desc);
+    }
+}
+
+
+static DcmBOT *build_bot(const DcmFile *file, const DcmDataSet *metadata)
+{
+    uint32_t item_tag, iheader_tag;
+    uint32_t item_length;
+    uint64_t i;
+    IHeader iheader;
+
+    dcm_log_debug("Building Basic Offset Table.");
+
+    uint32_t num_frames;
+    if (!get_num_frames(metadata, &num_frames)) {
+        dcm_log_error("Building Basic Offset Table failed. "
+                      "Could not get value of Data Element 'Number of Frames'.");
+        return NULL;
+    }
+    if (num_frames == 0) {
+        dcm_log_error("Building Basic Offset Table failed. "
+                      "Value of Data Element 'Number of Frames' is malformed.");
+        return NULL;
+    }
+
+    DcmBOT *known_bot = create_known_bot(file, num_frames);
+    if (known_bot) {
+        return known_bot;
+    }
+
+    if (file->pixel_data_offset == 0) {
+        dcm_log_error("Reading Basic Offset Table failed. "
+                      "Could not determine offset of Pixel Data Element. "
+                      "Read metadata first.");
+        return NULL;
+    }
+
+    uint32_t eheader_tag = read_tag_at(file, file->pixel_data_offset);
+    if (!(eheader_tag == TAG_PIXEL_DATA ||
+          eheader_tag == TAG_FLOAT_PIXEL_DATA ||
+          eheader_tag == TAG_DOUBLE_PIXEL_DATA)) {
+        dcm_log_error("Building Basic Offset Table failed. "
+                      "File pointer not positioned at Pixel Data Element.");
+        return NULL;
+    }
+
+    ssize_t *offsets = dcm_heap_malloc(num_frames * sizeof(ssize_t *));
+    if (offsets == NULL) {
+        dcm_log_error("Building Basic Offset Table failed. "
+                      "Could not allocate memory for values of "
+                      "Basic Offset Table.");
+        return NULL;
+    }
+
+    if (dcm_is_encapsulated_transfer_syntax(file->transfer_syntax_uid)) {
+        // The header of the BOT Item
+        if (!read_item_header_at(file, file->pixel_data_offset + 12, &iheader)) {
+            dcm_log_error("Building Basic Offset Table failed. "
+                          "Could not read header of Basic Offset Table Item.");
+            dcm_heap_free(offsets);
+            return NULL;
+        }
+        item_tag = iheader_get_tag(&iheader);
+        if (item_tag != TAG_ITEM) {
+            dcm_log_error("Building Basic Offset Table failed. "
+                          "Unexpected Tag found for Basic Offset Table Item.");
+            dcm_heap_free(offsets);
+            return NULL;
+        }
+
+        // Walk the Frame Items, which follow the BOT Item
+        size_t current_offset = file->first_frame_offset;
+        i = 0;
+        while (true) {
+            if (!read_item_header_at(file, current_offset, &iheader)) {
+                dcm_log_error("Building Basic Offset Table failed. "
+                              "Could not read header of Frame Item #%d.",
+                              i + 1);
+                dcm_heap_free(offsets);
+                return NULL;
+            }
+            iheader_tag = iheader_get_tag(&iheader);
+            item_length = iheader_get_length(&iheader);
+            if (iheader_tag == TAG_SQ_DELIM) {
+                break;
+            }
+            if (iheader_tag != TAG_ITEM) {
+                dcm_log_error("Building Basic Offset Table failed. "
+                              "Frame Item #%d has wrong Tag '%08X'.",
+                              i + 1,
+                              iheader_tag);
+                dcm_heap_free(offsets);
+                return NULL;
+            }
+            if (i == num_frames) {
+                dcm_log_error("Building Basic Offset Table failed. "
+                              "Found more Frame Items than frames.");
+                dcm_heap_free(offsets);
+                return NULL;
+            }
+            // Offsets are relative to the first byte of the first Frame Item
+            offsets[i] = current_offset - file->first_frame_offset;
+
+            current_offset += 8 + item_length;
+            i += 1;
+        }
+
+        if (i != num_frames) {
+            dcm_log_error("Building Basic Offset Table failed. "
+                          "Found incorrect number of Frame Items.");
+            dcm_heap_free(offsets);
+            return NULL;
+        }
+    } else {
+        struct PixelDescription *desc = create_pixel_description(metadata);
+        if (desc == NULL) {
+            dcm_log_error("Building Basic Offset Table failed. "
+                          "Could not get image pixel description.");
+            dcm_heap_free(offsets);
+            return NULL;
+        }
+        for (i = 0; i < num_frames; i++) {
+            offsets[i] = (ssize_t) (i * get_native_frame_length(desc));
+        }
+        destroy_pixel_description(desc);
+    }
+
+    return dcm_bot_create(offsets, num_frames);
+}
+
+
+DcmBOT *dcm_file_build_bot(const DcmFile *file, const DcmDataSet *metadata)
+{
+    dcm_trace_start("build_bot", file);
+    DcmBOT *result = build_bot(file, metadata);
+    dcm_trace_end("build_bot", file);
+    return result;
+}
+
+
+char *dcm_file_create_offset_index(const DcmFile *file,
+                                   const DcmBOT *bot,
+                                   size_t *length)
+{
+    uint32_t i;
+
+    if (file->pixel_data_offset == 0) {
+        dcm_log_error("Creating offset index failed. "
+                      "Could not determine offset of Pixel Data Element. "
+                      "Read metadata first.");
+        return NULL;
+    }
+
+    uint32_t num_frames = dcm_bot_get_num_frames(bot);
+    size_t index_length = OFFSET_INDEX_HEADER_SIZE + (size_t) num_frames * 8;
+    char *index = DCM_ARRAY_ZEROS(index_length, char);
+    if (index == NULL) {
+        dcm_log_error("Creating offset index failed. "
+                      "Could not allocate memory.");
+        return NULL;
+    }
+
+    memcpy(index, OFFSET_INDEX_MAGIC, 8);
+    encode_uint64(index + 8, file->file_size);
+    encode_uint64(index + 16, (uint64_t) file->file_mtime);
+    encode_uint64(index + 24, file->pixel_data_offset);
+    encode_uint64(index + 32, file->first_frame_offset);
+    encode_uint32(index + 40, num_frames);
+    for (i = 0; i < num_frames; i++) {
+        encode_uint64(index + OFFSET_INDEX_HEADER_SIZE + i * 8,
+                      (uint64_t) dcm_bot_get_frame_offset(bot, i + 1));
+    }
+
+    *length = index_length;
+    return index;
+}
+
+
+bool dcm_file_load_offset_index(DcmFile *file,
+                                const char *index,
+                                size_t length)
+{
+    uint32_t i;
+
+    if (length < OFFSET_INDEX_HEADER_SIZE ||
+        memcmp(index, OFFSET_INDEX_MAGIC, 8) != 0) {
+        dcm_log_error("Loading offset index failed. "
+                      "Index is malformed.");
+        return false;
+    }
+    uint64_t file_size = decode_uint64(index + 8);
+    int64_t file_mtime = (int64_t) decode_uint64(index + 16);
+    if (file_size != file->file_size || file_mtime != file->file_mtime) {
+        dcm_log_info("Offset index does not match file.");
+        return false;
+    }
+    uint64_t pixel_data_offset = decode_uint64(index + 24);
+    uint64_t first_frame_offset = decode_uint64(index + 32);
+    uint32_t num_frames = decode_uint32(index + 40);
+    if (num_frames == 0 ||
+        length != OFFSET_INDEX_HEADER_SIZE + (size_t) num_frames * 8 ||
+        pixel_data_offset == 0 ||
+        first_frame_offset <= pixel_data_offset ||
+        first_frame_offset >= file_size) {
+        dcm_log_error("Loading offset index failed. "
+                      "Index is malformed.");
+        return false;
+    }
+
+    ssize_t *offsets = dcm_heap_malloc(num_frames * sizeof(ssize_t));
+    if (offsets == NULL) {
+        dcm_log_error("Loading offset index failed. "
+                      "Could not allocate memory.");
+        return false;
+    }
+    for (i = 0; i < num_frames; i++) {
+        uint64_t offset = decode_uint64(index + OFFSET_INDEX_HEADER_SIZE +
+                                        i * 8);
+        if (offset >= file_size - first_frame_offset) {
+            dcm_log_error("Loading offset index failed. "
+                          "Offset of Frame #%u is out of range.", i + 1);
+            dcm_heap_free(offsets);
+            return false;
+        }
+        offsets[i] = (ssize_t) offset;
+    }
+
+    dcm_heap_free(file->index_offsets);
+    file->index_offsets = offsets;
+    file->index_num_frames = num_frames;
+    file->pixel_data_offset = (size_t) pixel_data_offset;
+    file->first_frame_offset = (size_t) first_frame_offset;
+    return true;
+}
+
+
+bool dcm_file_write_offset_index(const DcmFile *file,
+                                 const DcmBOT *bot,
+                                 const char *index_path)
+{
+    size_t length;
+    char *index = dcm_file_create_offset_index(file, bot, &length);
+    if (index == NULL) {
+        return false;
+    }
+
+    FILE *fp = fopen(index_path, "wb");
+    if (fp == NULL) {
+        dcm_log_error("Writing offset index failed. "
+                      "Could not open file for writing: %s", index_path);
+        dcm_heap_free(index);
+        return false;
+    }
+    bool success = fwrite(index, 1, length, fp) == length;
+    if (fclose(fp) != 0) {
+        success = false;
+    }
+    dcm_heap_free(index);
+    if (!success) {
+        dcm_log_error("Writing offset index failed. "
+                      "Could not write file: %s", index_path);
+    }
+    return success;
+}
+
+
+bool dcm_file_read_offset_index(DcmFile *file, const char *index_path)
+{
+    FILE *fp = fopen(index_path, "rb");
+    if (fp == NULL) {
+        dcm_log_info("Could not open offset index: %s", index_path);
+        return false;
+    }
+
+    char header[OFFSET_INDEX_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), fp) != sizeof(header)) {
+        dcm_log_error("Reading offset index failed. "
+                      "Index is malformed.");
+        fclose(fp);
+        return false;
+    }
+    size_t length = OFFSET_INDEX_HEADER_SIZE +
+                    (size_t) decode_uint32(header + 40) * 8;
+    char *index = dcm_heap_malloc(length);
+    if (index == NULL) {
+        dcm_log_error("Reading offset index failed. "
+                      "Could not allocate memory.");
+        fclose(fp);
+        return false;
+    }
+    memcpy(index, header, sizeof(header));
+    size_t remaining = length - sizeof(header);
+    bool complete = fread(index + sizeof(header), 1, remaining, fp) ==
+                    remaining;
+    fclose(fp);
+    if (!complete) {
+        dcm_log_error("Reading offset index failed. "
+                      "Index is truncated.");
+        dcm_heap_free(index);
+        return false;
+    }
+
+    bool success = dcm_file_load_offset_index(file, index, length);
+    dcm_heap_free(index);
+    return success;
+}
+
+
+/**
+ * Determine the offset of a Frame Item relative to the beginning of the file.
+ */
+static bool get_frame_item_offset(const DcmFile *file,
+                                  const DcmBOT *bot,
+                                  uint32_t number,
+                                  size_t *item_offset)
+{
+    if (number == 0 || number > dcm_bot_get_num_frames(bot)) {
+        dcm_log_error("Reading Frame Item failed. "
+                      "Frame Number must be in range 1 to %u.",
+                      dcm_bot_get_num_frames(bot));
+        return false;
+    }
+    if (file->first_frame_offset == 0) {
+        dcm_log_error("Reading Frame Item failed. "
+                      "Could not determine offset of first Frame Item. "
+                      "Read metadata first.");
+        return false;
+    }
+    ssize_t frame_offset = dcm_bot_get_frame_offset(bot, number);
+    *item_offset = file->first_frame_offset + frame_offset;
+    return true;
+}
+
+
+/**
+ * Determine offset and length of the value of the Frame Item at the given
+ * offset, reading the Item header if the Pixel Data are encapsulated.
+ */
+static bool get_frame_value_extent(const DcmFile *file,
+                                   const struct PixelDescription *desc,
+                                   uint32_t number,
+                                   size_t item_offset,
+                                   size_t *offset,
+                                   uint32_t *length)
+{
+    if (dcm_is_encapsulated_transfer_syntax(file->transfer_syntax_uid)) {
+        IHeader iheader;
+        if (!read_item_header_at(file, item_offset, &iheader)) {
+            dcm_log_error("Reading Frame Item failed. "
+                          "Could not read header of Frame Item #%d.",
+                          number);
+            return false;
+        }
+        uint32_t iheader_tag = iheader_get_tag(&iheader);
+        if (iheader_tag != TAG_ITEM) {
+            dcm_log_error("Reading Frame Item failed. "
+                          "No Item Tag found for Frame Item #%d.",
+                          number);
+            return false;
+        }
+        *length = iheader_get_length(&iheader);
+        // Skip the header of the Frame Item
+        *offset = item_offset + 8;
+    } else {
+        *length = (uint32_t) get_native_frame_length(desc);
+        *offset = item_offset;
+    }
+    return true;
+}
+
+
+/**
+ * Determine offset and length of the value of a Frame Item.
+ *
+ * Does not use the position of the stream and is thus safe to call
+ * concurrently.
+ */
+static bool locate_frame(const DcmFile *file,
+                         const DcmBOT *bot,
+                         const struct PixelDescription *desc,
+                         uint32_t number,
+                         size_t *offset,
+                         uint32_t *length)
+{
+    size_t item_offset;
+    return (get_frame_item_offset(file, bot, number, &item_offset) &&
+            get_frame_value_extent(file,
+                                   desc,
+                                   number,
+                                   item_offset,
+                                   offset,
+                                   length));
+}
+
+
+/**
+ * Extent of the content of a file that is about to be read.
+ */
+struct Extent {
+    size_t offset;
+    size_t length;
+};
+
+
+static int compare_extents(const void *a, const void *b)
+{
+    const struct Extent *extent_a = (const struct Extent *) a;
+    const struct Extent *extent_b = (const struct Extent *) b;
+    if (extent_a->offset < extent_b->offset) {
+        return -1;
+    }
+    return extent_a->offset > extent_b->offset;
+}
+
+
+/**
+ * Announce that an extent of the file will be read soon.
+ */
+static void file_prefetch(const DcmFile *file, size_t offset, size_t length)
+{
+    if (file->map) {
+#if defined(HAVE_MADVISE) && defined(MADV_WILLNEED)
+        if (file->map->is_owned && offset < file->map->size) {
+            // Advice applies to whole pages
+            uintptr_t page_size = (uintptr_t) sysconf(_SC_PAGESIZE);
+            uintptr_t start = (uintptr_t) (file->map->data + offset);
+            uintptr_t end = start + (length < file->map->size - offset ?
+                                     length : file->map->size - offset);
+            start &= ~(page_size - 1);
+            madvise((void *) start, end - start, MADV_WILLNEED);
+        }
+#endif
+        return;
+    }
+    if (file->io->prefetch) {
+        file->io->prefetch(file->io_handle,
+                           (int64_t) offset,
+                           (int64_t) length);
+    }
+}
+
+
+bool dcm_file_prefetch_frames(const DcmFile *file,
+                              const DcmBOT *bot,
+                              const uint32_t *numbers,
+                              uint32_t num_numbers)
+{
+    uint32_t i, j;
+    size_t item_offset;
+    size_t offset;
+    uint32_t length;
+
+    assert(file);
+    assert(bot);
+    if (num_numbers == 0) {
+        return true;
+    }
+
+    bool is_encapsulated = dcm_is_encapsulated_transfer_syntax(
+        file->transfer_syntax_uid
+    );
+    if (!is_encapsulated && file->desc == NULL) {
+        dcm_log_error("Prefetching Frame Items failed. "
+                      "Could not get image pixel description. "
+                      "Read metadata first.");
+        return false;
+    }
+
+    struct Extent *extents = DCM_ARRAY_ZEROS(num_numbers, struct Extent);
+    if (extents == NULL) {
+        dcm_log_error("Prefetching Frame Items failed. "
+                      "Could not allocate memory.");
+        return false;
+    }
+
+    uint32_t num_frames = dcm_bot_get_num_frames(bot);
+    for (i = 0; i < num_numbers; i++) {
+        uint32_t number = numbers[i];
+        if (!get_frame_item_offset(file, bot, number, &item_offset)) {
+            dcm_heap_free(extents);
+            return false;
+        }
+        extents[i].offset = item_offset;
+        if (!is_encapsulated) {
+            extents[i].length = get_native_frame_length(file->desc);
+        } else if (number < num_frames &&
+                   dcm_bot_get_frame_offset(bot, number + 1) >
+                   dcm_bot_get_frame_offset(bot, number)) {
+            // The Item extends up to the next one, such that its header
+            // need not be read in advance
+            extents[i].length = (size_t) (
+                dcm_bot_get_frame_offset(bot, number + 1) -
+                dcm_bot_get_frame_offset(bot, number)
+            );
+        } else if (get_frame_value_extent(file,
+                                          file->desc,
+                                          number,
+                                          item_offset,
+                                          &offset,
+                                          &length)) {
+            extents[i].length = offset - item_offset + length;
+        } else {
+            dcm_heap_free(extents);
+            return false;
+        }
+    }
+
+    // Adjacent Frames are announced at once
+    qsort(extents, num_numbers, sizeof(struct Extent), compare_extents);
+    for (i = 0; i < num_numbers; i = j) {
+        size_t start = extents[i].offset;
+        size_t end = start + extents[i].length;
+        for (j = i + 1; j < num_numbers && extents[j].offset <= end; j++) {
+            if (extents[j].offset + extents[j].length > end) {
+                end = extents[j].offset + extents[j].length;
+            }
+        }
+        file_prefetch(file, start, end - start);
+    }
+    dcm_heap_free(extents);
+
+    return true;
+}
+
+
+/**
+ * Get the value of a Data Element with Value Representation UL or US.
+ */
+static bool get_dimension(const DcmDataSet *metadata,
+                          uint32_t tag,
+                          uint32_t *value)
+{
+    if (!dcm_dataset_contains(metadata, tag)) {
+        dcm_log_error("Getting value of Data Element '%08X' failed. "
+                      "Could not find Data Element.", tag);
+        return false;
+    }
+    DcmElement *element = dcm_dataset_get(metadata, tag);
+    if (dcm_element_check_vr(element, "US")) {
+        *value = dcm_element_get_value_US(element, 0);
+    } else {
+        *value = dcm_element_get_value_UL(element, 0);
+    }
+    return true;
+}
+
+
+/**
+ * Layout of the Frames of an image across its Total Pixel Matrix.
+ */
+struct _DcmTileMap {
+    uint32_t total_rows;
+    uint32_t total_columns;
+    uint32_t tile_rows;
+    uint32_t tile_columns;
+    uint32_t tiles_across;
+    uint32_t num_frames;
+    // Zero-based position of the top left pixel of each Frame, or NULL if
+    // the Frames are tiles in row-major order
+    uint32_t *rows;
+    uint32_t *columns;
+};
+
+
+DcmTileMap *dcm_tile_map_create(const DcmDataSet *metadata)
+{
+    assert(metadata);
+    uint32_t i;
+
+    DcmTileMap *map = DCM_NEW(DcmTileMap);
+    if (map == NULL) {
+        dcm_log_error("Creation of tile map failed. "
+                      "Could not allocate memory.");
+        return NULL;
+    }
+    if (!get_dimension(metadata, 0x00480007, &map->total_rows) ||
+        !get_dimension(metadata, 0x00480006, &map->total_columns) ||
+        !get_dimension(metadata, 0x00280010, &map->tile_rows) ||
+        !get_dimension(metadata, 0x00280011, &map->tile_columns) ||
+        map->tile_rows == 0 ||
+        map->tile_columns == 0) {
+        dcm_log_error("Creation of tile map failed. "
+                      "Could not determine layout of tiles.");
+        dcm_heap_free(map);
+        return NULL;
+    }
+    map->tiles_across = ((map->total_columns + map->tile_columns - 1) /
+                         map->tile_columns);
+    uint32_t tiles_down = ((map->total_rows + map->tile_rows - 1) /
+                           map->tile_rows);
+    map->num_frames = map->tiles_across * tiles_down;
+
+    bool is_full = true;
+    if (dcm_dataset_contains(metadata, 0x00209311)) {
+        DcmElement *element = dcm_dataset_get(metadata, 0x00209311);
+        is_full = strcmp(dcm_element_get_value_CS(element, 0),
+                         "TILED_FULL") == 0;
+    }
+    if (is_full || !dcm_dataset_contains(metadata, 0x52009230)) {
+        return map;
+    }
+
+    // Tiles of sparse images are placed by their Plane Position (Slide)
+    DcmQuery *queries[2] = {
+        dcm_query_create("PlanePositionSlideSequence[0]"
+                         ".RowPositionInTotalImagePixelMatrix"),
+        dcm_query_create("PlanePositionSlideSequence[0]"
+                         ".ColumnPositionInTotalImagePixelMatrix"),
+    };
+    int32_t *positions[2] = {NULL, NULL};
+    uint32_t num_frames = 0;
+    if (queries[0] && queries[1]) {
+        num_frames = dcm_dataset_get_frame_integers(
+            metadata, (const DcmQuery *const *) queries, 2, positions, 0);
+    }
+    if (num_frames > 0) {
+        positions[0] = DCM_ARRAY_ZEROS(num_frames, int32_t);
+        positions[1] = DCM_ARRAY_ZEROS(num_frames, int32_t);
+        map->rows = DCM_ARRAY_ZEROS(num_frames, uint32_t);
+        map->columns = DCM_ARRAY_ZEROS(num_frames, uint32_t);
+    }
+    bool success = positions[0] && positions[1] && map->rows && map->columns;
+    if (success) {
+        dcm_dataset_get_frame_integers(metadata,
+                                       (const DcmQuery *const *) queries,
+                                       2,
+                                       positions,
+                                       num_frames);
+        for (i = 0; i < num_frames; i++) {
+            // Positions are one-based
+            if (positions[0][i] < 1 || positions[1][i] < 1) {
+                dcm_log_error("Creation of tile map failed. "
+                              "Frame #%u lacks a valid Plane Position.",
+                              i + 1);
+                success = false;
+                break;
+            }
+            map->rows[i] = (uint32_t) positions[0][i] - 1;
+            map->columns[i] = (uint32_t) positions[1][i] - 1;
+        }
+        map->num_frames = num_frames;
+    } else {
+        dcm_log_error("Creation of tile map failed. "
+                      "Could not get Plane Positions of Frames.");
+    }
+    dcm_heap_free(positions[0]);
+    dcm_heap_free(positions[1]);
+    dcm_query_destroy(queries[0]);
+    dcm_query_destroy(queries[1]);
+    if (!success) {
+        dcm_tile_map_destroy(map);
+        return NULL;
+    }
+    return map;
+}
+
+
+/**
+ * Get the position of the top left pixel of a Frame.
+ */
+static void get_tile_position(const DcmTileMap *map,
+                              uint32_t number,
+                              uint32_t *row,
+                              uint32_t *column)
+{
+    if (map->rows) {
+        *row = map->rows[number - 1];
+        *column = map->columns[number - 1];
+    } else {
+        *row = (number - 1) / map->tiles_across * map->tile_rows;
+        *column = (number - 1) % map->tiles_across * map->tile_columns;
+    }
+}
+
+
+uint32_t dcm_tile_map_find_frames(const DcmTileMap *map,
+                                  uint32_t row,
+                                  uint32_t column,
+                                  uint32_t num_rows,
+                                  uint32_t num_columns,
+                                  uint32_t *numbers,
+                                  uint32_t capacity)
+{
+    assert(map);
+    uint32_t i, j;
+    uint32_t num_numbers = 0;
+
+    if (num_rows == 0 || num_columns == 0 ||
+        row >= map->total_rows || column >= map->total_columns) {
+        return 0;
+    }
+    uint64_t end_row = (uint64_t) row + num_rows;
+    uint64_t end_column = (uint64_t) column + num_columns;
+
+    if (map->rows) {
+        for (i = 0; i < map->num_frames; i++) {
+            if (map->rows[i] < end_row &&
+                map->rows[i] + map->tile_rows > row &&
+                map->columns[i] < end_column &&
+                map->columns[i] + map->tile_columns > column) {
+                if (num_numbers < capacity) {
+                    numbers[num_numbers] = i + 1;
+                }
+                num_numbers += 1;
+            }
+        }
+        return num_numbers;
+    }
+
+    if (end_row > map->total_rows) {
+        end_row = map->total_rows;
+    }
+    if (end_column > map->total_columns) {
+        end_column = map->total_columns;
+    }
+    uint32_t first_tile_row = row / map->tile_rows;
+    uint32_t first_tile_column = column / map->tile_columns;
+    uint32_t last_tile_row = (uint32_t) ((end_row - 1) / map->tile_rows);
+    uint32_t last_tile_column = (uint32_t) ((end_column - 1) /
+                                            map->tile_columns);
+    for (i = first_tile_row; i <= last_tile_row; i++) {
+        for (j = first_tile_column; j <= last_tile_column; j++) {
+            if (num_numbers < capacity) {
+                numbers[num_numbers] = i * map->tiles_across + j + 1;
+            }
+            num_numbers += 1;
+        }
+    }
+    return num_numbers;
+}
+
+
+void dcm_tile_map_destroy(DcmTileMap *map)
+{
+    if (map) {
+        dcm_heap_free(map->rows);
+        dcm_heap_free(map->columns);
+        dcm_heap_free(map);
+    }
+}
+
+
+bool dcm_file_prefetch_region(const DcmFile *file,
+                              const DcmBOT *bot,
+                              const DcmTileMap *map,
+                              uint32_t row,
+                              uint32_t column,
+                              uint32_t num_rows,
+                              uint32_t num_columns)
+{
+    assert(file);
+    assert(bot);
+    assert(map);
+
+    if (num_rows == 0 || num_columns == 0) {
+        return true;
+    }
+    if (row >= map->total_rows || column >= map->total_columns) {
+        dcm_log_error("Prefetching region failed. "
+                      "Region is outside of the Total Pixel Matrix.");
+        return false;
+    }
+
+    uint32_t num_numbers = dcm_tile_map_find_frames(map,
+                                                    row, column,
+                                                    num_rows, num_columns,
+                                                    NULL, 0);
+    uint32_t *numbers = DCM_ARRAY_ZEROS(num_numbers, uint32_t);
+    if (numbers == NULL) {
+        dcm_log_error("Prefetching region failed. "
+                      "Could not allocate memory.");
+        return false;
+    }
+    dcm_tile_map_find_frames(map,
+                             row, column,
+                             num_rows, num_columns,
+                             numbers, num_numbers);
+    bool result = dcm_file_prefetch_frames(file, bot, numbers, num_numbers);
+    dcm_heap_free(numbers);
+
+    return result;
+}
+
+
+static bool read_region(const DcmFile *file,
+                        const DcmDataSet *metadata,
+                        const DcmBOT *bot,
+                        const DcmTileMap *map,
+                        DcmDecoder *decoder,
+                        uint32_t row,
+                        uint32_t column,
+                        uint32_t num_rows,
+                        uint32_t num_columns,
+                        char *buffer,
+                        size_t size)
+{
+    assert(file);
+    assert(metadata);
+    assert(bot);
+    assert(map);
+    assert(buffer);
+    uint32_t samples_per_pixel, bits_allocated;
+    uint32_t i, y;
+
+    if (!get_dimension(metadata, 0x00280002, &samples_per_pixel) ||
+        !get_dimension(metadata, 0x00280100, &bits_allocated)) {
+        return false;
+    }
+    if (bits_allocated % 8 != 0) {
+        dcm_log_error("Reading region failed. "
+                      "Bits Allocated %u is not supported.",
+                      bits_allocated);
+        return false;
+    }
+    size_t pixel_size = (size_t) samples_per_pixel * (bits_allocated / 8);
+    size_t row_length = num_columns * pixel_size;
+    if (size / (num_rows > 0 ? num_rows : 1) < row_length) {
+        dcm_log_error("Reading region failed. "
+                      "Buffer of %zu bytes is too small for a region of "
+                      "%u x %u pixels.",
+                      size, num_columns, num_rows);
+        return false;
+    }
+    // Pixels that are not covered by any Frame remain zero
+    memset(buffer, 0, row_length * num_rows);
+
+    uint32_t num_numbers = dcm_tile_map_find_frames(map,
+                                                    row, column,
+                                                    num_rows, num_columns,
+                                                    NULL, 0);
+    if (num_numbers == 0) {
+        return true;
+    }
+    uint32_t *numbers = DCM_ARRAY_ZEROS(num_numbers, uint32_t);
+    DcmFrame **frames = DCM_ARRAY_ZEROS(num_numbers, DcmFrame *);
+    char **tiles = DCM_ARRAY_ZEROS(num_numbers, char *);
+    size_t tile_length = ((size_t) map->tile_rows * map->tile_columns *
+                          pixel_size);
+    char *tile_buffer = dcm_heap_malloc(tile_length * num_numbers);
+    DcmDecoder *own_decoder = decoder ? NULL : dcm_decoder_create();
+    bool success = numbers && frames && tiles && tile_buffer &&
+                   (decoder || own_decoder);
+    if (!success) {
+        dcm_log_error("Reading region failed. "
+                      "Could not allocate memory.");
+    }
+
+    // The Frames are fetched together and decoded in parallel
+    if (success) {
+        dcm_tile_map_find_frames(map,
+                                 row, column,
+                                 num_rows, num_columns,
+                                 numbers, num_numbers);
+        for (i = 0; i < num_numbers; i++) {
+            tiles[i] = tile_buffer + i * tile_length;
+        }
+        success = dcm_file_read_frames(file, metadata, bot,
+                                       numbers, num_numbers, frames) &&
+                  dcm_decoder_decode_frames(decoder ? decoder : own_decoder,
+                                            (const DcmFrame *const *) frames,
+                                            num_numbers,
+                                            tiles,
+                                            tile_length);
+    }
+
+    for (i = 0; success && i < num_numbers; i++) {
+        uint32_t tile_row, tile_column;
+        get_tile_position(map, numbers[i], &tile_row, &tile_column);
+        // Intersection of the tile and the region
+        uint64_t top = tile_row > row ? tile_row : row;
+        uint64_t left = tile_column > column ? tile_column : column;
+        uint64_t bottom = (uint64_t) tile_row + map->tile_rows;
+        uint64_t right = (uint64_t) tile_column + map->tile_columns;
+        if (bottom > (uint64_t) row + num_rows) {
+            bottom = (uint64_t) row + num_rows;
+        }
+        if (right > (uint64_t) column + num_columns) {
+            right = (uint64_t) column + num_columns;
+        }
+        // Tiles at the edges are padded beyond the Total Pixel Matrix
+        if (bottom > map->total_rows) {
+            bottom = map->total_rows;
+        }
+        if (right > map->total_columns) {
+            right = map->total_columns;
+        }
+        if (top >= bottom || left >= right) {
+            continue;
+        }
+        size_t length = (size_t) (right - left) * pixel_size;
+        for (y = (uint32_t) top; y < bottom; y++) {
+            memcpy(buffer + (y - row) * row_length +
+                   (left - column) * pixel_size,
+                   tiles[i] + (size_t) (y - tile_row) * map->tile_columns *
+                   pixel_size + (left - tile_column) * pixel_size,
+                   length);
+        }
+    }
+
+    if (frames) {
+        for (i = 0; i < num_numbers; i++) {
+            dcm_frame_destroy(frames[i]);
+        }
+    }
+    dcm_decoder_destroy(own_decoder);
+    dcm_heap_free(tile_buffer);
+    dcm_heap_free(tiles);
+    dcm_heap_free(frames);
+    dcm_heap_free(numbers);
+    return success;
+}
+
+
+bool dcm_file_read_region(const DcmFile *file,
+                          const DcmDataSet *metadata,
+                          const DcmBOT *bot,
+                          const DcmTileMap *map,
+                          DcmDecoder *decoder,
+                          uint32_t row,
+                          uint32_t column,
+                          uint32_t num_rows,
+                          uint32_t num_columns,
+                          char *buffer,
+                          size_t size)
+{
+    dcm_trace_start("read_region", file);
+    bool result = read_region(file,
+                              metadata,
+                              bot,
+                              map,
+                              decoder,
+                              row,
+                              column,
+                              num_rows,
+                              num_columns,
+                              buffer,
+                              size);
+    dcm_trace_end("read_region", file);
+    return result;
+}
+
+
+/**
+ * Read the value of a Frame Item whose extent is known into a new Frame.
+ */
+static DcmFrame *read_frame_at(const DcmFile *file,
+                               const struct PixelDescription *desc,
+                               uint32_t number,
+                               size_t offset,
+                               uint32_t length)
+{
+    char *value = dcm_heap_malloc(length);
+    if (value == NULL) {
+        dcm_log_error("Reading Frame Item failed. "
+                      "Could not allocate memory for Frame Item #%d.",
+                      number);
+        return NULL;
+    }
+    if (file_pread(file, value, length, offset) != length) {
+        dcm_log_error("Reading Frame Item failed. "
+                      "Could not read value of Frame Item #%d.",
+                      number);
+        dcm_heap_free(value);
+        return NULL;
+    }
+
+    char *transfer_syntax_uid = dcm_strdup(file->transfer_syntax_uid);
+    if (transfer_syntax_uid == NULL) {
+        dcm_log_error("Reading Frame Item failed. "
+                      "Could not allocate memory for Frame item #%d.",
+                      number);
+        dcm_heap_free(value);
+        return NULL;
+    }
+
+    char *photometric_interpretation = dcm_strdup(
+        desc->photometric_interpretation
+    );
+    if (photometric_interpretation == NULL) {
+        dcm_log_error("Reading Frame Item failed. "
+                      "Could not allocate memory for Frame item #%d.",
+                      number);
+        dcm_heap_free(value);
+        dcm_heap_free(transfer_syntax_uid);
+        return NULL;
+    }
+
+    return dcm_frame_create(number,
+                            value,
+                            length,
+                            desc->rows,
+                            desc->columns,
+                            desc->samples_per_pixel,
+                            desc->bits_allocated,
+                            desc->bits_stored,
+                            desc->pixel_representation,
+                            desc->planar_configuration,
+                            photometric_interpretation,
+                            transfer_syntax_uid);
+}
+
+
+static DcmFrame *read_frame(const DcmFile *file,
+                            const DcmDataSet *metadata,
+                            const DcmBOT *bot,
+                            uint32_t number)
+{
+    size_t offset;
+    uint32_t length;
+
+    dcm_log_debug("Read Frame Item #%d.", number);
+    struct PixelDescription *desc = create_pixel_description(metadata);
+    if (desc == NULL) {
+        dcm_log_error("Reading Frame Item failed. "
+                      "Could not get image pixel description.");
+        return NULL;
+    }
+
+    DcmFrame *frame = NULL;
+    if (locate_frame(file, bot, desc, number, &offset, &length)) {
+        frame = read_frame_at(file, desc, number, offset, length);
+    }
+    destroy_pixel_description(desc);
+
+    return frame;
+}
+
+
+DcmFrame *dcm_file_read_frame(const DcmFile *file,
+                              const DcmDataSet *metadata,
+                              const DcmBOT *bot,
+                              uint32_t number)
+{
+    dcm_trace_start("read_frame", file);
+    uint64_t start = get_microseconds();
+    DcmFrame *result = read_frame(file, metadata, bot, number);
+    if (result) {
+        count_frame_read(file, start);
+    }
+    dcm_trace_end("read_frame", file);
+    return result;
+}
+
+
+/**
+ * Owner of a Frame view whose value had to be copied out of the file.
+ */
+struct FrameBuffer {
+    DcmFile *file;
+    char *data;
+};
+
+
+static void frame_buffer_release(void *owner)
+{
+    struct FrameBuffer *buffer = (struct FrameBuffer *) owner;
+    file_release(buffer->file);
+    dcm_heap_free(buffer->data);
+    dcm_heap_free(buffer);
+}
+
+
+static DcmFrame *load_frame_view_at(const DcmFile *file,
+                                    uint32_t number,
+                                    size_t item_offset)
+{
+    size_t offset;
+    uint32_t length;
+    const char *data;
+    void *owner;
+    void (*release)(void *owner);
+
+    const struct PixelDescription *desc = file->desc;
+    if (!get_frame_value_extent(file,
+                                desc,
+                                number,
+                                item_offset,
+                                &offset,
+                                &length)) {
+        return NULL;
+    }
+
+    if (file->map) {
+        if (offset + length > file->map->size) {
+            dcm_log_error("Reading Frame Item failed. "
+                          "Value of Frame Item #%d exceeds end of file.",
+                          number);
+            return NULL;
+        }
+        data = file->map->data + offset;
+        owner = (void *) file;
+        release = file_release;
+    } else {
+        struct FrameBuffer *buffer = DCM_NEW(struct FrameBuffer);
+        if (buffer == NULL) {
+            dcm_log_error("Reading Frame Item failed. "
+                          "Could not allocate memory for Frame Item #%d.",
+                          number);
+            return NULL;
+        }
+        buffer->data = dcm_heap_malloc(length);
+        if (buffer->data == NULL) {
+            dcm_log_error("Reading Frame Item failed. "
+                          "Could not allocate memory for Frame Item #%d.",
+                          number);
+            dcm_heap_free(buffer);
+            return NULL;
+        }
+        if (file_pread(file, buffer->data, length, offset) != length) {
+            dcm_log_error("Reading Frame Item failed. "
+                          "Could not read value of Frame Item #%d.",
+                          number);
+            dcm_heap_free(buffer->data);
+            dcm_heap_free(buffer);
+            return NULL;
+        }
+        buffer->file = (DcmFile *) file;
+        data = buffer->data;
+        owner = buffer;
+        release = frame_buffer_release;
+    }
+
+    // The view keeps the file and thus the mapping and strings alive
+    file_retain(file);
+
+    return dcm_frame_create_view(number,
+                                 data,
+                                 length,
+                                 desc->rows,
+                                 desc->columns,
+                                 desc->samples_per_pixel,
+                                 desc->bits_allocated,
+                                 desc->bits_stored,
+                                 desc->pixel_representation,
+                                 desc->planar_configuration,
+                                 desc->photometric_interpretation,
+                                 file->transfer_syntax_uid,
+                                 owner,
+                                 release);
+}
+
+
+static DcmFrame *read_frame_view_at(const DcmFile *file,
+                                    uint32_t number,
+                                    size_t item_offset)
+{
+    dcm_trace_start("read_frame_view", file);
+    uint64_t start = get_microseconds();
+    DcmFrame *frame = load_frame_view_at(file, number, item_offset);
+    if (frame) {
+        count_frame_read(file, start);
+    }
+    dcm_trace_end("read_frame_view", file);
+    return frame;
+}
+
+
+DcmFrame *dcm_file_read_frame_view(const DcmFile *file,
+                                   const DcmBOT *bot,
+                                   uint32_t number)
+{
+    size_t item_offset;
+
+    dcm_log_debug("Read view of Frame Item #%d.", number);
+    if (file->desc == NULL) {
+        dcm_log_error("Reading Frame Item failed. "
+                      "Could not get image pixel description. "
+                      "Read metadata first.");
+        return NULL;
+    }
+
+    if (!get_frame_item_offset(file, bot, number, &item_offset)) {
+        return NULL;
+    }
+
+    return read_frame_view_at(file, number, item_offset);
+}
+
+
+/**
+ * Pixel data of a run of adjacent Frame Items that was read at once.
+ *
+ * The buffer is shared by all Frames of the run and released together with
+ * the last of them.
+ */
+struct FrameRun {
+    atomic_uint refcount;
+    char *data;
+    char *photometric_interpretation;
+    char *transfer_syntax_uid;
+};
+
+
+static void frame_run_release(void *owner)
+{
+    struct FrameRun *run = (struct FrameRun *) owner;
+    if (atomic_fetch_sub(&run->refcount, 1) == 1) {
+        dcm_heap_free(run->data);
+        dcm_heap_free(run->photometric_interpretation);
+        dcm_heap_free(run->transfer_syntax_uid);
+        dcm_heap_free(run);
+    }
+}
+
+
+/**
+ * Position of a requested Frame Item in the file.
+ */
+struct FrameRequest {
+    uint32_t index;
+    uint32_t number;
+    // Byte range of the Frame Item, including the Item header if encapsulated
+    size_t start;
+    size_t end;
+};
+
+
+static int compare_frame_requests(const void *a, const void *b)
+{
+    const struct FrameRequest *ra = (const struct FrameRequest *) a;
+    const struct FrameRequest *rb = (const struct FrameRequest *) b;
+    if (ra->start < rb->start) {
+        return -1;
+    }
+    return ra->start > rb->start;
+}
+
+
+static bool locate_frame_item(const DcmFile *file,
+                              const DcmBOT *bot,
+                              const struct PixelDescription *desc,
+                              bool encapsulated,
+                              struct FrameRequest *request)
+{
+    uint32_t number = request->number;
+    uint32_t num_frames = dcm_bot_get_num_frames(bot);
+
+    if (number == 0 || number > num_frames) {
+        dcm_log_error("Reading Frame Items failed. "
+                      "Frame Number must be in range 1 to %u.",
+                      num_frames);
+        return false;
+    }
+    request->start = (file->first_frame_offset +
+                      dcm_bot_get_frame_offset(bot, number));
+
+    if (!encapsulated) {
+        request->end = request->start + get_native_frame_length(desc);
+    } else if (number < num_frames) {
+        // Frame Items are stored back to back
+        request->end = (file->first_frame_offset +
+                        dcm_bot_get_frame_offset(bot, number + 1));
+    } else {
+        IHeader iheader;
+        if (!read_item_header_at(file, request->start, &iheader)) {
+            dcm_log_error("Reading Frame Items failed. "
+                          "Could not read header of Frame Item #%d.",
+                          number);
+            return false;
+        }
+        request->end = request->start + 8 + iheader_get_length(&iheader);
+    }
+
+    if (request->end <= request->start) {
+        dcm_log_error("Reading Frame Items failed. "
+                      "Basic Offset Table is inconsistent at Frame Item #%d.",
+                      number);
+        return false;
+    }
+    return true;
+}
+
+
+static DcmFrame *create_run_frame(struct FrameRun *run,
+                                  size_t run_start,
+                                  const struct FrameRequest *request,
+                                  const struct PixelDescription *desc,
+                                  bool encapsulated)
+{
+    const char *data = run->data + (request->start - run_start);
+    size_t length = request->end - request->start;
+
+    if (encapsulated) {
+        uint32_t item_tag = decode_tag(data);
+        uint32_t item_length = decode_uint32(data + 4);
+        if (item_tag != TAG_ITEM || (size_t) item_length + 8 > length) {
+            dcm_log_error("Reading Frame Items failed. "
+                          "No valid Item found for Frame Item #%d.",
+                          request->number);
+            return NULL;
+        }
+        data += 8;
+        length = item_length;
+    }
+
+    atomic_fetch_add(&run->refcount, 1);
+    return dcm_frame_create_view(request->number,
+                                 data,
+                                 (uint32_t) length,
+                                 desc->rows,
+                                 desc->columns,
+                                 desc->samples_per_pixel,
+                                 desc->bits_allocated,
+                                 desc->bits_stored,
+                                 desc->pixel_representation,
+                                 desc->planar_configuration,
+                                 run->photometric_interpretation,
+                                 run->transfer_syntax_uid,
+                                 run,
+                                 frame_run_release);
+}
+
+
+static bool read_frame_run(const DcmFile *file,
+                           const struct FrameRequest *requests,
+                           uint32_t num_requests,
+                           const struct PixelDescription *desc,
+                           bool encapsulated,
+                           DcmFrame **frames)
+{
+    uint32_t i;
+    size_t run_start = requests[0].start;
+    size_t run_end = requests[0].end;
+    for (i = 1; i < num_requests; i++) {
+        if (requests[i].end > run_end) {
+            run_end = requests[i].end;
+        }
+    }
+
+    struct FrameRun *run = DCM_NEW(struct FrameRun);
+    if (run == NULL) {
+        dcm_log_error("Reading Frame Items failed. "
+                      "Could not allocate memory.");
+        return false;
+    }
+    atomic_init(&run->refcount, 1);
+    run->data = dcm_heap_malloc(run_end - run_start);
+    run->photometric_interpretation = dcm_strdup(
+        desc->photometric_interpretation
+    );
+    run->transfer_syntax_uid = dcm_strdup(file->transfer_syntax_uid);
+    if (run->data == NULL ||
+        run->photometric_interpretation == NULL ||
+        run->transfer_syntax_uid == NULL) {
+        dcm_log_error("Reading Frame Items failed. "
+                      "Could not allocate memory.");
+        frame_run_release(run);
+        return false;
+    }
+
+    dcm_log_debug("Read %u Frame Items with a single read of %zu bytes.",
+                  num_requests,
+                  run_end - run_start);
+    if (file_pread(file, run->data, run_end - run_start, run_start) !=
+            run_end - run_start) {
+        dcm_log_error("Reading Frame Items failed. "
+                      "Could not read value of Frame Item #%d.",
+                      requests[0].number);
+        frame_run_release(run);
+        return false;
+    }
+
+    bool success = true;
+    for (i = 0; i < num_requests; i++) {
+        DcmFrame *frame = create_run_frame(run,
+                                           run_start,
+                                           &requests[i],
+                                           desc,
+                                           encapsulated);
+        if (frame == NULL) {
+            success = false;
+            break;
+        }
+        frames[requests[i].index] = frame;
+    }
+
+    frame_run_release(run);
+    return success;
+}
+
+
+static bool read_frames(const DcmFile *file,
+                        const DcmDataSet *metadata,
+                        const DcmBOT *bot,
+                        const uint32_t *numbers,
+                        uint32_t num_numbers,
+                        DcmFrame **frames)
+{
+    uint32_t i, j;
+
+    dcm_log_debug("Read %u Frame Items.", num_numbers);
+    for (i = 0; i < num_numbers; i++) {
+        frames[i] = NULL;
+    }
+    if (num_numbers == 0) {
+        return true;
+    }
+    if (file->first_frame_offset == 0) {
+        dcm_log_error("Reading Frame Items failed. "
+                      "Could not determine offset of first Frame Item. "
+                      "Read metadata first.");
+        return false;
+    }
+
+    struct PixelDescription *desc = create_pixel_description(metadata);
+    if (desc == NULL) {
+        dcm_log_error("Reading Frame Items failed. "
+                      "Could not get image pixel description.");
+        return false;
+    }
+    bool encapsulated = dcm_is_encapsulated_transfer_syntax(
+        file->transfer_syntax_uid
+    );
+
+    struct FrameRequest *requests = dcm_heap_malloc(
+        num_numbers * sizeof(struct FrameRequest)
+    );
+    if (requests == NULL) {
+        dcm_log_error("Reading Frame Items failed. "
+                      "Could not allocate memory.");
+        destroy_pixel_description(desc);
+        return false;
+    }
+    for (i = 0; i < num_numbers; i++) {
+        requests[i].index = i;
+        requests[i].number = numbers[i];
+        if (!locate_frame_item(file, bot, desc, encapsulated, &requests[i])) {
+            dcm_heap_free(requests);
+            destroy_pixel_description(desc);
+            return false;
+        }
+    }
+
+    // Sort by position in the file, such that adjacent Frame Items are
+    // neighbours and can be fetched with a single read
+    qsort(requests,
+          num_numbers,
+          sizeof(struct FrameRequest),
+          compare_frame_requests);
+
+    bool success = true;
+    i = 0;
+    while (success && i < num_numbers) {
+        size_t run_end = requests[i].end;
+        j = i + 1;
+        while (j < num_numbers && requests[j].start <= run_end) {
+            if (requests[j].end > run_end) {
+                run_end = requests[j].end;
+            }
+            j++;
+        }
+        success = read_frame_run(file,
+                                 &requests[i],
+                                 j - i,
+                                 desc,
+                                 encapsulated,
+                                 frames);
+        i = j;
+    }
+
+    if (!success) {
+        for (i = 0; i < num_numbers; i++) {
+            dcm_frame_destroy(frames[i]);
+            frames[i] = NULL;
+        }
+    }
+
+    dcm_heap_free(requests);
+    destroy_pixel_description(desc);
+    return success;
+}
+
+
+bool dcm_file_read_frames(const DcmFile *file,
+                          const DcmDataSet *metadata,
+                          const DcmBOT *bot,
+                          const uint32_t *numbers,
+                          uint32_t num_numbers,
+                          DcmFrame **frames)
+{
+    dcm_trace_start("read_frames", file);
+    bool result = read_frames(file,
+                              metadata,
+                              bot,
+                              numbers,
+                              num_numbers,
+                              frames);
+    if (result) {
+        COUNT(file, num_frames, num_numbers);
+    }
+    dcm_trace_end("read_frames", file);
+    return result;
+}
+
+
+/**
+ * Maximum number of threads that serve asynchronous Frame reads.
+ */
+#define MAX_READ_THREADS 16
+
+
+/**
+ * Pending asynchronous read of a Frame Item or part of a Sequence.
+ */
+struct ReadTask {
+    struct ReadTask *next;
+    // Performs the task and frees it
+    void (*run)(struct ReadTask *task);
+    DcmFile *file;
+    uint32_t number;
+    size_t item_offset;
+    DcmFrameCallback callback;
+    void *user_data;
+};
+
+
+static void run_frame_task(struct ReadTask *task)
+{
+    DcmFrame *frame = read_frame_view_at(task->file,
+                                         task->number,
+                                         task->item_offset);
+    file_release(task->file);
+    task->callback(frame, task->user_data);
+    dcm_heap_free(task);
+}
+
+
+#ifdef HAVE_PTHREAD_H
+/**
+ * Queue of read tasks that is shared by all files and the threads serving
+ * them. The threads are started on first use and run until the process exits.
+ */
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    struct ReadTask *head;
+    struct ReadTask *tail;
+    bool running;
+    long num_threads;
+    long num_processors;
+} read_queue = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, false, 0, 1
+};
+
+static pthread_once_t read_queue_once = PTHREAD_ONCE_INIT;
 
-            n_item = 0;
-            while (n_item < item_length) {
-                if (read_tag(fp, n_item_ptr) == TAG_ITEM_DELIM) {
-                    // Item with undefined length
-                    dcm_log_debug("Stop reading Item #%d of "
-                                  "Data Element '%08X'. "
-                                  "Encountered Item Delimination Tag.",
-                                  item_index, tag);
-                    fseek(fp, 4, SEEK_CUR);
-                    n_item += 4;
-                    break;
-                } else {
-                    fseek(fp, -4, SEEK_CUR);
-                    n_item -= 4;
-                }
 
-                item_eheader = read_element_header(fp, n_item_ptr, implicit);
-                if (item_eheader == NULL) {
-                    dcm_log_error("Reading of Data Element failed. "
-                                  "Could not read header of Item #%d "
-                                  "of Data Element '%08X'.",
-                                  item_index, tag);
-                    iheader_destroy(item_iheader);
-                    eheader_destroy(item_eheader);
-                    dcm_sequence_destroy(value);
-                    return NULL;
-                }
+static void *read_worker(void *arg)
+{
+    (void) arg;
 
-                item_element = read_element(fp,
-                                            item_eheader,
-                                            n_item_ptr,
-                                            implicit);
-                if (item_element == NULL) {
-                    dcm_log_error("Reading of Data Element failed. "
-                                  "Could not read value of Item #%d of "
-                                  "Data Element '%08X'.",
-                                  item_index, tag);
-                    iheader_destroy(item_iheader);
-                    eheader_destroy(item_eheader);
-                    dcm_sequence_destroy(value);
-                    return NULL;
-                }
-                if (!dcm_dataset_insert(item_dataset, item_element)) {
-                    dcm_log_error("Inserting Item #%d of Data Element '%08X' "
-                                  "into Data Set failed.", item_index, tag);
-                    iheader_destroy(item_iheader);
-                    eheader_destroy(item_eheader);
-                    dcm_sequence_destroy(value);
-                    return NULL;
-                }
-                eheader_destroy(item_eheader);
-            }
-            n_seq += n_item;
-            dcm_sequence_append(value, item_dataset);
-            iheader_destroy(item_iheader);
-            item_index += 1;
-        }
-        *n += n_seq;
-        return dcm_element_create_SQ(tag, value);
-    } else if (eheader_check_vr(header, "FD")) {
-        vm = length / sizeof(double);
-        double *values = malloc(vm * sizeof(double));
-        if (values == NULL) {
-            dcm_log_error("Reading of Data Element failed. "
-                          "Could not allocate memory.");
-            return NULL;
+    while (true) {
+        pthread_mutex_lock(&read_queue.mutex);
+        while (read_queue.head == NULL) {
+            pthread_cond_wait(&read_queue.cond, &read_queue.mutex);
         }
-        for (i = 0; i < vm; i++) {
-            double val;
-            *n += fread(&val, 1, sizeof(double), fp);
-            values[i] = val;
+        struct ReadTask *task = read_queue.head;
+        read_queue.head = task->next;
+        if (read_queue.head == NULL) {
+            read_queue.tail = NULL;
         }
-        return dcm_element_create_FD_multi(tag, values, vm);
-    } else if (eheader_check_vr(header, "FL")) {
-        vm = length / sizeof(float);
-        float *values = malloc(vm * sizeof(float));
-        if (values == NULL) {
-            dcm_log_error("Reading of Data Element failed. "
-                          "Could not allocate memory.");
-            return NULL;
+        pthread_mutex_unlock(&read_queue.mutex);
+
+        task->run(task);
+    }
+    return NULL;
+}
+
+
+static void start_read_workers(void)
+{
+    long num_threads = 4;
+#ifdef _SC_NPROCESSORS_ONLN
+    num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    read_queue.num_processors = num_threads;
+    if (num_threads > MAX_READ_THREADS) {
+        num_threads = MAX_READ_THREADS;
+    }
+
+    long i;
+    for (i = 0; i < num_threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, read_worker, NULL) != 0) {
+            dcm_log_warning("Could not start thread #%ld for reading "
+                            "Frame Items.", i + 1);
+            break;
         }
-        for (i = 0; i < vm; i++) {
-            float val;
-            *n += fread(&val, 1, sizeof(float), fp);
-            values[i] = val;
+        pthread_detach(thread);
+        read_queue.running = true;
+        read_queue.num_threads = i + 1;
+    }
+}
+#endif
+
+
+static void submit_read_task(struct ReadTask *task)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_once(&read_queue_once, start_read_workers);
+    if (read_queue.running) {
+        task->next = NULL;
+        pthread_mutex_lock(&read_queue.mutex);
+        if (read_queue.tail) {
+            read_queue.tail->next = task;
+        } else {
+            read_queue.head = task;
         }
-        return dcm_element_create_FL_multi(tag, values, vm);
-    } else if (eheader_check_vr(header, "SS")) {
-        vm = length / sizeof(int16_t);
-        int16_t *values = malloc(vm * sizeof(int16_t));
-        if (values == NULL) {
+        read_queue.tail = task;
+        pthread_cond_signal(&read_queue.cond);
+        pthread_mutex_unlock(&read_queue.mutex);
+        return;
+    }
+#endif
+    // Without threads, the read completes before submission returns
+    task->run(task);
+}
+
+
+/**
+ * Get the number of threads that serve read tasks, starting them if needed.
+ */
+static long get_num_read_workers(void)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_once(&read_queue_once, start_read_workers);
+    return read_queue.num_threads;
+#else
+    return 0;
+#endif
+}
+
+
+/**
+ * Minimum number of Items of a Sequence for them to be read in parallel.
+ */
+#define PARALLEL_MIN_ITEMS 8
+
+/**
+ * Minimum number of bytes of Items that are read as a batch. Smaller batches
+ * cost more to hand to another thread than they take to read.
+ */
+#define PARALLEL_MIN_BATCH_SIZE 65536
+
+/**
+ * Number of batches per processor, so that Items of uneven size even out.
+ */
+#define PARALLEL_BATCHES_PER_PROCESSOR 4
+
+
+/**
+ * Location of an Item of a Sequence.
+ */
+struct ItemExtent {
+    // Offset of the first Data Element of the Item
+    size_t offset;
+    // Item Length as encoded in the Item header
+    uint32_t length;
+};
+
+
+/**
+ * Items of a Sequence that are read in batches by the calling thread and by
+ * the read threads. Each batch is read through a separate cursor.
+ */
+struct ParseJob {
+    const DcmFile *file;
+    uint32_t tag;
+    bool implicit;
+    struct ItemExtent *extents;
+    DcmDataSet **items;
+    uint32_t num_items;
+    uint32_t num_batches;
+    atomic_bool failed;
+};
+
+
+/**
+ * Set up a stream that reads a file by offset on behalf of the file, such
+ * that Data Elements are pooled and counted as if the file read them.
+ */
+static bool init_cursor(DcmFile *cursor, const DcmFile *file)
+{
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->io = file->io;
+    cursor->io_handle = file->io_handle;
+    cursor->map = file->map;
+    cursor->read_flags = file->read_flags & ~DCM_READ_PARALLEL;
+    // The file holds a reference to the pool while its Items are read
+    cursor->string_pool = file->string_pool;
+    cursor->counters = file->counters;
+    cursor->is_counting_elements = true;
+    atomic_init(&cursor->next_read_offset, 0);
+    if (cursor->map == NULL) {
+        cursor->buffer = dcm_heap_malloc(READ_BUFFER_SIZE);
+        if (cursor->buffer == NULL) {
             dcm_log_error("Reading of Data Element failed. "
                           "Could not allocate memory.");
-            return NULL;
-        }
-        for (i = 0; i < vm; i++) {
-            int16_t val;
-            *n += fread(&val, 1, sizeof(int16_t), fp);
-            values[i] = val;
+            return false;
         }
-        return dcm_element_create_SS_multi(tag, values, vm);
-    } else if (eheader_check_vr(header, "SL")) {
-        vm = length / sizeof(int32_t);
-        int32_t *values = malloc(vm * sizeof(int32_t));
-        if (values == NULL) {
-            dcm_log_error("Reading of Data Element failed. "
-                          "Could not allocate memory.");
-            return NULL;
+    }
+    return true;
+}
+
+
+static void parse_batch(void *arg, uint32_t index)
+{
+    struct ParseJob *job = (struct ParseJob *) arg;
+    DcmFile cursor;
+    uint32_t i;
+
+    if (atomic_load(&job->failed) || !init_cursor(&cursor, job->file)) {
+        atomic_store(&job->failed, true);
+        return;
+    }
+
+    uint64_t first = (uint64_t) index * job->num_items / job->num_batches;
+    uint64_t last = (uint64_t) (index + 1) * job->num_items / job->num_batches;
+    for (i = (uint32_t) first; i < (uint32_t) last; i++) {
+        if (atomic_load(&job->failed)) {
+            break;
         }
-        for (i = 0; i < vm; i++) {
-            int32_t val;
-            *n += fread(&val, 1, sizeof(int32_t), fp);
-            values[i] = val;
+        size_t n = 0;
+        file_seek(&cursor, (long) job->extents[i].offset, SEEK_SET);
+        job->items[i] = read_item(&cursor,
+                                  job->tag,
+                                  i,
+                                  job->extents[i].length,
+                                  &n,
+                                  job->implicit);
+        if (job->items[i] == NULL) {
+            atomic_store(&job->failed, true);
         }
-        return dcm_element_create_SL_multi(tag, values, vm);
-    } else if (eheader_check_vr(header, "SV")) {
-        vm = length / sizeof(int64_t);
-        int64_t *values = malloc(vm * sizeof(int64_t));
-        if (values == NULL) {
-            dcm_log_error("Reading of Data Element failed. "
-                          "Could not allocate memory.");
-            return NULL;
+    }
+
+    dcm_heap_free(cursor.buffer);
+}
+
+
+/**
+ * Get the number of processors that Items of a Sequence are parsed on.
+ */
+static long get_num_processors(void)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_once(&read_queue_once, start_read_workers);
+    return read_queue.num_processors;
+#else
+    return 1;
+#endif
+}
+
+
+/**
+ * Find the Items of a Sequence by reading only their headers.
+ */
+static bool scan_sequence_items(DcmFile *file,
+                                uint32_t tag,
+                                uint32_t length,
+                                bool implicit,
+                                struct ItemExtent **extents,
+                                uint32_t *num_items)
+{
+    IHeader header;
+    size_t n = 0;
+    uint32_t capacity = 64;
+
+    *num_items = 0;
+    *extents = DCM_ARRAY_ZEROS(capacity, struct ItemExtent);
+    if (*extents == NULL) {
+        dcm_log_error("Reading of Data Element failed. "
+                      "Could not allocate memory.");
+        return false;
+    }
+
+    while (n < length) {
+        if (!read_item_header(file, &n, &header)) {
+            goto failure;
         }
-        for (i = 0; i < vm; i++) {
-            int64_t val;
-            *n += fread(&val, 1, sizeof(int64_t), fp);
-            values[i] = val;
+        uint32_t item_tag = iheader_get_tag(&header);
+        uint32_t item_length = iheader_get_length(&header);
+        if (item_tag == TAG_SQ_DELIM) {
+            break;
         }
-        return dcm_element_create_SV_multi(tag, values, vm);
-    } else if (eheader_check_vr(header, "UL")) {
-        vm = length / sizeof(uint32_t);
-        uint32_t *values = malloc(vm * sizeof(uint32_t));
-        if (values == NULL) {
+        if (item_tag != TAG_ITEM) {
             dcm_log_error("Reading of Data Element failed. "
-                          "Could not allocate memory.");
-            return NULL;
+                          "Expected tag '%08X' instead of '%08X' "
+                          "for Item #%d of Data Element '%08X'.",
+                          TAG_ITEM, item_tag, *num_items, tag);
+            goto failure;
         }
-        for (i = 0; i < vm; i++) {
-            uint32_t val;
-            *n += fread(&val, 1, sizeof(uint32_t), fp);
-            values[i] = val;
+
+        if (*num_items == capacity) {
+            capacity *= 2;
+            struct ItemExtent *resized = dcm_heap_realloc(
+                *extents,
+                capacity * sizeof(struct ItemExtent)
+            );
+            if (resized == NULL) {
+                dcm_log_error("Reading of Data Element failed. "
+                              "Could not allocate memory.");
+                goto failure;
+            }
+            *extents = resized;
         }
-        return dcm_element_create_UL_multi(tag, values, vm);
-    } else if (eheader_check_vr(header, "US")) {
-        vm = length / sizeof(uint16_t);
-        uint16_t *values = malloc(vm * sizeof(uint16_t));
-        if (values == NULL) {
+        size_t offset = (size_t) file_tell(file);
+        (*extents)[*num_items].offset = offset;
+        (*extents)[*num_items].length = item_length;
+        *num_items += 1;
+
+        if (item_length != 0xFFFFFFFF) {
+            if (file_seek(file, (long) item_length, SEEK_CUR) != 0) {
+                goto failure;
+            }
+        } else if (!skip_item(file, implicit)) {
             dcm_log_error("Reading of Data Element failed. "
-                          "Could not allocate memory.");
-            return NULL;
+                          "Could not find end of Item #%d of "
+                          "Data Element '%08X'.", *num_items, tag);
+            goto failure;
         }
-        for (i = 0; i < vm; i++) {
-            uint16_t val;
-            *n += fread(&val, 1, sizeof(uint16_t), fp);
-            values[i] = val;
+        n += (size_t) file_tell(file) - offset;
+    }
+    return true;
+
+failure:
+    dcm_heap_free(*extents);
+    *extents = NULL;
+    return false;
+}
+
+
+/**
+ * Read the Items of a Sequence in parallel.
+ *
+ * Sets ``is_read`` if the Items were appended to ``seq``. Otherwise, the
+ * stream is left at the first Item to read the Sequence as usual, and
+ * ``is_serial`` is set if neither the Sequence nor the smaller Sequences
+ * within its Items can be read in parallel.
+ */
+static bool read_sequence_parallel(DcmFile *file,
+                                   uint32_t tag,
+                                   uint32_t length,
+                                   bool implicit,
+                                   DcmSequence *seq,
+                                   size_t *n,
+                                   bool *is_read,
+                                   bool *is_serial)
+{
+    struct ItemExtent *extents;
+    uint32_t i, num_items;
+
+    *is_read = false;
+    *is_serial = false;
+    // Arenas are not shared between threads
+    if (dcm_arena_current() != NULL) {
+        return true;
+    }
+#ifndef HAVE_PREAD
+    // Without positional reads, reading by offset uses the stream
+    if (file->map == NULL) {
+        return true;
+    }
+#endif
+    // Parsing is bound by the processor, rather than by reads
+    long num_processors = get_num_processors();
+    if (num_processors < 2 ||
+        get_num_read_workers() == 0 ||
+        (length != 0xFFFFFFFF && length < 2 * PARALLEL_MIN_BATCH_SIZE)) {
+        *is_serial = true;
+        return true;
+    }
+
+    long start = file_tell(file);
+    file->is_counting_elements = false;
+    bool is_scanned = scan_sequence_items(file, tag, length, implicit,
+                                          &extents, &num_items);
+    file->is_counting_elements = true;
+    if (!is_scanned) {
+        return false;
+    }
+    long end = file_tell(file);
+    uint64_t num_batches = (uint64_t) (end - start) / PARALLEL_MIN_BATCH_SIZE;
+    if (num_batches > (uint64_t) num_processors *
+                      PARALLEL_BATCHES_PER_PROCESSOR) {
+        num_batches = (uint64_t) num_processors *
+                      PARALLEL_BATCHES_PER_PROCESSOR;
+    }
+    if (num_batches > num_items) {
+        num_batches = num_items;
+    }
+    if (num_items < PARALLEL_MIN_ITEMS || num_batches < 2) {
+        *is_serial = num_batches < 2;
+        dcm_heap_free(extents);
+        file_seek(file, start, SEEK_SET);
+        return true;
+    }
+
+    DcmDataSet **items = DCM_ARRAY_ZEROS(num_items, DcmDataSet *);
+    if (items == NULL) {
+        dcm_log_error("Reading of Data Element failed. "
+                      "Could not allocate memory.");
+        dcm_heap_free(extents);
+        return false;
+    }
+    struct ParseJob job = {
+        .file = file,
+        .tag = tag,
+        .implicit = implicit,
+        .extents = extents,
+        .items = items,
+        .num_items = num_items,
+        .num_batches = (uint32_t) num_batches,
+    };
+    atomic_init(&job.failed, false);
+
+    dcm_log_debug("Read %d Items of Data Element '%08X' in %d batches.",
+                  num_items, tag, job.num_batches);
+    dcm_run_parallel(job.num_batches, parse_batch, &job);
+
+    bool failed = atomic_load(&job.failed);
+    for (i = 0; i < num_items; i++) {
+        if (failed) {
+            if (items[i]) {
+                dcm_dataset_destroy(items[i]);
+            }
+        } else if (!dcm_sequence_append(seq, items[i])) {
+            failed = true;
         }
-        return dcm_element_create_US_multi(tag, values, vm);
-    } else if (eheader_check_vr(header, "UV")) {
-        vm = length / sizeof(uint64_t);
-        uint64_t *values = malloc(vm * sizeof(uint64_t));
-        if (values == NULL) {
-            dcm_log_error("Reading of Data Element failed. "
-                          "Could not allocate memory.");
-            return NULL;
+    }
+    dcm_heap_free(items);
+    dcm_heap_free(extents);
+    if (failed) {
+        return false;
+    }
+
+    file_seek(file, end, SEEK_SET);
+    *n += (size_t) (end - start);
+    *is_read = true;
+    return true;
+}
+
+
+/**
+ * Calls of a function that are made by the calling thread and by helpers
+ * running on the read threads. Each participant claims the next index until
+ * none is left, so that a busy or missing helper only means that the others
+ * make more calls.
+ */
+struct ParallelJob {
+    void (*function)(void *arg, uint32_t index);
+    void *arg;
+    uint32_t count;
+    atomic_uint next;
+    atomic_uint num_done;
+    // Held by the calling thread and by each helper
+    atomic_uint refcount;
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+};
+
+
+static void parallel_job_release(struct ParallelJob *job)
+{
+    if (atomic_fetch_sub(&job->refcount, 1) == 1) {
+#ifdef HAVE_PTHREAD_H
+        pthread_cond_destroy(&job->cond);
+        pthread_mutex_destroy(&job->mutex);
+#endif
+        dcm_heap_free(job);
+    }
+}
+
+
+static void parallel_job_run(struct ParallelJob *job)
+{
+    while (true) {
+        uint32_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->count) {
+            break;
         }
-        for (i = 0; i < vm; i++) {
-            uint64_t val;
-            *n += fread(&val, 1, sizeof(uint64_t), fp);
-            values[i] = val;
+        job->function(job->arg, i);
+        if (atomic_fetch_add(&job->num_done, 1) + 1 == job->count) {
+#ifdef HAVE_PTHREAD_H
+            pthread_mutex_lock(&job->mutex);
+            pthread_cond_broadcast(&job->cond);
+            pthread_mutex_unlock(&job->mutex);
+#endif
         }
-        return dcm_element_create_UV_multi(tag, values, vm);
-    } else {
-        vm = 1;
-        char *value = malloc(length);
-        if (value == NULL) {
-            dcm_log_error("Reading of Data Element failed. "
-                          "Could not allocate memory for "
-                          "value of Data Element '%08X'.",
-                          tag);
-            return NULL;
+    }
+}
+
+
+static void run_parallel_task(struct ReadTask *task)
+{
+    struct ParallelJob *job = (struct ParallelJob *) task->user_data;
+    parallel_job_run(job);
+    parallel_job_release(job);
+    dcm_heap_free(task);
+}
+
+
+void dcm_run_parallel(uint32_t count,
+                      void (*function)(void *arg, uint32_t index),
+                      void *arg)
+{
+    uint32_t i;
+
+    long num_helpers = count > 1 ? get_num_read_workers() : 0;
+    struct ParallelJob *job = num_helpers > 0 ?
+                              DCM_NEW(struct ParallelJob) : NULL;
+    if (job == NULL) {
+        for (i = 0; i < count; i++) {
+            function(arg, i);
         }
-        *n += fread(value, 1, length, fp);
+        return;
+    }
+    job->function = function;
+    job->arg = arg;
+    job->count = count;
+    atomic_init(&job->next, 0);
+    atomic_init(&job->num_done, 0);
+    atomic_init(&job->refcount, 1);
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_init(&job->mutex, NULL);
+    pthread_cond_init(&job->cond, NULL);
+#endif
+
+    if (num_helpers > (long) count - 1) {
+        num_helpers = (long) count - 1;
+    }
+    for (i = 0; i < (uint32_t) num_helpers; i++) {
+        struct ReadTask *task = DCM_NEW(struct ReadTask);
+        if (task == NULL) {
+            break;
+        }
+        task->run = run_parallel_task;
+        task->user_data = job;
+        atomic_fetch_add(&job->refcount, 1);
+        submit_read_task(task);
+    }
 
-        if (eheader_check_vr(header, "OB")) {
-            return dcm_element_create_OB(tag, value, length);
-        } else if (eheader_check_vr(header, "OD")) {
-            return dcm_element_create_OD(tag, value, length);
-        } else if (eheader_check_vr(header, "OF")) {
-            return dcm_element_create_OF(tag, value, length);
-        } else if (eheader_check_vr(header, "OL")) {
-            return dcm_element_create_OL(tag, value, length);
-        } else if (eheader_check_vr(header, "OV")) {
-            return dcm_element_create_OV(tag, value, length);
-        } else if (eheader_check_vr(header, "OW")) {
-            return dcm_element_create_OW(tag, value, length);
-        } else if (eheader_check_vr(header, "UC")) {
-            return dcm_element_create_UC(tag, value, length);
-        } else if (eheader_check_vr(header, "UN")) {
-            return dcm_element_create_UN(tag, value, length);
-        } else {
-            tag = eheader_get_tag(header);
-            dcm_log_error("Reading of Data Element failed. "
-                          "Data Element '%08X' has unexpected "
-                          "Value Representation.", tag);
+    parallel_job_run(job);
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&job->mutex);
+    while (atomic_load(&job->num_done) < count) {
+        pthread_cond_wait(&job->cond, &job->mutex);
+    }
+    pthread_mutex_unlock(&job->mutex);
+#endif
+    parallel_job_release(job);
+}
+
+
+struct SeriesInstance {
+    DcmDataSet *file_meta;
+    DcmDataSet *metadata;
+};
+
+
+struct _DcmSeries {
+    uint32_t num_instances;
+    struct SeriesInstance *instances;
+};
+
+
+struct SeriesLoad {
+    const char *const *file_paths;
+    uint32_t read_flags;
+    DcmStringPool *pool;
+    struct SeriesInstance *instances;
+};
+
+
+static void load_series_instance(void *arg, uint32_t index)
+{
+    struct SeriesLoad *load = (struct SeriesLoad *) arg;
+    struct SeriesInstance *instance = &load->instances[index];
+
+    DcmFile *file = dcm_file_create(load->file_paths[index], 'r');
+    if (file == NULL) {
+        return;
+    }
+    dcm_file_set_read_flags(file, load->read_flags);
+    dcm_file_set_string_pool(file, load->pool);
+    instance->file_meta = dcm_file_read_file_meta(file);
+    if (instance->file_meta) {
+        instance->metadata = dcm_file_read_metadata(file);
+    }
+    if (instance->metadata == NULL) {
+        dcm_log_error("Loading of series failed. "
+                      "Could not read instance '%s'.",
+                      load->file_paths[index]);
+        dcm_dataset_destroy(instance->file_meta);
+        instance->file_meta = NULL;
+    }
+    // Lazily read Data Sets keep the file open themselves
+    dcm_file_destroy(file);
+}
+
+
+DcmSeries *dcm_series_load(const char *const *file_paths,
+                           uint32_t num_files,
+                           uint32_t read_flags,
+                           DcmStringPool *pool)
+{
+    DcmSeries *series = DCM_NEW(DcmSeries);
+    if (series == NULL) {
+        return NULL;
+    }
+    if (num_files > 0) {
+        series->instances = DCM_ARRAY_ZEROS(num_files, struct SeriesInstance);
+        if (series->instances == NULL) {
+            dcm_heap_free(series);
             return NULL;
         }
     }
-    return element;
+    series->num_instances = num_files;
+
+    struct SeriesLoad load = {file_paths, read_flags, pool, series->instances};
+    dcm_trace_start("load_series", NULL);
+    dcm_run_parallel(num_files, load_series_instance, &load);
+    dcm_trace_end("load_series", NULL);
+    return series;
 }
 
 
-DcmFile *dcm_file_create(const char *file_path, const char mode)
+uint32_t dcm_series_get_num_instances(const DcmSeries *series)
 {
-    if (mode != 'r' && mode != 'w') {
-        dcm_log_error("Creation of file failed. "
-                      "Wrong file mode specified.");
-        exit(1);
-    }
+    return series->num_instances;
+}
 
-    DcmFile *file = DCM_NEW(DcmFile);
-    if (file == NULL) {
-        dcm_log_error("Creation of file failed. "
-                      "Could not allocate memory for file.");
+
+DcmDataSet *dcm_series_get_file_meta(const DcmSeries *series, uint32_t index)
+{
+    if (index >= series->num_instances) {
+        dcm_log_error("Getting File Meta Information of instance failed. "
+                      "Index %u exceeds number of instances %u.",
+                      index, series->num_instances);
         return NULL;
     }
+    return series->instances[index].file_meta;
+}
 
-    char file_mode[3];
-    file_mode[0] = mode;
-    file_mode[1] = 'b';
-    file_mode[2] = '\0';
-    file->fp = fopen(file_path, file_mode);
-    if (file->fp == NULL) {
-        dcm_log_error("Could not open file for reading: %s", file_path);
+
+DcmDataSet *dcm_series_get_metadata(const DcmSeries *series, uint32_t index)
+{
+    if (index >= series->num_instances) {
+        dcm_log_error("Getting metadata of instance failed. "
+                      "Index %u exceeds number of instances %u.",
+                      index, series->num_instances);
         return NULL;
     }
+    return series->instances[index].metadata;
+}
 
-    file->offset = 0;
-    file->pixel_data_offset = 0;
-    file->transfer_syntax_uid = NULL;
 
-    return file;
+void dcm_series_destroy(DcmSeries *series)
+{
+    uint32_t i;
+
+    if (series) {
+        for (i = 0; i < series->num_instances; i++) {
+            dcm_dataset_destroy(series->instances[i].file_meta);
+            dcm_dataset_destroy(series->instances[i].metadata);
+        }
+        dcm_heap_free(series->instances);
+        dcm_heap_free(series);
+    }
 }
 
 
-DcmDataSet *dcm_file_read_file_meta(DcmFile *file)
+/**
+ * Content of a stream that has arrived so far, which the File of the
+ * stream reads from.
+ */
+struct StreamSource {
+    char *data;
+    size_t length;
+    size_t capacity;
+#ifdef HAVE_PTHREAD_H
+    // Held while content is appended, since Frames may be read meanwhile
+    pthread_mutex_t mutex;
+#endif
+};
+
+
+static void stream_source_lock(struct StreamSource *source)
 {
-    const bool implicit = false;
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&source->mutex);
+#else
+    (void) source;
+#endif
+}
 
-    size_t size;
-    size_t *n = &size;
-    uint8_t n_elem;
-    uint32_t tag;
-    uint16_t group_number;
-    EHeader *header;
-    DcmElement *element;
 
-    DcmDataSet *file_meta = dcm_dataset_create();
-    if (file_meta == NULL) {
-        dcm_log_error("Reading of File Meta Information failed. "
-                      "Could not construct Data Set.");
-        return NULL;
+static void stream_source_unlock(struct StreamSource *source)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_unlock(&source->mutex);
+#else
+    (void) source;
+#endif
+}
+
+
+static int64_t stream_read_at(void *handle,
+                              char *buffer,
+                              int64_t length,
+                              int64_t offset)
+{
+    struct StreamSource *source = (struct StreamSource *) handle;
+    size_t available = 0;
+
+    stream_source_lock(source);
+    if ((uint64_t) offset < source->length) {
+        available = source->length - (size_t) offset;
+        if ((uint64_t) length < available) {
+            available = (size_t) length;
+        }
+        memcpy(buffer, source->data + offset, available);
     }
+    stream_source_unlock(source);
 
-    size = 0;
+    return (int64_t) available;
+}
 
-    // File Preamble
-    char preamble[129];
-    size += fread(preamble, 1, sizeof(preamble) - 1, file->fp);
-    preamble[128] = '\0';
 
-    // DICOM Prefix
-    char prefix[5];
-    size += fread(prefix, 1, sizeof(prefix) - 1, file->fp);
-    prefix[4] = '\0';
-    if (strcmp(prefix, "DICM") != 0) {
-        dcm_log_error("Reading of File Meta Information failed. "
-                      "Prefix 'DICM' not found.");
-        dcm_dataset_destroy(file_meta);
-        return NULL;
-    }
+static void stream_close(void *handle)
+{
+    struct StreamSource *source = (struct StreamSource *) handle;
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_destroy(&source->mutex);
+#endif
+    dcm_heap_free(source->data);
+    dcm_heap_free(source);
+}
 
-    size = 0;
 
-    // File Meta Information Group Length
-    header = read_element_header(file->fp, n, implicit);
-    if (header == NULL) {
-        dcm_log_error("Reading of File Meta Information failed. "
-                      "Header of Data Element 'Group Length' "
-                      "could not be read.");
-        dcm_dataset_destroy(file_meta);
-        return NULL;
-    }
-    element = read_element(file->fp, header, n, implicit);
-    if (element == NULL) {
-        dcm_log_error("Reading of File Meta Information failed. "
-                      "Value of Data Element 'Group Length' "
-                      "could not be read.");
-        eheader_destroy(header);
-        dcm_dataset_destroy(file_meta);
-        return NULL;
-    }
+// The content grows, such that neither its size nor a mapping is known
+static const DcmIOMethods stream_methods = {
+    stream_read_at, NULL, NULL, stream_close, NULL
+};
 
-    uint32_t group_length = dcm_element_get_value_UL(element, 0);
-    eheader_destroy(header);
-    dcm_element_destroy(element);
 
-    // File Meta Information Version
-    header = read_element_header(file->fp, n, implicit);
-    if (header == NULL) {
-        dcm_log_error("Reading of File Meta Information failed. "
-                      "Header of Data Element 'File Meta Information Version' "
-                      "could not be read.");
-        dcm_dataset_destroy(file_meta);
+enum StreamPhase {
+    // Waiting for the File Meta Information
+    STREAM_FILE_META,
+    // Scanning the Data Set for the Pixel Data Element
+    STREAM_DATASET,
+    // Waiting for the end of content that cannot be scanned
+    STREAM_WAIT,
+    // Scanning the Frame Items
+    STREAM_FRAMES,
+    STREAM_DONE,
+    STREAM_FAILED,
+};
+
+
+enum ScanResult {
+    SCAN_MORE,
+    SCAN_PIXEL_DATA,
+    SCAN_END,
+    SCAN_ERROR,
+};
+
+
+struct _DcmStream {
+    // Reads the content through the source, which it owns
+    DcmFile *file;
+    struct StreamSource *source;
+    enum StreamPhase phase;
+    bool is_finished;
+    bool implicit;
+    bool encapsulated;
+    DcmDataSet *file_meta;
+    DcmDataSet *metadata;
+    // Offset of the next header to scan and number of Sequences and Items
+    // of undefined length that enclose it
+    size_t scan_offset;
+    uint32_t depth;
+    // Number of Items of encapsulated Pixel Data scanned so far, including
+    // the Basic Offset Table Item
+    uint32_t num_items;
+    uint32_t num_frames;
+    size_t *frame_offsets;
+    uint32_t *frame_lengths;
+    // Frames 1 to this number have arrived
+    atomic_uint num_available;
+};
+
+
+DcmStream *dcm_stream_create(void)
+{
+    DcmStream *stream = DCM_NEW(DcmStream);
+    if (stream == NULL) {
+        dcm_log_error("Creation of stream failed. "
+                      "Could not allocate memory.");
         return NULL;
     }
-    element = read_element(file->fp, header, n, implicit);
-    if (element == NULL) {
-        dcm_log_error("Reading of File Meta Information failed. "
-                      "Value of Data Element 'File Meta Information Version' "
-                      "could not be read.");
-        eheader_destroy(header);
-        dcm_dataset_destroy(file_meta);
+    struct StreamSource *source = DCM_NEW(struct StreamSource);
+    if (source == NULL) {
+        dcm_log_error("Creation of stream failed. "
+                      "Could not allocate memory.");
+        dcm_heap_free(stream);
         return NULL;
     }
-    eheader_destroy(header);
-    dcm_element_destroy(element);
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_init(&source->mutex, NULL);
+#endif
+    // The source is closed along with the File, also if creation fails
+    stream->file = dcm_file_create_io(&stream_methods, source);
+    if (stream->file == NULL) {
+        dcm_heap_free(stream);
+        return NULL;
+    }
+    stream->source = source;
+    stream->phase = STREAM_FILE_META;
+    atomic_init(&stream->num_available, 0);
+    return stream;
+}
 
-    n_elem = 0;
-    while(true) {
-        header = read_element_header(file->fp, n, implicit);
-        if (header == NULL) {
-            dcm_log_error("Reading of File Meta Information failed. "
-                          "Could not read header of Data Element #%d.",
-                          n_elem);
-            dcm_element_destroy(element);
-            dcm_dataset_destroy(file_meta);
-            return NULL;
-        }
-        tag = eheader_get_tag(header);
-        group_number = eheader_get_group_number(header);
-        if (group_number != 0x0002) {
-            eheader_destroy(header);
-            break;
-        }
 
-        element = read_element(file->fp, header, n, implicit);
-        if (element == NULL) {
-            dcm_log_error("Reading File Meta Information failed. "
-                          "Could not read value of Data Element '%08X'.", tag);
-            eheader_destroy(header);
-            dcm_dataset_destroy(file_meta);
-            return NULL;
+/**
+ * Scan the headers of the Data Set up to the Pixel Data Element, without
+ * decoding any values.
+ */
+static enum ScanResult scan_dataset(DcmStream *stream,
+                                    const char *data,
+                                    size_t length)
+{
+    while (stream->scan_offset + 8 <= length) {
+        const char *header = data + stream->scan_offset;
+        uint32_t tag = decode_tag(header);
+        uint32_t value_length;
+        size_t header_length = 8;
+
+        if ((tag >> 16) == 0xFFFE) {
+            if (stream->depth == 0) {
+                dcm_log_error("Reading of stream failed. "
+                              "Encountered Item outside of a Sequence.");
+                return SCAN_ERROR;
+            }
+            value_length = decode_uint32(header + 4);
+            if (tag != TAG_ITEM) {
+                // Item and Sequence Delimitation close the enclosing part
+                stream->depth -= 1;
+                stream->scan_offset += header_length;
+                continue;
+            }
+        } else {
+            if (stream->depth == 0) {
+                if (tag == TAG_PIXEL_DATA ||
+                    tag == TAG_FLOAT_PIXEL_DATA ||
+                    tag == TAG_DOUBLE_PIXEL_DATA) {
+                    return SCAN_PIXEL_DATA;
+                }
+                if (tag == TAG_TRAILING_PADDING) {
+                    return SCAN_END;
+                }
+            }
+            if (stream->implicit) {
+                value_length = decode_uint32(header + 4);
+            } else {
+                char vr[3] = {header[4], header[5], '\0'};
+                if (has_short_length(vr)) {
+                    value_length = decode_uint16(header + 6);
+                } else {
+                    header_length = 12;
+                    if (stream->scan_offset + header_length > length) {
+                        return SCAN_MORE;
+                    }
+                    value_length = decode_uint32(header + 8);
+                }
+            }
         }
 
-        if (!dcm_dataset_insert(file_meta, element)) {
-            dcm_log_error("Reading File Meta Information failed. "
-                          "Could not insert Data Element '%08X' into "
-                          "Data Set.", tag);
-            eheader_destroy(header);
-            dcm_dataset_destroy(file_meta);
-            return NULL;
+        if (value_length == 0xFFFFFFFF) {
+            // Sequences and Items of undefined length are scanned through
+            stream->depth += 1;
+            stream->scan_offset += header_length;
+        } else {
+            stream->scan_offset += header_length + value_length;
         }
+    }
+    return SCAN_MORE;
+}
 
-        if (size >= group_length) {
-            eheader_destroy(header);
-            break;
-        }
-        n_elem += 1;
-        eheader_destroy(header);
+
+static bool stream_start_frames(DcmStream *stream)
+{
+    DcmFile *file = stream->file;
+
+    if (file->pixel_data_offset == 0) {
+        stream->phase = STREAM_DONE;
+        return true;
     }
 
-    file->offset = ftell(file->fp);
+    stream->num_frames = 1;
+    DcmElement *element = dcm_dataset_get(stream->metadata, 0x00280008);
+    if (element &&
+        !parse_num_frames(dcm_element_get_value_IS(element, 0),
+                          &stream->num_frames)) {
+        dcm_log_error("Reading of stream failed. "
+                      "Could not get number of Frames.");
+        return false;
+    }
+    if (file->desc == NULL) {
+        dcm_log_error("Reading of stream failed. "
+                      "Could not get image pixel description.");
+        return false;
+    }
 
-    element = dcm_dataset_get(file_meta, 0x00020010);
-    const char *transfer_syntax_uid = dcm_element_get_value_UI(element, 0);
-    file->transfer_syntax_uid = strdup(transfer_syntax_uid);
-    if (file->transfer_syntax_uid == NULL) {
-        dcm_log_error("Reading of File Meta Information failed. "
-                      "Could not allocate memory for data element "
-                      "'Transfer Syntax UID'.");
-        file->offset = 0;  // reset state
-        dcm_dataset_destroy(file_meta);
-        return NULL;
+    stream->frame_offsets = DCM_ARRAY_ZEROS(stream->num_frames, size_t);
+    stream->frame_lengths = DCM_ARRAY_ZEROS(stream->num_frames, uint32_t);
+    if (stream->frame_offsets == NULL || stream->frame_lengths == NULL) {
+        dcm_log_error("Reading of stream failed. "
+                      "Could not allocate memory.");
+        return false;
     }
 
-    dcm_dataset_lock(file_meta);
-    return file_meta;
+    if (stream->encapsulated) {
+        // Start with the header of the Basic Offset Table Item
+        stream->scan_offset = file->pixel_data_offset + 12;
+        stream->num_items = 0;
+    } else {
+        size_t frame_length = get_native_frame_length(file->desc);
+        for (uint32_t i = 0; i < stream->num_frames; i++) {
+            stream->frame_offsets[i] = file->first_frame_offset +
+                                       i * frame_length;
+            stream->frame_lengths[i] = (uint32_t) frame_length;
+        }
+    }
+    stream->phase = STREAM_FRAMES;
+    return true;
 }
 
 
-void dcm_file_destroy(DcmFile *file)
+static bool stream_read_metadata(DcmStream *stream)
 {
-    if (file) {
-        if (file->transfer_syntax_uid) {
-            free(file->transfer_syntax_uid);
-        }
-        fclose(file->fp);
-        free(file);
-        file = NULL;
+    dcm_log_debug("Read metadata of stream.");
+    stream->metadata = dcm_file_read_metadata(stream->file);
+    if (stream->metadata == NULL) {
+        dcm_log_error("Reading of stream failed. "
+                      "Could not read metadata.");
+        return false;
     }
+    return stream_start_frames(stream);
 }
 
 
-DcmDataSet *dcm_file_read_metadata(DcmFile *file)
+static bool stream_read_file_meta(DcmStream *stream,
+                                  const char *data,
+                                  size_t length)
 {
-    uint32_t tag;
-    uint16_t group_number;
-    size_t size = 0;
-    size_t *n = &size;
-    uint32_t n_elem;
-    bool implicit;
-    char tmp[1];
-    DcmElement *element;
-    EHeader *header;
-
-    if (file->offset == 0) {
-        DcmDataSet *file_meta = dcm_file_read_file_meta(file);
-        if (file_meta == NULL) {
-            dcm_log_error("Reading metadata failed. "
-                          "Could not read File Meta Information.");
-            return NULL;
+    if (!stream->is_finished) {
+        // The File Meta Information ends as given by its Group Length
+        if (length < 144) {
+            return true;
+        }
+        if (memcmp(data + 128, "DICM", 4) != 0 ||
+            decode_tag(data + 132) != 0x00020000 ||
+            memcmp(data + 136, "UL", 2) != 0) {
+            // Without Group Length, the whole content is needed
+            stream->phase = STREAM_WAIT;
+            return true;
+        }
+        if (length < 144 + (size_t) decode_uint32(data + 140)) {
+            return true;
         }
     }
-    fseek(file->fp, file->offset, SEEK_SET);
 
-    implicit = false;
-    if (file->transfer_syntax_uid) {
-        if (strcmp(file->transfer_syntax_uid, "1.2.840.10008.1.2") == 0) {
-            implicit = true;
-        }
+    dcm_log_debug("Read File Meta Information of stream.");
+    stream->file_meta = dcm_file_read_file_meta(stream->file);
+    if (stream->file_meta == NULL) {
+        dcm_log_error("Reading of stream failed. "
+                      "Could not read File Meta Information.");
+        return false;
     }
 
-    DcmDataSet *dataset = dcm_dataset_create();
-    if (dataset == NULL) {
-        dcm_log_error("Reading of Data Set failed. "
-                      "Could not construct Data Set.");
-        return NULL;
+    const char *transfer_syntax_uid = stream->file->transfer_syntax_uid;
+    stream->implicit = strcmp(transfer_syntax_uid, "1.2.840.10008.1.2") == 0;
+    stream->encapsulated = dcm_is_encapsulated_transfer_syntax(
+        transfer_syntax_uid
+    );
+    if (strcmp(transfer_syntax_uid, "1.2.840.10008.1.2.2") == 0 ||
+        strcmp(transfer_syntax_uid, "1.2.840.10008.1.2.1.99") == 0) {
+        // Big Endian and deflated Data Sets are not scanned
+        stream->phase = STREAM_WAIT;
+    } else {
+        stream->scan_offset = stream->file->offset;
+        stream->phase = STREAM_DATASET;
     }
+    return true;
+}
 
-    n_elem = 0;
-    while (!feof(file->fp)) {
-        if (fread(tmp, 1, 1, file->fp) == 0) {
-            dcm_log_info("Stop reading Data Set. Reached end of file.");
-            break;
+
+static bool stream_scan_dataset(DcmStream *stream,
+                                const char *data,
+                                size_t length)
+{
+    enum ScanResult result = scan_dataset(stream, data, length);
+    if (result == SCAN_ERROR) {
+        return false;
+    }
+    if (result == SCAN_PIXEL_DATA || result == SCAN_END) {
+        // The metadata is read up to the header of the Data Element that
+        // ends it and, for encapsulated Pixel Data, the header of the Basic
+        // Offset Table Item, which locates the first Frame Item
+        size_t header_end = stream->scan_offset + (stream->implicit ? 8 : 12);
+        if (result == SCAN_PIXEL_DATA && stream->encapsulated) {
+            header_end += 8;
         }
-        fseek(file->fp, -1L, SEEK_CUR);
+        if (header_end > length) {
+            result = SCAN_MORE;
+        }
+    }
+    if (result == SCAN_MORE && !stream->is_finished) {
+        return true;
+    }
+    return stream_read_metadata(stream);
+}
 
-        header = read_element_header(file->fp, n, implicit);
-        if (header == NULL) {
-            dcm_log_error("Reading of Data Set failed. "
-                          "Could not read header of Data Element #%d.",
-                          n_elem);
-            dcm_dataset_destroy(dataset);
-            return NULL;
+
+static bool stream_scan_frames(DcmStream *stream,
+                               const char *data,
+                               size_t length)
+{
+    uint32_t num_available = atomic_load(&stream->num_available);
+
+    if (!stream->encapsulated) {
+        size_t first = stream->file->first_frame_offset;
+        size_t frame_length = stream->frame_lengths[0];
+        if (length > first && frame_length > 0) {
+            size_t num_arrived = (length - first) / frame_length;
+            if (num_arrived > stream->num_frames) {
+                num_arrived = stream->num_frames;
+            }
+            num_available = (uint32_t) num_arrived;
+        }
+        if (num_available == stream->num_frames) {
+            stream->phase = STREAM_DONE;
         }
+    }
 
-        tag = eheader_get_tag(header);
-        group_number = eheader_get_group_number(header);
-        if (tag == TAG_TRAILING_PADDING) {
-            dcm_log_debug("Stop reading Data Set. "
-                          "Encountered Data Set Trailing Tag.");
-            eheader_destroy(header);
+    while (stream->encapsulated && stream->scan_offset + 8 <= length) {
+        const char *header = data + stream->scan_offset;
+        uint32_t tag = decode_tag(header);
+        uint32_t item_length = decode_uint32(header + 4);
+        if (tag == TAG_SQ_DELIM) {
+            stream->phase = STREAM_DONE;
             break;
-        } else if (tag == TAG_PIXEL_DATA ||
-                   tag == TAG_FLOAT_PIXEL_DATA ||
-                   tag == TAG_DOUBLE_PIXEL_DATA) {
-            // Set file pointer to the first byte of the pixel data element
-            if (implicit) {
-                // Tag: 4 bytes, Value Length: 4 bytes
-                fseek(file->fp, -8L, SEEK_CUR);
-            } else {
-                // Tag: 4 bytes, VR: 2 bytes + 2 bytes, Value Length: 4 bytes
-                fseek(file->fp, -12L, SEEK_CUR);
-            }
-            file->pixel_data_offset = ftell(file->fp);
-            dcm_log_debug("Stop reading Data Set. "
-                          "Encountered Tag of Pixel Data Element.");
-            eheader_destroy(header);
+        }
+        if (tag != TAG_ITEM) {
+            dcm_log_error("Reading of stream failed. "
+                          "No Item Tag found for Frame Item #%u.",
+                          stream->num_items);
+            return false;
+        }
+        size_t item_end = stream->scan_offset + 8 + item_length;
+        if (item_end > length) {
             break;
         }
-        if (group_number == 0x0002) {
-            dcm_log_error("Reading of Data Set failed. "
-                          "Encountered File Meta Information group.");
-            eheader_destroy(header);
-            dcm_dataset_destroy(dataset);
-            return NULL;
+        // The first Item is the Basic Offset Table
+        if (stream->num_items > 0) {
+            stream->frame_offsets[num_available] = stream->scan_offset + 8;
+            stream->frame_lengths[num_available] = item_length;
+            num_available += 1;
+        }
+        stream->num_items += 1;
+        stream->scan_offset = item_end;
+        if (num_available == stream->num_frames) {
+            stream->phase = STREAM_DONE;
+            break;
         }
+    }
 
-        element = read_element(file->fp, header, n, implicit);
-        if (element == NULL) {
-            dcm_log_error("Reading of Data Set failed. "
-                          "Could not read value of Data Element '%08X'.",
-                          tag);
-            eheader_destroy(header);
-            dcm_dataset_destroy(dataset);
-            return NULL;
+    // Readers may use the extents of Frames once they are counted
+    atomic_store_explicit(&stream->num_available,
+                          num_available,
+                          memory_order_release);
+
+    if (stream->phase == STREAM_DONE && num_available < stream->num_frames) {
+        dcm_log_error("Reading of stream failed. "
+                      "Pixel Data contain fewer Items than Frames.");
+        return false;
+    }
+    if (stream->phase == STREAM_FRAMES && stream->is_finished) {
+        dcm_log_error("Reading of stream failed. "
+                      "Content ended after %u of %u Frames.",
+                      num_available,
+                      stream->num_frames);
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Parse as much of the content as has arrived.
+ */
+static DcmStreamState stream_advance(DcmStream *stream)
+{
+    // Only the caller appends content, such that it is read without lock
+    const char *data = stream->source->data;
+    size_t length = stream->source->length;
+    enum StreamPhase phase;
+
+    do {
+        phase = stream->phase;
+        bool result = true;
+        switch (phase) {
+            case STREAM_FILE_META:
+                result = stream_read_file_meta(stream, data, length);
+                break;
+            case STREAM_DATASET:
+                result = stream_scan_dataset(stream, data, length);
+                break;
+            case STREAM_WAIT:
+                if (stream->is_finished) {
+                    result = (stream->file_meta != NULL ||
+                              stream_read_file_meta(stream, data, length)) &&
+                             stream_read_metadata(stream);
+                }
+                break;
+            case STREAM_FRAMES:
+                result = stream_scan_frames(stream, data, length);
+                break;
+            default:
+                break;
         }
-        if (!dcm_dataset_insert(dataset, element)) {
-            dcm_log_error("Inserting Data Element '%08X' into Data Set "
-                          "failed.", tag);
-            eheader_destroy(header);
-            dcm_dataset_destroy(dataset);
-            return NULL;
+        if (!result) {
+            stream->phase = STREAM_FAILED;
         }
-        eheader_destroy(header);
-
-        n_elem += 1;
+        // Continue with the next phase until more content is needed
+    } while (stream->phase != phase);
+
+    switch (stream->phase) {
+        case STREAM_FRAMES:
+            return DCM_STREAM_METADATA;
+        case STREAM_DONE:
+            return DCM_STREAM_COMPLETE;
+        case STREAM_FAILED:
+            return DCM_STREAM_ERROR;
+        default:
+            return DCM_STREAM_NEED_DATA;
     }
-    dcm_dataset_lock(dataset);
-    return dataset;
 }
 
 
-static bool get_num_frames(const DcmDataSet *metadata,
-                           uint32_t *number_of_frames)
+DcmStreamState dcm_stream_push(DcmStream *stream,
+                               const char *data,
+                               size_t length)
 {
-    const uint32_t tag = 0x00280008;
+    if (stream->phase == STREAM_FAILED) {
+        return DCM_STREAM_ERROR;
+    }
+    if (stream->is_finished) {
+        dcm_log_error("Pushing content to stream failed. "
+                      "Stream has been finished.");
+        return DCM_STREAM_ERROR;
+    }
 
-    DcmElement *element = dcm_dataset_get(metadata, tag);
-    if (element == NULL) {
-        dcm_log_error("Getting value of Data Element 'Number of Frames' "
-                      "failed. Could not find Data Element with Tag '%08X'.",
-                      tag);
-        return false;
+    struct StreamSource *source = stream->source;
+    stream_source_lock(source);
+    if (source->length + length > source->capacity) {
+        size_t capacity = source->capacity > 0 ? source->capacity : 65536;
+        while (capacity < source->length + length) {
+            capacity *= 2;
+        }
+        char *resized = dcm_heap_realloc(source->data, capacity);
+        if (resized == NULL) {
+            stream_source_unlock(source);
+            dcm_log_error("Pushing content to stream failed. "
+                          "Could not allocate memory.");
+            return DCM_STREAM_ERROR;
+        }
+        source->data = resized;
+        source->capacity = capacity;
+    }
+    if (length > 0) {
+        memcpy(source->data + source->length, data, length);
     }
+    source->length += length;
+    stream_source_unlock(source);
 
-    const char *value = dcm_element_get_value_IS(element, 0);
-    *number_of_frames = (uint32_t) strtol(value, NULL, 10);
+    return stream_advance(stream);
+}
 
-    return true;
+
+DcmStreamState dcm_stream_finish(DcmStream *stream)
+{
+    if (stream->phase == STREAM_FAILED) {
+        return DCM_STREAM_ERROR;
+    }
+    stream->is_finished = true;
+    return stream_advance(stream);
 }
 
 
-DcmBOT *dcm_file_read_bot(const DcmFile *file, const DcmDataSet *metadata)
+DcmDataSet *dcm_stream_get_file_meta(const DcmStream *stream)
 {
-    uint32_t tmp_value;
-    uint64_t value;
-    uint32_t i;
-    size_t tmp_offset;
+    return stream->file_meta;
+}
 
-    dcm_log_debug("Reading Basic Offset Table.");
 
-    if (!dcm_is_encapsulated_transfer_syntax(file->transfer_syntax_uid)) {
-        dcm_log_error("Reading Basic Offset Table failed. "
-                      "Data Set with transfer syntax '%s' shall not contain "
-                      "a Basic Offset Table because it is not encapsulated.",
-                      file->transfer_syntax_uid);
+DcmDataSet *dcm_stream_get_metadata(const DcmStream *stream)
+{
+    return stream->metadata;
+}
+
+
+uint32_t dcm_stream_get_num_frames(const DcmStream *stream)
+{
+    return atomic_load_explicit(&((DcmStream *) stream)->num_available,
+                                memory_order_acquire);
+}
+
+
+DcmFrame *dcm_stream_read_frame(const DcmStream *stream, uint32_t number)
+{
+    uint32_t num_available = dcm_stream_get_num_frames(stream);
+    if (number == 0 || number > num_available) {
+        dcm_log_error("Reading Frame of stream failed. "
+                      "Frame #%u has not arrived; Frames 1 to %u have.",
+                      number,
+                      num_available);
         return NULL;
     }
 
-    uint32_t num_frames;
-    if (!get_num_frames(metadata, &num_frames)) {
-        dcm_log_error("Reading Basic Offset Table failed. "
-                      "Could not get value of Data Element 'Number of Frames'.");
-        return NULL;
+    const DcmFile *file = stream->file;
+    dcm_trace_start("read_frame", file);
+    uint64_t start = get_microseconds();
+    DcmFrame *result = read_frame_at(file,
+                                     file->desc,
+                                     number,
+                                     stream->frame_offsets[number - 1],
+                                     stream->frame_lengths[number - 1]);
+    if (result) {
+        count_frame_read(file, start);
     }
-    if (num_frames == 0) {
-        dcm_log_error("Reading Basic Offset Table failed. "
-                      "Value of Data Element 'Number of Frames' is malformed.");
-        return NULL;
+    dcm_trace_end("read_frame", file);
+    return result;
+}
+
+
+DcmFile *dcm_stream_get_file(const DcmStream *stream)
+{
+    return stream->file;
+}
+
+
+void dcm_stream_destroy(DcmStream *stream)
+{
+    if (stream) {
+        dcm_dataset_destroy(stream->file_meta);
+        dcm_dataset_destroy(stream->metadata);
+        dcm_heap_free(stream->frame_offsets);
+        dcm_heap_free(stream->frame_lengths);
+        // Closes the source once Frame views no longer use the File
+        dcm_file_destroy(stream->file);
+        dcm_heap_free(stream);
     }
+}
 
-    if (file->pixel_data_offset == 0) {
-        dcm_log_error("Reading Basic Offset Table failed. "
-                      "Could not determine offset of Pixel Data Element. "
+
+bool dcm_file_read_frame_async(const DcmFile *file,
+                               const DcmBOT *bot,
+                               uint32_t number,
+                               DcmFrameCallback callback,
+                               void *user_data)
+{
+    size_t item_offset;
+
+    dcm_log_debug("Submit read of Frame Item #%d.", number);
+    if (file->desc == NULL) {
+        dcm_log_error("Reading Frame Item failed. "
+                      "Could not get image pixel description. "
                       "Read metadata first.");
-        return NULL;
+        return false;
     }
-    fseek(file->fp, file->pixel_data_offset, SEEK_SET);
 
-    EHeader *eheader = read_element_header(file->fp, &tmp_offset, false);
-    uint32_t eheader_tag = eheader_get_tag(eheader);
-    eheader_destroy(eheader);
-    if (!(eheader_tag == TAG_PIXEL_DATA ||
-          eheader_tag == TAG_FLOAT_PIXEL_DATA ||
-          eheader_tag == TAG_DOUBLE_PIXEL_DATA)) {
-        dcm_log_error("Reading Basic Offset Table failed. "
-                      "File pointer not positioned at Pixel Data Element.");
-        return NULL;
+    // Resolve the offset now, such that the BOT need not outlive the read
+    if (!get_frame_item_offset(file, bot, number, &item_offset)) {
+        return false;
     }
 
-    // The header of the BOT Item
-    IHeader *iheader = read_item_header(file->fp, &tmp_offset);
-    if (iheader == NULL) {
-        dcm_log_error("Reading Basic Offset Table failed. "
-                      "Could not read header of Basic Offset Table Item.");
-        iheader_destroy(iheader);
-        return NULL;
-    }
-    uint32_t item_tag = iheader_get_tag(iheader);
-    if (item_tag != TAG_ITEM) {
-        dcm_log_error("Reading Basic Offset Table failed. "
-                      "Unexpected Tag found for Basic Offset Table Item.");
-        iheader_destroy(iheader);
-        return NULL;
+    struct ReadTask *task = DCM_NEW(struct ReadTask);
+    if (task == NULL) {
+        dcm_log_error("Reading Frame Item failed. "
+                      "Could not allocate memory for read of "
+                      "Frame Item #%d.", number);
+        return false;
     }
+    task->run = run_frame_task;
+    task->file = (DcmFile *) file;
+    task->number = number;
+    task->item_offset = item_offset;
+    task->callback = callback;
+    task->user_data = user_data;
 
-    ssize_t *offsets = malloc(num_frames * sizeof(ssize_t *));
-    if (offsets == NULL) {
-        dcm_log_error("Reading Basic Offset Table failed. "
-                      "Could not allocate memory for values of "
-                      "Basic Offset Table.");
-        iheader_destroy(iheader);
+    // The task keeps the file alive until the read has completed
+    file_retain(file);
+    submit_read_task(task);
+
+    return true;
+}
+
+
+struct _DcmFrameRequest {
+    DcmFrame *frame;
+    atomic_bool done;
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+};
+
+
+static void complete_frame_request(DcmFrame *frame, void *user_data)
+{
+    DcmFrameRequest *request = (DcmFrameRequest *) user_data;
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&request->mutex);
+#endif
+    request->frame = frame;
+    atomic_store(&request->done, true);
+#ifdef HAVE_PTHREAD_H
+    pthread_cond_signal(&request->cond);
+    pthread_mutex_unlock(&request->mutex);
+#endif
+}
+
+
+DcmFrameRequest *dcm_file_submit_frame(const DcmFile *file,
+                                       const DcmBOT *bot,
+                                       uint32_t number)
+{
+    DcmFrameRequest *request = DCM_NEW(DcmFrameRequest);
+    if (request == NULL) {
+        dcm_log_error("Reading Frame Item failed. "
+                      "Could not allocate memory for read of "
+                      "Frame Item #%d.", number);
         return NULL;
     }
-
-    // The BOT Item must be present, but the value is optional
-    uint32_t item_length = iheader_get_length(iheader);
-    iheader_destroy(iheader);
-    if (item_length > 0) {
-        dcm_log_info("Read Basic Offset Table value.");
-        // Read offset values from BOT Item value
-        for (i = 0; i < num_frames; i++) {
-            tmp_offset += fread(&tmp_value, 1, sizeof(tmp_value), file->fp);
-            value = (uint64_t) tmp_value;
-            if (value == TAG_ITEM) {
-                dcm_log_error("Reading Basic Offset Table failed. "
-                              "Encountered unexpected Item Tag "
-                              "in Basic Offset Table.");
-                free(offsets);
-                return NULL;
-            }
-            offsets[i] = value;
-        }
-    } else {
-        dcm_log_info("Basic Offset Table is emtpy.");
-        // Handle Extended Offset Table attribute
-        const DcmElement *eot_element = dcm_dataset_get(metadata, 0x7FE00001);
-        if (eot_element) {
-            dcm_log_info("Found Extended Offset Table.");
-            const char *blob = dcm_element_get_value_OV(eot_element);
-            char *end_ptr;
-            for (i = 0; i < num_frames; i++) {
-                value = (uint64_t) strtoull(blob, &end_ptr, 64);
-                // strtoull returns 0 in case of error
-                if (value == 0 && i > 0) {
-                    dcm_log_error("Reading Basic Offset Table failed. "
-                                  "Failed to parse value of Extended Offset "
-                                  "Table element for frame #%d.", i + 1);
-                    free(offsets);
-                    iheader_destroy(iheader);
-                    return NULL;
-                }
-                offsets[i] = value;
-            }
-        }
+    request->frame = NULL;
+    atomic_init(&request->done, false);
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_init(&request->mutex, NULL);
+    pthread_cond_init(&request->cond, NULL);
+#endif
+
+    if (!dcm_file_read_frame_async(file,
+                                   bot,
+                                   number,
+                                   complete_frame_request,
+                                   request)) {
+#ifdef HAVE_PTHREAD_H
+        pthread_cond_destroy(&request->cond);
+        pthread_mutex_destroy(&request->mutex);
+#endif
+        dcm_heap_free(request);
         return NULL;
     }
 
-    return dcm_bot_create(offsets, num_frames);
+    return request;
 }
 
 
-static struct PixelDescription *create_pixel_description(const DcmDataSet *metadata)
+bool dcm_frame_request_is_done(const DcmFrameRequest *request)
 {
-    DcmElement *element;
+    assert(request);
+    return atomic_load(&((DcmFrameRequest *) request)->done);
+}
 
-    struct PixelDescription *desc = malloc(sizeof(struct PixelDescription));
-    if (desc == NULL) {
-        dcm_log_error("Getting image pixel description failed. "
-                      "Could not allocate memory.");
-        return NULL;
-    }
 
-    element = dcm_dataset_get(metadata, 0x00280010);
-    if (element == NULL) {
-        dcm_log_error("Getting image pixel description failed. "
-                      "Could not get Data Element 'Rows'.");
-        free(desc);
-        return NULL;
+DcmFrame *dcm_frame_request_wait(DcmFrameRequest *request)
+{
+    assert(request);
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&request->mutex);
+    while (!atomic_load(&request->done)) {
+        pthread_cond_wait(&request->cond, &request->mutex);
     }
-    desc->rows = dcm_element_get_value_US(element, 0);
+    pthread_mutex_unlock(&request->mutex);
+    pthread_cond_destroy(&request->cond);
+    pthread_mutex_destroy(&request->mutex);
+#endif
+    DcmFrame *frame = request->frame;
+    dcm_heap_free(request);
+    return frame;
+}
 
-    element = dcm_dataset_get(metadata, 0x00280011);
-    if (element == NULL) {
-        dcm_log_error("Getting image pixel description failed. "
-                      "Could not get Data Element 'Columns'.");
-        free(desc);
-        return NULL;
-    }
-    desc->columns = dcm_element_get_value_US(element, 0);
 
-    element = dcm_dataset_get(metadata, 0x00280002);
-    if (element == NULL) {
-        dcm_log_error("Getting image pixel description failed. "
-                      "Could not get Data Element 'Samples per Pixel'.");
-        free(desc);
-        return NULL;
+/**
+ * Frame held by a Frame Cache.
+ */
+struct CacheEntry {
+    // File identifier in the upper and Frame number in the lower half
+    uint64_t key;
+    DcmFrame *frame;
+    size_t size;
+    // Held by the cache while the entry is cached and by each Frame view
+    atomic_uint refcount;
+    // Neighbours in the order of use, most recently used first
+    struct CacheEntry *prev;
+    struct CacheEntry *next;
+    UT_hash_handle hh;
+};
+
+
+struct _DcmFrameCache {
+    size_t max_bytes;
+    size_t num_bytes;
+    struct CacheEntry *entries;
+    struct CacheEntry *head;
+    struct CacheEntry *tail;
+    uint64_t num_hits;
+    uint64_t num_misses;
+    uint64_t num_evictions;
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_t mutex;
+#endif
+};
+
+
+static void cache_lock(DcmFrameCache *cache)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&cache->mutex);
+#else
+    (void) cache;
+#endif
+}
+
+
+static void cache_unlock(DcmFrameCache *cache)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_unlock(&cache->mutex);
+#else
+    (void) cache;
+#endif
+}
+
+
+static void cache_entry_release(void *owner)
+{
+    struct CacheEntry *entry = (struct CacheEntry *) owner;
+    if (atomic_fetch_sub(&entry->refcount, 1) == 1) {
+        dcm_frame_destroy(entry->frame);
+        dcm_heap_free(entry);
     }
-    desc->samples_per_pixel = dcm_element_get_value_US(element, 0);
+}
 
-    element = dcm_dataset_get(metadata, 0x00280100);
-    if (element == NULL) {
-        dcm_log_error("Getting image pixel description failed. "
-                      "Could not get Data Element 'Bits Allocated'.");
-        free(desc);
-        return NULL;
+
+static void cache_unlink(DcmFrameCache *cache, struct CacheEntry *entry)
+{
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->head = entry->next;
     }
-    desc->bits_allocated = dcm_element_get_value_US(element, 0);
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = NULL;
+}
 
-    element = dcm_dataset_get(metadata, 0x00280101);
-    if (element == NULL) {
-        dcm_log_error("Getting image pixel description failed. "
-                      "Could not get Data Element 'Bits Stored'.");
-        free(desc);
-        return NULL;
+
+static void cache_push_front(DcmFrameCache *cache, struct CacheEntry *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head) {
+        cache->head->prev = entry;
+    } else {
+        cache->tail = entry;
     }
-    desc->bits_stored = dcm_element_get_value_US(element, 0);
+    cache->head = entry;
+}
 
-    element = dcm_dataset_get(metadata, 0x00280103);
-    if (element == NULL) {
-        dcm_log_error("Getting image pixel description failed. "
-                      "Could not get Data Element 'Pixel Representation'.");
-        free(desc);
+
+static void cache_remove(DcmFrameCache *cache, struct CacheEntry *entry)
+{
+    HASH_DEL(cache->entries, entry);
+    cache_unlink(cache, entry);
+    cache->num_bytes -= entry->size;
+    // Frames that are still in use remain valid
+    cache_entry_release(entry);
+}
+
+
+DcmFrameCache *dcm_frame_cache_create(size_t max_bytes)
+{
+    DcmFrameCache *cache = DCM_NEW(DcmFrameCache);
+    if (cache == NULL) {
+        dcm_log_error("Creation of Frame Cache failed. "
+                      "Could not allocate memory.");
         return NULL;
     }
-    desc->pixel_representation = dcm_element_get_value_US(element, 0);
+    cache->max_bytes = max_bytes;
+    cache->num_bytes = 0;
+    cache->entries = NULL;
+    cache->head = NULL;
+    cache->tail = NULL;
+    cache->num_hits = 0;
+    cache->num_misses = 0;
+    cache->num_evictions = 0;
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_init(&cache->mutex, NULL);
+#endif
+    return cache;
+}
 
-    element = dcm_dataset_get(metadata, 0x00280006);
-    if (element == NULL) {
-        dcm_log_error("Getting image pixel description failed. "
-                      "Could not get Data Element 'Planar Configuration'.");
-        free(desc);
-        return NULL;
+
+/**
+ * Create a Frame that refers to the Frame of a cache entry.
+ *
+ * Takes over a reference to the entry.
+ */
+static DcmFrame *create_cached_frame(struct CacheEntry *entry)
+{
+    const DcmFrame *frame = entry->frame;
+    const char *photometric_interpretation =
+        dcm_frame_get_photometric_interpretation(frame);
+    return dcm_frame_create_view(dcm_frame_get_number(frame),
+                                 dcm_frame_get_value(frame),
+                                 dcm_frame_get_length(frame),
+                                 dcm_frame_get_rows(frame),
+                                 dcm_frame_get_columns(frame),
+                                 dcm_frame_get_samples_per_pixel(frame),
+                                 dcm_frame_get_bits_allocated(frame),
+                                 dcm_frame_get_bits_stored(frame),
+                                 dcm_frame_get_pixel_representation(frame),
+                                 dcm_frame_get_planar_configuration(frame),
+                                 photometric_interpretation,
+                                 dcm_frame_get_transfer_syntax_uid(frame),
+                                 entry,
+                                 cache_entry_release);
+}
+
+
+DcmFrame *dcm_frame_cache_read_frame(DcmFrameCache *cache,
+                                     const DcmFile *file,
+                                     const DcmDataSet *metadata,
+                                     const DcmBOT *bot,
+                                     uint32_t number)
+{
+    struct CacheEntry *entry;
+    struct CacheEntry *existing;
+
+    assert(cache);
+    assert(file);
+    uint64_t key = ((uint64_t) file->id << 32) | number;
+
+    cache_lock(cache);
+    HASH_FIND(hh, cache->entries, &key, sizeof(key), entry);
+    if (entry) {
+        cache->num_hits += 1;
+        cache_unlink(cache, entry);
+        cache_push_front(cache, entry);
+        atomic_fetch_add(&entry->refcount, 1);
+        cache_unlock(cache);
+        return create_cached_frame(entry);
     }
-    desc->planar_configuration = dcm_element_get_value_US(element, 0);
+    cache->num_misses += 1;
+    cache_unlock(cache);
 
-    element = dcm_dataset_get(metadata, 0x00280004);
-    if (element == NULL) {
-        dcm_log_error("Getting image pixel description failed. "
-                      "Could not get Data Element 'Photometric Interpretation'.");
-        free(desc);
+    // Read without holding the lock, such that other Frames can be served
+    DcmFrame *frame = dcm_file_read_frame(file, metadata, bot, number);
+    if (frame == NULL) {
         return NULL;
     }
-    const char *photometric_interpretation = dcm_element_get_value_CS(element, 0);
-    desc->photometric_interpretation = strdup(photometric_interpretation);
-    if (desc->photometric_interpretation == NULL) {
-        dcm_log_error("Getting image pixel description failed. "
-                      "Could not allocate memory for value of "
-                      "Data Element 'Photometric Interpretation'.");
-        free(desc);
-        return NULL;
+    size_t size = sizeof(struct CacheEntry) + dcm_frame_get_length(frame);
+    if (size > cache->max_bytes) {
+        return frame;
+    }
+    entry = DCM_NEW(struct CacheEntry);
+    if (entry == NULL) {
+        return frame;
     }
+    entry->key = key;
+    entry->frame = frame;
+    entry->size = size;
+    atomic_init(&entry->refcount, 1);
+
+    cache_lock(cache);
+    HASH_FIND(hh, cache->entries, &key, sizeof(key), existing);
+    if (existing) {
+        // Another thread has read the same Frame in the meantime
+        cache_entry_release(entry);
+        entry = existing;
+    } else {
+        HASH_ADD(hh, cache->entries, key, sizeof(key), entry);
+        cache_push_front(cache, entry);
+        cache->num_bytes += size;
+        while (cache->num_bytes > cache->max_bytes && cache->tail != entry) {
+            cache->num_evictions += 1;
+            cache_remove(cache, cache->tail);
+        }
+    }
+    atomic_fetch_add(&entry->refcount, 1);
+    cache_unlock(cache);
 
-    return desc;
+    return create_cached_frame(entry);
 }
 
 
-static void destroy_pixel_description(struct PixelDescription *desc)
+void dcm_frame_cache_get_stats(DcmFrameCache *cache, DcmFrameCacheStats *stats)
 {
-    if (desc) {
-        if (desc->photometric_interpretation) {
-            free(desc->photometric_interpretation);
-        }
-        free(desc);
-    }
+    assert(cache);
+    assert(stats);
+
+    cache_lock(cache);
+    stats->num_hits = cache->num_hits;
+    stats->num_misses = cache->num_misses;
+    stats->num_evictions = cache->num_evictions;
+    stats->num_frames = HASH_COUNT(cache->entries);
+    stats->num_bytes = cache->num_bytes;
+    cache_unlock(cache);
 }
 
 
-DcmBOT *dcm_file_build_bot(const DcmFile *file, const DcmDataSet *metadata)
+void dcm_frame_cache_destroy(DcmFrameCache *cache)
 {
-    uint32_t item_tag, iheader_tag;
-    uint32_t item_length;
-    uint64_t i;
-    size_t current_offset, tmp_offset;
-    IHeader *iheader;
+    if (cache) {
+        while (cache->head) {
+            cache_remove(cache, cache->head);
+        }
+#ifdef HAVE_PTHREAD_H
+        pthread_mutex_destroy(&cache->mutex);
+#endif
+        dcm_heap_free(cache);
+    }
+}
 
-    dcm_log_debug("Building Basic Offset Table.");
 
+/**
+ * State of a file that is being written.
+ */
+struct FileWriter {
+    FILE *fp;
+    // Number of bytes written to the file so far
+    uint64_t position;
+    bool implicit;
+    bool is_encapsulated;
+    bool use_extended_offset_table;
+    bool has_pixel_data;
+    bool is_finished;
     uint32_t num_frames;
-    if (!get_num_frames(metadata, &num_frames)) {
-        dcm_log_error("Building Basic Offset Table failed. "
-                      "Could not get value of Data Element 'Number of Frames'.");
-        return NULL;
+    uint32_t num_frames_written;
+    // Length of each Frame of native Pixel Data
+    uint64_t frame_length;
+    // Offsets and lengths of the Frame Items of encapsulated Pixel Data
+    uint64_t *offsets;
+    uint64_t *lengths;
+    // Position of the offset table, which is filled in when finishing
+    uint64_t table_position;
+    uint64_t lengths_position;
+    uint64_t first_item_position;
+    // Encoding of the Data Elements that follow the Pixel Data
+    char *trailer;
+    size_t trailer_length;
+    size_t trailer_capacity;
+};
+
+
+static void writer_destroy(struct FileWriter *writer)
+{
+    if (writer) {
+        dcm_heap_free(writer->offsets);
+        dcm_heap_free(writer->lengths);
+        dcm_heap_free(writer->trailer);
+        dcm_heap_free(writer);
     }
-    if (num_frames == 0) {
-        dcm_log_error("Building Basic Offset Table failed. "
-                      "Value of Data Element 'Number of Frames' is malformed.");
-        return NULL;
+}
+
+
+static bool write_to_file(void *data, const char *buffer, size_t length)
+{
+    struct FileWriter *writer = (struct FileWriter *) data;
+    if (length > 0 && fwrite(buffer, 1, length, writer->fp) != length) {
+        dcm_log_error("Writing of file failed. %s", strerror(errno));
+        return false;
     }
+    writer->position += length;
+    return true;
+}
 
-    if (file->pixel_data_offset == 0) {
-        dcm_log_error("Reading Basic Offset Table failed. "
-                      "Could not determine offset of Pixel Data Element. "
-                      "Read metadata first.");
-        return NULL;
+
+static bool write_to_trailer(void *data, const char *buffer, size_t length)
+{
+    struct FileWriter *writer = (struct FileWriter *) data;
+    if (writer->trailer_length + length > writer->trailer_capacity) {
+        size_t capacity = writer->trailer_capacity * 2;
+        if (capacity < writer->trailer_length + length) {
+            capacity = writer->trailer_length + length + 256;
+        }
+        char *trailer = dcm_heap_realloc(writer->trailer, capacity);
+        if (trailer == NULL) {
+            dcm_log_error("Writing of file failed. "
+                          "Could not allocate memory for Data Elements.");
+            return false;
+        }
+        writer->trailer = trailer;
+        writer->trailer_capacity = capacity;
     }
-    fseek(file->fp, file->pixel_data_offset, SEEK_SET);
+    memcpy(writer->trailer + writer->trailer_length, buffer, length);
+    writer->trailer_length += length;
+    return true;
+}
 
-    EHeader *eheader = read_element_header(file->fp, &tmp_offset, false);
-    uint32_t eheader_tag = eheader_get_tag(eheader);
-    eheader_destroy(eheader);
-    if (!(eheader_tag == TAG_PIXEL_DATA ||
-          eheader_tag == TAG_FLOAT_PIXEL_DATA ||
-          eheader_tag == TAG_DOUBLE_PIXEL_DATA)) {
-        dcm_log_error("Building Basic Offset Table failed. "
-                      "File pointer not positioned at Pixel Data Element.");
-        return NULL;
+
+static bool count_bytes(void *data, const char *buffer, size_t length)
+{
+    (void) buffer;
+    *((uint64_t *) data) += length;
+    return true;
+}
+
+
+static bool write_file_meta(struct FileWriter *writer,
+                            const DcmDataSet *file_meta)
+{
+    char preamble[132];
+    memset(preamble, 0, 128);
+    memcpy(preamble + 128, "DICM", 4);
+    if (!write_to_file(writer, preamble, sizeof(preamble))) {
+        return false;
     }
 
-    ssize_t *offsets = malloc(num_frames * sizeof(ssize_t *));
-    if (offsets == NULL) {
-        dcm_log_error("Building Basic Offset Table failed. "
-                      "Could not allocate memory for values of "
-                      "Basic Offset Table.");
-        return NULL;
+    // File Meta Information is always encoded with explicit Value
+    // Representation and is preceded by its length. The File Meta
+    // Information Version is skipped when reading and is written here
+    // unless it is given.
+    const char version[14] = {
+        0x02, 0x00, 0x01, 0x00, 'O', 'B', 0x00, 0x00,
+        0x02, 0x00, 0x00, 0x00, 0x00, 0x01
+    };
+    bool has_version = dcm_dataset_contains(file_meta, 0x00020001);
+    uint64_t group_length = has_version ? 0 : sizeof(version);
+    if (!dcm_dataset_encode(file_meta, false, 0x00020001, 0x0002FFFF,
+                            count_bytes, &group_length)) {
+        return false;
+    }
+    if (group_length > UINT32_MAX) {
+        dcm_log_error("Writing of File Meta Information failed. "
+                      "Content is too long.");
+        return false;
     }
+    char value[4];
+    encode_uint32(value, (uint32_t) group_length);
+    return dcm_element_encode_header(0x00020000, "UL", 4, false,
+                                     write_to_file, writer) &&
+           write_to_file(writer, value, sizeof(value)) &&
+           (has_version ||
+            write_to_file(writer, version, sizeof(version))) &&
+           dcm_dataset_encode(file_meta, false, 0x00020001, 0x0002FFFF,
+                              write_to_file, writer);
+}
 
-    if (dcm_is_encapsulated_transfer_syntax(file->transfer_syntax_uid)) {
-        // The header of the BOT Item
-        iheader = read_item_header(file->fp, &tmp_offset);
-        if (iheader == NULL) {
-            dcm_log_error("Building Basic Offset Table failed. "
-                          "Could not read header of Basic Offset Table Item.");
-            free(offsets);
-            iheader_destroy(iheader);
-            return NULL;
-        }
-        item_tag = iheader_get_tag(iheader);
-        if (item_tag != TAG_ITEM) {
-            dcm_log_error("Building Basic Offset Table failed. "
-                          "Unexpected Tag found for Basic Offset Table Item.");
-            free(offsets);
-            iheader_destroy(iheader);
-            return NULL;
+
+/**
+ * Write zeros in place of an offset table, which is filled in at the end.
+ */
+static bool write_zeros(struct FileWriter *writer, uint64_t length)
+{
+    char zeros[512];
+    memset(zeros, 0, sizeof(zeros));
+    while (length > 0) {
+        size_t n = length < sizeof(zeros) ? (size_t) length : sizeof(zeros);
+        if (!write_to_file(writer, zeros, n)) {
+            return false;
         }
+        length -= n;
+    }
+    return true;
+}
 
-        // The BOT Item must be present, but the value is optional
-        item_length = iheader_get_length(iheader);
-        iheader_destroy(iheader);
-        // Move filepointer to first byte of first Frame item
-        fseek(file->fp, item_length, SEEK_SET);
-        i = 0;
-        while (true) {
-            iheader = read_item_header(file->fp, &current_offset);
-            if (iheader == NULL) {
-                dcm_log_error("Building Basic Offset Table failed. "
-                              "Could not read header of Frame Item #%d.",
-                              i + 1);
-            }
-            iheader_tag = iheader_get_tag(iheader);
-            if (iheader_tag == TAG_SQ_DELIM) {
-                break;
-            }
-            if (iheader_tag != TAG_ITEM) {
-                dcm_log_error("Building Basic Offset Table failed. "
-                              "Frame Item #%d has wrong Tag '%08X'.",
-                              i + 1,
-                              iheader_tag);
-                free(offsets);
-                iheader_destroy(iheader);
-                return NULL;
-            }
-            if (feof(file->fp)) {
-                break;
-            }
-            offsets[i] = current_offset;
 
-            item_length = iheader_get_length(iheader);
-            fseek(file->fp, item_length, SEEK_CUR);
-            iheader_destroy(iheader);
-            i += 1;
+static bool write_pixel_data_header(struct FileWriter *writer,
+                                    const DcmDataSet *metadata)
+{
+    uint32_t rows, columns, samples_per_pixel, bits_allocated;
+    if (!get_dimension(metadata, 0x00280010, &rows) ||
+        !get_dimension(metadata, 0x00280011, &columns) ||
+        !get_dimension(metadata, 0x00280002, &samples_per_pixel) ||
+        !get_dimension(metadata, 0x00280100, &bits_allocated)) {
+        return false;
+    }
+    writer->num_frames = 1;
+    if (dcm_dataset_contains(metadata, 0x00280008) &&
+        !get_num_frames(metadata, &writer->num_frames)) {
+        return false;
+    }
+    if (writer->num_frames == 0) {
+        dcm_log_error("Writing of Pixel Data failed. "
+                      "Data Set contains no Frames.");
+        return false;
+    }
+
+    if (!writer->is_encapsulated) {
+        uint64_t num_bits = (uint64_t) rows * columns *
+                            samples_per_pixel * bits_allocated;
+        writer->frame_length = (num_bits + 7) / 8;
+        uint64_t length = writer->frame_length * writer->num_frames;
+        length += length % 2;
+        if (length >= 0xFFFFFFFF) {
+            dcm_log_error("Writing of Pixel Data failed. "
+                          "Native Pixel Data of %" PRIu64 " bytes is too "
+                          "long.", length);
+            return false;
         }
+        const char *vr = bits_allocated > 8 ? "OW" : "OB";
+        return dcm_element_encode_header(TAG_PIXEL_DATA,
+                                         vr,
+                                         (uint32_t) length,
+                                         writer->implicit,
+                                         write_to_file,
+                                         writer);
+    }
 
-        if (i != num_frames) {
-            dcm_log_error("Building Basic Offset Table failed. "
-                          "Found incorrect number of Frame Items.");
-            free(offsets);
-            return NULL;
+    writer->offsets = dcm_calloc(writer->num_frames, sizeof(uint64_t));
+    writer->lengths = dcm_calloc(writer->num_frames, sizeof(uint64_t));
+    if (writer->offsets == NULL || writer->lengths == NULL) {
+        dcm_log_error("Writing of Pixel Data failed. "
+                      "Could not allocate memory for offset table.");
+        return false;
+    }
+
+    uint64_t table_length = (uint64_t) writer->num_frames * 8;
+    if (table_length > UINT32_MAX) {
+        dcm_log_error("Writing of Pixel Data failed. "
+                      "Offset table of %u Frames is too long.",
+                      writer->num_frames);
+        return false;
+    }
+    if (writer->use_extended_offset_table) {
+        // The Basic Offset Table stays empty and the Extended Offset Table
+        // and its lengths are reserved before the Pixel Data
+        if (!dcm_element_encode_header(TAG_EXTENDED_OFFSET_TABLE, "OV",
+                                       (uint32_t) table_length,
+                                       writer->implicit,
+                                       write_to_file, writer)) {
+            return false;
+        }
+        writer->table_position = writer->position;
+        if (!write_zeros(writer, table_length) ||
+            !dcm_element_encode_header(TAG_EXTENDED_OFFSET_TABLE_LENGTHS,
+                                       "OV",
+                                       (uint32_t) table_length,
+                                       writer->implicit,
+                                       write_to_file, writer)) {
+            return false;
+        }
+        writer->lengths_position = writer->position;
+        if (!write_zeros(writer, table_length) ||
+            !dcm_element_encode_header(TAG_PIXEL_DATA, "OB", 0xFFFFFFFF,
+                                       writer->implicit,
+                                       write_to_file, writer) ||
+            !dcm_element_encode_header(TAG_ITEM, NULL, 0, true,
+                                       write_to_file, writer)) {
+            return false;
         }
     } else {
-        struct PixelDescription *desc = create_pixel_description(metadata);
-        if (desc == NULL) {
-            dcm_log_error("Building Basic Offset Table failed. "
-                          "Could not get image pixel description.");
+        uint32_t bot_length = writer->num_frames * 4;
+        if (!dcm_element_encode_header(TAG_PIXEL_DATA, "OB", 0xFFFFFFFF,
+                                       writer->implicit,
+                                       write_to_file, writer) ||
+            !dcm_element_encode_header(TAG_ITEM, NULL, bot_length, true,
+                                       write_to_file, writer)) {
+            return false;
         }
-        for (i = 0; i < num_frames; i++) {
-            offsets[i] = i * desc->rows * desc->columns * desc->samples_per_pixel;
+        writer->table_position = writer->position;
+        if (!write_zeros(writer, bot_length)) {
+            return false;
         }
-        destroy_pixel_description(desc);
     }
-
-    return dcm_bot_create(offsets, num_frames);
+    writer->first_item_position = writer->position;
+    return true;
 }
 
 
-DcmFrame *dcm_file_read_frame(const DcmFile *file,
-                              const DcmDataSet *metadata,
-                              const DcmBOT *bot,
-                              uint32_t number)
+bool dcm_file_write_metadata(DcmFile *file,
+                             const DcmDataSet *file_meta,
+                             const DcmDataSet *metadata,
+                             bool use_extended_offset_table)
 {
-    ssize_t first_frame_offset, total_frame_offset;
-    uint32_t length;
-    size_t current_offset = 0;
-    size_t *n = &current_offset;
+    assert(file);
+    assert(file_meta);
+    assert(metadata);
 
-    dcm_log_debug("Read Frame Item #%d.", number);
-    if (number == 0) {
-        dcm_log_error("Reading Frame Item failed. "
-                      "Frame Number must be positive.");
-        return NULL;
+    if (!file->is_writable) {
+        dcm_log_error("Writing of file failed. "
+                      "File was not opened for writing.");
+        return false;
+    }
+    if (file->writer) {
+        dcm_log_error("Writing of file failed. "
+                      "Metadata has already been written.");
+        return false;
     }
-    ssize_t frame_offset = dcm_bot_get_frame_offset(bot, number);
-    uint32_t num_frames = dcm_bot_get_num_frames(bot);
-    if (dcm_is_encapsulated_transfer_syntax(file->transfer_syntax_uid)) {
-        // Header of Pixel Data Element and Basic Offset Table
-        first_frame_offset = 12 + 8 + 4 * num_frames;
-    } else {
-        // Header of Pixel Data Element
-        first_frame_offset = 10;
 
+    DcmElement *element = dcm_dataset_get(file_meta, 0x00020010);
+    if (element == NULL) {
+        dcm_log_error("Writing of file failed. "
+                      "File Meta Information lacks Transfer Syntax UID.");
+        return false;
+    }
+    const char *transfer_syntax_uid = dcm_element_get_value_UI(element, 0);
+    if (strcmp(transfer_syntax_uid, "1.2.840.10008.1.2.2") == 0) {
+        dcm_log_error("Writing of file failed. "
+                      "Explicit VR Big Endian Transfer Syntax is not "
+                      "supported.");
+        return false;
     }
 
-    total_frame_offset = (file->pixel_data_offset +
-                          first_frame_offset +
-                          frame_offset);
-    fseek(file->fp, total_frame_offset, SEEK_SET);
+    struct FileWriter *writer = DCM_NEW(struct FileWriter);
+    if (writer == NULL) {
+        dcm_log_error("Writing of file failed. "
+                      "Could not allocate memory.");
+        return false;
+    }
+    file->writer = writer;
+    writer->fp = ((struct StdioHandle *) file->io_handle)->fp;
+    writer->implicit = strcmp(transfer_syntax_uid, "1.2.840.10008.1.2") == 0;
+    writer->is_encapsulated =
+        dcm_is_encapsulated_transfer_syntax(transfer_syntax_uid);
+    writer->use_extended_offset_table = use_extended_offset_table;
+    writer->has_pixel_data = dcm_dataset_contains(metadata, 0x00280010);
+
+    // Data Elements that follow the Pixel Data are encoded now, so that
+    // the Data Set need not be kept until the last Frame is written
+    if (!write_file_meta(writer, file_meta) ||
+        !dcm_dataset_encode(metadata, writer->implicit,
+                            0x00030000, 0x7FE00000,
+                            write_to_file, writer) ||
+        !dcm_dataset_encode(metadata, writer->implicit,
+                            0x7FE00011, 0xFFFBFFFF,
+                            write_to_trailer, writer)) {
+        return false;
+    }
 
-    struct PixelDescription *desc = create_pixel_description(metadata);
-    if (desc == NULL) {
-        dcm_log_error("Reading Frame Item failed. "
-                      "Could not get image pixel description.");
-        return NULL;
+    if (writer->has_pixel_data) {
+        return write_pixel_data_header(writer, metadata);
     }
+    return true;
+}
 
-    if (dcm_is_encapsulated_transfer_syntax(file->transfer_syntax_uid)) {
-        IHeader *iheader = read_item_header(file->fp, n);
-        if (iheader == NULL) {
-            dcm_log_error("Reading Frame Item failed. "
-                          "Could not read header of Frame Item #%d.",
-                          number);
-            destroy_pixel_description(desc);
-            return NULL;
+
+bool dcm_file_write_frame(DcmFile *file, const char *value, uint32_t length)
+{
+    assert(file);
+    assert(value);
+    struct FileWriter *writer = file->writer;
+
+    if (writer == NULL || !writer->has_pixel_data || writer->is_finished) {
+        dcm_log_error("Writing of Frame failed. "
+                      "File is not ready for Frames.");
+        return false;
+    }
+    if (writer->num_frames_written == writer->num_frames) {
+        dcm_log_error("Writing of Frame failed. "
+                      "All %u Frames have been written.",
+                      writer->num_frames);
+        return false;
+    }
+
+    if (!writer->is_encapsulated) {
+        if (length != writer->frame_length) {
+            dcm_log_error("Writing of Frame #%u failed. "
+                          "Frame has %u bytes instead of %" PRIu64 ".",
+                          writer->num_frames_written + 1,
+                          length,
+                          writer->frame_length);
+            return false;
         }
-        uint32_t iheader_tag = iheader_get_tag(iheader);
-        if (iheader_tag != TAG_ITEM) {
-            dcm_log_error("Reading Frame Item failed. "
-                          "No Item Tag found for Frame Item #%d.",
-                          number);
-            destroy_pixel_description(desc);
-            iheader_destroy(iheader);
-            return NULL;
+        if (!write_to_file(writer, value, length)) {
+            return false;
         }
-        length = iheader_get_length(iheader);
-        iheader_destroy(iheader);
-    } else {
-        length = desc->rows * desc->columns * desc->samples_per_pixel;
+        writer->num_frames_written += 1;
+        return true;
     }
 
-    char *value = malloc(length);
-    if (value == NULL) {
-        dcm_log_error("Reading Frame Item failed. "
-                      "Could not allocate memory for Frame Item #%d.",
-                      number);
-        return NULL;
+    // Each Frame is encapsulated in a single Item
+    if (length == UINT32_MAX) {
+        dcm_log_error("Writing of Frame #%u failed. "
+                      "Frame is too long.",
+                      writer->num_frames_written + 1);
+        return false;
+    }
+    uint32_t padding = length % 2;
+    uint32_t i = writer->num_frames_written;
+    writer->offsets[i] = writer->position - writer->first_item_position;
+    writer->lengths[i] = length;
+    if (!dcm_element_encode_header(TAG_ITEM, NULL, length + padding, true,
+                                   write_to_file, writer) ||
+        !write_to_file(writer, value, length) ||
+        (padding > 0 && !write_to_file(writer, "", 1))) {
+        return false;
     }
-    *n += fread(value, 1, length, file->fp);
+    writer->num_frames_written += 1;
+    return true;
+}
 
-    char *transfer_syntax_uid = strdup(file->transfer_syntax_uid);
-    if (transfer_syntax_uid == NULL) {
-        dcm_log_error("Reading Frame Item failed. "
-                      "Could not allocate memory for Frame item #%d.",
-                      number);
-        return NULL;
+
+/**
+ * Overwrite the reserved offset table once all Frames have been written.
+ */
+static bool write_offset_table(struct FileWriter *writer)
+{
+    uint32_t i;
+    uint64_t end = writer->position;
+    size_t size = writer->use_extended_offset_table ? 8 : 4;
+
+    char *table = dcm_heap_malloc(writer->num_frames * size);
+    if (table == NULL) {
+        dcm_log_error("Writing of offset table failed. "
+                      "Could not allocate memory.");
+        return false;
+    }
+    for (i = 0; i < writer->num_frames; i++) {
+        if (writer->use_extended_offset_table) {
+            encode_uint64(table + i * size, writer->offsets[i]);
+        } else if (writer->offsets[i] > UINT32_MAX) {
+            dcm_log_error("Writing of Basic Offset Table failed. "
+                          "Offset of Frame #%u exceeds 32 bits, which "
+                          "requires an Extended Offset Table.",
+                          i + 1);
+            dcm_heap_free(table);
+            return false;
+        } else {
+            encode_uint32(table + i * size, (uint32_t) writer->offsets[i]);
+        }
     }
 
-    char *photometric_interpretation = strdup(desc->photometric_interpretation);
-    if (photometric_interpretation == NULL) {
-        dcm_log_error("Reading Frame Item failed. "
-                      "Could not allocate memory for Frame item #%d.",
-                      number);
-        free(transfer_syntax_uid);
-        destroy_pixel_description(desc);
-        return NULL;
+    bool result = stdio_seek(writer->fp, (int64_t) writer->table_position) &&
+                  fwrite(table, size, writer->num_frames, writer->fp) ==
+                  writer->num_frames;
+    if (result && writer->use_extended_offset_table) {
+        for (i = 0; i < writer->num_frames; i++) {
+            encode_uint64(table + i * size, writer->lengths[i]);
+        }
+        result = stdio_seek(writer->fp,
+                            (int64_t) writer->lengths_position) &&
+                 fwrite(table, size, writer->num_frames, writer->fp) ==
+                 writer->num_frames;
+    }
+    dcm_heap_free(table);
+    if (!result || !stdio_seek(writer->fp, (int64_t) end)) {
+        dcm_log_error("Writing of offset table failed. %s",
+                      strerror(errno));
+        return false;
     }
+    return true;
+}
 
-    DcmFrame *frame = dcm_frame_create(number,
-                                       value,
-                                       length,
-                                       desc->rows,
-                                       desc->columns,
-                                       desc->samples_per_pixel,
-                                       desc->bits_allocated,
-                                       desc->bits_stored,
-                                       desc->pixel_representation,
-                                       desc->planar_configuration,
-                                       photometric_interpretation,
-                                       transfer_syntax_uid);
-    destroy_pixel_description(desc);
 
-    return frame;
+bool dcm_file_finish_write(DcmFile *file)
+{
+    assert(file);
+    struct FileWriter *writer = file->writer;
+
+    if (writer == NULL || writer->is_finished) {
+        dcm_log_error("Finishing write of file failed. "
+                      "Metadata has not been written.");
+        return false;
+    }
+    if (writer->has_pixel_data &&
+        writer->num_frames_written != writer->num_frames) {
+        dcm_log_error("Finishing write of file failed. "
+                      "Only %u of %u Frames have been written.",
+                      writer->num_frames_written,
+                      writer->num_frames);
+        return false;
+    }
+    writer->is_finished = true;
+
+    if (writer->has_pixel_data) {
+        if (writer->is_encapsulated) {
+            if (!dcm_element_encode_header(TAG_SQ_DELIM, NULL, 0, true,
+                                           write_to_file, writer) ||
+                !write_offset_table(writer)) {
+                return false;
+            }
+        } else if ((writer->frame_length * writer->num_frames) % 2 == 1 &&
+                   !write_to_file(writer, "", 1)) {
+            return false;
+        }
+    }
+
+    if (!write_to_file(writer, writer->trailer, writer->trailer_length)) {
+        return false;
+    }
+    if (fflush(writer->fp) != 0) {
+        dcm_log_error("Finishing write of file failed. %s", strerror(errno));
+        return false;
+    }
+    return true;
 }
@@ -2,6 +2,8 @@
  * Implementation of subroutines that are independent of the DICOM standard.
  */
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -9,12 +11,107 @@
 
 #include "config.h"
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
 #include "dicom.h"
+#include "pdicom.h"
+
+
+// Heap allocations made by the library
+static atomic_uint_fast64_t num_allocations;
+
+
+// Allocator installed by the host, which is used in place of the C library
+static struct {
+    DcmAllocator functions;
+    void *user_data;
+    bool is_set;
+} allocator;
+
+
+uint64_t dcm_get_num_allocations(void)
+{
+    return atomic_load_explicit(&num_allocations, memory_order_relaxed);
+}
+
+
+bool dcm_set_allocator(const DcmAllocator *functions, void *user_data)
+{
+    if (functions == NULL) {
+        allocator.is_set = false;
+        allocator.user_data = NULL;
+        return true;
+    }
+    if (functions->allocate == NULL ||
+        functions->reallocate == NULL ||
+        functions->release == NULL) {
+        dcm_log_error("Setting allocator failed. "
+                      "All functions of the allocator must be given.");
+        return false;
+    }
+    allocator.functions = *functions;
+    allocator.user_data = user_data;
+    allocator.is_set = true;
+    return true;
+}
+
+
+void *dcm_heap_malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&num_allocations, 1, memory_order_relaxed);
+    if (allocator.is_set) {
+        return allocator.functions.allocate(allocator.user_data, size);
+    }
+    return malloc(size);
+}
+
+
+void *dcm_heap_realloc(void *ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&num_allocations, 1, memory_order_relaxed);
+    if (allocator.is_set) {
+        return allocator.functions.reallocate(allocator.user_data, ptr, size);
+    }
+    return realloc(ptr, size);
+}
+
+
+void dcm_heap_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    if (allocator.is_set) {
+        allocator.functions.release(allocator.user_data, ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+
+char *dcm_strdup(const char *value)
+{
+    size_t length = strlen(value);
+    char *result = dcm_heap_malloc(length + 1);
+    if (result) {
+        memcpy(result, value, length + 1);
+    }
+    return result;
+}
 
 
 void *dcm_calloc(size_t n, size_t size)
 {
-    void *result = calloc(n, size);
+    void *result = NULL;
+    if (size == 0 || n <= SIZE_MAX / size) {
+        // Like calloc(), a zero size yields a unique pointer
+        result = dcm_heap_malloc(n * size > 0 ? n * size : 1);
+    }
+    if (result) {
+        memset(result, 0, n * size);
+    }
     if(!result) {
         dcm_log_error("Failed to allocate and initialize memory.");
         return NULL;
@@ -23,20 +120,377 @@ void *dcm_calloc(size_t n, size_t size)
 }
 
 
+/**
+ * Size of the first block of an arena. Subsequent blocks double in size.
+ */
+#define ARENA_MIN_BLOCK_SIZE 16384
+#define ARENA_MAX_BLOCK_SIZE 4194304
+
+
+struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+};
+
+
+struct _DcmArena {
+    struct ArenaBlock *blocks;
+    size_t next_block_size;
+    atomic_uint refcount;
+};
+
+
+static _Thread_local DcmArena *current_arena = NULL;
+
+
+DcmArena *dcm_arena_create(void)
+{
+    DcmArena *arena = DCM_NEW(DcmArena);
+    if (arena == NULL) {
+        return NULL;
+    }
+    arena->blocks = NULL;
+    arena->next_block_size = ARENA_MIN_BLOCK_SIZE;
+    atomic_init(&arena->refcount, 1);
+    return arena;
+}
+
+
+void dcm_arena_retain(DcmArena *arena)
+{
+    atomic_fetch_add(&arena->refcount, 1);
+}
+
+
+void dcm_arena_release(DcmArena *arena)
+{
+    if (arena == NULL || atomic_fetch_sub(&arena->refcount, 1) != 1) {
+        return;
+    }
+    struct ArenaBlock *block = arena->blocks;
+    while (block) {
+        struct ArenaBlock *next = block->next;
+        dcm_heap_free(block);
+        block = next;
+    }
+    dcm_heap_free(arena);
+}
+
+
+void *dcm_arena_alloc(DcmArena *arena, size_t size)
+{
+    const size_t alignment = sizeof(max_align_t);
+    size = (size + alignment - 1) / alignment * alignment;
+
+    struct ArenaBlock *block = arena->blocks;
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = arena->next_block_size;
+        if (block_size < size) {
+            block_size = size;
+        }
+        // Blocks are zeroed once, since memory is never reused
+        block = dcm_calloc(1, sizeof(struct ArenaBlock) + block_size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->size = block_size;
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
+        if (arena->next_block_size < ARENA_MAX_BLOCK_SIZE) {
+            arena->next_block_size *= 2;
+        }
+    }
+
+    void *result = (char *) block->data + block->used;
+    block->used += size;
+    return result;
+}
+
+
+DcmArena *dcm_arena_enter(DcmArena *arena)
+{
+    DcmArena *previous = current_arena;
+    current_arena = arena;
+    return previous;
+}
+
+
+void dcm_arena_leave(DcmArena *previous)
+{
+    current_arena = previous;
+}
+
+
+DcmArena *dcm_arena_current(void)
+{
+    return current_arena;
+}
+
+
+void *dcm_malloc(size_t size)
+{
+    if (current_arena) {
+        return dcm_arena_alloc(current_arena, size);
+    }
+    void *result = dcm_heap_malloc(size);
+    if (result == NULL && size > 0) {
+        dcm_log_error("Failed to allocate memory.");
+    }
+    return result;
+}
+
+
+void dcm_free(void *ptr)
+{
+    if (current_arena == NULL) {
+        dcm_heap_free(ptr);
+    }
+}
+
+
+/**
+ * Number of buckets of an empty string pool. The number doubles whenever the
+ * pool holds more strings than it has buckets.
+ */
+#define STRING_POOL_MIN_BUCKETS 256
+
+
+struct PooledString {
+    struct PooledString *next;
+    uint32_t hash;
+    char chars[];
+};
+
+
+struct _DcmStringPool {
+    // Strings are carved from the arena and live as long as the pool
+    DcmArena *arena;
+    struct PooledString **buckets;
+    uint32_t num_buckets;
+    atomic_uint num_strings;
+    // Held by the caller and by each Data Element with pooled values
+    atomic_uint refcount;
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_t mutex;
+#endif
+};
+
+
+DcmStringPool *dcm_string_pool_create(void)
+{
+    DcmStringPool *pool = DCM_NEW(DcmStringPool);
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->arena = dcm_arena_create();
+    pool->buckets = DCM_ARRAY_ZEROS(STRING_POOL_MIN_BUCKETS,
+                                    struct PooledString *);
+    if (pool->arena == NULL || pool->buckets == NULL) {
+        dcm_arena_release(pool->arena);
+        dcm_heap_free(pool->buckets);
+        dcm_heap_free(pool);
+        return NULL;
+    }
+    pool->num_buckets = STRING_POOL_MIN_BUCKETS;
+    atomic_init(&pool->num_strings, 0);
+    atomic_init(&pool->refcount, 1);
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_init(&pool->mutex, NULL);
+#endif
+    return pool;
+}
+
+
+void dcm_string_pool_retain(DcmStringPool *pool)
+{
+    atomic_fetch_add(&pool->refcount, 1);
+}
+
+
+void dcm_string_pool_release(DcmStringPool *pool)
+{
+    if (pool == NULL || atomic_fetch_sub(&pool->refcount, 1) != 1) {
+        return;
+    }
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_destroy(&pool->mutex);
+#endif
+    dcm_heap_free(pool->buckets);
+    dcm_arena_release(pool->arena);
+    dcm_heap_free(pool);
+}
+
+
+static uint32_t hash_string(const char *value, size_t length)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    size_t i;
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char) value[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+static void grow_string_pool(DcmStringPool *pool)
+{
+    uint32_t num_buckets = pool->num_buckets * 2;
+    struct PooledString **buckets = dcm_calloc(num_buckets,
+                                               sizeof(struct PooledString *));
+    if (buckets == NULL) {
+        // Lookups remain correct, only slower
+        return;
+    }
+    uint32_t i;
+    for (i = 0; i < pool->num_buckets; i++) {
+        struct PooledString *entry = pool->buckets[i];
+        while (entry) {
+            struct PooledString *next = entry->next;
+            uint32_t bucket = entry->hash & (num_buckets - 1);
+            entry->next = buckets[bucket];
+            buckets[bucket] = entry;
+            entry = next;
+        }
+    }
+    dcm_heap_free(pool->buckets);
+    pool->buckets = buckets;
+    pool->num_buckets = num_buckets;
+}
+
+
+const char *dcm_string_pool_intern(DcmStringPool *pool, const char *value)
+{
+    size_t length = strlen(value);
+    uint32_t hash = hash_string(value, length);
+    const char *result = NULL;
+
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&pool->mutex);
+#endif
+    struct PooledString *entry = pool->buckets[hash & (pool->num_buckets - 1)];
+    while (entry) {
+        if (entry->hash == hash && strcmp(entry->chars, value) == 0) {
+            result = entry->chars;
+            break;
+        }
+        entry = entry->next;
+    }
+    if (result == NULL) {
+        entry = dcm_arena_alloc(pool->arena,
+                                sizeof(struct PooledString) + length + 1);
+        if (entry) {
+            entry->hash = hash;
+            memcpy(entry->chars, value, length + 1);
+            uint32_t bucket = hash & (pool->num_buckets - 1);
+            entry->next = pool->buckets[bucket];
+            pool->buckets[bucket] = entry;
+            if (atomic_fetch_add(&pool->num_strings, 1) + 1 >
+                    pool->num_buckets) {
+                grow_string_pool(pool);
+            }
+            result = entry->chars;
+        }
+    }
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_unlock(&pool->mutex);
+#endif
+    return result;
+}
+
+
+uint32_t dcm_string_pool_count(const DcmStringPool *pool)
+{
+    return atomic_load(&pool->num_strings);
+}
+
+
+void dcm_string_pool_destroy(DcmStringPool *pool)
+{
+    dcm_string_pool_release(pool);
+}
+
+
 const char *dcm_get_version(void)
 {
     return SUFFIXED_VERSION;
 }
 
 
+static struct {
+    const DcmTraceHooks *_Atomic hooks;
+    void *user_data;
+} trace = {NULL, NULL};
+
+
+void dcm_set_trace_hooks(const DcmTraceHooks *hooks, void *user_data)
+{
+    trace.user_data = user_data;
+    atomic_store(&trace.hooks, hooks);
+}
+
+
+void dcm_trace_start(const char *name, const DcmFile *file)
+{
+    const DcmTraceHooks *hooks = atomic_load_explicit(&trace.hooks,
+                                                      memory_order_acquire);
+    if (hooks && hooks->span_start) {
+        hooks->span_start(trace.user_data, name, file);
+    }
+}
+
+
+void dcm_trace_end(const char *name, const DcmFile *file)
+{
+    const DcmTraceHooks *hooks = atomic_load_explicit(&trace.hooks,
+                                                      memory_order_acquire);
+    if (hooks && hooks->span_end) {
+        hooks->span_end(trace.user_data, name, file);
+    }
+}
+
+
 DcmLogLevel dcm_log_level = DCM_LOG_NOTSET;
 
 
-static void dcm_logf(const char *level, const char *format, va_list args)
+// Size of the buffer into which messages for a log function are formatted
+#define LOG_MESSAGE_SIZE 1024
+
+
+static struct {
+    DcmLogFunction function;
+    void *user_data;
+} log_sink = {NULL, NULL};
+
+
+void dcm_set_log_function(DcmLogFunction function, void *user_data)
+{
+    log_sink.function = function;
+    log_sink.user_data = user_data;
+}
+
+
+static void dcm_logf(DcmLogLevel log_level,
+                     const char *level,
+                     const char *format,
+                     va_list args)
 {
+    if (log_sink.function) {
+        char message[LOG_MESSAGE_SIZE];
+        vsnprintf(message, sizeof(message), format, args);
+        log_sink.function(log_sink.user_data, log_level, message);
+        return;
+    }
+
     time_t now;
     time(&now);
-    char *datetime = ctime(&now);
+    // ctime() returns a shared buffer, which is not safe across threads
+    char datetime[26];
+    ctime_r(&now, datetime);
     datetime[strcspn(datetime, "\n")] = '\0';
     fprintf(stderr, "%s [%s] - ", level, datetime);
     vfprintf(stderr, format, args);
@@ -44,56 +498,56 @@ static void dcm_logf(const char *level, const char *format, va_list args)
 }
 
 
-void dcm_log_critical(const char *format, ...)
+void (dcm_log_critical)(const char *format, ...)
 {
     if (dcm_log_level <= DCM_LOG_CRITICAL) {
         va_list(args);
         va_start(args, format);
-        dcm_logf("CRITICAL", format, args);
+        dcm_logf(DCM_LOG_CRITICAL, "CRITICAL", format, args);
         va_end(args);
     }
 }
 
 
-void dcm_log_error(const char *format, ...)
+void (dcm_log_error)(const char *format, ...)
 {
     if ((dcm_log_level > DCM_LOG_NOTSET) & (dcm_log_level <= DCM_LOG_ERROR)) {
         va_list(args);
         va_start(args, format);
-        dcm_logf("ERROR   ", format, args);
+        dcm_logf(DCM_LOG_ERROR, "ERROR   ", format, args);
         va_end(args);
     }
 }
 
 
-void dcm_log_warning(const char *format, ...)
+void (dcm_log_warning)(const char *format, ...)
 {
     if ((dcm_log_level > DCM_LOG_NOTSET) & (dcm_log_level <= DCM_LOG_WARNING)) {
         va_list(args);
         va_start(args, format);
-        dcm_logf("WARNING ", format, args);
+        dcm_logf(DCM_LOG_WARNING, "WARNING ", format, args);
         va_end(args);
     }
 }
 
 
-void dcm_log_info(const char *format, ...)
+void (dcm_log_info)(const char *format, ...)
 {
     if ((dcm_log_level > DCM_LOG_NOTSET) & (dcm_log_level <= DCM_LOG_INFO)) {
         va_list(args);
         va_start(args, format);
-        dcm_logf("INFO    ", format, args);
+        dcm_logf(DCM_LOG_INFO, "INFO    ", format, args);
         va_end(args);
     }
 }
 
 
-void dcm_log_debug(const char *format, ...)
+void (dcm_log_debug)(const char *format, ...)
 {
     if ((dcm_log_level > DCM_LOG_NOTSET) & (dcm_log_level <= DCM_LOG_DEBUG)) {
         va_list(args);
         va_start(args, format);
-        dcm_logf("DEBUG   ", format, args);
+        dcm_logf(DCM_LOG_DEBUG, "DEBUG   ", format, args);
         va_end(args);
     }
 }
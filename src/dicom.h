@@ -40,6 +40,9 @@ extern void *dcm_calloc(size_t n, size_t size);
 
 /**
  * Maximum number of characters in values with Value Representation AT.
+ *
+ * Deprecated, since values of Attribute Tags are numbers, which
+ * :c:func:`dcm_element_get_value_AT` returns.
  */
 #define DCM_CAPACITY_AT 4
 
@@ -133,6 +136,11 @@ typedef struct _DcmDataSet DcmDataSet;
  */
 typedef struct _DcmSequence DcmSequence;
 
+/**
+ * Compiled path to nested Data Elements
+ */
+typedef struct _DcmQuery DcmQuery;
+
 /**
  * Frame Item of Pixel Data Element
  */
@@ -143,6 +151,242 @@ typedef struct _DcmFrame DcmFrame;
  */
 typedef struct _DcmBOT DcmBOT;
 
+/**
+ * Pending asynchronous read of a Frame Item
+ */
+typedef struct _DcmFrameRequest DcmFrameRequest;
+
+/**
+ * Cache of Frames that were read from Files
+ */
+typedef struct _DcmFrameCache DcmFrameCache;
+
+/**
+ * Decoder of Frames, which reuses the contexts of codecs
+ */
+typedef struct _DcmDecoder DcmDecoder;
+
+/**
+ * Layout of the Frames of an image across its Total Pixel Matrix
+ */
+typedef struct _DcmTileMap DcmTileMap;
+
+/**
+ * Shared storage of character string values that occur in many Data Sets
+ */
+typedef struct _DcmStringPool DcmStringPool;
+
+/**
+ * Instances of a series that were read together
+ */
+typedef struct _DcmSeries DcmSeries;
+
+/**
+ * Parser for the content of a File that arrives in chunks
+ */
+typedef struct _DcmStream DcmStream;
+
+/**
+ * Counters of a Frame Cache
+ */
+struct _DcmFrameCacheStats {
+    /** Number of reads that were served from the cache */
+    uint64_t num_hits;
+    /** Number of reads that were served from the File */
+    uint64_t num_misses;
+    /** Number of Frames that were removed to stay within the budget */
+    uint64_t num_evictions;
+    /** Number of Frames in the cache */
+    uint32_t num_frames;
+    /** Number of bytes taken by the Frames in the cache */
+    size_t num_bytes;
+};
+
+/**
+ * Frame Cache counters
+ */
+typedef struct _DcmFrameCacheStats DcmFrameCacheStats;
+
+/**
+ * Number of buckets of the histogram of Frame read latencies.
+ */
+#define DCM_STATS_LATENCY_BUCKETS 16
+
+/**
+ * Counters of the work done by the library, kept for each File and for all
+ * Files together
+ */
+struct _DcmStats {
+    /** Number of bytes obtained from I/O methods, which excludes reads
+     *  from mapped files */
+    uint64_t bytes_read;
+    /** Number of calls of I/O methods that read */
+    uint64_t num_reads;
+    /** Number of reads that did not continue where the previous read
+     *  ended */
+    uint64_t num_seeks;
+    /** Number of Data Element headers that were parsed */
+    uint64_t num_elements;
+    /** Number of heap allocations made by the library, which is only
+     *  counted for all Files together */
+    uint64_t num_allocations;
+    /** Number of individual Frames that were read */
+    uint64_t num_frames;
+    /** Histogram of the latencies of reads of individual Frames. Bucket
+     *  0 counts reads that took less than a microsecond, bucket ``i``
+     *  those that took less than 2^i and at least 2^(i-1) microseconds
+     *  and the last bucket also all longer reads. */
+    uint64_t frame_read_latency[DCM_STATS_LATENCY_BUCKETS];
+};
+
+/**
+ * Library counters
+ */
+typedef struct _DcmStats DcmStats;
+
+/**
+ * Functions that are called at the start and end of operations of the
+ * library, for example to record spans of a trace.
+ *
+ * Each function receives the ``user_data`` that was passed to
+ * :c:func:`dcm_set_trace_hooks`, the name of the operation, such as
+ * ``"read_metadata"`` or ``"read_frame"``, and the File it works on, which
+ * may be NULL. The end of an operation is reported on the thread that
+ * reported its start. Operations may be nested and may run on several
+ * threads at once. Either function may be NULL.
+ */
+struct _DcmTraceHooks {
+    /** Start of an operation */
+    void (*span_start)(void *user_data, const char *name, const DcmFile *file);
+    /** End of an operation */
+    void (*span_end)(void *user_data, const char *name, const DcmFile *file);
+};
+
+/**
+ * Trace hooks
+ */
+typedef struct _DcmTraceHooks DcmTraceHooks;
+
+/**
+ * Functions that the library uses in place of the C library to manage heap
+ * memory.
+ */
+struct _DcmAllocator {
+    /** Allocate memory like :c:func:`malloc` */
+    void *(*allocate)(void *user_data, size_t size);
+    /** Resize memory like :c:func:`realloc` */
+    void *(*reallocate)(void *user_data, void *ptr, size_t size);
+    /** Release memory like :c:func:`free` */
+    void (*release)(void *user_data, void *ptr);
+};
+
+/**
+ * Allocator
+ */
+typedef struct _DcmAllocator DcmAllocator;
+
+/**
+ * Function that is called when an asynchronous read of a Frame has completed.
+ *
+ * The Frame is owned by the callee and is NULL if the read failed.
+ */
+typedef void (*DcmFrameCallback)(DcmFrame *frame, void *user_data);
+
+/**
+ * Functions that are called for the parts of a Data Set as it is parsed.
+ *
+ * Each function receives the ``user_data`` that was passed to
+ * :c:func:`dcm_file_parse` and returns whether parsing shall continue. Any
+ * function may be NULL to ignore the corresponding event.
+ */
+struct _DcmParseHandlers {
+    /** Header of a Data Element other than a Sequence */
+    bool (*element_start)(void *user_data,
+                          uint32_t tag,
+                          const char *vr,
+                          uint32_t length);
+    /** Chunk of the value of a Data Element or a Pixel Data fragment */
+    bool (*value_chunk)(void *user_data, const char *data, uint32_t size);
+    /** End of a Data Element other than a Sequence */
+    bool (*element_end)(void *user_data, uint32_t tag);
+    /** Header of a Data Element that contains a Sequence */
+    bool (*sequence_start)(void *user_data, uint32_t tag, uint32_t length);
+    /** End of a Data Element that contains a Sequence */
+    bool (*sequence_end)(void *user_data, uint32_t tag);
+    /** Header of an Item of a Sequence, counting from zero */
+    bool (*item_start)(void *user_data, uint32_t index, uint32_t length);
+    /** End of an Item of a Sequence */
+    bool (*item_end)(void *user_data, uint32_t index);
+    /** Header of an Item of encapsulated Pixel Data, counting from zero
+     *  with the Basic Offset Table */
+    bool (*fragment_start)(void *user_data, uint32_t index, uint32_t length);
+};
+
+/**
+ * Parse event handlers
+ */
+typedef struct _DcmParseHandlers DcmParseHandlers;
+
+/**
+ * Functions through which a File reads its content from a source other than
+ * a file on disk, such as a network stream or a memory buffer.
+ *
+ * Each function receives the handle that was passed to
+ * :c:func:`dcm_file_create_io`.
+ */
+struct _DcmIOMethods {
+    /** Read up to `length` bytes at `offset` into `buffer` and return the
+     *  number of bytes read, 0 at the end of the content or a negative
+     *  number on error. Must allow concurrent calls if Frames are read
+     *  from several threads at once. */
+    int64_t (*read_at)(void *handle,
+                       char *buffer,
+                       int64_t length,
+                       int64_t offset);
+    /** Return the size of the content in bytes or a negative number if it
+     *  is unknown; may be NULL */
+    int64_t (*size)(void *handle);
+    /** Return the whole content if it is contiguous in memory and remains
+     *  valid until the handle is closed, setting `size`, or NULL otherwise;
+     *  may be NULL */
+    const char *(*map)(void *handle, int64_t *size);
+    /** Release the handle once the File is destroyed; may be NULL */
+    void (*close)(void *handle);
+    /** Announce that `length` bytes at `offset` will be read soon, for
+     *  example to start fetching them in the background; may be NULL */
+    void (*prefetch)(void *handle, int64_t offset, int64_t length);
+};
+
+/**
+ * I/O methods
+ */
+typedef struct _DcmIOMethods DcmIOMethods;
+
+/**
+ * Functions that decode the Frames of an encapsulated Transfer Syntax.
+ *
+ * Decoded samples are stored like native Pixel Data in Little Endian byte
+ * order, with the samples of each pixel next to each other.
+ */
+struct _DcmCodec {
+    /** Create state that is reused for decoding several Frames, but only
+     *  by one thread at a time; may be NULL */
+    void *(*create_context)(void);
+    /** Decode `frame` into `buffer` of `size` bytes, which holds at least
+     *  :c:func:`dcm_frame_get_decoded_length` bytes */
+    bool (*decode)(void *context,
+                   const DcmFrame *frame,
+                   char *buffer,
+                   size_t size);
+    /** Destroy the state; may be NULL */
+    void (*destroy_context)(void *context);
+};
+
+/**
+ * Codec
+ */
+typedef struct _DcmCodec DcmCodec;
+
 
 /**
  * Enumeration of log levels
@@ -167,6 +411,73 @@ enum _DcmLogLevel {
  */
 typedef enum _DcmLogLevel DcmLogLevel;
 
+/**
+ * Function that receives log messages in place of the stderr stream.
+ *
+ * The message is formatted, but has neither the level nor a timestamp.
+ */
+typedef void (*DcmLogFunction)(void *user_data,
+                               DcmLogLevel level,
+                               const char *message);
+
+/**
+ * Enumeration of flags that control how Data Sets are read from a File
+ */
+enum _DcmReadFlags {
+    /** Allocate each part of a Data Set separately */
+    DCM_READ_DEFAULT = 0,
+    /** Allocate each Data Set and all of its content from a single arena */
+    DCM_READ_ARENA = 1,
+    /** Read values of top-level Data Elements on first access */
+    DCM_READ_LAZY = 2,
+    /** Read the Items of large Sequences on several threads */
+    DCM_READ_PARALLEL = 4,
+};
+
+/**
+ * Read flags
+ */
+typedef enum _DcmReadFlags DcmReadFlags;
+
+/**
+ * Enumeration of flags that control how the samples of Frames are converted
+ */
+enum _DcmConvertFlags {
+    /** Store the samples of each pixel next to each other */
+    DCM_CONVERT_DEFAULT = 0,
+    /** Store each color component in a separate plane */
+    DCM_CONVERT_PLANAR = 1,
+    /** Reverse the byte order of samples that are longer than a byte */
+    DCM_CONVERT_SWAP_BYTES = 2,
+    /** Keep only the stored bits and shift signed samples to be unsigned */
+    DCM_CONVERT_UNSIGNED = 4,
+};
+
+/**
+ * Convert flags
+ */
+typedef enum _DcmConvertFlags DcmConvertFlags;
+
+/**
+ * Enumeration of the states of a Stream
+ */
+enum _DcmStreamState {
+    /** More content is needed before the metadata can be read */
+    DCM_STREAM_NEED_DATA = 0,
+    /** The metadata has been read and Frames become available as they
+     *  arrive */
+    DCM_STREAM_METADATA = 1,
+    /** The metadata has been read and all Frames have arrived */
+    DCM_STREAM_COMPLETE = 2,
+    /** The content is malformed or ended early */
+    DCM_STREAM_ERROR = 3,
+};
+
+/**
+ * Stream state
+ */
+typedef enum _DcmStreamState DcmStreamState;
+
 /**
  * Global variable to set log level.
  */
@@ -212,6 +523,22 @@ extern void dcm_log_info(const char *format, ...);
  */
 extern void dcm_log_debug(const char *format, ...);
 
+/**
+ * Send log messages to a function instead of the stderr stream.
+ *
+ * Messages are still filtered by :c:data:`dcm_log_level` and are passed to
+ * the function from whichever thread logs them. Messages longer than 1023
+ * characters are truncated.
+ *
+ * The function must be installed before the library is used by other
+ * threads and must not be changed while they may log, since `function`
+ * and `user_data` are not replaced together atomically.
+ *
+ * :param function: Log function or NULL to write to stderr again
+ * :param user_data: Argument to pass to the function
+ */
+extern void dcm_set_log_function(DcmLogFunction function, void *user_data);
+
 /**
  * Get the version of the library.
  *
@@ -219,6 +546,83 @@ extern void dcm_log_debug(const char *format, ...);
  */
 extern const char *dcm_get_version(void);
 
+/**
+ * Install functions that the library uses to manage heap memory.
+ *
+ * The allocator must be installed before the library is used in any other
+ * way and must not be changed while memory obtained from it is still in use.
+ * Memory that is exchanged with the library, such as the values that are
+ * passed to :c:func:`dcm_element_create_CS` or the buffers of Frames, must
+ * be allocated and released with the same allocator.
+ *
+ * :param functions: Allocator or NULL to use the C library again
+ * :param user_data: Argument to pass to the functions
+ *
+ * :return: Whether the allocator was installed
+ */
+extern bool dcm_set_allocator(const DcmAllocator *functions, void *user_data);
+
+/**
+ * Install functions that are called at the start and end of operations.
+ *
+ * The hooks must be installed before the library is used by other threads
+ * and must remain valid while they are installed.
+ *
+ * :param hooks: Trace hooks or NULL to remove them
+ * :param user_data: Argument to pass to the hooks
+ */
+extern void dcm_set_trace_hooks(const DcmTraceHooks *hooks, void *user_data);
+
+/**
+ * Get the counters of all Files together since the program started.
+ *
+ * :param stats: Pointer to the counters
+ */
+extern void dcm_get_stats(DcmStats *stats);
+
+/**
+ * Create an empty String Pool.
+ *
+ * A String Pool keeps a single copy of each character string value that is
+ * added to it, for example the UIDs and Code Strings that are repeated in the
+ * Data Sets of all instances of a series. The pool can be used from several
+ * threads at once. Strings remain in the pool until it is destroyed and
+ * memory is only released once no Data Set uses the pool any more.
+ *
+ * :return: String Pool
+ */
+extern DcmStringPool *dcm_string_pool_create(void);
+
+/**
+ * Get the pooled copy of a character string.
+ *
+ * :param pool: String Pool
+ * :param value: Character string
+ *
+ * :return: Copy of the string that is owned by the pool
+ */
+extern const char *dcm_string_pool_intern(DcmStringPool *pool,
+                                          const char *value);
+
+/**
+ * Get the number of distinct character strings in a String Pool.
+ *
+ * :param pool: String Pool
+ *
+ * :return: Number of strings
+ */
+extern uint32_t dcm_string_pool_count(const DcmStringPool *pool);
+
+/**
+ * Destroy a String Pool.
+ *
+ * Data Elements that use strings of the pool keep it alive until they are
+ * destroyed themselves.
+ *
+ * :param pool: String Pool
+ */
+extern void dcm_string_pool_destroy(DcmStringPool *pool);
+
 /**
  * Look up the Value Representation of an Attribute in the Dictionary.
  *
@@ -237,6 +641,16 @@ extern const char *dcm_dict_lookup_vr(uint32_t tag);
  */
 extern const char *dcm_dict_lookup_keyword(uint32_t tag);
 
+/**
+ * Look up the Tag of an Attribute in the Dictionary by its Keyword.
+ *
+ * :param keyword: Attribute Keyword
+ * :param tag: Pointer to the Attribute Tag
+ *
+ * :return: Whether the Keyword was found
+ */
+extern bool dcm_dict_lookup_tag(const char *keyword, uint32_t *tag);
+
 /**
  * Determine whether a Tag is public.
  *
@@ -347,18 +761,19 @@ extern DcmElement *dcm_element_create_AS_multi(uint32_t tag,
  * Create a Data Element with Value Representation AT (Attribute Tag).
  *
  * :param tag: Tag
- * :param value: Character string value
+ * :param value: Attribute Tag value, with the group number in the upper
+ *               16 bits
  *
  * :return: Pointer to Data Element
  */
-extern DcmElement *dcm_element_create_AT(uint32_t tag, char *value);
+extern DcmElement *dcm_element_create_AT(uint32_t tag, uint32_t value);
 
 /**
  * Create a Data Element with Value Representation AT (Attribute Tag)
  * and Value Multiplicity equal to or greater than one.
  *
  * :param tag: Tag
- * :param values: Array of character string values
+ * :param values: Array of Attribute Tag values
  * :param vm: Value Multiplicity
  *
  * The created object takes over ownership of the memory referenced by `values`
@@ -367,7 +782,7 @@ extern DcmElement *dcm_element_create_AT(uint32_t tag, char *value);
  * :return: Pointer to Data Element
  */
 extern DcmElement *dcm_element_create_AT_multi(uint32_t tag,
-                                               char **values,
+                                               uint32_t *values,
                                                uint32_t vm);
 
 /**
@@ -1078,6 +1493,15 @@ extern uint16_t dcm_element_get_element_number(const DcmElement *element);
  */
 extern uint32_t dcm_element_get_tag(const DcmElement *element);
 
+/**
+ * Get Value Representation of a Data Element.
+ *
+ * :param element: Pointer to Data Element
+ *
+ * :return: Value Representation
+ */
+extern const char *dcm_element_get_vr(const DcmElement *element);
+
 /**
  * Check Value Representation of a Data Element.
  *
@@ -1124,6 +1548,23 @@ extern bool dcm_element_is_multivalued(const DcmElement *element);
  */
 extern DcmElement *dcm_element_clone(const DcmElement *element);
 
+/**
+ * Get a value of a Data Element with a character string Value
+ * Representation.
+ *
+ * Unlike the getters for a single Value Representation, such as
+ * :c:func:`dcm_element_get_value_LO`, any of the values of Data Elements
+ * with Value Representation AE, AS, CS, DA, DS, DT, IS, LO, LT, PN, SH,
+ * ST, TM, UI, UR or UT can be obtained.
+ *
+ * :param element: Pointer to Data Element
+ * :param index: Zero-based index of value within the Data Element
+ *
+ * :return: Pointer to memory location where value is stored
+ */
+extern const char *dcm_element_get_value_string(const DcmElement *element,
+                                                uint32_t index);
+
 /**
  * Get value of a Data Element with Value Representation AE
  * (Appllication Entity).
@@ -1153,10 +1594,10 @@ extern const char *dcm_element_get_value_AS(const DcmElement *element,
  * :param element: Pointer to Data Element
  * :param index: Zero-based index of value within the Data Element
  *
- * :return: Pointer to memory location where value is stored
+ * :return: Attribute Tag, with the group number in the upper 16 bits
  */
-extern const char *dcm_element_get_value_AT(const DcmElement *element,
-                                            uint32_t index);
+extern uint32_t dcm_element_get_value_AT(const DcmElement *element,
+                                         uint32_t index);
 
 /**
  * Get value of a Data Element with Value Representation CS (Code String).
@@ -1702,6 +2143,122 @@ extern bool dcm_sequence_is_locked(const DcmSequence *seq);
 extern void dcm_sequence_destroy(DcmSequence *seq);
 
 
+/**
+ * Query
+ */
+
+/**
+ * Compile a path to nested Data Elements into a Query.
+ *
+ * The path consists of Attributes separated by dots, such as
+ * ``PerFrameFunctionalGroupsSequence[*].PlanePositionSlideSequence[0].XOffsetInSlideCoordinateSystem``.
+ * Attributes are given by Keyword or by Tag as eight hexadecimal digits.
+ * Each but the last Attribute refers to a Sequence and may be followed by
+ * the zero-based index of an Item in brackets or by ``[*]`` to select all
+ * Items, which is also the default.
+ *
+ * :param path: Path
+ *
+ * :return: Query
+ */
+extern DcmQuery *dcm_query_create(const char *path);
+
+/**
+ * Find the Data Elements that are selected by a Query.
+ *
+ * The Data Elements are returned in the order of the Sequence Items. Items
+ * that lack one of the Attributes of the path are skipped.
+ *
+ * :param query: Query
+ * :param dataset: Data Set
+ * :param elements: Array for the selected Data Elements, which remain owned
+ *                  by the Data Set
+ * :param capacity: Number of Data Elements that fit into `elements`
+ *
+ * :return: Number of selected Data Elements, which may exceed `capacity`
+ */
+extern uint32_t dcm_query_evaluate(const DcmQuery *query,
+                                   const DcmDataSet *dataset,
+                                   const DcmElement **elements,
+                                   uint32_t capacity);
+
+/**
+ * Get the first value of each Data Element that is selected by a Query as
+ * number.
+ *
+ * Values of Data Elements with numeric Value Representation or with Value
+ * Representation DS or IS are converted; all others yield NaN.
+ *
+ * :param query: Query
+ * :param dataset: Data Set
+ * :param values: Array for the values
+ * :param capacity: Number of values that fit into `values`
+ *
+ * :return: Number of selected Data Elements, which may exceed `capacity`
+ */
+extern uint32_t dcm_query_evaluate_numbers(const DcmQuery *query,
+                                           const DcmDataSet *dataset,
+                                           double *values,
+                                           uint32_t capacity);
+
+/**
+ * Get the values of Functional Group Attributes of each Frame as columns.
+ *
+ * Each Query is evaluated relative to the Item of the Per-frame Functional
+ * Groups Sequence of a Frame, for example
+ * ``PlanePositionSlideSequence.XOffsetInSlideCoordinateSystem``, and falls
+ * back to the Shared Functional Groups Sequence if the Item lacks the
+ * Attribute. Element `i` of column `j` receives the first value of the
+ * Attribute selected by Query `j` for Frame `i + 1`, converted as by
+ * :c:func:`dcm_query_evaluate_numbers`, or NaN if the Attribute is missing.
+ *
+ * If the Data Set has no Per-frame Functional Groups Sequence, all Frames
+ * receive the values of the Shared Functional Groups Sequence.
+ *
+ * :param dataset: Metadata of an image
+ * :param queries: Queries
+ * :param num_queries: Number of Queries and columns
+ * :param columns: Arrays for the values
+ * :param capacity: Number of values that fit into each column
+ *
+ * :return: Number of Frames, which may exceed `capacity`
+ */
+extern uint32_t dcm_dataset_get_frame_numbers(const DcmDataSet *dataset,
+                                              const DcmQuery *const *queries,
+                                              uint32_t num_queries,
+                                              double *const *columns,
+                                              uint32_t capacity);
+
+/**
+ * Get the values of Functional Group Attributes of each Frame as integer
+ * columns.
+ *
+ * Like :c:func:`dcm_dataset_get_frame_numbers`, but values are truncated to
+ * integers and missing values or values outside the range of ``int32_t``
+ * are given as ``INT32_MIN``.
+ *
+ * :param dataset: Metadata of an image
+ * :param queries: Queries
+ * :param num_queries: Number of Queries and columns
+ * :param columns: Arrays for the values
+ * :param capacity: Number of values that fit into each column
+ *
+ * :return: Number of Frames, which may exceed `capacity`
+ */
+extern uint32_t dcm_dataset_get_frame_integers(const DcmDataSet *dataset,
+                                               const DcmQuery *const *queries,
+                                               uint32_t num_queries,
+                                               int32_t *const *columns,
+                                               uint32_t capacity);
+
+/**
+ * Destroy a Query.
+ *
+ * :param query: Query
+ */
+extern void dcm_query_destroy(DcmQuery *query);
+
+
 /**
  * Frame
  *
@@ -1747,6 +2304,50 @@ extern DcmFrame *dcm_frame_create(uint32_t number,
                                   const char *photometric_interpretation,
                                   const char *transfer_syntax_uid);
 
+/**
+ * Create a Frame that references memory it does not own.
+ *
+ * :param number: Number of the Frame within the Pixel Data Element
+ * :param data: Pixel data of the Frame
+ * :param length: Size of the Frame (number of bytes)
+ * :param rows: Number of rows in pixel matrix
+ * :param columns: Number of columns in pixel matrix
+ * :param samples_per_pixel: Number of samples per pixel
+ * :param bits_allocated: Number of bits allocated per pixel
+ * :param bits_stored: Number of bits stored per pixel
+ * :param pixel_representation: Representation of pixels
+ *                              (unsigned integers or 2's complement)
+ * :param planar_configuration: Configuration of samples
+ *                              (color-by-plane or color-by-pixel)
+ * :param photometric_interpretation: Interpretation of pixels
+ *                                    (monochrome, RGB, etc.)
+ * :param transfer_syntax_uid: UID of transfer syntax in which data is encoded
+ * :param owner: Object that keeps `data`, `photometric_interpretation`,
+ *               and `transfer_syntax_uid` alive
+ * :param release: Function that gets called with `owner` when the object is
+ *                 destroyed or if the creation fails
+ *
+ * Unlike a Frame created via :c:func:`dcm_frame_create`, the object does not
+ * copy or free any of the referenced memory. Instead, it takes over one
+ * reference to `owner` and gives it back via `release`.
+ *
+ * :return: Frame Item
+ */
+extern DcmFrame *dcm_frame_create_view(uint32_t number,
+                                       const char *data,
+                                       uint32_t length,
+                                       uint16_t rows,
+                                       uint16_t columns,
+                                       uint16_t samples_per_pixel,
+                                       uint16_t bits_allocated,
+                                       uint16_t bits_stored,
+                                       uint16_t pixel_representation,
+                                       uint16_t planar_configuration,
+                                       const char *photometric_interpretation,
+                                       const char *transfer_syntax_uid,
+                                       void *owner,
+                                       void (*release)(void *owner));
+
 /**
  * Get number of a Frame Item within the Pixel Data Element.
  *
@@ -1864,6 +2465,51 @@ extern const char *dcm_frame_get_transfer_syntax_uid(const DcmFrame *frame);
  */
 extern const char *dcm_frame_get_value(const DcmFrame *frame);
 
+/**
+ * Copy the samples of a native Frame into a different layout.
+ *
+ * Samples are read in the Little Endian byte order of native Transfer
+ * Syntaxes. Without flags, the samples of each pixel are stored next to
+ * each other, whatever the Planar Configuration of the Frame. With
+ * :c:enumerator:`DCM_CONVERT_UNSIGNED`, bits outside of Bits Stored are
+ * cleared and signed samples are offset by half of their range, so that
+ * the smallest value becomes zero. Samples must be 8, 16 or 32 bits long.
+ *
+ * :param frame: Frame
+ * :param flags: Convert flags
+ * :param buffer: Memory for the converted samples
+ * :param size: Size of the memory in bytes, at least the length of the Frame
+ *
+ * :return: Whether the Frame could be converted
+ */
+extern bool dcm_frame_convert(const DcmFrame *frame,
+                              uint32_t flags,
+                              char *buffer,
+                              size_t size);
+
+/**
+ * Map the samples of a native Frame to 8 bits through a linear window.
+ *
+ * Samples are interpreted according to Bits Stored, High Bit and Pixel
+ * Representation and mapped as described in Part 3, C.11.2.1.2.1, with
+ * one byte per sample in the layout of the Frame. A Rescale Slope and
+ * Intercept can be applied by passing ``(center - intercept) / slope``
+ * and ``width / slope``. Samples must be at most 16 bits long.
+ *
+ * :param frame: Frame
+ * :param center: Window Center
+ * :param width: Window Width, at least 1
+ * :param buffer: Memory for the mapped samples
+ * :param size: Size of the memory in bytes, at least the number of samples
+ *
+ * :return: Whether the Frame could be mapped
+ */
+extern bool dcm_frame_apply_window(const DcmFrame *frame,
+                                   double center,
+                                   double width,
+                                   uint8_t *buffer,
+                                   size_t size);
+
 /**
  * Destroy a Frame.
  *
@@ -1873,19 +2519,126 @@ extern void dcm_frame_destroy(DcmFrame *frame);
 
 
 /**
- * Basic Offset Table (BOT).
+ * Codecs
  */
 
 /**
- * Create a Basic Offset Table.
+ * Register a codec for a Transfer Syntax.
  *
- * :param offsets: Offset of each Frame in the Pixel Data Element
- *                 (measured from the first byte of the first Frame).
- * :param num_frames: Number of Frames in the Pixel Data Element
- *                    (measured from the first byte of the File).
+ * Registered codecs replace earlier registrations and the built-in codecs
+ * for the same Transfer Syntax. RLE Lossless is built in, as is JPEG
+ * Baseline if the library was built with libjpeg. The codec must remain
+ * valid for as long as Frames are decoded.
  *
- * The created object takes over ownership of the memory referenced by `offsets`
- * and frees it when the object is destroyed or if the creation fails.
+ * :param transfer_syntax_uid: Transfer Syntax UID
+ * :param codec: Codec
+ *
+ * :return: Whether the codec could be registered
+ */
+extern bool dcm_codec_register(const char *transfer_syntax_uid,
+                               const DcmCodec *codec);
+
+/**
+ * Find the codec for a Transfer Syntax.
+ *
+ * :param transfer_syntax_uid: Transfer Syntax UID
+ *
+ * :return: Codec or NULL if no codec is available
+ */
+extern const DcmCodec *dcm_codec_find(const char *transfer_syntax_uid);
+
+/**
+ * Get the number of bytes of a Frame once it is decoded.
+ *
+ * :param frame: Frame
+ *
+ * :return: Length of the decoded Frame
+ */
+extern size_t dcm_frame_get_decoded_length(const DcmFrame *frame);
+
+/**
+ * Decode a Frame.
+ *
+ * Native Frames are copied with the samples of each pixel next to each
+ * other. Encapsulated Frames are decoded by the codec of their Transfer
+ * Syntax, whose context is created for this call only.
+ *
+ * :param frame: Frame
+ * :param buffer: Memory for the decoded Frame
+ * :param size: Size of the memory in bytes
+ *
+ * :return: Whether the Frame could be decoded
+ */
+extern bool dcm_frame_decode(const DcmFrame *frame, char *buffer, size_t size);
+
+/**
+ * Create a Decoder.
+ *
+ * A Decoder keeps the contexts of codecs once they have been used, so that
+ * decoding further Frames does not set up the codec again. A Decoder may be
+ * used from several threads at once.
+ *
+ * :return: Decoder
+ */
+extern DcmDecoder *dcm_decoder_create(void);
+
+/**
+ * Decode a Frame with a Decoder.
+ *
+ * :param decoder: Decoder
+ * :param frame: Frame
+ * :param buffer: Memory for the decoded Frame
+ * :param size: Size of the memory in bytes
+ *
+ * :return: Whether the Frame could be decoded
+ */
+extern bool dcm_decoder_decode(DcmDecoder *decoder,
+                               const DcmFrame *frame,
+                               char *buffer,
+                               size_t size);
+
+/**
+ * Decode several Frames with a Decoder, spread over the read threads.
+ *
+ * The calling thread decodes Frames as well and returns once all Frames
+ * have been decoded.
+ *
+ * :param decoder: Decoder
+ * :param frames: Frames
+ * :param num_frames: Number of Frames
+ * :param buffers: Memory for each decoded Frame
+ * :param size: Size of each memory in bytes
+ *
+ * :return: Whether all Frames could be decoded
+ */
+extern bool dcm_decoder_decode_frames(DcmDecoder *decoder,
+                                      const DcmFrame *const *frames,
+                                      uint32_t num_frames,
+                                      char *const *buffers,
+                                      size_t size);
+
+/**
+ * Destroy a Decoder and the contexts of its codecs.
+ *
+ * :param decoder: Decoder
+ */
+extern void dcm_decoder_destroy(DcmDecoder *decoder);
+
+
+/**
+ * Basic Offset Table (BOT).
+ */
+
+/**
+ * Create a Basic Offset Table.
+ *
+ * :param offsets: Offset of each Frame in the Pixel Data Element
+ *                 (measured from the first byte of the first Frame).
+ * :param num_frames: Number of Frames in the Pixel Data Element
+ *                    (measured from the first byte of the File).
+ *
+ * The created object takes over ownership of the memory referenced by `offsets`
+ * and frees it when the object is destroyed or if the creation fails.
  *
  * :return: Basic Offset Table
  */
@@ -1904,11 +2657,11 @@ extern uint32_t dcm_bot_get_num_frames(const DcmBOT *bot);
  * Get Frame offset in the Basic Offset Table.
  *
  * :param bot: Basic Offset Table
- * :param index: Zero-based index of Frame in the Pixel Data Element
+ * :param number: One-based number of Frame in the Pixel Data Element
  *
  * :return: offset
  */
-extern ssize_t dcm_bot_get_frame_offset(const DcmBOT *bot, uint32_t index);
+extern ssize_t dcm_bot_get_frame_offset(const DcmBOT *bot, uint32_t number);
 
 /**
  * Print a Basic Offset Table.
@@ -1932,6 +2685,13 @@ extern void dcm_bot_destroy(DcmBOT *bot);
 /**
  * Create a File.
  *
+ * The following file modes are supported:
+ *
+ * - ``'r'``: read the file through buffered stream I/O
+ * - ``'m'``: map the file into memory and read directly from the mapping;
+ *   falls back to ``'r'`` if the file cannot be mapped (e.g., a pipe)
+ * - ``'w'``: open the file for writing
+ *
  * :param file_path: Path to the file on disk.
  * :param mode: File Mode to use when opening the file.
  *
@@ -1939,6 +2699,98 @@ extern void dcm_bot_destroy(DcmBOT *bot);
  */
 extern DcmFile *dcm_file_create(const char *file_path, const char mode);
 
+/**
+ * Create a File that reads through I/O methods.
+ *
+ * The File reads the content by offset only, so that sources such as range
+ * requests against an object store can be used without seeking. If the
+ * methods provide the whole content in memory, the content is read from
+ * there like a mapped file.
+ *
+ * :param io: I/O methods, which must remain valid while the File is in use
+ * :param handle: Argument to pass to each method, which is closed with the
+ *                File or if creation fails
+ *
+ * :return: file
+ */
+extern DcmFile *dcm_file_create_io(const DcmIOMethods *io, void *handle);
+
+/**
+ * Create a File that reads from a memory buffer.
+ *
+ * The buffer is not copied and must remain valid until the File and all
+ * Frames and lazily read Data Sets obtained from it have been destroyed.
+ *
+ * :param data: Content of a Part 10 file
+ * :param size: Size of the content in bytes
+ *
+ * :return: file
+ */
+extern DcmFile *dcm_file_create_memory(const char *data, size_t size);
+
+/**
+ * Create a File that reads from an open file descriptor.
+ *
+ * The descriptor is read by offset and is not closed by the File.
+ *
+ * :param fd: File descriptor that is open for reading
+ *
+ * :return: file
+ */
+extern DcmFile *dcm_file_create_fd(int fd);
+
+/**
+ * Set the flags that control how Data Sets are read from a File.
+ *
+ * With :c:enumerator:`DCM_READ_ARENA`, the Data Sets returned by
+ * :c:func:`dcm_file_read_file_meta` and :c:func:`dcm_file_read_metadata`
+ * are carved from a few large blocks of memory, together with their Data
+ * Elements, values and nested Sequences. The blocks are freed at once when
+ * the Data Set is destroyed via :c:func:`dcm_dataset_destroy`.
+ *
+ * With :c:enumerator:`DCM_READ_LAZY`, :c:func:`dcm_file_read_metadata`
+ * only records the Tag, Value Representation and position of each top-level
+ * Data Element and skips over its value. The value, including all Items of a
+ * Sequence, is read from the File when the Data Element is first obtained
+ * from the Data Set. The Data Set keeps the File open until it is destroyed,
+ * even if the File itself has been destroyed before. Values may be loaded
+ * from several threads at once.
+ *
+ * With :c:enumerator:`DCM_READ_PARALLEL`, the Items of a Sequence with many
+ * Items are located by their headers first and then read concurrently by
+ * the calling thread and the threads that serve
+ * :c:func:`dcm_file_read_frame_async`. The Items are added to the Sequence
+ * in their original order. Sequences within Items and Data Sets that are
+ * read with :c:enumerator:`DCM_READ_ARENA` are read by the calling thread
+ * alone.
+ *
+ * :param file: File
+ * :param flags: Bitwise combination of :c:type:`DcmReadFlags`
+ */
+extern void dcm_file_set_read_flags(DcmFile *file, uint32_t flags);
+
+/**
+ * Set the String Pool into which character string values are read.
+ *
+ * Values of Data Elements that are read from the File afterwards are
+ * replaced by the copies in the pool, so that Data Sets of many Files share
+ * the memory of repeated values. Free text values such as those of Value
+ * Representation LT and values of Data Sets that are read with
+ * :c:enumerator:`DCM_READ_ARENA` are not pooled.
+ *
+ * :param file: File
+ * :param pool: String Pool, which gains a reference, or NULL for none
+ */
+extern void dcm_file_set_string_pool(DcmFile *file, DcmStringPool *pool);
+
+/**
+ * Get the counters of a File since it was created.
+ *
+ * :param file: File
+ * :param stats: Pointer to the counters
+ */
+extern void dcm_file_get_stats(const DcmFile *file, DcmStats *stats);
+
 /**
  * Read File Metainformation from a File.
  *
@@ -1964,12 +2816,61 @@ extern DcmDataSet *dcm_file_read_file_meta(DcmFile *file);
  */
 extern DcmDataSet *dcm_file_read_metadata(DcmFile *file);
 
+/**
+ * Read selected metadata from a File.
+ *
+ * Like :c:func:`dcm_file_read_metadata`, but only Data Elements whose Tags
+ * are wanted are read. The values of all other Data Elements are skipped
+ * without being decoded. Reading stops at the first Data Element with a Tag
+ * greater than `max_tag` or than the greatest wanted Tag, whichever is
+ * smaller. Frames can only be read once the metadata has been read up to the
+ * Pixel Data Element.
+ *
+ * :param file: File
+ * :param tags: Attribute Tags of the wanted Data Elements in any order or
+ *              NULL to read all Data Elements up to `max_tag`
+ * :param num_tags: Number of Attribute Tags
+ * :param max_tag: Greatest Attribute Tag to read
+ *
+ * :return: metadata
+ */
+extern DcmDataSet *dcm_file_read_metadata_tags(DcmFile *file,
+                                               const uint32_t *tags,
+                                               uint32_t num_tags,
+                                               uint32_t max_tag);
+
+/**
+ * Parse the Data Set of a File without constructing it in memory.
+ *
+ * Walks the Data Elements following the File Meta Information up to the end
+ * of the File, including the Pixel Data Element, and calls a handler for
+ * each event. Values are passed as encoded in the File in chunks of bounded
+ * size, which remain valid only during the call, such that memory use does
+ * not depend on the size of the File. Values of Sequences are reported as
+ * Items, whose Data Elements are reported in turn. Encapsulated Pixel Data
+ * is reported as fragments.
+ *
+ * :param file: File
+ * :param handlers: Event handlers
+ * :param user_data: Argument to pass to each handler
+ *
+ * :return: Whether the Data Set was parsed, which includes being stopped by
+ *          a handler
+ */
+extern bool dcm_file_parse(DcmFile *file,
+                           const DcmParseHandlers *handlers,
+                           void *user_data);
+
 /**
  * Read Basic Offset Table from a File.
  *
  * In case the Pixel Data element does not contain a Basic Offset Table item,
- * but contains an Extended Offset Table element, the value of the Extended
- * Offset Table element will be read instead.
+ * but the Data Set contains an Extended Offset Table element, the value of
+ * the Extended Offset Table element, which was kept while reading the
+ * metadata, is used instead. If an offset index has been loaded via
+ * :c:func:`dcm_file_load_offset_index`, its offsets are used.
+ *
+ * Like :c:func:`dcm_file_read_frame`, this is safe to call concurrently.
  *
  * :param file: File
  * :param metadata: Metadata
@@ -1982,6 +2883,9 @@ extern DcmBOT *dcm_file_read_bot(const DcmFile *file,
 /**
  * Build Basic Offset Table for a File.
  *
+ * Walks the Frame Items of the Pixel Data Element, unless the offsets are
+ * known from the Extended Offset Table or a loaded offset index.
+ *
  * :param file: File
  * :param metadata: Metadata
  *
@@ -1990,13 +2894,123 @@ extern DcmBOT *dcm_file_read_bot(const DcmFile *file,
 extern DcmBOT *dcm_file_build_bot(const DcmFile *file,
                                   const DcmDataSet *metadata);
 
+/**
+ * Serialize the Frame offsets of a File into an offset index.
+ *
+ * The index holds the offsets of the Frames and of the Pixel Data Element
+ * and is keyed by the size and modification time of the File, so that it
+ * can be stored alongside the File and loaded via
+ * :c:func:`dcm_file_load_offset_index` when the File is opened again.
+ *
+ * :param file: File, whose metadata has been read
+ * :param bot: Basic Offset Table of the File
+ * :param length: Pointer to the length of the index in bytes
+ *
+ * :return: Index, to be released with the ``release`` function of the
+ *          allocator installed via :c:func:`dcm_set_allocator`, which is
+ *          :c:func:`free` by default
+ */
+extern char *dcm_file_create_offset_index(const DcmFile *file,
+                                          const DcmBOT *bot,
+                                          size_t *length);
+
+/**
+ * Load an offset index that was created for a File.
+ *
+ * Subsequent calls to :c:func:`dcm_file_read_bot` and
+ * :c:func:`dcm_file_build_bot` use the offsets of the index instead of
+ * reading them from the File. Fails if the index does not match the size
+ * and modification time of the File.
+ *
+ * :param file: File
+ * :param index: Index created via :c:func:`dcm_file_create_offset_index`
+ * :param length: Length of the index in bytes
+ *
+ * :return: Whether the index was loaded
+ */
+extern bool dcm_file_load_offset_index(DcmFile *file,
+                                       const char *index,
+                                       size_t length);
+
+/**
+ * Write the offset index of a File to disk.
+ *
+ * :param file: File, whose metadata has been read
+ * :param bot: Basic Offset Table of the File
+ * :param index_path: Path of the index file
+ *
+ * :return: Whether the index was written
+ */
+extern bool dcm_file_write_offset_index(const DcmFile *file,
+                                        const DcmBOT *bot,
+                                        const char *index_path);
+
+/**
+ * Load the offset index of a File from disk.
+ *
+ * :param file: File
+ * :param index_path: Path of the index file
+ *
+ * :return: Whether the index was loaded
+ */
+extern bool dcm_file_read_offset_index(DcmFile *file, const char *index_path);
+
+/**
+ * Announce that Frames will be read soon.
+ *
+ * Locates the Frame Items without reading them and passes their extents,
+ * merging neighbouring ones, to the operating system or to the prefetch
+ * method of the I/O methods of the File. Files on disk are advised via
+ * ``posix_fadvise()`` and mapped files via ``madvise()`` where available.
+ * The call returns without waiting for any data.
+ *
+ * :param file: File
+ * :param bot: Basic Offset Table
+ * :param numbers: One-based indices of the Frames in any order
+ * :param num_numbers: Number of Frames
+ *
+ * :return: Whether all Frames could be located
+ */
+extern bool dcm_file_prefetch_frames(const DcmFile *file,
+                                     const DcmBOT *bot,
+                                     const uint32_t *numbers,
+                                     uint32_t num_numbers);
+
+/**
+ * Announce that a region of the Total Pixel Matrix will be read soon.
+ *
+ * Like :c:func:`dcm_file_prefetch_frames` for the Frames that intersect the
+ * region, as found by :c:func:`dcm_tile_map_find_frames`.
+ *
+ * :param file: File
+ * :param bot: Basic Offset Table
+ * :param map: Tile map of the image
+ * :param row: Zero-based row of the top left pixel of the region
+ * :param column: Zero-based column of the top left pixel of the region
+ * :param num_rows: Height of the region in pixels
+ * :param num_columns: Width of the region in pixels
+ *
+ * :return: Whether all Frames could be located
+ */
+extern bool dcm_file_prefetch_region(const DcmFile *file,
+                                     const DcmBOT *bot,
+                                     const DcmTileMap *map,
+                                     uint32_t row,
+                                     uint32_t column,
+                                     uint32_t num_rows,
+                                     uint32_t num_columns);
+
 /**
  * Read an individual Frame from a File.
  *
+ * Frames are read with positional I/O, which does not depend on the position
+ * of the underlying stream. Once the metadata has been read, multiple threads
+ * may thus read Frames from the same File concurrently.
+ *
  * :param file: File
  * :param metadata: Metadata
  * :param bot: Basic Offset Table
- * :param index: Zero-based offset of the Frame in the Pixel Data Element
+ * :param index: One-based index of the Frame in the Pixel Data Element
  *
  * :return: Frame
  */
@@ -2005,6 +3019,308 @@ extern DcmFrame *dcm_file_read_frame(const DcmFile *file,
                                      const DcmBOT *bot,
                                      uint32_t index);
 
+/**
+ * Read an individual Frame from a File without copying its pixel data.
+ *
+ * If the File was opened in mode ``'m'``, the pixel data of the returned Frame
+ * points directly into the memory mapping. Otherwise, the pixel data is read
+ * into a buffer that is owned by the Frame. In both cases the descriptive
+ * strings of the Frame are shared with the File and the Frame keeps the File
+ * alive, such that the File may be destroyed before the Frame.
+ *
+ * Requires that the metadata has been read via
+ * :c:func:`dcm_file_read_metadata`.
+ *
+ * :param file: File
+ * :param bot: Basic Offset Table
+ * :param number: One-based index of the Frame in the Pixel Data Element
+ *
+ * :return: Frame
+ */
+extern DcmFrame *dcm_file_read_frame_view(const DcmFile *file,
+                                          const DcmBOT *bot,
+                                          uint32_t number);
+
+/**
+ * Read several Frames from a File at once.
+ *
+ * The requested Frame Items are sorted by their position in the file and
+ * Frame Items that are adjacent are fetched with a single read. The pixel
+ * data of Frames read together is shared by them and released along with the
+ * last of them.
+ *
+ * In case of failure, no Frames are returned.
+ *
+ * :param file: File
+ * :param metadata: Metadata
+ * :param bot: Basic Offset Table
+ * :param numbers: One-based indices of the Frames in the Pixel Data Element
+ * :param num_numbers: Number of Frames to read
+ * :param frames: Array of length ``num_numbers`` to receive the Frames in the
+ *                order of ``numbers``
+ *
+ * :return: Whether the Frames were read successfully
+ */
+extern bool dcm_file_read_frames(const DcmFile *file,
+                                 const DcmDataSet *metadata,
+                                 const DcmBOT *bot,
+                                 const uint32_t *numbers,
+                                 uint32_t num_numbers,
+                                 DcmFrame **frames);
+
+/**
+ * Create a map of the Frames of an image across its Total Pixel Matrix.
+ *
+ * With Dimension Organization Type ``TILED_FULL``, Frames are tiles in
+ * row-major order and only the tiles of the first Focal Plane and Optical
+ * Path are mapped. Otherwise, if the metadata contains Per-Frame Functional
+ * Groups, each Frame is placed at its Plane Position (Slide). Each level of
+ * a pyramid is a separate image with its own map.
+ *
+ * :param metadata: Metadata of the image
+ *
+ * :return: Tile map
+ */
+extern DcmTileMap *dcm_tile_map_create(const DcmDataSet *metadata);
+
+/**
+ * Find the Frames that intersect a region of the Total Pixel Matrix.
+ *
+ * :param map: Tile map
+ * :param row: Zero-based row of the top left pixel of the region
+ * :param column: Zero-based column of the top left pixel of the region
+ * :param num_rows: Height of the region in pixels
+ * :param num_columns: Width of the region in pixels
+ * :param numbers: Array for the one-based Frame numbers
+ * :param capacity: Number of Frame numbers that fit into the array
+ *
+ * :return: Number of Frames, which may exceed `capacity`
+ */
+extern uint32_t dcm_tile_map_find_frames(const DcmTileMap *map,
+                                         uint32_t row,
+                                         uint32_t column,
+                                         uint32_t num_rows,
+                                         uint32_t num_columns,
+                                         uint32_t *numbers,
+                                         uint32_t capacity);
+
+/**
+ * Destroy a tile map.
+ *
+ * :param map: Tile map
+ */
+extern void dcm_tile_map_destroy(DcmTileMap *map);
+
+/**
+ * Read a region of the Total Pixel Matrix into a single buffer.
+ *
+ * The Frames that intersect the region are read together via
+ * :c:func:`dcm_file_read_frames`, decoded in parallel and their pixels
+ * within the region are copied into `buffer`. The region is stored row by
+ * row in the decoded layout of :c:type:`DcmCodec`. Pixels that no Frame
+ * covers are set to zero, and Frames that overlap are copied in
+ * ascending order of their numbers.
+ *
+ * :param file: File
+ * :param metadata: Metadata
+ * :param bot: Basic Offset Table
+ * :param map: Tile map of the image
+ * :param decoder: Decoder to reuse or NULL
+ * :param row: Zero-based row of the top left pixel of the region
+ * :param column: Zero-based column of the top left pixel of the region
+ * :param num_rows: Height of the region in pixels
+ * :param num_columns: Width of the region in pixels
+ * :param buffer: Memory for the pixels of the region
+ * :param size: Size of the memory in bytes
+ *
+ * :return: Whether the region could be read
+ */
+extern bool dcm_file_read_region(const DcmFile *file,
+                                 const DcmDataSet *metadata,
+                                 const DcmBOT *bot,
+                                 const DcmTileMap *map,
+                                 DcmDecoder *decoder,
+                                 uint32_t row,
+                                 uint32_t column,
+                                 uint32_t num_rows,
+                                 uint32_t num_columns,
+                                 char *buffer,
+                                 size_t size);
+
+/**
+ * Read an individual Frame from a File asynchronously.
+ *
+ * The read is served by a pool of threads that is shared by all Files and
+ * started on first use. Once the Frame has been read, ``callback`` is called
+ * from one of these threads with the Frame and ``user_data``. On platforms
+ * without thread support, ``callback`` is called before this function
+ * returns.
+ *
+ * The Frame is read as by :c:func:`dcm_file_read_frame_view`, which requires
+ * that the metadata has been read. The File may be destroyed before the read
+ * has completed; the Basic Offset Table is only used during submission.
+ *
+ * :param file: File
+ * :param bot: Basic Offset Table
+ * :param number: One-based index of the Frame in the Pixel Data Element
+ * :param callback: Function to call on completion
+ * :param user_data: Argument to pass to ``callback``
+ *
+ * :return: Whether the read was submitted; if not, ``callback`` is not called
+ */
+extern bool dcm_file_read_frame_async(const DcmFile *file,
+                                      const DcmBOT *bot,
+                                      uint32_t number,
+                                      DcmFrameCallback callback,
+                                      void *user_data);
+
+/**
+ * Submit an asynchronous read of an individual Frame from a File.
+ *
+ * Like :c:func:`dcm_file_read_frame_async`, but the result is collected with
+ * :c:func:`dcm_frame_request_wait` rather than delivered to a callback.
+ *
+ * :param file: File
+ * :param bot: Basic Offset Table
+ * :param number: One-based index of the Frame in the Pixel Data Element
+ *
+ * :return: Frame Request
+ */
+extern DcmFrameRequest *dcm_file_submit_frame(const DcmFile *file,
+                                              const DcmBOT *bot,
+                                              uint32_t number);
+
+/**
+ * Determine whether the read of a Frame Request has completed.
+ *
+ * :param request: Frame Request
+ *
+ * :return: Whether :c:func:`dcm_frame_request_wait` would return immediately
+ */
+extern bool dcm_frame_request_is_done(const DcmFrameRequest *request);
+
+/**
+ * Wait for the read of a Frame Request to complete and destroy the request.
+ *
+ * :param request: Frame Request
+ *
+ * :return: Frame or NULL if the read failed
+ */
+extern DcmFrame *dcm_frame_request_wait(DcmFrameRequest *request);
+
+/**
+ * Create a Frame Cache.
+ *
+ * A Frame Cache may be shared by several Files and used from several
+ * threads at once. Once the Frames in the cache take more than `max_bytes`,
+ * the least recently read Frames are removed.
+ *
+ * :param max_bytes: Budget for the Frames in the cache in bytes
+ *
+ * :return: Frame Cache
+ */
+extern DcmFrameCache *dcm_frame_cache_create(size_t max_bytes);
+
+/**
+ * Read a Frame through a Frame Cache.
+ *
+ * Like :c:func:`dcm_file_read_frame`, but a Frame that is in the cache is
+ * not read again. The returned Frame shares its value with the cache and
+ * with other callers. It remains valid after the Frame has been removed
+ * from the cache and must be destroyed via :c:func:`dcm_frame_destroy` as
+ * usual. Frames that alone exceed the budget are not cached.
+ *
+ * :param cache: Frame Cache
+ * :param file: File
+ * :param metadata: Metadata
+ * :param bot: Basic Offset Table
+ * :param number: One-based index of the Frame in the Pixel Data Element
+ *
+ * :return: Frame
+ */
+extern DcmFrame *dcm_frame_cache_read_frame(DcmFrameCache *cache,
+                                            const DcmFile *file,
+                                            const DcmDataSet *metadata,
+                                            const DcmBOT *bot,
+                                            uint32_t number);
+
+/**
+ * Get the counters of a Frame Cache.
+ *
+ * :param cache: Frame Cache
+ * :param stats: Pointer to the counters
+ */
+extern void dcm_frame_cache_get_stats(DcmFrameCache *cache,
+                                      DcmFrameCacheStats *stats);
+
+/**
+ * Destroy a Frame Cache.
+ *
+ * Frames that were read through the cache remain valid.
+ *
+ * :param cache: Frame Cache
+ */
+extern void dcm_frame_cache_destroy(DcmFrameCache *cache);
+
+/**
+ * Write the File Meta Information and the Data Set to a File.
+ *
+ * The File must have been created with mode ``'w'``. The Transfer Syntax of
+ * the Data Set is given by the Transfer Syntax UID of the File Meta
+ * Information, whose group length is computed. Pixel Data Elements of the
+ * Data Set are ignored. If the Data Set describes an image, the Frames are
+ * then appended one at a time via :c:func:`dcm_file_write_frame`, so that
+ * only a single Frame needs to be held in memory.
+ *
+ * For encapsulated Transfer Syntaxes, space for the offset table is
+ * reserved in front of the Frames and filled in by
+ * :c:func:`dcm_file_finish_write`. The offsets are stored in the Basic
+ * Offset Table or, if `use_extended_offset_table` is true, in the
+ * Extended Offset Table, which is needed once the Frames exceed 4 GB.
+ *
+ * :param file: File
+ * :param file_meta: File Meta Information
+ * :param metadata: Data Set
+ * :param use_extended_offset_table: Whether to write an Extended Offset
+ *                                   Table rather than a Basic Offset Table
+ *
+ * :return: Whether writing succeeded
+ */
+extern bool dcm_file_write_metadata(DcmFile *file,
+                                    const DcmDataSet *file_meta,
+                                    const DcmDataSet *metadata,
+                                    bool use_extended_offset_table);
+
+/**
+ * Append the next Frame to the Pixel Data of a File.
+ *
+ * Frames are written in order. Native Frames must be exactly as long as
+ * the image description of the Data Set implies, encapsulated Frames are
+ * written as a single Item each.
+ *
+ * :param file: File
+ * :param value: Pixel data of the Frame
+ * :param length: Length of the Frame in bytes
+ *
+ * :return: Whether writing succeeded
+ */
+extern bool dcm_file_write_frame(DcmFile *file,
+                                 const char *value,
+                                 uint32_t length);
+
+/**
+ * Complete writing of a File.
+ *
+ * Fills in the offset table, writes the Data Elements that follow the
+ * Pixel Data and flushes the File. Fails unless all Frames have been
+ * written.
+ *
+ * :param file: File
+ *
+ * :return: Whether writing succeeded
+ */
+extern bool dcm_file_finish_write(DcmFile *file);
+
 /**
  * Destroy a File.
  *
@@ -2012,4 +3328,171 @@ extern DcmFrame *dcm_file_read_frame(const DcmFile *file,
  */
 extern void dcm_file_destroy(DcmFile *file);
 
+/**
+ * Read the Data Sets of the instances of a series.
+ *
+ * The files are read concurrently by the calling thread and the threads
+ * that serve :c:func:`dcm_file_read_frame_async`, and are closed once their
+ * Data Sets have been read, unless the Data Sets are read lazily. Files that
+ * cannot be read are logged and have no Data Sets in the series.
+ *
+ * :param file_paths: Paths to the files on disk
+ * :param num_files: Number of files
+ * :param read_flags: Bitwise combination of :c:type:`DcmReadFlags`, as for
+ *                    :c:func:`dcm_file_set_read_flags`
+ * :param pool: String Pool that is shared by the Data Sets or NULL
+ *
+ * :return: Series with the instances in the order of their paths
+ */
+extern DcmSeries *dcm_series_load(const char *const *file_paths,
+                                  uint32_t num_files,
+                                  uint32_t read_flags,
+                                  DcmStringPool *pool);
+
+/**
+ * Get the number of instances of a series.
+ *
+ * :param series: Series
+ *
+ * :return: Number of instances
+ */
+extern uint32_t dcm_series_get_num_instances(const DcmSeries *series);
+
+/**
+ * Get the File Meta Information of an instance of a series.
+ *
+ * :param series: Series
+ * :param index: Zero-based index of the instance
+ *
+ * :return: File Meta Information, which is owned by the series, or NULL if
+ *          the instance could not be read
+ */
+extern DcmDataSet *dcm_series_get_file_meta(const DcmSeries *series,
+                                            uint32_t index);
+
+/**
+ * Get the metadata of an instance of a series.
+ *
+ * :param series: Series
+ * :param index: Zero-based index of the instance
+ *
+ * :return: Metadata, which is owned by the series, or NULL if the instance
+ *          could not be read
+ */
+extern DcmDataSet *dcm_series_get_metadata(const DcmSeries *series,
+                                           uint32_t index);
+
+/**
+ * Destroy a series and the Data Sets of its instances.
+ *
+ * :param series: Series
+ */
+extern void dcm_series_destroy(DcmSeries *series);
+
+/**
+ * Create a Stream, which parses the content of a File as it arrives, for
+ * example while the File is received over the network.
+ *
+ * Content is pushed in chunks of any size. Unlike
+ * :c:func:`dcm_file_read_metadata`, which treats the end of the content as
+ * the end of the Data Set, the Stream waits for more content until the
+ * Pixel Data Element is reached and only then reads the metadata. Frames
+ * become available one after the other as their Items arrive. The content
+ * is kept in memory until the Stream is destroyed.
+ *
+ * :return: Stream
+ */
+extern DcmStream *dcm_stream_create(void);
+
+/**
+ * Append content to a Stream and parse as much of it as possible.
+ *
+ * Content must be pushed by one thread at a time, but Frames may be read
+ * by other threads meanwhile.
+ *
+ * :param stream: Stream
+ * :param data: Chunk of content, which is copied
+ * :param length: Number of bytes
+ *
+ * :return: State of the Stream
+ */
+extern DcmStreamState dcm_stream_push(DcmStream *stream,
+                                      const char *data,
+                                      size_t length);
+
+/**
+ * Mark the end of the content of a Stream.
+ *
+ * Content that ends before the Pixel Data Element is read like a complete
+ * File. Content that ends before all Frames have arrived is an error, but
+ * the metadata and the Frames that have arrived remain available.
+ *
+ * :param stream: Stream
+ *
+ * :return: State of the Stream
+ */
+extern DcmStreamState dcm_stream_finish(DcmStream *stream);
+
+/**
+ * Get the File Meta Information of a Stream.
+ *
+ * :param stream: Stream
+ *
+ * :return: File Meta Information, which is owned by the Stream, or NULL if
+ *          it has not yet been read
+ */
+extern DcmDataSet *dcm_stream_get_file_meta(const DcmStream *stream);
+
+/**
+ * Get the metadata of a Stream.
+ *
+ * :param stream: Stream
+ *
+ * :return: Metadata, which is owned by the Stream, or NULL if it has not yet
+ *          been read
+ */
+extern DcmDataSet *dcm_stream_get_metadata(const DcmStream *stream);
+
+/**
+ * Get the number of Frames of a Stream that have arrived.
+ *
+ * Frames arrive in order, such that Frames 1 to the returned number can be
+ * read.
+ *
+ * :param stream: Stream
+ *
+ * :return: Number of Frames that have arrived
+ */
+extern uint32_t dcm_stream_get_num_frames(const DcmStream *stream);
+
+/**
+ * Read an individual Frame of a Stream that has arrived.
+ *
+ * :param stream: Stream
+ * :param number: One-based index of the Frame
+ *
+ * :return: Frame
+ */
+extern DcmFrame *dcm_stream_read_frame(const DcmStream *stream,
+                                       uint32_t number);
+
+/**
+ * Get the File through which a Stream reads its content.
+ *
+ * Read flags may be set on the File before content is pushed. Once the
+ * Stream is complete, the File can be used like any other File.
+ *
+ * :param stream: Stream
+ *
+ * :return: File, which is owned by the Stream
+ */
+extern DcmFile *dcm_stream_get_file(const DcmStream *stream);
+
+/**
+ * Destroy a Stream, its Data Sets and its File.
+ *
+ * :param stream: Stream
+ */
+extern void dcm_stream_destroy(DcmStream *stream);
+
 #endif
@@ -0,0 +1,348 @@
+/*
+ * Declarations that are shared by the implementation files, but are not part
+ * of the public interface of the library.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dicom.h"
+
+#ifndef DCM_PRIVATE_INCLUDED
+#define DCM_PRIVATE_INCLUDED
+
+/*
+ * Within the library, the level is checked before a log function is called,
+ * so that messages below the level cost neither a call nor the evaluation
+ * of their arguments.
+ */
+#define DCM_LOG_ENABLED(LEVEL) \
+    (dcm_log_level > DCM_LOG_NOTSET && dcm_log_level <= (LEVEL))
+
+#define dcm_log_critical(...) \
+    (dcm_log_level <= DCM_LOG_CRITICAL ? \
+     dcm_log_critical(__VA_ARGS__) : (void) 0)
+#define dcm_log_error(...) \
+    (DCM_LOG_ENABLED(DCM_LOG_ERROR) ? dcm_log_error(__VA_ARGS__) : (void) 0)
+#define dcm_log_warning(...) \
+    (DCM_LOG_ENABLED(DCM_LOG_WARNING) ? \
+     dcm_log_warning(__VA_ARGS__) : (void) 0)
+#define dcm_log_info(...) \
+    (DCM_LOG_ENABLED(DCM_LOG_INFO) ? dcm_log_info(__VA_ARGS__) : (void) 0)
+#define dcm_log_debug(...) \
+    (DCM_LOG_ENABLED(DCM_LOG_DEBUG) ? dcm_log_debug(__VA_ARGS__) : (void) 0)
+
+/**
+ * Get the number of heap allocations made by the library.
+ *
+ * :return: Number of allocations
+ */
+extern uint64_t dcm_get_num_allocations(void);
+
+/**
+ * Report the start of an operation to the trace hooks, if any.
+ *
+ * :param name: Name of the operation
+ * :param file: File the operation works on or NULL
+ */
+extern void dcm_trace_start(const char *name, const DcmFile *file);
+
+/**
+ * Report the end of an operation to the trace hooks, if any.
+ *
+ * :param name: Name of the operation
+ * :param file: File the operation works on or NULL
+ */
+extern void dcm_trace_end(const char *name, const DcmFile *file);
+
+/**
+ * Region of memory from which objects are carved and freed all at once.
+ *
+ * Memory obtained from an arena is zeroed and is released together with the
+ * arena. Each object that is allocated from an arena and needs it to stay
+ * alive holds a reference to it.
+ */
+typedef struct _DcmArena DcmArena;
+
+/**
+ * Create an empty arena with a single reference.
+ *
+ * :return: Arena
+ */
+extern DcmArena *dcm_arena_create(void);
+
+/**
+ * Add a reference to an arena.
+ *
+ * :param arena: Arena
+ */
+extern void dcm_arena_retain(DcmArena *arena);
+
+/**
+ * Drop a reference to an arena and free its memory with the last reference.
+ *
+ * :param arena: Arena
+ */
+extern void dcm_arena_release(DcmArena *arena);
+
+/**
+ * Allocate zeroed memory from an arena.
+ *
+ * :param arena: Arena
+ * :param size: Number of bytes
+ *
+ * :return: Pointer to memory that is suitably aligned for any type
+ */
+extern void *dcm_arena_alloc(DcmArena *arena, size_t size);
+
+/**
+ * Make an arena the current arena of the calling thread.
+ *
+ * While an arena is current, :c:func:`dcm_malloc` allocates from it and
+ * :c:func:`dcm_free` does not release memory.
+ *
+ * :param arena: Arena or NULL to allocate from the heap
+ *
+ * :return: Previously current arena, to be passed to :c:func:`dcm_arena_leave`
+ */
+extern DcmArena *dcm_arena_enter(DcmArena *arena);
+
+/**
+ * Restore the arena that was current before :c:func:`dcm_arena_enter`.
+ *
+ * :param previous: Previously current arena
+ */
+extern void dcm_arena_leave(DcmArena *previous);
+
+/**
+ * Get the current arena of the calling thread.
+ *
+ * :return: Arena or NULL if memory is allocated from the heap
+ */
+extern DcmArena *dcm_arena_current(void);
+
+/**
+ * Allocate memory from the current arena or the heap.
+ *
+ * Like memory from :c:func:`malloc`, the memory is not necessarily zeroed.
+ *
+ * :param size: Number of bytes
+ *
+ * :return: Pointer to allocated memory
+ */
+extern void *dcm_malloc(size_t size);
+
+/**
+ * Free memory obtained from :c:func:`dcm_malloc`.
+ *
+ * Does nothing while an arena is current, since the memory is released
+ * together with the arena.
+ *
+ * :param ptr: Pointer to allocated memory
+ */
+extern void dcm_free(void *ptr);
+
+/**
+ * Allocate memory with the allocator that was installed with
+ * :c:func:`dcm_set_allocator`, regardless of the current arena.
+ *
+ * :param size: Number of bytes
+ *
+ * :return: Pointer to allocated memory
+ */
+extern void *dcm_heap_malloc(size_t size);
+
+/**
+ * Resize memory from :c:func:`dcm_heap_malloc`.
+ *
+ * :param ptr: Pointer to allocated memory or NULL
+ * :param size: Number of bytes
+ *
+ * :return: Pointer to resized memory
+ */
+extern void *dcm_heap_realloc(void *ptr, size_t size);
+
+/**
+ * Free memory from :c:func:`dcm_heap_malloc` or :c:func:`dcm_heap_realloc`.
+ *
+ * :param ptr: Pointer to allocated memory or NULL
+ */
+extern void dcm_heap_free(void *ptr);
+
+/**
+ * Copy a string into memory from :c:func:`dcm_heap_malloc`.
+ *
+ * :param str: String
+ *
+ * :return: Copy of the string
+ */
+extern char *dcm_strdup(const char *str);
+
+/**
+ * Add a reference to a String Pool.
+ *
+ * :param pool: String Pool
+ */
+extern void dcm_string_pool_retain(DcmStringPool *pool);
+
+/**
+ * Drop a reference to a String Pool and free it with the last reference.
+ *
+ * :param pool: String Pool
+ */
+extern void dcm_string_pool_release(DcmStringPool *pool);
+
+/**
+ * Replace the values of a character string Data Element by pooled copies.
+ *
+ * Values of Data Elements that are allocated from an arena, that are stored
+ * within the Data Element or that are free text are left as they are.
+ *
+ * :param element: Data Element
+ * :param pool: String Pool, which gains a reference if values are replaced
+ */
+extern void dcm_element_intern(DcmElement *element, DcmStringPool *pool);
+
+/**
+ * Location from which the values of lazily read Data Elements are loaded.
+ *
+ * A source refers to the File from which a Data Set was read and, if the
+ * Data Set was allocated from an arena, to that arena.
+ */
+typedef struct _DcmElementSource DcmElementSource;
+
+/**
+ * Add a reference to a source.
+ *
+ * :param source: Source
+ */
+extern void dcm_element_source_retain(DcmElementSource *source);
+
+/**
+ * Drop a reference to a source and free it with the last reference.
+ *
+ * :param source: Source
+ */
+extern void dcm_element_source_release(DcmElementSource *source);
+
+/**
+ * Acquire exclusive use of a source.
+ *
+ * :param source: Source
+ */
+extern void dcm_element_source_lock(DcmElementSource *source);
+
+/**
+ * Release exclusive use of a source.
+ *
+ * :param source: Source
+ */
+extern void dcm_element_source_unlock(DcmElementSource *source);
+
+/**
+ * Read the value of a Data Element from a source.
+ *
+ * The caller must hold the lock of the source.
+ *
+ * :param source: Source
+ * :param tag: Attribute Tag
+ * :param vr: Value Representation
+ * :param length: Value Length as encoded in the Data Element header
+ * :param offset: Offset of the value from the beginning of the File
+ *
+ * :return: Data Element with the decoded value
+ */
+extern DcmElement *dcm_element_source_load(DcmElementSource *source,
+                                           uint32_t tag,
+                                           const char *vr,
+                                           uint32_t length,
+                                           size_t offset);
+
+/**
+ * Create a Data Element whose value is read from a source on first access.
+ *
+ * :param tag: Attribute Tag
+ * :param vr: Value Representation
+ * :param length: Value Length as encoded in the Data Element header
+ * :param source: Source, which gains a reference
+ * :param offset: Offset of the value from the beginning of the File
+ *
+ * :return: Data Element
+ */
+extern DcmElement *dcm_element_create_lazy(uint32_t tag,
+                                           const char *vr,
+                                           uint32_t length,
+                                           DcmElementSource *source,
+                                           size_t offset);
+
+/**
+ * Function that receives encoded content.
+ *
+ * :param writer: Destination that was passed to the encoding function
+ * :param data: Encoded bytes
+ * :param length: Number of bytes
+ *
+ * :return: Whether the bytes could be written
+ */
+typedef bool (*DcmWriteFunction)(void *writer,
+                                 const char *data,
+                                 size_t length);
+
+/**
+ * Encode the header of a Data Element in Little Endian byte order.
+ *
+ * Item and Delimitation headers are encoded by passing NULL as the Value
+ * Representation.
+ *
+ * :param tag: Attribute Tag
+ * :param vr: Value Representation or NULL
+ * :param length: Value Length
+ * :param implicit: Whether the Value Representation is implicit
+ * :param write: Function that receives the encoding
+ * :param writer: Destination for the function
+ *
+ * :return: Whether encoding succeeded
+ */
+extern bool dcm_element_encode_header(uint32_t tag,
+                                      const char *vr,
+                                      uint32_t length,
+                                      bool implicit,
+                                      DcmWriteFunction write,
+                                      void *writer);
+
+/**
+ * Encode the Data Elements of a Data Set in Little Endian byte order.
+ *
+ * Only Data Elements with tags between the first and the last tag are
+ * encoded. Sequences and their Items are encoded with undefined length.
+ *
+ * :param dataset: Data Set
+ * :param implicit: Whether the Value Representation is implicit
+ * :param first_tag: Smallest Attribute Tag that is encoded
+ * :param last_tag: Largest Attribute Tag that is encoded
+ * :param write: Function that receives the encoding
+ * :param writer: Destination for the function
+ *
+ * :return: Whether encoding succeeded
+ */
+extern bool dcm_dataset_encode(const DcmDataSet *dataset,
+                               bool implicit,
+                               uint32_t first_tag,
+                               uint32_t last_tag,
+                               DcmWriteFunction write,
+                               void *writer);
+
+/**
+ * Call a function for each index of a range, spread over the read threads.
+ *
+ * The calling thread takes part and the function returns once all calls
+ * have returned.
+ *
+ * :param count: Number of indices
+ * :param function: Function that is called with `arg` and each index
+ * :param arg: Argument passed to the function
+ */
+extern void dcm_run_parallel(uint32_t count,
+                             void (*function)(void *arg, uint32_t index),
+                             void *arg);
+
+#endif
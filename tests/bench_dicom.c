@@ -0,0 +1,737 @@
+/*
+ * Microbenchmarks of the library.
+ *
+ * Each benchmark is repeated until it has run for a minimum time and is
+ * reported in nanoseconds and, where it reads data, megabytes per second of
+ * input. With glibc, the number of heap allocations per operation is
+ * reported as well, by counting calls of malloc, calloc and realloc.
+ *
+ * Results can be saved and later compared against, for example to check a
+ * change for performance regressions:
+ *
+ *     bench_dicom -s baseline.txt FILE_PATH
+ *     bench_dicom -c baseline.txt FILE_PATH
+ */
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/dicom.h"
+
+
+static const char usage[] = "usage: bench_dicom [-t SECONDS] [-s RESULTS] "
+                            "[-c BASELINE] [-r PERCENT] [-h] FILE_PATH\n";
+
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && \
+    !defined(__SANITIZE_THREAD__)
+#define COUNT_ALLOCATIONS 1
+
+static atomic_ulong num_allocations;
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&num_allocations, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    atomic_fetch_add_explicit(&num_allocations, 1, memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&num_allocations, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+
+/**
+ * Number of Frames of the generated large files.
+ */
+#define NUM_FRAMES 100000
+
+/**
+ * Number of Items of the generated wide Sequence.
+ */
+#define NUM_ITEMS 10000
+
+/**
+ * Nesting depth of the generated deep Sequence.
+ */
+#define SEQUENCE_DEPTH 64
+
+
+struct Buffer {
+    char *data;
+    size_t size;
+};
+
+
+struct Baseline {
+    char name[64];
+    double ns_per_op;
+};
+
+
+static struct {
+    double min_seconds;
+    FILE *results;
+    struct Baseline *baseline;
+    size_t num_baseline;
+    double tolerance;
+    bool regressed;
+} bench = {0.5, NULL, NULL, 0, 20.0, false};
+
+
+// Prevents the compiler from dropping the work of a benchmark
+static volatile uintptr_t sink;
+
+
+static double get_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
+
+
+static unsigned long get_num_allocations(void)
+{
+#ifdef COUNT_ALLOCATIONS
+    return atomic_load(&num_allocations);
+#else
+    return 0;
+#endif
+}
+
+
+static const struct Baseline *find_baseline(const char *name)
+{
+    size_t i;
+    for (i = 0; i < bench.num_baseline; i++) {
+        if (strcmp(bench.baseline[i].name, name) == 0) {
+            return &bench.baseline[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Run a benchmark with doubling numbers of operations until the minimum
+ * time has passed and report the last run.
+ */
+static void measure(const char *name,
+                    size_t bytes_per_op,
+                    void (*run)(void *arg, uint64_t num_ops),
+                    void *arg)
+{
+    uint64_t num_ops = 1;
+    double seconds;
+    unsigned long allocations;
+
+    while (true) {
+        unsigned long first_allocation = get_num_allocations();
+        double start = get_seconds();
+        run(arg, num_ops);
+        seconds = get_seconds() - start;
+        allocations = get_num_allocations() - first_allocation;
+        if (seconds >= bench.min_seconds || num_ops >= (UINT64_C(1) << 40)) {
+            break;
+        }
+        // Aim directly for the minimum time once the run is long enough
+        // to be timed reliably
+        if (seconds > 0.01) {
+            uint64_t estimate = (uint64_t) (num_ops * 1.2 *
+                                            bench.min_seconds / seconds);
+            num_ops = estimate > num_ops * 2 ? estimate : num_ops * 2;
+        } else {
+            num_ops *= 2;
+        }
+    }
+
+    double ns_per_op = seconds * 1e9 / (double) num_ops;
+    printf("%-32s %12.1f ns/op", name, ns_per_op);
+    if (bytes_per_op > 0) {
+        printf(" %10.1f MB/s",
+               (double) bytes_per_op * num_ops / seconds / 1e6);
+    } else {
+        printf(" %15s", "");
+    }
+#ifdef COUNT_ALLOCATIONS
+    printf(" %10.1f allocs/op", (double) allocations / (double) num_ops);
+#else
+    (void) allocations;
+#endif
+
+    const struct Baseline *baseline = find_baseline(name);
+    if (baseline) {
+        double change = (ns_per_op / baseline->ns_per_op - 1.0) * 100.0;
+        printf(" %+7.1f%%", change);
+        if (change > bench.tolerance) {
+            printf(" REGRESSION");
+            bench.regressed = true;
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+
+    if (bench.results) {
+        fprintf(bench.results, "%s %.3f\n", name, ns_per_op);
+    }
+}
+
+
+static bool load_baseline(const char *path)
+{
+    FILE *stream = fopen(path, "r");
+    if (stream == NULL) {
+        fprintf(stderr, "Could not open baseline '%s'.\n", path);
+        return false;
+    }
+    struct Baseline entry;
+    while (fscanf(stream, "%63s %lf", entry.name, &entry.ns_per_op) == 2) {
+        struct Baseline *baseline = realloc(bench.baseline,
+                                            (bench.num_baseline + 1) *
+                                            sizeof(struct Baseline));
+        if (baseline == NULL) {
+            fclose(stream);
+            return false;
+        }
+        bench.baseline = baseline;
+        bench.baseline[bench.num_baseline++] = entry;
+    }
+    fclose(stream);
+    return true;
+}
+
+
+static bool load_file(const char *path, struct Buffer *buffer)
+{
+    FILE *stream = fopen(path, "rb");
+    if (stream == NULL) {
+        fprintf(stderr, "Could not open file '%s'.\n", path);
+        return false;
+    }
+    fseek(stream, 0, SEEK_END);
+    long size = ftell(stream);
+    fseek(stream, 0, SEEK_SET);
+    buffer->data = malloc(size > 0 ? (size_t) size : 1);
+    buffer->size = size > 0 ? (size_t) size : 0;
+    bool success = buffer->data &&
+                   fread(buffer->data, 1, buffer->size, stream) ==
+                   buffer->size;
+    fclose(stream);
+    if (!success) {
+        fprintf(stderr, "Could not read file '%s'.\n", path);
+    }
+    return success;
+}
+
+
+static char *copy_string(const char *value)
+{
+    char *copy = malloc(strlen(value) + 1);
+    strcpy(copy, value);
+    return copy;
+}
+
+
+// Generators of synthetic files
+
+static DcmDataSet *create_file_meta(const char *transfer_syntax_uid)
+{
+    DcmDataSet *file_meta = dcm_dataset_create();
+    dcm_dataset_insert(file_meta,
+                       dcm_element_create_UI(0x00020002,
+                                             copy_string("1.2.840.10008."
+                                                         "5.1.4.1.1.7")));
+    dcm_dataset_insert(file_meta,
+                       dcm_element_create_UI(0x00020003,
+                                             copy_string("1.2.3.4.5")));
+    dcm_dataset_insert(file_meta,
+                       dcm_element_create_UI(0x00020010,
+                                             copy_string(transfer_syntax_uid)));
+    dcm_dataset_insert(file_meta,
+                       dcm_element_create_UI(0x00020012,
+                                             copy_string("1.2.3.4")));
+    return file_meta;
+}
+
+
+static DcmDataSet *create_metadata(void)
+{
+    DcmDataSet *metadata = dcm_dataset_create();
+    dcm_dataset_insert(metadata,
+                       dcm_element_create_UI(0x00080016,
+                                             copy_string("1.2.840.10008."
+                                                         "5.1.4.1.1.7")));
+    dcm_dataset_insert(metadata,
+                       dcm_element_create_UI(0x00080018,
+                                             copy_string("1.2.3.4.5")));
+    return metadata;
+}
+
+
+/**
+ * Write a file with many small Frames of 16 x 16 8-bit pixels.
+ */
+static bool write_frames_file(const char *path,
+                              const char *transfer_syntax_uid,
+                              uint32_t frame_length)
+{
+    char number_of_frames[16];
+    char frame[256];
+    uint32_t i;
+
+    DcmDataSet *file_meta = create_file_meta(transfer_syntax_uid);
+    DcmDataSet *metadata = create_metadata();
+    snprintf(number_of_frames, sizeof(number_of_frames), "%d", NUM_FRAMES);
+    dcm_dataset_insert(metadata,
+                       dcm_element_create_US(0x00280002, 1));
+    dcm_dataset_insert(metadata,
+                       dcm_element_create_CS(0x00280004,
+                                             copy_string("MONOCHROME2")));
+    dcm_dataset_insert(metadata, dcm_element_create_US(0x00280006, 0));
+    dcm_dataset_insert(metadata,
+                       dcm_element_create_IS(0x00280008,
+                                             copy_string(number_of_frames)));
+    dcm_dataset_insert(metadata, dcm_element_create_US(0x00280010, 16));
+    dcm_dataset_insert(metadata, dcm_element_create_US(0x00280011, 16));
+    dcm_dataset_insert(metadata, dcm_element_create_US(0x00280100, 8));
+    dcm_dataset_insert(metadata, dcm_element_create_US(0x00280101, 8));
+    dcm_dataset_insert(metadata, dcm_element_create_US(0x00280102, 7));
+    dcm_dataset_insert(metadata, dcm_element_create_US(0x00280103, 0));
+
+    DcmFile *file = dcm_file_create(path, 'w');
+    bool success = file &&
+                   dcm_file_write_metadata(file, file_meta, metadata, false);
+    for (i = 0; success && i < NUM_FRAMES; i++) {
+        memset(frame, (int) (i & 0xFF), sizeof(frame));
+        success = dcm_file_write_frame(file, frame, frame_length);
+    }
+    success = success && dcm_file_finish_write(file);
+    dcm_file_destroy(file);
+    dcm_dataset_destroy(metadata);
+    dcm_dataset_destroy(file_meta);
+    return success;
+}
+
+
+static DcmDataSet *create_deep_item(uint32_t depth)
+{
+    DcmDataSet *item = dcm_dataset_create();
+    dcm_dataset_insert(item,
+                       dcm_element_create_CS(0x0040A040,
+                                             copy_string("CONTAINER")));
+    if (depth > 1) {
+        DcmSequence *seq = dcm_sequence_create();
+        dcm_sequence_append(seq, create_deep_item(depth - 1));
+        dcm_dataset_insert(item, dcm_element_create_SQ(0x0040A730, seq));
+    }
+    return item;
+}
+
+
+/**
+ * Write a file with a Sequence of many Items and a deeply nested Sequence.
+ */
+static bool write_sequences_file(const char *path)
+{
+    uint32_t i;
+
+    DcmDataSet *file_meta = create_file_meta("1.2.840.10008.1.2.1");
+    DcmDataSet *metadata = create_metadata();
+
+    DcmSequence *deep = dcm_sequence_create();
+    dcm_sequence_append(deep, create_deep_item(SEQUENCE_DEPTH));
+    dcm_dataset_insert(metadata, dcm_element_create_SQ(0x0040A730, deep));
+
+    DcmSequence *wide = dcm_sequence_create();
+    for (i = 0; i < NUM_ITEMS; i++) {
+        DcmDataSet *position = dcm_dataset_create();
+        dcm_dataset_insert(position,
+                           dcm_element_create_SL(0x0048021E, (int32_t) i));
+        dcm_dataset_insert(position,
+                           dcm_element_create_SL(0x0048021F, (int32_t) i));
+        DcmSequence *positions = dcm_sequence_create();
+        dcm_sequence_append(positions, position);
+        DcmDataSet *groups = dcm_dataset_create();
+        dcm_dataset_insert(groups,
+                           dcm_element_create_SQ(0x0048021A, positions));
+        dcm_sequence_append(wide, groups);
+    }
+    dcm_dataset_insert(metadata, dcm_element_create_SQ(0x52009230, wide));
+
+    DcmFile *file = dcm_file_create(path, 'w');
+    bool success = file &&
+                   dcm_file_write_metadata(file, file_meta, metadata, false) &&
+                   dcm_file_finish_write(file);
+    dcm_file_destroy(file);
+    dcm_dataset_destroy(metadata);
+    dcm_dataset_destroy(file_meta);
+    return success;
+}
+
+
+static bool create_temp_path(char *path, size_t size, const char *name)
+{
+    const char *directory = getenv("TMPDIR");
+    if (directory == NULL || directory[0] == '\0') {
+        directory = "/tmp";
+    }
+    snprintf(path, size, "%s/libdicom-bench-%s-XXXXXX", directory, name);
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "Could not create temporary file '%s'.\n", path);
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+
+// Benchmarks
+
+struct ParseArgs {
+    const struct Buffer *buffer;
+    uint32_t read_flags;
+};
+
+
+static void run_parse(void *arg, uint64_t num_ops)
+{
+    const struct ParseArgs *args = (const struct ParseArgs *) arg;
+    DcmParseHandlers handlers = {0};
+    uint64_t i;
+
+    for (i = 0; i < num_ops; i++) {
+        DcmFile *file = dcm_file_create_memory(args->buffer->data,
+                                               args->buffer->size);
+        sink += dcm_file_parse(file, &handlers, NULL);
+        dcm_file_destroy(file);
+    }
+}
+
+
+static void run_read_metadata(void *arg, uint64_t num_ops)
+{
+    const struct ParseArgs *args = (const struct ParseArgs *) arg;
+    uint64_t i;
+
+    for (i = 0; i < num_ops; i++) {
+        DcmFile *file = dcm_file_create_memory(args->buffer->data,
+                                               args->buffer->size);
+        dcm_file_set_read_flags(file, args->read_flags);
+        DcmDataSet *metadata = dcm_file_read_metadata(file);
+        sink += (uintptr_t) metadata;
+        dcm_dataset_destroy(metadata);
+        dcm_file_destroy(file);
+    }
+}
+
+
+struct FileArgs {
+    DcmFile *file;
+    DcmDataSet *metadata;
+    DcmBOT *bot;
+    uint32_t num_frames;
+};
+
+
+static void run_build_bot(void *arg, uint64_t num_ops)
+{
+    const struct FileArgs *args = (const struct FileArgs *) arg;
+    uint64_t i;
+
+    for (i = 0; i < num_ops; i++) {
+        DcmBOT *bot = dcm_file_build_bot(args->file, args->metadata);
+        sink += (uintptr_t) bot;
+        dcm_bot_destroy(bot);
+    }
+}
+
+
+static void read_frames(const struct FileArgs *args,
+                        uint64_t num_ops,
+                        bool random)
+{
+    uint32_t state = 12345;
+    uint64_t i;
+
+    for (i = 0; i < num_ops; i++) {
+        uint32_t index = (uint32_t) (i % args->num_frames);
+        if (random) {
+            // Linear congruential generator, as in many C libraries
+            state = state * 1103515245 + 12345;
+            index = (state >> 8) % args->num_frames;
+        }
+        DcmFrame *frame = dcm_file_read_frame(args->file,
+                                              args->metadata,
+                                              args->bot,
+                                              index + 1);
+        sink += (uintptr_t) frame;
+        dcm_frame_destroy(frame);
+    }
+}
+
+
+static void run_read_frames_sequential(void *arg, uint64_t num_ops)
+{
+    read_frames((const struct FileArgs *) arg, num_ops, false);
+}
+
+
+static void run_read_frames_random(void *arg, uint64_t num_ops)
+{
+    read_frames((const struct FileArgs *) arg, num_ops, true);
+}
+
+
+struct LookupArgs {
+    const DcmDataSet *dataset;
+    uint32_t *tags;
+    uint32_t num_tags;
+};
+
+
+static void run_dataset_get(void *arg, uint64_t num_ops)
+{
+    const struct LookupArgs *args = (const struct LookupArgs *) arg;
+    uint64_t i;
+
+    for (i = 0; i < num_ops; i++) {
+        sink += (uintptr_t) dcm_dataset_get(args->dataset,
+                                            args->tags[i % args->num_tags]);
+    }
+}
+
+
+static void run_dict_lookup_keyword(void *arg, uint64_t num_ops)
+{
+    const struct LookupArgs *args = (const struct LookupArgs *) arg;
+    uint64_t i;
+
+    for (i = 0; i < num_ops; i++) {
+        sink += (uintptr_t) dcm_dict_lookup_keyword(
+            args->tags[i % args->num_tags]);
+    }
+}
+
+
+static void run_dict_lookup_tag(void *arg, uint64_t num_ops)
+{
+    const char *const keywords[] = {
+        "SOPClassUID", "Rows", "Columns", "NumberOfFrames",
+        "PixelData", "TotalPixelMatrixRows", "StudyInstanceUID",
+        "PerFrameFunctionalGroupsSequence"
+    };
+    const uint32_t num_keywords = sizeof(keywords) / sizeof(keywords[0]);
+    uint32_t tag;
+    uint64_t i;
+
+    (void) arg;
+    for (i = 0; i < num_ops; i++) {
+        sink += dcm_dict_lookup_tag(keywords[i % num_keywords], &tag);
+        sink += tag;
+    }
+}
+
+
+static bool open_frames_file(const char *path, struct FileArgs *args)
+{
+    args->file = dcm_file_create(path, 'r');
+    args->metadata = args->file ? dcm_file_read_metadata(args->file) : NULL;
+    args->bot = args->metadata ?
+                dcm_file_build_bot(args->file, args->metadata) : NULL;
+    args->num_frames = NUM_FRAMES;
+    return args->bot != NULL;
+}
+
+
+static void close_frames_file(struct FileArgs *args)
+{
+    dcm_bot_destroy(args->bot);
+    dcm_dataset_destroy(args->metadata);
+    dcm_file_destroy(args->file);
+}
+
+
+static bool bench_sample_file(const char *file_path)
+{
+    struct Buffer buffer;
+    if (!load_file(file_path, &buffer)) {
+        return false;
+    }
+
+    struct ParseArgs parse = {&buffer, DCM_READ_DEFAULT};
+    measure("parse", buffer.size, run_parse, &parse);
+    measure("read_metadata", buffer.size, run_read_metadata, &parse);
+    parse.read_flags = DCM_READ_ARENA;
+    measure("read_metadata_arena", buffer.size, run_read_metadata, &parse);
+    parse.read_flags = DCM_READ_LAZY;
+    measure("read_metadata_lazy", buffer.size, run_read_metadata, &parse);
+
+    DcmFile *file = dcm_file_create_memory(buffer.data, buffer.size);
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    if (metadata == NULL) {
+        dcm_file_destroy(file);
+        free(buffer.data);
+        return false;
+    }
+    struct LookupArgs lookup = {metadata, NULL, dcm_dataset_count(metadata)};
+    lookup.tags = calloc(lookup.num_tags, sizeof(uint32_t));
+    dcm_dataset_copy_tags(metadata, lookup.tags, lookup.num_tags);
+    measure("dataset_get", 0, run_dataset_get, &lookup);
+    measure("dict_lookup_keyword", 0, run_dict_lookup_keyword, &lookup);
+    measure("dict_lookup_tag", 0, run_dict_lookup_tag, NULL);
+
+    free(lookup.tags);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+    free(buffer.data);
+    return true;
+}
+
+
+static bool bench_frames_file(const char *name,
+                              const char *transfer_syntax_uid,
+                              uint32_t frame_length)
+{
+    char path[4096];
+    char label[64];
+    struct FileArgs args;
+
+    if (!create_temp_path(path, sizeof(path), name)) {
+        return false;
+    }
+    bool success = write_frames_file(path, transfer_syntax_uid, frame_length) &&
+                   open_frames_file(path, &args);
+    if (success) {
+        snprintf(label, sizeof(label), "build_bot_%s", name);
+        measure(label, 0, run_build_bot, &args);
+        snprintf(label, sizeof(label), "read_frame_%s_sequential", name);
+        measure(label, frame_length, run_read_frames_sequential, &args);
+        snprintf(label, sizeof(label), "read_frame_%s_random", name);
+        measure(label, frame_length, run_read_frames_random, &args);
+        close_frames_file(&args);
+    } else {
+        fprintf(stderr, "Could not generate file '%s'.\n", path);
+    }
+    remove(path);
+    return success;
+}
+
+
+static bool bench_sequences_file(void)
+{
+    char path[4096];
+    struct Buffer buffer;
+
+    if (!create_temp_path(path, sizeof(path), "sequences")) {
+        return false;
+    }
+    bool success = write_sequences_file(path) && load_file(path, &buffer);
+    remove(path);
+    if (!success) {
+        fprintf(stderr, "Could not generate file '%s'.\n", path);
+        return false;
+    }
+
+    struct ParseArgs parse = {&buffer, DCM_READ_DEFAULT};
+    measure("parse_sequences", buffer.size, run_parse, &parse);
+    measure("read_metadata_sequences", buffer.size,
+            run_read_metadata, &parse);
+    parse.read_flags = DCM_READ_PARALLEL;
+    measure("read_metadata_sequences_parallel", buffer.size,
+            run_read_metadata, &parse);
+    free(buffer.data);
+    return true;
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *save_path = NULL;
+    int i;
+
+    dcm_log_level = DCM_LOG_ERROR;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        switch (argv[i][1]) {
+            case 'h':
+                printf("%s\n", usage);
+                return EXIT_SUCCESS;
+            case 't':
+                if (++i == argc) {
+                    fprintf(stderr, "%s\n", usage);
+                    return EXIT_FAILURE;
+                }
+                bench.min_seconds = atof(argv[i]);
+                break;
+            case 's':
+                if (++i == argc) {
+                    fprintf(stderr, "%s\n", usage);
+                    return EXIT_FAILURE;
+                }
+                save_path = argv[i];
+                break;
+            case 'c':
+                if (++i == argc || !load_baseline(argv[i])) {
+                    fprintf(stderr, "%s\n", usage);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'r':
+                if (++i == argc) {
+                    fprintf(stderr, "%s\n", usage);
+                    return EXIT_FAILURE;
+                }
+                bench.tolerance = atof(argv[i]);
+                break;
+            default:
+                fprintf(stderr, "%s\n", usage);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if ((i + 1) != argc) {
+        fprintf(stderr, "%s\n", usage);
+        return EXIT_FAILURE;
+    }
+
+    if (save_path) {
+        bench.results = fopen(save_path, "w");
+        if (bench.results == NULL) {
+            fprintf(stderr, "Could not open results '%s'.\n", save_path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bool success = bench_sample_file(argv[i]) &&
+                   bench_frames_file("native", "1.2.840.10008.1.2.1", 256) &&
+                   bench_frames_file("encapsulated",
+                                     "1.2.840.10008.1.2.5", 64) &&
+                   bench_sequences_file();
+
+    if (bench.results) {
+        fclose(bench.results);
+    }
+    free(bench.baseline);
+    if (!success) {
+        return EXIT_FAILURE;
+    }
+    return bench.regressed ? 2 : EXIT_SUCCESS;
+}
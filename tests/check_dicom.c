@@ -1,4 +1,10 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <check.h>
 
 #include "../src/dicom.h"
@@ -40,6 +46,119 @@ START_TEST(test_log_level)
 END_TEST
 
 
+struct CountingAllocator {
+    atomic_int num_allocations;
+    atomic_int num_releases;
+    // Number of allocations that succeed, or zero for no limit
+    int max_allocations;
+};
+
+
+static void *counting_allocate(void *user_data, size_t size)
+{
+    struct CountingAllocator *counts = user_data;
+    if (counts->max_allocations > 0 &&
+        atomic_load(&counts->num_allocations) >= counts->max_allocations) {
+        return NULL;
+    }
+    atomic_fetch_add(&counts->num_allocations, 1);
+    return malloc(size);
+}
+
+
+static void *counting_reallocate(void *user_data, void *ptr, size_t size)
+{
+    struct CountingAllocator *counts = user_data;
+    atomic_fetch_add(&counts->num_allocations, 1);
+    return realloc(ptr, size);
+}
+
+
+static void counting_release(void *user_data, void *ptr)
+{
+    struct CountingAllocator *counts = user_data;
+    atomic_fetch_add(&counts->num_releases, 1);
+    free(ptr);
+}
+
+
+struct LogCapture {
+    DcmLogLevel level;
+    char message[256];
+};
+
+
+static void capture_log(void *user_data,
+                        DcmLogLevel level,
+                        const char *message)
+{
+    struct LogCapture *capture = user_data;
+    capture->level = level;
+    snprintf(capture->message, sizeof(capture->message), "%s", message);
+}
+
+
+START_TEST(test_allocator_and_log)
+{
+    const DcmAllocator incomplete = {counting_allocate, NULL, NULL};
+    ck_assert_int_eq(dcm_set_allocator(&incomplete, NULL), false);
+
+    struct CountingAllocator counts = {0, 0, 0};
+    const DcmAllocator functions = {
+        counting_allocate,
+        counting_reallocate,
+        counting_release,
+    };
+    ck_assert_int_eq(dcm_set_allocator(&functions, &counts), true);
+
+    DcmFile *file = dcm_file_create("./data/test_files/sm_image.dcm", 'r');
+    ck_assert_ptr_nonnull(file);
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    ck_assert_ptr_nonnull(metadata);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+
+    ck_assert_int_gt(atomic_load(&counts.num_allocations), 0);
+    ck_assert_int_gt(atomic_load(&counts.num_releases), 0);
+    ck_assert_int_eq(dcm_set_allocator(NULL, NULL), true);
+
+    // Streams release what they allocated wherever their creation fails
+    for (int max_allocations = 1; ; max_allocations++) {
+        struct CountingAllocator limited = {0, 0, max_allocations};
+        ck_assert_int_eq(dcm_set_allocator(&functions, &limited), true);
+        DcmStream *stream = dcm_stream_create();
+        dcm_stream_destroy(stream);
+        ck_assert_int_eq(dcm_set_allocator(NULL, NULL), true);
+        ck_assert_int_eq(atomic_load(&limited.num_allocations),
+                         atomic_load(&limited.num_releases));
+        if (stream) {
+            break;
+        }
+    }
+
+    DcmLogLevel log_level = dcm_log_level;
+    dcm_log_level = DCM_LOG_ERROR;
+    struct LogCapture capture = {DCM_LOG_NOTSET, ""};
+    dcm_set_log_function(capture_log, &capture);
+
+    // messages below the log level do not reach the function
+    dcm_log_warning("Not captured.");
+    ck_assert_int_eq(capture.level, DCM_LOG_NOTSET);
+
+    dcm_log_error("Captured %d.", 42);
+    ck_assert_int_eq(capture.level, DCM_LOG_ERROR);
+    ck_assert_str_eq(capture.message, "Captured 42.");
+
+    capture.level = DCM_LOG_NOTSET;
+    ck_assert_ptr_null(dcm_file_create("./data/test_files/missing.dcm", 'r'));
+    ck_assert_int_eq(capture.level, DCM_LOG_ERROR);
+
+    dcm_set_log_function(NULL, NULL);
+    dcm_log_level = log_level;
+}
+END_TEST
+
+
 START_TEST(test_tag_validity_checks)
 {
     ck_assert_int_eq(dcm_is_valid_tag(0x00280008), true);
@@ -59,6 +178,7 @@ START_TEST(test_vr_validity_checks)
     ck_assert_int_eq(dcm_is_valid_vr("SQ"), true);
     ck_assert_int_eq(dcm_is_valid_vr("US"), true);
     ck_assert_int_eq(dcm_is_valid_vr("AE"), true);
+    ck_assert_int_eq(dcm_is_valid_vr("UV"), true);
 
     ck_assert_int_eq(dcm_is_valid_vr("A"), false);
     ck_assert_int_eq(dcm_is_valid_vr("ABC"), false);
@@ -82,6 +202,10 @@ START_TEST(test_dict_tag_lookups)
     ck_assert_str_eq(dcm_dict_lookup_keyword(0x00620021), "TrackingUID");
     ck_assert_str_eq(dcm_dict_lookup_keyword(0x00660031), "AlgorithmVersion");
     ck_assert_str_eq(dcm_dict_lookup_keyword(0x00701305), "Plane");
+    // First and last entries of the dictionary
+    ck_assert_str_eq(dcm_dict_lookup_keyword(0x00000000), "CommandGroupLength");
+    ck_assert_str_eq(dcm_dict_lookup_keyword(0xFFFCFFFC),
+                     "DataSetTrailingPadding");
 }
 END_TEST
 
@@ -114,6 +238,7 @@ START_TEST(test_element_AE)
 
     ck_assert_int_eq(dcm_element_get_tag(element), tag);
     ck_assert_int_eq(dcm_element_check_vr(element, "AE"), true);
+    ck_assert_str_eq(dcm_element_get_vr(element), "AE");
     ck_assert_int_eq(dcm_element_get_length(element),
                      compute_length_of_string_value(value));
     ck_assert_int_eq(dcm_element_is_multivalued(element), false);
@@ -170,6 +295,7 @@ START_TEST(test_element_CS_multivalue)
 
     for (uint32_t i = 0; i < vm; i++) {
         ck_assert_str_eq(values[i], dcm_element_get_value_CS(element, i));
+        ck_assert_str_eq(values[i], dcm_element_get_value_string(element, i));
     }
 
     dcm_element_print(element, 0);
@@ -333,6 +459,37 @@ START_TEST(test_element_US)
 END_TEST
 
 
+START_TEST(test_element_single_values)
+{
+    // Short and long single values, which are stored differently
+    const char *strings[2] = {"MONOCHROME2", "1.2.840.10008.5.1.4.1.1.77.1.6"};
+    uint32_t i;
+
+    for (i = 0; i < 2; i++) {
+        char **values = malloc(sizeof(char *));
+        values[0] = strdup(strings[i]);
+        DcmElement *element = dcm_element_create_UI_multi(0x00080016,
+                                                          values,
+                                                          1);
+        ck_assert_int_eq(dcm_element_is_multivalued(element), false);
+        ck_assert_str_eq(dcm_element_get_value_UI(element, 0), strings[i]);
+
+        DcmElement *clone = dcm_element_clone(element);
+        dcm_element_destroy(element);
+        ck_assert_str_eq(dcm_element_get_value_UI(clone, 0), strings[i]);
+        dcm_element_destroy(clone);
+    }
+
+    DcmElement *element = dcm_element_create_FD(0x00180050, 0.25);
+    DcmElement *clone = dcm_element_clone(element);
+    dcm_element_destroy(element);
+    ck_assert_uint_eq(dcm_element_get_length(clone), sizeof(double));
+    ck_assert(dcm_element_get_value_FD(clone, 0) == 0.25);
+    dcm_element_destroy(clone);
+}
+END_TEST
+
+
 START_TEST(test_sequence)
 {
     DcmElement *element;
@@ -418,6 +575,71 @@ START_TEST(test_dataset)
 END_TEST
 
 
+START_TEST(test_dataset_frame_values)
+{
+    uint32_t i;
+    double x[4], spacing[4];
+    int32_t column[4];
+    double *number_columns[2] = {x, spacing};
+    int32_t *integer_columns[1] = {column};
+
+    DcmSequence *per_frame = dcm_sequence_create();
+    for (i = 0; i < 3; i++) {
+        DcmDataSet *position = dcm_dataset_create();
+        char *value = malloc(DCM_CAPACITY_DS + 1);
+        snprintf(value, DCM_CAPACITY_DS + 1, "%u.25", i);
+        dcm_dataset_insert(position, dcm_element_create_DS(0x0040072A, value));
+        dcm_dataset_insert(position,
+                           dcm_element_create_SL(0x0048021E, 1 + 10 * i));
+        DcmSequence *positions = dcm_sequence_create();
+        dcm_sequence_append(positions, position);
+        DcmDataSet *item = dcm_dataset_create();
+        dcm_dataset_insert(item, dcm_element_create_SQ(0x0048021A, positions));
+        dcm_sequence_append(per_frame, item);
+    }
+    DcmDataSet *measures = dcm_dataset_create();
+    char *thickness = malloc(DCM_CAPACITY_DS + 1);
+    strncpy(thickness, " 1E-2", 6);
+    dcm_dataset_insert(measures, dcm_element_create_DS(0x00180050, thickness));
+    DcmSequence *measures_seq = dcm_sequence_create();
+    dcm_sequence_append(measures_seq, measures);
+    DcmDataSet *shared_item = dcm_dataset_create();
+    dcm_dataset_insert(shared_item,
+                       dcm_element_create_SQ(0x00289110, measures_seq));
+    DcmSequence *shared = dcm_sequence_create();
+    dcm_sequence_append(shared, shared_item);
+
+    DcmDataSet *dataset = dcm_dataset_create();
+    dcm_dataset_insert(dataset, dcm_element_create_SQ(0x52009229, shared));
+    dcm_dataset_insert(dataset, dcm_element_create_SQ(0x52009230, per_frame));
+
+    const DcmQuery *queries[2] = {
+        dcm_query_create("PlanePositionSlideSequence."
+                         "XOffsetInSlideCoordinateSystem"),
+        dcm_query_create("PixelMeasuresSequence.SliceThickness"),
+    };
+    ck_assert_uint_eq(dcm_dataset_get_frame_numbers(dataset, queries, 2,
+                                                    number_columns, 4), 3);
+    for (i = 0; i < 3; i++) {
+        ck_assert(x[i] == i + 0.25);
+        ck_assert(spacing[i] == 0.01);
+    }
+    dcm_query_destroy((DcmQuery *) queries[0]);
+    dcm_query_destroy((DcmQuery *) queries[1]);
+
+    queries[0] = dcm_query_create("PlanePositionSlideSequence."
+                                  "ColumnPositionInTotalImagePixelMatrix");
+    ck_assert_uint_eq(dcm_dataset_get_frame_integers(dataset, queries, 1,
+                                                     integer_columns, 2), 3);
+    ck_assert_int_eq(column[0], 1);
+    ck_assert_int_eq(column[1], 11);
+    dcm_query_destroy((DcmQuery *) queries[0]);
+
+    dcm_dataset_destroy(dataset);
+}
+END_TEST
+
+
 START_TEST(test_file_sm_image_file_meta)
 {
     const char *file_path = "./data/test_files/sm_image.dcm";
@@ -471,6 +693,755 @@ START_TEST(test_file_sm_image_metadata)
 END_TEST
 
 
+START_TEST(test_file_sm_image_metadata_arena)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    uint32_t i;
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+
+    DcmFile *arena_file = dcm_file_create(file_path, 'r');
+    dcm_file_set_read_flags(arena_file, DCM_READ_ARENA);
+    DcmDataSet *arena_meta = dcm_file_read_file_meta(arena_file);
+    DcmDataSet *arena_metadata = dcm_file_read_metadata(arena_file);
+    dcm_file_destroy(arena_file);
+
+    ck_assert_ptr_nonnull(arena_meta);
+    ck_assert_ptr_nonnull(arena_metadata);
+    ck_assert_uint_eq(dcm_dataset_count(arena_metadata),
+                      dcm_dataset_count(metadata));
+
+    // Image Type
+    DcmElement *element = dcm_dataset_get(metadata, 0x00080008);
+    DcmElement *arena_element = dcm_dataset_get(arena_metadata, 0x00080008);
+    ck_assert_uint_eq(dcm_element_get_vm(arena_element), 4);
+    for (i = 0; i < 4; i++) {
+        ck_assert_str_eq(dcm_element_get_value_CS(arena_element, i),
+                         dcm_element_get_value_CS(element, i));
+    }
+
+    // Rows
+    arena_element = dcm_dataset_get(arena_metadata, 0x00280010);
+    ck_assert_uint_eq(dcm_element_get_value_US(arena_element, 0), 10);
+
+    // Dimension Index Sequence
+    element = dcm_dataset_get(metadata, 0x00209222);
+    arena_element = dcm_dataset_get(arena_metadata, 0x00209222);
+    DcmSequence *seq = dcm_element_get_value_SQ(element);
+    DcmSequence *arena_seq = dcm_element_get_value_SQ(arena_element);
+    ck_assert_uint_eq(dcm_sequence_count(arena_seq), dcm_sequence_count(seq));
+    DcmDataSet *arena_item = dcm_sequence_get(arena_seq, 0);
+    ck_assert_uint_eq(dcm_dataset_count(arena_item),
+                      dcm_dataset_count(dcm_sequence_get(seq, 0)));
+
+    // Clones are independent of the arena
+    DcmDataSet *cloned_item = dcm_dataset_clone(arena_item);
+
+    dcm_dataset_destroy(arena_meta);
+    dcm_dataset_destroy(arena_metadata);
+    ck_assert_uint_eq(dcm_dataset_count(cloned_item),
+                      dcm_dataset_count(dcm_sequence_get(seq, 0)));
+    dcm_dataset_destroy(cloned_item);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+
+START_TEST(test_file_sm_image_metadata_lazy)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    const char modes[2] = {'r', 'm'};
+    const uint32_t flags[2] = {DCM_READ_LAZY, DCM_READ_LAZY | DCM_READ_ARENA};
+    uint32_t i, j;
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+
+    for (i = 0; i < 4; i++) {
+        DcmFile *lazy_file = dcm_file_create(file_path, modes[i / 2]);
+        dcm_file_set_read_flags(lazy_file, flags[i % 2]);
+        DcmDataSet *lazy_metadata = dcm_file_read_metadata(lazy_file);
+        ck_assert_ptr_nonnull(lazy_metadata);
+        ck_assert_uint_eq(dcm_dataset_count(lazy_metadata),
+                          dcm_dataset_count(metadata));
+
+        // Frames can be located by means of the lazily read metadata
+        DcmBOT *bot = dcm_file_build_bot(lazy_file, lazy_metadata);
+        ck_assert_uint_eq(dcm_bot_get_num_frames(bot), 25);
+        DcmFrame *frame = dcm_file_read_frame(lazy_file, lazy_metadata, bot, 1);
+        ck_assert_uint_eq(dcm_frame_get_length(frame), 300);
+        dcm_frame_destroy(frame);
+        dcm_bot_destroy(bot);
+
+        // Values are read after the File has been destroyed
+        dcm_file_destroy(lazy_file);
+
+        // SOP Class UID
+        DcmElement *element = dcm_dataset_get(lazy_metadata, 0x00080016);
+        ck_assert_str_eq(dcm_element_get_value_UI(element, 0),
+                         "1.2.840.10008.5.1.4.1.1.77.1.6");
+
+        // Image Type
+        element = dcm_dataset_get(metadata, 0x00080008);
+        DcmElement *lazy_element = dcm_dataset_get(lazy_metadata, 0x00080008);
+        ck_assert_uint_eq(dcm_element_get_vm(lazy_element), 4);
+        for (j = 0; j < 4; j++) {
+            ck_assert_str_eq(dcm_element_get_value_CS(lazy_element, j),
+                             dcm_element_get_value_CS(element, j));
+        }
+
+        // Dimension Index Sequence
+        element = dcm_dataset_get(metadata, 0x00209222);
+        lazy_element = dcm_dataset_get(lazy_metadata, 0x00209222);
+        DcmSequence *seq = dcm_element_get_value_SQ(element);
+        DcmSequence *lazy_seq = dcm_element_get_value_SQ(lazy_element);
+        ck_assert_uint_eq(dcm_sequence_count(lazy_seq),
+                          dcm_sequence_count(seq));
+        ck_assert_uint_eq(dcm_dataset_count(dcm_sequence_get(lazy_seq, 0)),
+                          dcm_dataset_count(dcm_sequence_get(seq, 0)));
+
+        // Clones read all remaining values
+        DcmDataSet *cloned_metadata = dcm_dataset_clone(lazy_metadata);
+        dcm_dataset_destroy(lazy_metadata);
+        ck_assert_uint_eq(dcm_dataset_count(cloned_metadata),
+                          dcm_dataset_count(metadata));
+        dcm_dataset_destroy(cloned_metadata);
+    }
+
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+
+START_TEST(test_file_sm_image_metadata_tags)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    // Series Instance UID, SOP Class UID, Dimension Index Sequence, Rows
+    const uint32_t tags[4] = {0x0020000E, 0x00080016, 0x00209222, 0x00280010};
+    uint32_t i;
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+
+    DcmFile *tags_file = dcm_file_create(file_path, 'r');
+    DcmDataSet *tags_metadata = dcm_file_read_metadata_tags(tags_file,
+                                                            tags, 4,
+                                                            0xFFFFFFFF);
+    ck_assert_ptr_nonnull(tags_metadata);
+    ck_assert_uint_eq(dcm_dataset_count(tags_metadata), 4);
+    DcmElement *element = dcm_dataset_get(tags_metadata, 0x00080016);
+    ck_assert_str_eq(dcm_element_get_value_UI(element, 0),
+                     "1.2.840.10008.5.1.4.1.1.77.1.6");
+    element = dcm_dataset_get(tags_metadata, 0x00280010);
+    ck_assert_uint_eq(dcm_element_get_value_US(element, 0), 10);
+    element = dcm_dataset_get(tags_metadata, 0x00209222);
+    ck_assert_uint_eq(dcm_sequence_count(dcm_element_get_value_SQ(element)),
+                      dcm_sequence_count(dcm_element_get_value_SQ(
+                          dcm_dataset_get(metadata, 0x00209222))));
+    dcm_dataset_destroy(tags_metadata);
+    dcm_file_destroy(tags_file);
+
+    // All Data Elements up to the Patient module
+    tags_file = dcm_file_create(file_path, 'm');
+    tags_metadata = dcm_file_read_metadata_tags(tags_file, NULL, 0, 0x0010FFFF);
+    ck_assert_ptr_nonnull(tags_metadata);
+    uint32_t n = dcm_dataset_count(metadata);
+    uint32_t *all_tags = calloc(n, sizeof(uint32_t));
+    dcm_dataset_copy_tags(metadata, all_tags, n);
+    uint32_t num_wanted = 0;
+    for (i = 0; i < n; i++) {
+        if (all_tags[i] <= 0x0010FFFF) {
+            num_wanted += 1;
+            ck_assert(dcm_dataset_contains(tags_metadata, all_tags[i]));
+        }
+    }
+    ck_assert_uint_eq(dcm_dataset_count(tags_metadata), num_wanted);
+    free(all_tags);
+    dcm_dataset_destroy(tags_metadata);
+    dcm_file_destroy(tags_file);
+
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+START_TEST(test_file_sm_image_metadata_query)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    const DcmElement *elements[32];
+    double values[32];
+    uint32_t tag;
+
+    ck_assert(dcm_dict_lookup_tag("Rows", &tag));
+    ck_assert_uint_eq(tag, 0x00280010);
+    ck_assert(dcm_dict_lookup_tag("DataSetTrailingPadding", &tag));
+    ck_assert_uint_eq(tag, 0xFFFCFFFC);
+    ck_assert(!dcm_dict_lookup_tag("NoSuchKeyword", &tag));
+
+    ck_assert_ptr_null(dcm_query_create("NoSuchKeyword"));
+    ck_assert_ptr_null(dcm_query_create("DimensionIndexSequence[x].Rows"));
+    ck_assert_ptr_null(dcm_query_create("DimensionIndexSequence..Rows"));
+    ck_assert_ptr_null(dcm_query_create("Rows[0]"));
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+
+    DcmQuery *query = dcm_query_create("Rows");
+    ck_assert_ptr_nonnull(query);
+    ck_assert_uint_eq(dcm_query_evaluate_numbers(query, metadata,
+                                                 values, 32), 1);
+    ck_assert(values[0] == 10.0);
+    dcm_query_destroy(query);
+
+    query = dcm_query_create("00209222[*].DimensionIndexPointer");
+    ck_assert_ptr_nonnull(query);
+    ck_assert_uint_eq(dcm_query_evaluate(query, metadata, elements, 32), 2);
+    ck_assert_uint_eq(dcm_element_get_tag(elements[1]), 0x00209165);
+    dcm_query_destroy(query);
+
+    query = dcm_query_create("SpecimenDescriptionSequence."
+                             "SpecimenPreparationSequence."
+                             "SpecimenPreparationStepContentItemSequence."
+                             "ConceptNameCodeSequence[0].CodeValue");
+    ck_assert_ptr_nonnull(query);
+    ck_assert_uint_eq(dcm_query_evaluate(query, metadata, elements, 4), 24);
+    ck_assert_str_eq(dcm_element_get_value_SH(elements[0]), "121041");
+    ck_assert_str_eq(dcm_element_get_value_SH(elements[1]), "111724");
+    dcm_query_destroy(query);
+
+    // Frames without Per-frame Functional Groups share their values
+    query = dcm_query_create("PixelMeasuresSequence.SliceThickness");
+    const DcmQuery *queries[1] = {query};
+    double *columns[1] = {values};
+    ck_assert_uint_eq(dcm_dataset_get_frame_numbers(metadata, queries, 1,
+                                                    columns, 32), 25);
+    ck_assert(values[0] == 0.01);
+    ck_assert(values[24] == 0.01);
+    dcm_query_destroy(query);
+
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+START_TEST(test_file_sm_image_metadata_parallel)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    const DcmElement *elements[32];
+    const DcmElement *parallel_elements[32];
+    uint32_t i;
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmStringPool *pool = dcm_string_pool_create();
+    dcm_file_set_string_pool(file, pool);
+    DcmDataSet *file_meta = dcm_file_read_file_meta(file);
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+
+    DcmFile *parallel_file = dcm_file_create(file_path, 'r');
+    DcmStringPool *parallel_pool = dcm_string_pool_create();
+    dcm_file_set_string_pool(parallel_file, parallel_pool);
+    dcm_file_set_read_flags(parallel_file, DCM_READ_PARALLEL);
+    DcmDataSet *parallel_metadata = dcm_file_read_metadata(parallel_file);
+    ck_assert_ptr_nonnull(parallel_metadata);
+    ck_assert_uint_eq(dcm_dataset_count(parallel_metadata),
+                      dcm_dataset_count(metadata));
+
+    // Items of the largest Sequence keep their order
+    DcmQuery *query = dcm_query_create(
+        "SpecimenDescriptionSequence."
+        "SpecimenPreparationSequence."
+        "SpecimenPreparationStepContentItemSequence."
+        "ConceptNameCodeSequence.CodeValue");
+    uint32_t count = dcm_query_evaluate(query, metadata, elements, 32);
+    ck_assert_uint_eq(dcm_query_evaluate(query, parallel_metadata,
+                                         parallel_elements, 32), count);
+    for (i = 0; i < count; i++) {
+        ck_assert_str_eq(dcm_element_get_value_SH(parallel_elements[i]),
+                         dcm_element_get_value_SH(elements[i]));
+    }
+    dcm_query_destroy(query);
+
+    // Values of Items read in parallel are pooled like the others
+    ck_assert_uint_gt(dcm_string_pool_count(pool), 0);
+    ck_assert_uint_eq(dcm_string_pool_count(parallel_pool),
+                      dcm_string_pool_count(pool));
+    dcm_string_pool_destroy(parallel_pool);
+    dcm_string_pool_destroy(pool);
+
+    // Data Elements of Items read in parallel are counted like the others
+    DcmStats stats;
+    DcmStats parallel_stats;
+    dcm_file_get_stats(file, &stats);
+    dcm_file_get_stats(parallel_file, &parallel_stats);
+    ck_assert_uint_eq(parallel_stats.num_elements, stats.num_elements);
+    ck_assert_uint_ge(parallel_stats.num_reads, stats.num_reads);
+
+    // Small Sequences are read serially, so a larger one is needed to read
+    // Items in parallel
+    const char *output_path = "./sm_image_parallel.tmp";
+    DcmDataSet *large = dcm_dataset_create();
+    ck_assert(dcm_dataset_insert(large, dcm_element_clone(
+        dcm_dataset_get(metadata, 0x00080016))));
+    ck_assert(dcm_dataset_insert(large, dcm_element_clone(
+        dcm_dataset_get(metadata, 0x00080018))));
+    DcmSequence *sequence = dcm_sequence_create();
+    for (i = 0; i < 8000; i++) {
+        DcmDataSet *item = dcm_dataset_create();
+        // Values that are too long to be held inline are pooled
+        char *value = malloc(32);
+        snprintf(value, 32, "Specimen Preparation Step %u", i % 10);
+        ck_assert(dcm_dataset_insert(item,
+                                     dcm_element_create_LO(0x00080104,
+                                                           value)));
+        ck_assert(dcm_dataset_insert(item,
+                                     dcm_element_create_UL(0x0040A132, i)));
+        ck_assert(dcm_sequence_append(sequence, item));
+    }
+    ck_assert(dcm_dataset_insert(large,
+                                 dcm_element_create_SQ(0x0040A730,
+                                                       sequence)));
+    DcmFile *output = dcm_file_create(output_path, 'w');
+    ck_assert(dcm_file_write_metadata(output, file_meta, large, false));
+    ck_assert(dcm_file_finish_write(output));
+    dcm_file_destroy(output);
+
+    DcmStats large_stats[2];
+    uint32_t num_strings[2];
+    for (i = 0; i < 2; i++) {
+        DcmFile *input = dcm_file_create(output_path, 'r');
+        pool = dcm_string_pool_create();
+        dcm_file_set_string_pool(input, pool);
+        dcm_file_set_read_flags(input,
+                                i == 0 ? DCM_READ_DEFAULT : DCM_READ_PARALLEL);
+        DcmDataSet *other = dcm_file_read_metadata(input);
+        ck_assert_ptr_nonnull(other);
+        DcmSequence *other_sequence = dcm_element_get_value_SQ(
+            dcm_dataset_get(other, 0x0040A730));
+        ck_assert_uint_eq(dcm_sequence_count(other_sequence), 8000);
+        ck_assert_uint_eq(dcm_element_get_value_UL(
+            dcm_dataset_get(dcm_sequence_get(other_sequence, 7999),
+                            0x0040A132), 0), 7999);
+        dcm_file_get_stats(input, &large_stats[i]);
+        num_strings[i] = dcm_string_pool_count(pool);
+        dcm_dataset_destroy(other);
+        dcm_string_pool_destroy(pool);
+        dcm_file_destroy(input);
+    }
+    ck_assert_uint_eq(large_stats[1].num_elements,
+                      large_stats[0].num_elements);
+    ck_assert_uint_eq(num_strings[1], num_strings[0]);
+    ck_assert_uint_ge(num_strings[0], 10);
+    remove(output_path);
+
+    dcm_dataset_destroy(large);
+    dcm_dataset_destroy(file_meta);
+    dcm_dataset_destroy(parallel_metadata);
+    dcm_file_destroy(parallel_file);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+struct ParseCounts {
+    uint32_t depth;
+    uint32_t num_top_level;
+    uint32_t num_items;
+    uint32_t max_depth;
+    bool in_pixel_data;
+    size_t num_pixel_bytes;
+    uint32_t max_elements;
+};
+
+
+static bool count_element(void *user_data,
+                          uint32_t tag,
+                          const char *vr,
+                          uint32_t length)
+{
+    struct ParseCounts *counts = (struct ParseCounts *) user_data;
+    (void) vr;
+    (void) length;
+    if (counts->depth == 0) {
+        counts->num_top_level += 1;
+    }
+    counts->in_pixel_data = tag == 0x7FE00010;
+    return counts->num_top_level < counts->max_elements;
+}
+
+
+static bool count_chunk(void *user_data, const char *data, uint32_t size)
+{
+    struct ParseCounts *counts = (struct ParseCounts *) user_data;
+    (void) data;
+    if (counts->in_pixel_data) {
+        counts->num_pixel_bytes += size;
+    }
+    return true;
+}
+
+
+static bool count_sequence(void *user_data, uint32_t tag, uint32_t length)
+{
+    return count_element(user_data, tag, "SQ", length);
+}
+
+
+static bool count_item_start(void *user_data, uint32_t index, uint32_t length)
+{
+    struct ParseCounts *counts = (struct ParseCounts *) user_data;
+    (void) index;
+    (void) length;
+    counts->depth += 1;
+    counts->num_items += 1;
+    if (counts->depth > counts->max_depth) {
+        counts->max_depth = counts->depth;
+    }
+    return true;
+}
+
+
+static bool count_item_end(void *user_data, uint32_t index)
+{
+    struct ParseCounts *counts = (struct ParseCounts *) user_data;
+    (void) index;
+    counts->depth -= 1;
+    return true;
+}
+
+
+START_TEST(test_file_sm_image_series)
+{
+    const char *file_paths[9];
+    uint32_t i;
+
+    for (i = 0; i < 8; i++) {
+        file_paths[i] = "./data/test_files/sm_image.dcm";
+    }
+    file_paths[8] = "./data/test_files/does_not_exist.dcm";
+
+    DcmStringPool *pool = dcm_string_pool_create();
+    ck_assert_ptr_nonnull(pool);
+    const char *value = dcm_string_pool_intern(pool, "MONOCHROME2");
+    ck_assert_str_eq(value, "MONOCHROME2");
+    ck_assert_ptr_eq(dcm_string_pool_intern(pool, "MONOCHROME2"), value);
+    ck_assert_uint_eq(dcm_string_pool_count(pool), 1);
+
+    DcmSeries *series = dcm_series_load(file_paths, 9, DCM_READ_DEFAULT, pool);
+    ck_assert_ptr_nonnull(series);
+    ck_assert_uint_eq(dcm_series_get_num_instances(series), 9);
+    uint32_t num_strings = dcm_string_pool_count(pool);
+    ck_assert_uint_gt(num_strings, 1);
+    // The pool is kept alive by the Data Sets that use it
+    dcm_string_pool_destroy(pool);
+
+    DcmDataSet *first = dcm_series_get_metadata(series, 0);
+    ck_assert_ptr_nonnull(first);
+    ck_assert_ptr_nonnull(dcm_series_get_file_meta(series, 0));
+    const char *study_uid = dcm_element_get_value_UI(
+        dcm_dataset_get(first, 0x0020000D), 0);
+    const char *syntax_uid = dcm_element_get_value_UI(
+        dcm_dataset_get(dcm_series_get_file_meta(series, 0), 0x00020010), 0);
+    ck_assert_str_eq(syntax_uid, "1.2.840.10008.1.2.1");
+    for (i = 1; i < 8; i++) {
+        DcmDataSet *metadata = dcm_series_get_metadata(series, i);
+        ck_assert_ptr_nonnull(metadata);
+        ck_assert_uint_eq(dcm_dataset_count(metadata),
+                          dcm_dataset_count(first));
+        // Repeated values share the memory of the pool
+        ck_assert_ptr_eq(dcm_element_get_value_UI(
+                             dcm_dataset_get(metadata, 0x0020000D), 0),
+                         study_uid);
+        ck_assert_ptr_eq(dcm_element_get_value_UI(
+                             dcm_dataset_get(dcm_series_get_file_meta(series,
+                                                                      i),
+                                             0x00020010), 0),
+                         syntax_uid);
+    }
+    ck_assert_ptr_null(dcm_series_get_metadata(series, 8));
+    ck_assert_ptr_null(dcm_series_get_file_meta(series, 8));
+    ck_assert_ptr_null(dcm_series_get_metadata(series, 9));
+    dcm_series_destroy(series);
+
+    // Without a pool, each Data Set has its own values
+    series = dcm_series_load(file_paths, 2, DCM_READ_LAZY, NULL);
+    ck_assert_ptr_ne(dcm_element_get_value_UI(
+                         dcm_dataset_get(dcm_series_get_metadata(series, 0),
+                                         0x0020000D), 0),
+                     dcm_element_get_value_UI(
+                         dcm_dataset_get(dcm_series_get_metadata(series, 1),
+                                         0x0020000D), 0));
+    dcm_series_destroy(series);
+
+    // Lazily read values are pooled once they are loaded
+    pool = dcm_string_pool_create();
+    series = dcm_series_load(file_paths, 2, DCM_READ_LAZY, pool);
+    dcm_string_pool_destroy(pool);
+    ck_assert_ptr_eq(dcm_element_get_value_UI(
+                         dcm_dataset_get(dcm_series_get_metadata(series, 0),
+                                         0x0020000D), 0),
+                     dcm_element_get_value_UI(
+                         dcm_dataset_get(dcm_series_get_metadata(series, 1),
+                                         0x0020000D), 0));
+    dcm_series_destroy(series);
+}
+END_TEST
+
+
+START_TEST(test_file_sm_image_parse)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    const DcmParseHandlers handlers = {
+        .element_start = count_element,
+        .value_chunk = count_chunk,
+        .sequence_start = count_sequence,
+        .item_start = count_item_start,
+        .item_end = count_item_end,
+    };
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+
+    struct ParseCounts counts = {0};
+    counts.max_elements = UINT32_MAX;
+    ck_assert(dcm_file_parse(file, &handlers, &counts));
+    ck_assert_uint_eq(counts.depth, 0);
+    ck_assert_uint_eq(counts.max_depth, 4);
+    ck_assert_uint_eq(counts.num_items, 80);
+    // All metadata and the Pixel Data Element with 25 native Frames
+    ck_assert_uint_eq(counts.num_top_level, dcm_dataset_count(metadata) + 1);
+    ck_assert_uint_eq(counts.num_pixel_bytes, 25 * 300);
+
+    // Handlers may stop parsing
+    memset(&counts, 0, sizeof(counts));
+    counts.max_elements = 3;
+    ck_assert(dcm_file_parse(file, &handlers, &counts));
+    ck_assert_uint_eq(counts.num_top_level, 3);
+
+    // The File remains usable for reading metadata
+    DcmDataSet *other_metadata = dcm_file_read_metadata(file);
+    ck_assert_uint_eq(dcm_dataset_count(other_metadata),
+                      dcm_dataset_count(metadata));
+
+    dcm_dataset_destroy(other_metadata);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+
+static DcmFrame *create_test_frame(const unsigned char *data,
+                                   uint32_t length,
+                                   uint16_t rows,
+                                   uint16_t columns,
+                                   uint16_t samples_per_pixel,
+                                   uint16_t bits_allocated,
+                                   uint16_t bits_stored,
+                                   uint16_t pixel_representation,
+                                   uint16_t planar_configuration,
+                                   const char *transfer_syntax_uid)
+{
+    char *value = malloc(length);
+    memcpy(value, data, length);
+    DcmFrame *frame = dcm_frame_create(1,
+                                       value,
+                                       length,
+                                       rows,
+                                       columns,
+                                       samples_per_pixel,
+                                       bits_allocated,
+                                       bits_stored,
+                                       pixel_representation,
+                                       planar_configuration,
+                                       strdup(samples_per_pixel == 3 ?
+                                              "RGB" : "MONOCHROME2"),
+                                       strdup(transfer_syntax_uid));
+    ck_assert_ptr_nonnull(frame);
+    return frame;
+}
+
+
+START_TEST(test_frame_convert)
+{
+    const char *native_uid = "1.2.840.10008.1.2.1";
+    char buffer[12];
+    uint8_t window[4];
+
+    // Color planes become pixels and back
+    const unsigned char planar[12] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    const unsigned char interleaved[12] = {1, 5, 9, 2, 6, 10,
+                                           3, 7, 11, 4, 8, 12};
+    DcmFrame *frame = create_test_frame(planar, 12, 2, 2, 3, 8, 8, 0, 1,
+                                        native_uid);
+    ck_assert(dcm_frame_convert(frame, DCM_CONVERT_DEFAULT, buffer, 12));
+    ck_assert_int_eq(memcmp(buffer, interleaved, 12), 0);
+    ck_assert(!dcm_frame_convert(frame, DCM_CONVERT_DEFAULT, buffer, 11));
+    dcm_frame_destroy(frame);
+    frame = create_test_frame(interleaved, 12, 2, 2, 3, 8, 8, 0, 0,
+                              native_uid);
+    ck_assert(dcm_frame_convert(frame, DCM_CONVERT_PLANAR, buffer, 12));
+    ck_assert_int_eq(memcmp(buffer, planar, 12), 0);
+    dcm_frame_destroy(frame);
+
+    // Signed 12 bit samples -2048, -1, 0 and 2047 with unused bits set
+    const unsigned char samples[8] = {0x00, 0xF8, 0xFF, 0xFF,
+                                      0x00, 0xA0, 0xFF, 0x07};
+    frame = create_test_frame(samples, 8, 1, 4, 1, 16, 12, 1, 0,
+                              native_uid);
+    ck_assert(dcm_frame_convert(frame, DCM_CONVERT_UNSIGNED, buffer, 8));
+    const unsigned char shifted[8] = {0x00, 0x00, 0xFF, 0x07,
+                                      0x00, 0x08, 0xFF, 0x0F};
+    ck_assert_int_eq(memcmp(buffer, shifted, 8), 0);
+    ck_assert(dcm_frame_convert(frame,
+                                DCM_CONVERT_UNSIGNED | DCM_CONVERT_SWAP_BYTES,
+                                buffer,
+                                8));
+    const unsigned char swapped[8] = {0x00, 0x00, 0x07, 0xFF,
+                                      0x08, 0x00, 0x0F, 0xFF};
+    ck_assert_int_eq(memcmp(buffer, swapped, 8), 0);
+
+    ck_assert(dcm_frame_apply_window(frame, 0.0, 4096.0, window, 4));
+    ck_assert_uint_eq(window[0], 0);
+    ck_assert_uint_eq(window[1], 127);
+    ck_assert_uint_eq(window[2], 128);
+    ck_assert_uint_eq(window[3], 255);
+    ck_assert(dcm_frame_apply_window(frame, 0.0, 2.0, window, 4));
+    ck_assert_uint_eq(window[0], 0);
+    ck_assert_uint_eq(window[1], 0);
+    ck_assert_uint_eq(window[3], 255);
+    ck_assert(!dcm_frame_apply_window(frame, 0.0, 0.5, window, 4));
+    ck_assert(!dcm_frame_apply_window(frame, 0.0, 4096.0, window, 3));
+    dcm_frame_destroy(frame);
+
+    // Encapsulated Frames cannot be converted
+    frame = create_test_frame(samples, 8, 1, 4, 1, 16, 12, 1, 0,
+                              "1.2.840.10008.1.2.4.50");
+    ck_assert(!dcm_frame_convert(frame, DCM_CONVERT_DEFAULT, buffer, 8));
+    dcm_frame_destroy(frame);
+}
+END_TEST
+
+
+static atomic_uint num_test_contexts;
+
+
+static void *create_test_context(void)
+{
+    atomic_fetch_add(&num_test_contexts, 1);
+    return malloc(1);
+}
+
+
+static bool decode_test_frame(void *context,
+                              const DcmFrame *frame,
+                              char *buffer,
+                              size_t size)
+{
+    ck_assert_ptr_nonnull(context);
+    memset(buffer, (int) dcm_frame_get_number(frame), size);
+    return true;
+}
+
+
+static void destroy_test_context(void *context)
+{
+    atomic_fetch_sub(&num_test_contexts, 1);
+    free(context);
+}
+
+
+START_TEST(test_frame_decode)
+{
+    const char *rle_uid = "1.2.840.10008.1.2.5";
+    const char *test_uid = "1.2.840.10008.1.2.4.90";
+    char buffer[8];
+    uint32_t i;
+
+    // Segments of the most and least significant bytes of 16 bit samples,
+    // a literal run and a replicate run
+    unsigned char rle[71] = {0x02, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00,
+                             0x45, 0x00, 0x00, 0x00};
+    const unsigned char segments[7] = {0x03, 0x01, 0x03, 0x05, 0x07,
+                                       0xFD, 0xAA};
+    memcpy(rle + 64, segments, sizeof(segments));
+    DcmFrame *frame = create_test_frame(rle, sizeof(rle), 2, 2, 1, 16, 16, 0,
+                                        0, rle_uid);
+    ck_assert_uint_eq(dcm_frame_get_decoded_length(frame), 8);
+    ck_assert(dcm_frame_decode(frame, buffer, sizeof(buffer)));
+    const unsigned char expected[8] = {0xAA, 0x01, 0xAA, 0x03,
+                                       0xAA, 0x05, 0xAA, 0x07};
+    ck_assert_int_eq(memcmp(buffer, expected, sizeof(expected)), 0);
+    ck_assert(!dcm_frame_decode(frame, buffer, sizeof(buffer) - 1));
+    dcm_frame_destroy(frame);
+
+    rle[0] = 0x03;
+    frame = create_test_frame(rle, sizeof(rle), 2, 2, 1, 16, 16, 0, 0,
+                              rle_uid);
+    ck_assert(!dcm_frame_decode(frame, buffer, sizeof(buffer)));
+    dcm_frame_destroy(frame);
+
+    // Transfer Syntaxes without codec cannot be decoded, unless a codec
+    // is registered
+    frame = create_test_frame(rle, 8, 2, 2, 1, 16, 16, 0, 0, test_uid);
+    if (dcm_codec_find(test_uid) == NULL) {
+        ck_assert(!dcm_frame_decode(frame, buffer, sizeof(buffer)));
+    }
+    dcm_frame_destroy(frame);
+    const DcmCodec codec = {
+        .create_context = create_test_context,
+        .decode = decode_test_frame,
+        .destroy_context = destroy_test_context,
+    };
+    ck_assert(dcm_codec_register(test_uid, &codec));
+    ck_assert_ptr_eq(dcm_codec_find(test_uid), &codec);
+
+    // Contexts are kept by the Decoder and reused for later Frames
+    DcmDecoder *decoder = dcm_decoder_create();
+    DcmFrame *frames[16];
+    char *buffers[16];
+    for (i = 0; i < 16; i++) {
+        char *value = malloc(8);
+        memset(value, 0, 8);
+        frames[i] = dcm_frame_create(i + 1, value, 8, 2, 2, 1, 16, 16, 0, 0,
+                                     strdup("MONOCHROME2"), strdup(test_uid));
+        buffers[i] = malloc(8);
+    }
+    ck_assert(dcm_decoder_decode(decoder, frames[0], buffers[0], 8));
+    ck_assert(dcm_decoder_decode(decoder, frames[1], buffers[1], 8));
+    ck_assert_uint_eq(atomic_load(&num_test_contexts), 1);
+    ck_assert(dcm_decoder_decode_frames(decoder,
+                                        (const DcmFrame *const *) frames,
+                                        16,
+                                        buffers,
+                                        8));
+    for (i = 0; i < 16; i++) {
+        ck_assert_int_eq(buffers[i][0], (char) (i + 1));
+        ck_assert_int_eq(buffers[i][7], (char) (i + 1));
+        dcm_frame_destroy(frames[i]);
+        free(buffers[i]);
+    }
+    ck_assert_uint_ge(atomic_load(&num_test_contexts), 1);
+    dcm_decoder_destroy(decoder);
+    ck_assert_uint_eq(atomic_load(&num_test_contexts), 0);
+
+    // A malformed JPEG leaves the codec usable
+    const char *jpeg_uid = "1.2.840.10008.1.2.4.50";
+    if (dcm_codec_find(jpeg_uid)) {
+        unsigned char jpeg[64] = {0xFF, 0xD8, 0xFF, 0xDB};
+        frame = create_test_frame(jpeg, sizeof(jpeg), 2, 2, 1, 8, 8, 0, 0,
+                                  jpeg_uid);
+        decoder = dcm_decoder_create();
+        ck_assert(!dcm_decoder_decode(decoder, frame, buffer, 4));
+        ck_assert(!dcm_decoder_decode(decoder, frame, buffer, 4));
+        dcm_decoder_destroy(decoder);
+        dcm_frame_destroy(frame);
+    }
+}
+END_TEST
+
+
 START_TEST(test_file_sm_image_frame)
 {
     const uint32_t frame_number = 1;
@@ -504,12 +1475,1223 @@ START_TEST(test_file_sm_image_frame)
 END_TEST
 
 
+START_TEST(test_file_sm_image_mapped)
+{
+    const uint32_t frame_number = 1;
+    const char *file_path = "./data/test_files/sm_image.dcm";
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    DcmBOT *bot = dcm_file_build_bot(file, metadata);
+    DcmFrame *frame = dcm_file_read_frame(file, metadata, bot, frame_number);
+
+    DcmFile *mapped_file = dcm_file_create(file_path, 'm');
+    DcmDataSet *mapped_metadata = dcm_file_read_metadata(mapped_file);
+    ck_assert_int_eq(dcm_dataset_count(mapped_metadata),
+                     dcm_dataset_count(metadata));
+
+    // SOP Class UID
+    DcmElement *element = dcm_dataset_get(mapped_metadata, 0x00080016);
+    ck_assert_str_eq(dcm_element_get_value_UI(element, 0),
+                     "1.2.840.10008.5.1.4.1.1.77.1.6");
+
+    DcmBOT *mapped_bot = dcm_file_build_bot(mapped_file, mapped_metadata);
+    ck_assert_uint_eq(dcm_bot_get_num_frames(mapped_bot), 25);
+
+    DcmFrame *mapped_frame = dcm_file_read_frame(mapped_file,
+                                                 mapped_metadata,
+                                                 mapped_bot,
+                                                 frame_number);
+    ck_assert_uint_eq(dcm_frame_get_length(mapped_frame),
+                      dcm_frame_get_length(frame));
+    ck_assert_int_eq(memcmp(dcm_frame_get_value(mapped_frame),
+                            dcm_frame_get_value(frame),
+                            dcm_frame_get_length(frame)), 0);
+
+    dcm_frame_destroy(mapped_frame);
+    dcm_bot_destroy(mapped_bot);
+    dcm_dataset_destroy(mapped_metadata);
+    dcm_file_destroy(mapped_file);
+    dcm_frame_destroy(frame);
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+struct TestSource {
+    const char *data;
+    size_t size;
+    uint32_t num_reads;
+    bool is_closed;
+    uint32_t num_prefetches;
+    int64_t prefetch_offset;
+    int64_t prefetch_length;
+};
+
+
+static int64_t test_source_read_at(void *handle,
+                                   char *buffer,
+                                   int64_t length,
+                                   int64_t offset)
+{
+    struct TestSource *source = (struct TestSource *) handle;
+    source->num_reads += 1;
+    if ((size_t) offset >= source->size) {
+        return 0;
+    }
+    if ((size_t) (offset + length) > source->size) {
+        length = (int64_t) source->size - offset;
+    }
+    memcpy(buffer, source->data + offset, (size_t) length);
+    return length;
+}
+
+
+static void test_source_close(void *handle)
+{
+    ((struct TestSource *) handle)->is_closed = true;
+}
+
+
+static void test_source_prefetch(void *handle, int64_t offset, int64_t length)
+{
+    struct TestSource *source = (struct TestSource *) handle;
+    source->num_prefetches += 1;
+    source->prefetch_offset = offset;
+    source->prefetch_length = length;
+}
+
+
+static void check_file_matches(DcmFile *file,
+                               const DcmDataSet *metadata,
+                               const DcmFrame *frame)
+{
+    ck_assert_ptr_nonnull(file);
+    DcmDataSet *other_metadata = dcm_file_read_metadata(file);
+    ck_assert_ptr_nonnull(other_metadata);
+    ck_assert_uint_eq(dcm_dataset_count(other_metadata),
+                      dcm_dataset_count(metadata));
+    DcmBOT *bot = dcm_file_build_bot(file, other_metadata);
+    ck_assert_uint_eq(dcm_bot_get_num_frames(bot), 25);
+    DcmFrame *other_frame = dcm_file_read_frame(file, other_metadata, bot, 25);
+    ck_assert_uint_eq(dcm_frame_get_length(other_frame),
+                      dcm_frame_get_length(frame));
+    ck_assert_int_eq(memcmp(dcm_frame_get_value(other_frame),
+                            dcm_frame_get_value(frame),
+                            dcm_frame_get_length(frame)), 0);
+    dcm_frame_destroy(other_frame);
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(other_metadata);
+    dcm_file_destroy(file);
+}
+
+
+START_TEST(test_file_sm_image_io)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    DcmBOT *bot = dcm_file_build_bot(file, metadata);
+    DcmFrame *frame = dcm_file_read_frame(file, metadata, bot, 25);
+
+    FILE *fp = fopen(file_path, "rb");
+    ck_assert_ptr_nonnull(fp);
+    fseek(fp, 0, SEEK_END);
+    size_t size = (size_t) ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *data = malloc(size);
+    ck_assert_uint_eq(fread(data, 1, size, fp), size);
+    fclose(fp);
+
+    check_file_matches(dcm_file_create_memory(data, size), metadata, frame);
+
+    int fd = open(file_path, O_RDONLY);
+    ck_assert_int_ge(fd, 0);
+    check_file_matches(dcm_file_create_fd(fd), metadata, frame);
+    close(fd);
+
+    // Custom methods that neither know the size nor map the content
+    const DcmIOMethods methods = {
+        .read_at = test_source_read_at,
+        .close = test_source_close,
+    };
+    struct TestSource source = {data, size, 0, false, 0, 0, 0};
+    check_file_matches(dcm_file_create_io(&methods, &source), metadata, frame);
+    ck_assert_uint_gt(source.num_reads, 0);
+    ck_assert(source.is_closed);
+
+    free(data);
+    dcm_frame_destroy(frame);
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+START_TEST(test_file_sm_image_frame_cache)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    DcmFrameCacheStats stats;
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    DcmBOT *bot = dcm_file_build_bot(file, metadata);
+    DcmFrame *frame = dcm_file_read_frame(file, metadata, bot, 1);
+
+    // Room for two Frames of 300 bytes
+    DcmFrameCache *cache = dcm_frame_cache_create(1000);
+    DcmFrame *first = dcm_frame_cache_read_frame(cache, file, metadata,
+                                                 bot, 1);
+    DcmFrame *again = dcm_frame_cache_read_frame(cache, file, metadata,
+                                                 bot, 1);
+    ck_assert_ptr_eq(dcm_frame_get_value(first), dcm_frame_get_value(again));
+    ck_assert_uint_eq(dcm_frame_get_number(again), 1);
+    ck_assert_int_eq(memcmp(dcm_frame_get_value(again),
+                            dcm_frame_get_value(frame),
+                            dcm_frame_get_length(frame)), 0);
+    dcm_frame_destroy(again);
+
+    DcmFrame *second = dcm_frame_cache_read_frame(cache, file, metadata,
+                                                  bot, 2);
+    DcmFrame *third = dcm_frame_cache_read_frame(cache, file, metadata,
+                                                 bot, 3);
+    dcm_frame_cache_get_stats(cache, &stats);
+    ck_assert_uint_eq(stats.num_hits, 1);
+    ck_assert_uint_eq(stats.num_misses, 3);
+    ck_assert_uint_eq(stats.num_evictions, 1);
+    ck_assert_uint_eq(stats.num_frames, 2);
+    ck_assert_uint_le(stats.num_bytes, 1000);
+
+    // Evicted Frames remain valid while in use
+    ck_assert_int_eq(memcmp(dcm_frame_get_value(first),
+                            dcm_frame_get_value(frame),
+                            dcm_frame_get_length(frame)), 0);
+    DcmFrame *reread = dcm_frame_cache_read_frame(cache, file, metadata,
+                                                  bot, 1);
+    ck_assert_ptr_ne(dcm_frame_get_value(reread), dcm_frame_get_value(first));
+    dcm_frame_cache_get_stats(cache, &stats);
+    ck_assert_uint_eq(stats.num_misses, 4);
+    ck_assert_uint_eq(stats.num_evictions, 2);
+
+    dcm_frame_cache_destroy(cache);
+    ck_assert_uint_eq(dcm_frame_get_length(third), 300);
+    dcm_frame_destroy(reread);
+    dcm_frame_destroy(third);
+    dcm_frame_destroy(second);
+    dcm_frame_destroy(first);
+
+    dcm_frame_destroy(frame);
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+START_TEST(test_file_sm_image_prefetch)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    const uint32_t numbers[3] = {3, 1, 2};
+    uint32_t i;
+
+    FILE *fp = fopen(file_path, "rb");
+    ck_assert_ptr_nonnull(fp);
+    fseek(fp, 0, SEEK_END);
+    size_t size = (size_t) ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *data = malloc(size);
+    ck_assert_uint_eq(fread(data, 1, size, fp), size);
+    fclose(fp);
+
+    const DcmIOMethods methods = {
+        .read_at = test_source_read_at,
+        .prefetch = test_source_prefetch,
+    };
+    struct TestSource source = {data, size, 0, false, 0, 0, 0};
+    DcmFile *file = dcm_file_create_io(&methods, &source);
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    DcmBOT *bot = dcm_file_build_bot(file, metadata);
+    DcmTileMap *map = dcm_tile_map_create(metadata);
+    ck_assert_ptr_nonnull(map);
+
+    // Adjacent native Frames are announced as one extent
+    ck_assert(dcm_file_prefetch_frames(file, bot, numbers, 3));
+    ck_assert_uint_eq(source.num_prefetches, 1);
+    ck_assert_int_eq(source.prefetch_length, 3 * 300);
+    int64_t first_offset = source.prefetch_offset;
+
+    // The Total Pixel Matrix of 50 x 50 pixels holds 5 x 5 tiles
+    source.num_prefetches = 0;
+    ck_assert(dcm_file_prefetch_region(file, bot, map, 15, 25, 10, 10));
+    ck_assert_uint_eq(source.num_prefetches, 2);
+    ck_assert_int_eq(source.prefetch_offset - first_offset, 12 * 300);
+    ck_assert_int_eq(source.prefetch_length, 2 * 300);
+
+    ck_assert(!dcm_file_prefetch_frames(file, bot, (uint32_t[]){26}, 1));
+    ck_assert(!dcm_file_prefetch_region(file, bot, map, 50, 0, 1, 1));
+
+    dcm_tile_map_destroy(map);
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+
+    // Files on disk, whether mapped or not, are advised without failing
+    for (i = 0; i < 2; i++) {
+        file = dcm_file_create(file_path, i == 0 ? 'r' : 'm');
+        metadata = dcm_file_read_metadata(file);
+        bot = dcm_file_build_bot(file, metadata);
+        map = dcm_tile_map_create(metadata);
+        ck_assert(dcm_file_prefetch_frames(file, bot, numbers, 3));
+        ck_assert(dcm_file_prefetch_region(file, bot, map, 0, 0, 50, 50));
+        DcmFrame *frame = dcm_file_read_frame(file, metadata, bot, 1);
+        ck_assert_uint_eq(dcm_frame_get_length(frame), 300);
+        dcm_frame_destroy(frame);
+        dcm_tile_map_destroy(map);
+        dcm_bot_destroy(bot);
+        dcm_dataset_destroy(metadata);
+        dcm_file_destroy(file);
+    }
+
+    free(data);
+}
+END_TEST
+
+static DcmDataSet *create_sparse_metadata(void)
+{
+    const int32_t positions[3][2] = {{1, 1}, {11, 21}, {6, 6}};
+    uint32_t i;
+
+    DcmDataSet *metadata = dcm_dataset_create();
+    char *value = malloc(13);
+    strcpy(value, "TILED_SPARSE");
+    ck_assert(dcm_dataset_insert(metadata,
+                                 dcm_element_create_CS(0x00209311, value)));
+    ck_assert(dcm_dataset_insert(metadata,
+                                 dcm_element_create_US(0x00280010, 10)));
+    ck_assert(dcm_dataset_insert(metadata,
+                                 dcm_element_create_US(0x00280011, 10)));
+    ck_assert(dcm_dataset_insert(metadata,
+                                 dcm_element_create_UL(0x00480006, 30)));
+    ck_assert(dcm_dataset_insert(metadata,
+                                 dcm_element_create_UL(0x00480007, 30)));
+    DcmSequence *frames = dcm_sequence_create();
+    for (i = 0; i < 3; i++) {
+        DcmDataSet *position = dcm_dataset_create();
+        ck_assert(dcm_dataset_insert(position,
+                                     dcm_element_create_SL(0x0048021F,
+                                                           positions[i][0])));
+        ck_assert(dcm_dataset_insert(position,
+                                     dcm_element_create_SL(0x0048021E,
+                                                           positions[i][1])));
+        DcmSequence *positions_seq = dcm_sequence_create();
+        ck_assert(dcm_sequence_append(positions_seq, position));
+        DcmDataSet *groups = dcm_dataset_create();
+        ck_assert(dcm_dataset_insert(groups,
+                                     dcm_element_create_SQ(0x0048021A,
+                                                           positions_seq)));
+        ck_assert(dcm_sequence_append(frames, groups));
+    }
+    ck_assert(dcm_dataset_insert(metadata,
+                                 dcm_element_create_SQ(0x52009230, frames)));
+    return metadata;
+}
+
+
+struct TraceCounts {
+    uint32_t num_starts;
+    uint32_t num_ends;
+    uint32_t num_frame_reads;
+    uint32_t depth;
+    uint32_t max_depth;
+};
+
+
+static void count_span_start(void *user_data,
+                             const char *name,
+                             const DcmFile *file)
+{
+    struct TraceCounts *counts = (struct TraceCounts *) user_data;
+    ck_assert_ptr_nonnull(file);
+    counts->num_starts += 1;
+    counts->num_frame_reads += strcmp(name, "read_frame") == 0;
+    counts->depth += 1;
+    if (counts->depth > counts->max_depth) {
+        counts->max_depth = counts->depth;
+    }
+}
+
+
+static void count_span_end(void *user_data,
+                           const char *name,
+                           const DcmFile *file)
+{
+    struct TraceCounts *counts = (struct TraceCounts *) user_data;
+    (void) name;
+    (void) file;
+    counts->num_ends += 1;
+    counts->depth -= 1;
+}
+
+
+START_TEST(test_file_sm_image_stats)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    const DcmTraceHooks hooks = {count_span_start, count_span_end};
+    struct TraceCounts counts = {0, 0, 0, 0, 0};
+    DcmStats stats;
+    DcmStats global_stats;
+    uint32_t i;
+
+    dcm_set_trace_hooks(&hooks, &counts);
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    DcmBOT *bot = dcm_file_build_bot(file, metadata);
+    for (i = 1; i <= 25; i++) {
+        dcm_frame_destroy(dcm_file_read_frame(file, metadata, bot, i));
+    }
+    dcm_set_trace_hooks(NULL, NULL);
+
+    ck_assert_uint_eq(counts.num_starts, counts.num_ends);
+    ck_assert_uint_eq(counts.num_starts, 27);
+    ck_assert_uint_eq(counts.num_frame_reads, 25);
+    ck_assert_uint_eq(counts.max_depth, 1);
+
+    dcm_file_get_stats(file, &stats);
+    ck_assert_uint_gt(stats.bytes_read, 25 * 300);
+    ck_assert_uint_gt(stats.num_reads, 0);
+    ck_assert_uint_gt(stats.num_seeks, 0);
+    ck_assert_uint_gt(stats.num_elements, dcm_dataset_count(metadata));
+    ck_assert_uint_eq(stats.num_allocations, 0);
+    ck_assert_uint_eq(stats.num_frames, 25);
+    uint64_t num_latencies = 0;
+    for (i = 0; i < DCM_STATS_LATENCY_BUCKETS; i++) {
+        num_latencies += stats.frame_read_latency[i];
+    }
+    ck_assert_uint_eq(num_latencies, 25);
+
+    // Counters of all Files include those of each File
+    dcm_get_stats(&global_stats);
+    ck_assert_uint_ge(global_stats.bytes_read, stats.bytes_read);
+    ck_assert_uint_ge(global_stats.num_elements, stats.num_elements);
+    ck_assert_uint_ge(global_stats.num_frames, stats.num_frames);
+    ck_assert_uint_gt(global_stats.num_allocations, 0);
+
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+
+    // Mapped files are not read through I/O methods
+    file = dcm_file_create(file_path, 'm');
+    metadata = dcm_file_read_metadata(file);
+    dcm_file_get_stats(file, &stats);
+    ck_assert_uint_eq(stats.bytes_read, 0);
+    ck_assert_uint_gt(stats.num_elements, 0);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+
+START_TEST(test_file_sm_image_region)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    uint32_t numbers[4];
+    uint32_t x, y;
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    DcmBOT *bot = dcm_file_build_bot(file, metadata);
+    DcmTileMap *map = dcm_tile_map_create(metadata);
+    ck_assert_ptr_nonnull(map);
+
+    // Tiles of 10 x 10 pixels cover the 50 x 50 Total Pixel Matrix
+    ck_assert_uint_eq(dcm_tile_map_find_frames(map, 0, 0, 10, 10,
+                                               numbers, 4), 1);
+    ck_assert_uint_eq(numbers[0], 1);
+    ck_assert_uint_eq(dcm_tile_map_find_frames(map, 5, 5, 10, 10,
+                                               numbers, 4), 4);
+    ck_assert_uint_eq(numbers[0], 1);
+    ck_assert_uint_eq(numbers[1], 2);
+    ck_assert_uint_eq(numbers[2], 6);
+    ck_assert_uint_eq(numbers[3], 7);
+    ck_assert_uint_eq(dcm_tile_map_find_frames(map, 0, 0, 50, 50,
+                                               numbers, 4), 25);
+    ck_assert_uint_eq(dcm_tile_map_find_frames(map, 50, 0, 1, 1,
+                                               numbers, 4), 0);
+
+    // The region is stitched from the pixels of the Frames it covers
+    DcmFrame *frames[25];
+    for (x = 0; x < 25; x++) {
+        frames[x] = dcm_file_read_frame(file, metadata, bot, x + 1);
+    }
+    char region[20 * 20 * 3];
+    ck_assert(dcm_file_read_region(file, metadata, bot, map, NULL,
+                                   15, 12, 20, 20, region, sizeof(region)));
+    for (y = 0; y < 20; y++) {
+        for (x = 0; x < 20; x++) {
+            uint32_t tile = (15 + y) / 10 * 5 + (12 + x) / 10;
+            const char *pixel = dcm_frame_get_value(frames[tile]) +
+                                ((15 + y) % 10 * 10 + (12 + x) % 10) * 3;
+            ck_assert_int_eq(memcmp(region + (y * 20 + x) * 3, pixel, 3), 0);
+        }
+    }
+
+    // Pixels beyond the Total Pixel Matrix are zero
+    DcmDecoder *decoder = dcm_decoder_create();
+    ck_assert(dcm_file_read_region(file, metadata, bot, map, decoder,
+                                   45, 45, 10, 10, region, 300));
+    ck_assert_int_eq(memcmp(region,
+                            dcm_frame_get_value(frames[24]) + 165,
+                            15), 0);
+    ck_assert_int_eq(region[5 * 3], 0);
+    ck_assert_int_eq(region[299], 0);
+    ck_assert(!dcm_file_read_region(file, metadata, bot, map, decoder,
+                                    0, 0, 10, 10, region, 299));
+    dcm_decoder_destroy(decoder);
+
+    for (x = 0; x < 25; x++) {
+        dcm_frame_destroy(frames[x]);
+    }
+    dcm_tile_map_destroy(map);
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+
+    // Sparse tiles are placed by their Plane Position
+    metadata = create_sparse_metadata();
+    map = dcm_tile_map_create(metadata);
+    ck_assert_ptr_nonnull(map);
+    ck_assert_uint_eq(dcm_tile_map_find_frames(map, 0, 0, 10, 10,
+                                               numbers, 4), 2);
+    ck_assert_uint_eq(numbers[0], 1);
+    ck_assert_uint_eq(numbers[1], 3);
+    ck_assert_uint_eq(dcm_tile_map_find_frames(map, 10, 20, 1, 1,
+                                               numbers, 4), 1);
+    ck_assert_uint_eq(numbers[0], 2);
+    ck_assert_uint_eq(dcm_tile_map_find_frames(map, 20, 0, 10, 10,
+                                               numbers, 4), 0);
+    dcm_tile_map_destroy(map);
+    dcm_dataset_destroy(metadata);
+}
+END_TEST
+
+
+START_TEST(test_file_sm_image_frame_view)
+{
+    const uint32_t frame_number = 25;
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    const char modes[] = {'r', 'm'};
+    uint32_t i;
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    DcmBOT *bot = dcm_file_build_bot(file, metadata);
+    DcmFrame *frame = dcm_file_read_frame(file, metadata, bot, frame_number);
+
+    for (i = 0; i < sizeof(modes); i++) {
+        DcmFile *view_file = dcm_file_create(file_path, modes[i]);
+        DcmDataSet *view_metadata = dcm_file_read_metadata(view_file);
+        DcmBOT *view_bot = dcm_file_build_bot(view_file, view_metadata);
+        DcmFrame *view = dcm_file_read_frame_view(view_file,
+                                                  view_bot,
+                                                  frame_number);
+
+        // The view outlives the file it was read from
+        dcm_bot_destroy(view_bot);
+        dcm_dataset_destroy(view_metadata);
+        dcm_file_destroy(view_file);
+
+        ck_assert_uint_eq(dcm_frame_get_number(view), frame_number);
+        ck_assert_uint_eq(dcm_frame_get_rows(view), 10);
+        ck_assert_uint_eq(dcm_frame_get_columns(view), 10);
+        ck_assert_uint_eq(dcm_frame_get_samples_per_pixel(view), 3);
+        ck_assert_str_eq(dcm_frame_get_photometric_interpretation(view),
+                         "RGB");
+        ck_assert_str_eq(dcm_frame_get_transfer_syntax_uid(view),
+                         "1.2.840.10008.1.2.1");
+        ck_assert_uint_eq(dcm_frame_get_length(view),
+                          dcm_frame_get_length(frame));
+        ck_assert_int_eq(memcmp(dcm_frame_get_value(view),
+                                dcm_frame_get_value(frame),
+                                dcm_frame_get_length(frame)), 0);
+
+        dcm_frame_destroy(view);
+    }
+
+    dcm_frame_destroy(frame);
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+
+START_TEST(test_file_sm_image_offset_index)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    const char *index_path = "./sm_image_offset_index.tmp";
+    uint32_t i;
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    DcmBOT *bot = dcm_file_build_bot(file, metadata);
+
+    size_t length;
+    char *index = dcm_file_create_offset_index(file, bot, &length);
+    ck_assert_ptr_nonnull(index);
+    ck_assert(dcm_file_write_offset_index(file, bot, index_path));
+
+    // Truncated indices and indices of files of different size are rejected
+    DcmFile *other_file = dcm_file_create(file_path, 'r');
+    ck_assert(!dcm_file_load_offset_index(other_file, index, length - 8));
+    index[8] ^= 1;
+    ck_assert(!dcm_file_load_offset_index(other_file, index, length));
+    index[8] ^= 1;
+    dcm_file_destroy(other_file);
+
+    DcmFile *index_file = dcm_file_create(file_path, 'm');
+    ck_assert(dcm_file_read_offset_index(index_file, index_path));
+    DcmDataSet *index_metadata = dcm_file_read_metadata(index_file);
+    DcmBOT *index_bot = dcm_file_build_bot(index_file, index_metadata);
+    ck_assert_uint_eq(dcm_bot_get_num_frames(index_bot), 25);
+    for (i = 1; i <= 25; i++) {
+        ck_assert_int_eq(dcm_bot_get_frame_offset(index_bot, i),
+                         dcm_bot_get_frame_offset(bot, i));
+    }
+    DcmFrame *frame = dcm_file_read_frame(index_file,
+                                          index_metadata,
+                                          index_bot,
+                                          25);
+    ck_assert_uint_eq(dcm_frame_get_length(frame), 300);
+    dcm_frame_destroy(frame);
+
+    dcm_bot_destroy(index_bot);
+    dcm_dataset_destroy(index_metadata);
+    dcm_file_destroy(index_file);
+    remove(index_path);
+    free(index);
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+
+static char *read_whole_file(const char *file_path, size_t *size)
+{
+    FILE *fp = fopen(file_path, "rb");
+    ck_assert_ptr_nonnull(fp);
+    fseek(fp, 0, SEEK_END);
+    *size = (size_t) ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *content = malloc(*size);
+    ck_assert_ptr_nonnull(content);
+    ck_assert_uint_eq(fread(content, 1, *size, fp), *size);
+    fclose(fp);
+    return content;
+}
+
+
+static bool contains_bytes(const char *content,
+                           size_t size,
+                           const char *bytes,
+                           size_t length)
+{
+    size_t i;
+    for (i = 0; i + length <= size; i++) {
+        if (memcmp(content + i, bytes, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+ * Shorten the value of the Extended Offset Table of a written file.
+ */
+static void truncate_extended_offset_table(const char *file_path,
+                                           uint32_t length)
+{
+    const char header[8] = {'\xE0', '\x7F', '\x01', '\x00', 'O', 'V', 0, 0};
+    size_t size;
+    size_t i;
+
+    char *content = read_whole_file(file_path, &size);
+    for (i = 0; i + 12 <= size; i++) {
+        if (memcmp(content + i, header, 8) == 0) {
+            break;
+        }
+    }
+    ck_assert_uint_le(i + 12, size);
+    uint32_t old_length = (uint8_t) content[i + 8] |
+                          (uint8_t) content[i + 9] << 8 |
+                          (uint8_t) content[i + 10] << 16 |
+                          (uint32_t) (uint8_t) content[i + 11] << 24;
+    ck_assert_uint_le(length, old_length);
+    content[i + 8] = (char) length;
+    content[i + 9] = (char) (length >> 8);
+    content[i + 10] = (char) (length >> 16);
+    content[i + 11] = (char) (length >> 24);
+
+    FILE *fp = fopen(file_path, "wb");
+    ck_assert_ptr_nonnull(fp);
+    size_t end = i + 12 + length;
+    size_t rest = i + 12 + old_length;
+    ck_assert_uint_eq(fwrite(content, 1, end, fp), end);
+    ck_assert_uint_eq(fwrite(content + rest, 1, size - rest, fp), size - rest);
+    fclose(fp);
+    free(content);
+}
+
+
+static void write_file(const char *file_path,
+                       const DcmDataSet *file_meta,
+                       const DcmDataSet *metadata,
+                       bool use_extended_offset_table,
+                       DcmFrame **frames)
+{
+    uint32_t i;
+
+    DcmFile *file = dcm_file_create(file_path, 'w');
+    ck_assert_ptr_nonnull(file);
+    ck_assert(dcm_file_write_metadata(file,
+                                      file_meta,
+                                      metadata,
+                                      use_extended_offset_table));
+    ck_assert(!dcm_file_finish_write(file));
+    for (i = 0; i < 25; i++) {
+        ck_assert(dcm_file_write_frame(file,
+                                       dcm_frame_get_value(frames[i]),
+                                       dcm_frame_get_length(frames[i])));
+    }
+    ck_assert(!dcm_file_write_frame(file,
+                                    dcm_frame_get_value(frames[0]),
+                                    dcm_frame_get_length(frames[0])));
+    ck_assert(dcm_file_finish_write(file));
+    dcm_file_destroy(file);
+}
+
+
+static void check_written_file(const char *file_path,
+                               const char *transfer_syntax_uid,
+                               const DcmDataSet *metadata,
+                               uint32_t num_elements,
+                               DcmFrame **frames)
+{
+    uint32_t i;
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    ck_assert_ptr_nonnull(file);
+    DcmDataSet *file_meta = dcm_file_read_file_meta(file);
+    ck_assert_ptr_nonnull(file_meta);
+    DcmElement *element = dcm_dataset_get(file_meta, 0x00020010);
+    ck_assert_str_eq(dcm_element_get_value_UI(element, 0),
+                     transfer_syntax_uid);
+
+    DcmDataSet *other_metadata = dcm_file_read_metadata(file);
+    ck_assert_ptr_nonnull(other_metadata);
+    ck_assert_uint_eq(dcm_dataset_count(other_metadata), num_elements);
+    element = dcm_dataset_get(other_metadata, 0x00080016);
+    ck_assert_str_eq(dcm_element_get_value_UI(element, 0),
+                     dcm_element_get_value_UI(dcm_dataset_get(metadata,
+                                                              0x00080016),
+                                              0));
+    element = dcm_dataset_get(other_metadata, 0x00480006);
+    ck_assert_uint_eq(dcm_element_get_value_UL(element, 0), 50);
+
+    // Attribute Tags are written as group and element number
+    DcmSequence *sequence = dcm_element_get_value_SQ(
+        dcm_dataset_get(other_metadata, 0x00209222));
+    element = dcm_dataset_get(dcm_sequence_get(sequence, 0), 0x00209165);
+    ck_assert_uint_eq(dcm_element_get_value_AT(element, 0), 0x0048021F);
+    size_t size;
+    char *content = read_whole_file(file_path, &size);
+    ck_assert(contains_bytes(content, size,
+                             "\x20\x00\x65\x91" "AT\x04\x00"
+                             "\x48\x00\x1F\x02", 12));
+    ck_assert(contains_bytes(content, size,
+                             "\x20\x00\x65\x91" "AT\x04\x00"
+                             "\x48\x00\x1E\x02", 12));
+    free(content);
+
+    // Nested Sequences survive the round trip
+    const char *path = "SharedFunctionalGroupsSequence[0]"
+                       ".PixelMeasuresSequence[0].SliceThickness";
+    DcmQuery *query = dcm_query_create(path);
+    double value;
+    ck_assert_uint_eq(dcm_query_evaluate_numbers(query,
+                                                 other_metadata,
+                                                 &value,
+                                                 1), 1);
+    ck_assert(value == 0.01);
+    dcm_query_destroy(query);
+
+    // Offsets of encapsulated Frames are read from the offset table and
+    // built from the Pixel Data when there is no usable table
+    DcmBOT *bot = NULL;
+    if (dcm_is_encapsulated_transfer_syntax(transfer_syntax_uid)) {
+        bot = dcm_file_read_bot(file, other_metadata);
+    }
+    if (bot == NULL) {
+        bot = dcm_file_build_bot(file, other_metadata);
+    }
+    ck_assert_ptr_nonnull(bot);
+    ck_assert_uint_eq(dcm_bot_get_num_frames(bot), 25);
+    for (i = 0; i < 25; i++) {
+        DcmFrame *frame = dcm_file_read_frame(file,
+                                              other_metadata,
+                                              bot,
+                                              i + 1);
+        ck_assert_ptr_nonnull(frame);
+        ck_assert_uint_eq(dcm_frame_get_length(frame),
+                          dcm_frame_get_length(frames[i]));
+        ck_assert_int_eq(memcmp(dcm_frame_get_value(frame),
+                                dcm_frame_get_value(frames[i]),
+                                dcm_frame_get_length(frame)), 0);
+        dcm_frame_destroy(frame);
+    }
+
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(other_metadata);
+    dcm_dataset_destroy(file_meta);
+    dcm_file_destroy(file);
+    remove(file_path);
+}
+
+
+START_TEST(test_file_sm_image_write)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    const char *output_path = "./sm_image_write.tmp";
+    const char *jpeg_uid = "1.2.840.10008.1.2.4.50";
+    DcmFrame *frames[25];
+    uint32_t i;
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *file_meta = dcm_file_read_file_meta(file);
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    DcmBOT *bot = dcm_file_build_bot(file, metadata);
+    for (i = 0; i < 25; i++) {
+        frames[i] = dcm_file_read_frame(file, metadata, bot, i + 1);
+        ck_assert_ptr_nonnull(frames[i]);
+    }
+
+    write_file(output_path, file_meta, metadata, false, frames);
+    const char *native_uid = dcm_element_get_value_UI(
+        dcm_dataset_get(file_meta, 0x00020010), 0);
+    uint32_t num_elements = dcm_dataset_count(metadata);
+    check_written_file(output_path, native_uid, metadata, num_elements, frames);
+
+    // Frames must match the image description of native Pixel Data
+    DcmFile *output = dcm_file_create(output_path, 'w');
+    ck_assert(dcm_file_write_metadata(output, file_meta, metadata, false));
+    ck_assert(!dcm_file_write_frame(output, dcm_frame_get_value(frames[0]), 3));
+    dcm_file_destroy(output);
+    remove(output_path);
+
+    // The same Frames can be stored encapsulated with either offset table
+    DcmDataSet *encapsulated_meta = dcm_dataset_clone(file_meta);
+    ck_assert(dcm_dataset_remove(encapsulated_meta, 0x00020010));
+    char *value = malloc(strlen(jpeg_uid) + 1);
+    strcpy(value, jpeg_uid);
+    ck_assert(dcm_dataset_insert(encapsulated_meta,
+                                 dcm_element_create_UI(0x00020010, value)));
+    write_file(output_path, encapsulated_meta, metadata, false, frames);
+    check_written_file(output_path, jpeg_uid, metadata, num_elements, frames);
+
+    // The Extended Offset Table and its lengths are part of the Data Set
+    write_file(output_path, encapsulated_meta, metadata, true, frames);
+    check_written_file(output_path,
+                       jpeg_uid,
+                       metadata,
+                       num_elements + 2,
+                       frames);
+
+    // Frames of an empty or malformed Extended Offset Table are located
+    // without it and the table is left out
+    write_file(output_path, encapsulated_meta, metadata, true, frames);
+    truncate_extended_offset_table(output_path, 0);
+    check_written_file(output_path,
+                       jpeg_uid,
+                       metadata,
+                       num_elements + 1,
+                       frames);
+    write_file(output_path, encapsulated_meta, metadata, true, frames);
+    truncate_extended_offset_table(output_path, 12);
+    check_written_file(output_path,
+                       jpeg_uid,
+                       metadata,
+                       num_elements + 1,
+                       frames);
+
+    dcm_dataset_destroy(encapsulated_meta);
+    for (i = 0; i < 25; i++) {
+        dcm_frame_destroy(frames[i]);
+    }
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(metadata);
+    dcm_dataset_destroy(file_meta);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+
+static void check_stream(const char *file_path, DcmFrame **frames)
+{
+    const size_t chunk_size = 997;
+    size_t size;
+    char *content = read_whole_file(file_path, &size);
+
+    DcmStream *stream = dcm_stream_create();
+    ck_assert_ptr_nonnull(stream);
+    DcmStreamState state = DCM_STREAM_NEED_DATA;
+    size_t metadata_offset = 0;
+    uint32_t num_read = 0;
+    for (size_t offset = 0; offset < size; offset += chunk_size) {
+        size_t length = size - offset < chunk_size ? size - offset : chunk_size;
+        state = dcm_stream_push(stream, content + offset, length);
+        ck_assert_int_ne(state, DCM_STREAM_ERROR);
+        if (state == DCM_STREAM_NEED_DATA) {
+            ck_assert_ptr_null(dcm_stream_get_metadata(stream));
+            continue;
+        }
+        if (metadata_offset == 0) {
+            metadata_offset = offset + length;
+        }
+
+        // Frames are read as soon as they have arrived
+        uint32_t num_frames = dcm_stream_get_num_frames(stream);
+        ck_assert_uint_ge(num_frames, num_read);
+        for (; num_read < num_frames; num_read++) {
+            DcmFrame *frame = dcm_stream_read_frame(stream, num_read + 1);
+            ck_assert_ptr_nonnull(frame);
+            ck_assert_uint_eq(dcm_frame_get_length(frame),
+                              dcm_frame_get_length(frames[num_read]));
+            ck_assert_mem_eq(dcm_frame_get_value(frame),
+                             dcm_frame_get_value(frames[num_read]),
+                             dcm_frame_get_length(frame));
+            dcm_frame_destroy(frame);
+        }
+        ck_assert_ptr_null(dcm_stream_read_frame(stream, num_frames + 1));
+    }
+    ck_assert_uint_gt(metadata_offset, 0);
+    // The metadata is read before most Frames have arrived
+    ck_assert_uint_lt(metadata_offset + 20 * dcm_frame_get_length(frames[0]),
+                      size);
+    ck_assert_int_eq(state, DCM_STREAM_COMPLETE);
+    ck_assert_int_eq(dcm_stream_finish(stream), DCM_STREAM_COMPLETE);
+    ck_assert_uint_eq(num_read, 25);
+
+    DcmElement *element = dcm_dataset_get(dcm_stream_get_metadata(stream),
+                                          0x00080016);
+    ck_assert_str_eq(dcm_element_get_value_UI(element, 0),
+                     "1.2.840.10008.5.1.4.1.1.77.1.6");
+    ck_assert_ptr_nonnull(dcm_stream_get_file_meta(stream));
+    dcm_stream_destroy(stream);
+
+    // Content that ends early keeps what has arrived
+    stream = dcm_stream_create();
+    ck_assert_int_eq(dcm_stream_push(stream, content, size - 100),
+                     DCM_STREAM_METADATA);
+    ck_assert_int_eq(dcm_stream_finish(stream), DCM_STREAM_ERROR);
+    ck_assert_ptr_nonnull(dcm_stream_get_metadata(stream));
+    ck_assert_uint_eq(dcm_stream_get_num_frames(stream), 24);
+    ck_assert_int_eq(dcm_stream_push(stream, content, 1), DCM_STREAM_ERROR);
+    dcm_stream_destroy(stream);
+
+    free(content);
+}
+
+
+START_TEST(test_file_sm_image_stream)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    const char *output_path = "./sm_image_stream.tmp";
+    const char *jpeg_uid = "1.2.840.10008.1.2.4.50";
+    DcmFrame *frames[25];
+    uint32_t i;
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *file_meta = dcm_file_read_file_meta(file);
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    DcmBOT *bot = dcm_file_build_bot(file, metadata);
+    for (i = 0; i < 25; i++) {
+        frames[i] = dcm_file_read_frame(file, metadata, bot, i + 1);
+        ck_assert_ptr_nonnull(frames[i]);
+    }
+
+    check_stream(file_path, frames);
+
+    // Encapsulated Frames arrive as their Items complete
+    DcmDataSet *encapsulated_meta = dcm_dataset_clone(file_meta);
+    ck_assert(dcm_dataset_remove(encapsulated_meta, 0x00020010));
+    char *value = malloc(strlen(jpeg_uid) + 1);
+    strcpy(value, jpeg_uid);
+    ck_assert(dcm_dataset_insert(encapsulated_meta,
+                                 dcm_element_create_UI(0x00020010, value)));
+    write_file(output_path, encapsulated_meta, metadata, false, frames);
+    check_stream(output_path, frames);
+    remove(output_path);
+
+    // Number of Frames must be a positive integer
+    const char header[10] = {'\x28', 0, '\x08', 0, 'I', 'S', 2, 0, '2', '5'};
+    const char *invalid_values[] = {"-1", "  ", "0 ", "1x"};
+    size_t size;
+    char *content = read_whole_file(file_path, &size);
+    for (i = 0; i + sizeof(header) <= size; i++) {
+        if (memcmp(content + i, header, sizeof(header)) == 0) {
+            break;
+        }
+    }
+    ck_assert_uint_le(i + sizeof(header), size);
+    char *value_bytes = content + i + 8;
+    for (i = 0; i < 4; i++) {
+        memcpy(value_bytes, invalid_values[i], 2);
+
+        DcmStream *stream = dcm_stream_create();
+        DcmStreamState state = dcm_stream_push(stream, content, size);
+        if (state != DCM_STREAM_ERROR) {
+            state = dcm_stream_finish(stream);
+        }
+        ck_assert_int_eq(state, DCM_STREAM_ERROR);
+        dcm_stream_destroy(stream);
+
+        DcmFile *memory_file = dcm_file_create_memory(content, size);
+        DcmDataSet *memory_metadata = dcm_file_read_metadata(memory_file);
+        if (memory_metadata) {
+            ck_assert_ptr_null(dcm_file_build_bot(memory_file,
+                                                  memory_metadata));
+        }
+        dcm_dataset_destroy(memory_metadata);
+        dcm_file_destroy(memory_file);
+    }
+    free(content);
+
+    dcm_dataset_destroy(encapsulated_meta);
+    for (i = 0; i < 25; i++) {
+        dcm_frame_destroy(frames[i]);
+    }
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(metadata);
+    dcm_dataset_destroy(file_meta);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+
+START_TEST(test_file_sm_image_frames)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    const char modes[] = {'r', 'm'};
+    const uint32_t numbers[] = {7, 3, 4, 5, 25, 1, 4};
+    const uint32_t num_numbers = sizeof(numbers) / sizeof(numbers[0]);
+    DcmFrame *frames[sizeof(numbers) / sizeof(numbers[0])];
+    uint32_t i, j;
+
+    for (i = 0; i < sizeof(modes); i++) {
+        DcmFile *file = dcm_file_create(file_path, modes[i]);
+        DcmDataSet *metadata = dcm_file_read_metadata(file);
+        DcmBOT *bot = dcm_file_build_bot(file, metadata);
+
+        ck_assert_int_eq(dcm_file_read_frames(file,
+                                              metadata,
+                                              bot,
+                                              numbers,
+                                              num_numbers,
+                                              frames), true);
+
+        for (j = 0; j < num_numbers; j++) {
+            DcmFrame *frame = dcm_file_read_frame(file,
+                                                  metadata,
+                                                  bot,
+                                                  numbers[j]);
+            ck_assert_uint_eq(dcm_frame_get_number(frames[j]), numbers[j]);
+            ck_assert_str_eq(dcm_frame_get_transfer_syntax_uid(frames[j]),
+                             "1.2.840.10008.1.2.1");
+            ck_assert_uint_eq(dcm_frame_get_length(frames[j]),
+                              dcm_frame_get_length(frame));
+            ck_assert_int_eq(memcmp(dcm_frame_get_value(frames[j]),
+                                    dcm_frame_get_value(frame),
+                                    dcm_frame_get_length(frame)), 0);
+            dcm_frame_destroy(frame);
+        }
+
+        // Frame numbers out of range fail the whole batch
+        const uint32_t invalid_numbers[] = {2, 26};
+        DcmFrame *invalid_frames[2];
+        ck_assert_int_eq(dcm_file_read_frames(file,
+                                              metadata,
+                                              bot,
+                                              invalid_numbers,
+                                              2,
+                                              invalid_frames), false);
+        ck_assert_ptr_null(invalid_frames[0]);
+        ck_assert_ptr_null(invalid_frames[1]);
+
+        dcm_bot_destroy(bot);
+        dcm_dataset_destroy(metadata);
+        dcm_file_destroy(file);
+
+        // Frames keep the shared pixel data alive
+        for (j = 0; j < num_numbers; j++) {
+            dcm_frame_destroy(frames[j]);
+        }
+    }
+}
+END_TEST
+
+
+struct FrameReader {
+    const DcmFile *file;
+    const DcmDataSet *metadata;
+    const DcmBOT *bot;
+    DcmFrame **expected;
+    uint32_t num_frames;
+    uint32_t num_mismatches;
+};
+
+
+static void *read_frames(void *arg)
+{
+    struct FrameReader *reader = (struct FrameReader *) arg;
+    uint32_t i;
+
+    // Read in reverse order to interleave with the other threads
+    for (i = reader->num_frames; i > 0; i--) {
+        DcmFrame *frame = dcm_file_read_frame(reader->file,
+                                              reader->metadata,
+                                              reader->bot,
+                                              i);
+        const DcmFrame *expected = reader->expected[i - 1];
+        if (frame == NULL ||
+            dcm_frame_get_length(frame) != dcm_frame_get_length(expected) ||
+            memcmp(dcm_frame_get_value(frame),
+                   dcm_frame_get_value(expected),
+                   dcm_frame_get_length(expected)) != 0) {
+            reader->num_mismatches += 1;
+        }
+        dcm_frame_destroy(frame);
+    }
+    return NULL;
+}
+
+
+START_TEST(test_file_sm_image_concurrent_frames)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    const char modes[] = {'r', 'm'};
+    const uint32_t num_frames = 25;
+    DcmFrame *expected[25];
+    struct FrameReader readers[4];
+    pthread_t threads[4];
+    uint32_t i, j;
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    DcmBOT *bot = dcm_file_build_bot(file, metadata);
+    for (i = 0; i < num_frames; i++) {
+        expected[i] = dcm_file_read_frame(file, metadata, bot, i + 1);
+        ck_assert_ptr_nonnull(expected[i]);
+    }
+
+    for (i = 0; i < sizeof(modes); i++) {
+        DcmFile *shared_file = dcm_file_create(file_path, modes[i]);
+        DcmDataSet *shared_metadata = dcm_file_read_metadata(shared_file);
+        DcmBOT *shared_bot = dcm_file_build_bot(shared_file, shared_metadata);
+
+        for (j = 0; j < 4; j++) {
+            readers[j].file = shared_file;
+            readers[j].metadata = shared_metadata;
+            readers[j].bot = shared_bot;
+            readers[j].expected = expected;
+            readers[j].num_frames = num_frames;
+            readers[j].num_mismatches = 0;
+            ck_assert_int_eq(pthread_create(&threads[j],
+                                            NULL,
+                                            read_frames,
+                                            &readers[j]), 0);
+        }
+        for (j = 0; j < 4; j++) {
+            pthread_join(threads[j], NULL);
+            ck_assert_uint_eq(readers[j].num_mismatches, 0);
+        }
+
+        dcm_bot_destroy(shared_bot);
+        dcm_dataset_destroy(shared_metadata);
+        dcm_file_destroy(shared_file);
+    }
+
+    for (i = 0; i < num_frames; i++) {
+        dcm_frame_destroy(expected[i]);
+    }
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+
+START_TEST(test_file_sm_image_async_frames)
+{
+    const char *file_path = "./data/test_files/sm_image.dcm";
+    const char modes[] = {'r', 'm'};
+    const uint32_t num_frames = 25;
+    DcmFrameRequest *requests[25];
+    uint32_t i, j;
+
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    DcmDataSet *metadata = dcm_file_read_metadata(file);
+    DcmBOT *bot = dcm_file_build_bot(file, metadata);
+
+    for (i = 0; i < sizeof(modes); i++) {
+        DcmFile *async_file = dcm_file_create(file_path, modes[i]);
+        DcmDataSet *async_metadata = dcm_file_read_metadata(async_file);
+        DcmBOT *async_bot = dcm_file_build_bot(async_file, async_metadata);
+
+        for (j = 0; j < num_frames; j++) {
+            requests[j] = dcm_file_submit_frame(async_file, async_bot, j + 1);
+            ck_assert_ptr_nonnull(requests[j]);
+        }
+        ck_assert_ptr_null(dcm_file_submit_frame(async_file,
+                                                 async_bot,
+                                                 num_frames + 1));
+
+        // Pending reads keep the file alive
+        dcm_bot_destroy(async_bot);
+        dcm_dataset_destroy(async_metadata);
+        dcm_file_destroy(async_file);
+
+        for (j = 0; j < num_frames; j++) {
+            DcmFrame *async_frame = dcm_frame_request_wait(requests[j]);
+            DcmFrame *frame = dcm_file_read_frame(file, metadata, bot, j + 1);
+            ck_assert_ptr_nonnull(async_frame);
+            ck_assert_uint_eq(dcm_frame_get_number(async_frame), j + 1);
+            ck_assert_uint_eq(dcm_frame_get_length(async_frame),
+                              dcm_frame_get_length(frame));
+            ck_assert_int_eq(memcmp(dcm_frame_get_value(async_frame),
+                                    dcm_frame_get_value(frame),
+                                    dcm_frame_get_length(frame)), 0);
+            dcm_frame_destroy(frame);
+            dcm_frame_destroy(async_frame);
+        }
+    }
+
+    dcm_bot_destroy(bot);
+    dcm_dataset_destroy(metadata);
+    dcm_file_destroy(file);
+}
+END_TEST
+
+
 Suite *create_main_suite(void)
 {
     Suite *suite = suite_create("main");
 
     TCase *log_case = tcase_create("log");
     tcase_add_test(log_case, test_log_level);
+    tcase_add_test(log_case, test_allocator_and_log);
     suite_add_tcase(suite, log_case);
 
     TCase *dict_case = tcase_create("dict");
@@ -538,10 +2720,12 @@ Suite *create_data_suite(void)
     tcase_add_test(element_case, test_element_SQ_empty);
     tcase_add_test(element_case, test_element_UI);
     tcase_add_test(element_case, test_element_US);
+    tcase_add_test(element_case, test_element_single_values);
     suite_add_tcase(suite, element_case);
 
     TCase *dataset_case = tcase_create("dataset");
     tcase_add_test(dataset_case, test_dataset);
+    tcase_add_test(dataset_case, test_dataset_frame_values);
     suite_add_tcase(suite, dataset_case);
 
     TCase *sequence_case = tcase_create("sequence");
@@ -562,10 +2746,32 @@ Suite *create_file_suite(void)
 
     TCase *metadata_case = tcase_create("metadata");
     tcase_add_test(metadata_case, test_file_sm_image_metadata);
+    tcase_add_test(metadata_case, test_file_sm_image_metadata_arena);
+    tcase_add_test(metadata_case, test_file_sm_image_metadata_lazy);
+    tcase_add_test(metadata_case, test_file_sm_image_metadata_tags);
+    tcase_add_test(metadata_case, test_file_sm_image_metadata_query);
+    tcase_add_test(metadata_case, test_file_sm_image_metadata_parallel);
+    tcase_add_test(metadata_case, test_file_sm_image_parse);
+    tcase_add_test(metadata_case, test_file_sm_image_series);
     suite_add_tcase(suite, metadata_case);
 
     TCase *frame_case = tcase_create("frame");
+    tcase_add_test(frame_case, test_frame_convert);
+    tcase_add_test(frame_case, test_frame_decode);
     tcase_add_test(frame_case, test_file_sm_image_frame);
+    tcase_add_test(frame_case, test_file_sm_image_mapped);
+    tcase_add_test(frame_case, test_file_sm_image_io);
+    tcase_add_test(frame_case, test_file_sm_image_frame_cache);
+    tcase_add_test(frame_case, test_file_sm_image_prefetch);
+    tcase_add_test(frame_case, test_file_sm_image_region);
+    tcase_add_test(frame_case, test_file_sm_image_stats);
+    tcase_add_test(frame_case, test_file_sm_image_frame_view);
+    tcase_add_test(frame_case, test_file_sm_image_frames);
+    tcase_add_test(frame_case, test_file_sm_image_offset_index);
+    tcase_add_test(frame_case, test_file_sm_image_write);
+    tcase_add_test(frame_case, test_file_sm_image_stream);
+    tcase_add_test(frame_case, test_file_sm_image_concurrent_frames);
+    tcase_add_test(frame_case, test_file_sm_image_async_frames);
     suite_add_tcase(suite, frame_case);
 
     return suite;
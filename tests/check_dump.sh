@@ -0,0 +1,103 @@
+#!/bin/sh
+# Check the output of dcm-dump for the bundled test files in each mode.
+
+srcdir=${srcdir:-.}
+dump=./tools/dcm-dump
+sm_image=$srcdir/data/test_files/sm_image.dcm
+values=$srcdir/data/test_files/values.dcm
+output=./check_dump.tmp
+status=0
+
+fail()
+{
+    echo "FAIL: $1" >&2
+    status=1
+}
+
+# Run dcm-dump with the given arguments, whose output must succeed
+run()
+{
+    if ! "$dump" "$@" > "$output"; then
+        fail "dcm-dump $* returned $?"
+    fi
+}
+
+# Check that the output contains a line
+expect_line()
+{
+    if ! grep -F -x -q -e "$1" "$output"; then
+        fail "missing line: $1"
+    fi
+}
+
+# Check that the output does not contain a string
+reject()
+{
+    if grep -F -q -e "$1" "$output"; then
+        fail "unexpected output: $1"
+    fi
+}
+
+# Plain text
+run "$values"
+expect_line "(0008,0119) LongCodeValue | UC | 32 | ABCDEFGHIJKLMNOPQRSTUVWXYZ012345"
+expect_line "(0010,4000) PatientComments | LT | 32 | First line"
+expect_line "Second \"quoted\" line"
+expect_line "(0018,1020) SoftwareVersions | LO | 26 | [libdicom 1.0, dcm-dump 1.0]"
+expect_line "(0028,0009) FrameIncrementPointer | AT | 8 | [00181063, 00181065]"
+expect_line "(0040,A160) TextValue | UT | 28 | Free text ending in a space"
+expect_line "  (0008,0119) LongCodeValue | UC | 4 | Odd"
+expect_line "    (0040,A160) TextValue | UT | 12 | Nested text"
+
+run "$sm_image"
+expect_line "===File Meta Information==="
+expect_line "(0028,0008) NumberOfFrames | IS | 2 | 25"
+expect_line "  (0020,9165) DimensionIndexPointer | AT | 4 | 0048021F"
+
+# DICOM JSON, which is compared as a whole, so that values must end where
+# they end in the file
+run -j "$values"
+cat > "$output.expected" <<'END'
+{"00020002":{"vr":"UI","Value":["1.2.840.10008.5.1.4.1.1.7"]},"00020003":{"vr":"UI","Value":["1.2.826.0.1.3680043.10.511.3.1"]},"00020010":{"vr":"UI","Value":["1.2.840.10008.1.2.1"]},"00020012":{"vr":"UI","Value":["1.2.826.0.1.3680043.10.511"]},"00080016":{"vr":"UI","Value":["1.2.840.10008.5.1.4.1.1.7"]},"00080018":{"vr":"UI","Value":["1.2.826.0.1.3680043.10.511.3.1"]},"00080119":{"vr":"UC","Value":["ABCDEFGHIJKLMNOPQRSTUVWXYZ012345"]},"00081190":{"vr":"UR","Value":["https://example.com/studies/1"]},"00100010":{"vr":"PN","Value":[{"Alphabetic":"Doe^Jane"}]},"00104000":{"vr":"LT","Value":["First line\u000aSecond \"quoted\" line"]},"00181020":{"vr":"LO","Value":["libdicom 1.0","dcm-dump 1.0"]},"00280008":{"vr":"IS","Value":[2]},"00280009":{"vr":"AT","Value":["00181063","00181065"]},"0040A160":{"vr":"UT","Value":["Free text ending in a space"]},"0040A730":{"vr":"SQ","Value":[{"00080119":{"vr":"UC","Value":["Odd"]},"0040A730":{"vr":"SQ","Value":[{"0040A160":{"vr":"UT","Value":["Nested text"]}}]}}]}}
+END
+if ! cmp -s "$output" "$output.expected"; then
+    fail "JSON of $values differs"
+fi
+rm -f "$output.expected"
+
+# Values of the image hold no control characters, which values that are
+# read beyond their end would show up as
+run -j "$sm_image"
+reject "\\u00"
+if [ "$(wc -l < "$output")" -ne 1 ]; then
+    fail "JSON of $sm_image is not a single line"
+fi
+
+# Selected Tags
+run -t "FrameIncrementPointer,0040A160" "$values"
+expect_line "(0028,0009) FrameIncrementPointer | AT | 8 | [00181063, 00181065]"
+expect_line "(0040,A160) TextValue | UT | 28 | Free text ending in a space"
+reject "LongCodeValue"
+reject "===File Meta Information==="
+
+run -j -t 00280009 "$values"
+expect_line '{"00280009":{"vr":"AT","Value":["00181063","00181065"]}}'
+
+# Depth of Sequences
+run -d 0 "$values"
+expect_line "(0040,A730) ContentSequence | SQ | [1 Items]"
+reject "Nested text"
+
+run -d 1 "$values"
+expect_line "  (0040,A730) ContentSequence | SQ | [1 Items]"
+reject "Nested text"
+
+# Files read on several threads are printed in the given order
+run -p 2 "$sm_image" "$values" "$sm_image"
+if [ "$(grep -c "^===File '" "$output")" -ne 3 ] ||
+   [ "$(grep "^===File '" "$output" | sed -n 2p)" != "===File '$values'===" ]; then
+    fail "files of dcm-dump -p are not printed in order"
+fi
+
+rm -f "$output"
+exit $status
@@ -1,28 +1,1103 @@
 #include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "config.h"
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
 #include <dicom.h>
 
 
-static const char usage[] = "usage: dcm-dump [-v] [-V] [-h] FILE_PATH\n";
+static const char usage[] = "usage: dcm-dump [-v] [-V] [-h] [-j] "
+                            "[-t TAGS] [-d DEPTH] [-p THREADS] "
+                            "FILE_PATH...\n";
+
+// Size of the stdout buffer, such that output is written in large blocks
+#define STDOUT_BUFFER_SIZE (1024 * 1024)
+
+// Number of files that may be dumped ahead of the file that is written next
+#define FILES_AHEAD_PER_THREAD 4
+
+
+struct Options {
+    bool json;
+    bool print_names;
+    uint32_t *tags;
+    uint32_t num_tags;
+    uint32_t max_depth;
+};
+
+
+/**
+ * Growable buffer that holds the output for a single file.
+ */
+struct Output {
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+};
+
+
+static bool output_reserve(struct Output *output, size_t length)
+{
+    if (output->length + length + 1 <= output->capacity) {
+        return true;
+    }
+    size_t capacity = output->capacity > 0 ? output->capacity : 4096;
+    while (capacity < output->length + length + 1) {
+        capacity *= 2;
+    }
+    char *data = realloc(output->data, capacity);
+    if (data == NULL) {
+        output->failed = true;
+        return false;
+    }
+    output->data = data;
+    output->capacity = capacity;
+    return true;
+}
+
+
+static void output_write(struct Output *output, const char *data, size_t n)
+{
+    if (output_reserve(output, n)) {
+        memcpy(output->data + output->length, data, n);
+        output->length += n;
+    }
+}
+
+
+static void output_puts(struct Output *output, const char *string)
+{
+    output_write(output, string, strlen(string));
+}
+
+
+static void output_printf(struct Output *output, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    char small[256];
+    int n = vsnprintf(small, sizeof(small), format, args);
+    va_end(args);
+    if (n < 0) {
+        output->failed = true;
+    } else if ((size_t) n < sizeof(small)) {
+        output_write(output, small, n);
+    } else if (output_reserve(output, n)) {
+        va_start(args, format);
+        vsnprintf(output->data + output->length, n + 1, format, args);
+        va_end(args);
+        output->length += n;
+    }
+}
+
+
+static void output_destroy(struct Output *output)
+{
+    free(output->data);
+    output->data = NULL;
+    output->length = 0;
+    output->capacity = 0;
+}
+
+
+/**
+ * How values of a Value Representation are accessed and written.
+ */
+enum ValueKind {
+    // Character strings with an index, like dcm_element_get_value_CS()
+    VALUE_STRING,
+    // Decimal String, which is a number in JSON
+    VALUE_DECIMAL,
+    // Integer String, which is a number in JSON
+    VALUE_INTEGER,
+    // Person Name, which is an object in JSON
+    VALUE_PERSON_NAME,
+    // Free text without an index, like dcm_element_get_value_UT()
+    VALUE_TEXT,
+    VALUE_FLOAT,
+    VALUE_SIGNED,
+    VALUE_UNSIGNED,
+    // Attribute Tag, which is a hexadecimal string in JSON
+    VALUE_TAG,
+    VALUE_BINARY,
+    VALUE_SEQUENCE,
+    // Values that cannot be accessed
+    VALUE_NONE,
+};
+
+
+static double get_FD(const DcmElement *element, uint32_t index)
+{
+    return dcm_element_get_value_FD(element, index);
+}
+
+static double get_FL(const DcmElement *element, uint32_t index)
+{
+    return dcm_element_get_value_FL(element, index);
+}
+
+static int64_t get_SL(const DcmElement *element, uint32_t index)
+{
+    return dcm_element_get_value_SL(element, index);
+}
+
+static int64_t get_SS(const DcmElement *element, uint32_t index)
+{
+    return dcm_element_get_value_SS(element, index);
+}
+
+static int64_t get_SV(const DcmElement *element, uint32_t index)
+{
+    return dcm_element_get_value_SV(element, index);
+}
+
+static const char *get_LT(const DcmElement *element)
+{
+    return dcm_element_get_value_string(element, 0);
+}
+
+static uint64_t get_AT(const DcmElement *element, uint32_t index)
+{
+    return dcm_element_get_value_AT(element, index);
+}
+
+static uint64_t get_UL(const DcmElement *element, uint32_t index)
+{
+    return dcm_element_get_value_UL(element, index);
+}
+
+static uint64_t get_US(const DcmElement *element, uint32_t index)
+{
+    return dcm_element_get_value_US(element, index);
+}
+
+static uint64_t get_UV(const DcmElement *element, uint32_t index)
+{
+    return dcm_element_get_value_UV(element, index);
+}
+
+
+struct ValueAccess {
+    char vr[3];
+    enum ValueKind kind;
+    // Whether the value is part of the plain text output
+    bool is_printed;
+    union {
+        const char *(*string)(const DcmElement *element, uint32_t index);
+        const char *(*text)(const DcmElement *element);
+        double (*real)(const DcmElement *element, uint32_t index);
+        int64_t (*sint)(const DcmElement *element, uint32_t index);
+        uint64_t (*uint)(const DcmElement *element, uint32_t index);
+    } get;
+};
+
+
+static const struct ValueAccess value_access[] = {
+    {"AE", VALUE_STRING, true, {.string = dcm_element_get_value_AE}},
+    {"AS", VALUE_STRING, true, {.string = dcm_element_get_value_AS}},
+    {"AT", VALUE_TAG, true, {.uint = get_AT}},
+    {"CS", VALUE_STRING, true, {.string = dcm_element_get_value_CS}},
+    {"DA", VALUE_STRING, true, {.string = dcm_element_get_value_DA}},
+    {"DS", VALUE_DECIMAL, true, {.string = dcm_element_get_value_DS}},
+    {"DT", VALUE_STRING, true, {.string = dcm_element_get_value_DT}},
+    {"FD", VALUE_FLOAT, true, {.real = get_FD}},
+    {"FL", VALUE_FLOAT, true, {.real = get_FL}},
+    {"IS", VALUE_INTEGER, true, {.string = dcm_element_get_value_IS}},
+    {"LO", VALUE_STRING, true, {.string = dcm_element_get_value_string}},
+    {"LT", VALUE_TEXT, true, {.text = get_LT}},
+    {"OB", VALUE_BINARY, false, {.text = dcm_element_get_value_OB}},
+    {"OD", VALUE_BINARY, false, {.text = dcm_element_get_value_OD}},
+    {"OF", VALUE_BINARY, false, {.text = dcm_element_get_value_OF}},
+    {"OL", VALUE_BINARY, false, {.text = dcm_element_get_value_OL}},
+    {"OV", VALUE_BINARY, false, {.text = dcm_element_get_value_OV}},
+    {"OW", VALUE_BINARY, false, {.text = dcm_element_get_value_OW}},
+    {"PN", VALUE_PERSON_NAME, true,
+     {.string = dcm_element_get_value_string}},
+    {"SH", VALUE_STRING, true, {.string = dcm_element_get_value_string}},
+    {"SL", VALUE_SIGNED, true, {.sint = get_SL}},
+    {"SQ", VALUE_SEQUENCE, true, {NULL}},
+    {"SS", VALUE_SIGNED, true, {.sint = get_SS}},
+    {"ST", VALUE_TEXT, true, {.text = dcm_element_get_value_ST}},
+    {"SV", VALUE_SIGNED, true, {.sint = get_SV}},
+    {"TM", VALUE_STRING, true, {.string = dcm_element_get_value_string}},
+    {"UC", VALUE_TEXT, true, {.text = dcm_element_get_value_UC}},
+    {"UI", VALUE_STRING, true, {.string = dcm_element_get_value_UI}},
+    {"UL", VALUE_UNSIGNED, true, {.uint = get_UL}},
+    {"UN", VALUE_BINARY, false, {.text = dcm_element_get_value_UN}},
+    {"UR", VALUE_TEXT, false, {.text = dcm_element_get_value_UR}},
+    {"US", VALUE_UNSIGNED, true, {.uint = get_US}},
+    {"UT", VALUE_TEXT, true, {.text = dcm_element_get_value_UT}},
+    {"UV", VALUE_UNSIGNED, false, {.uint = get_UV}},
+};
+
+
+static const struct ValueAccess *lookup_value_access(const char *vr)
+{
+    size_t n = sizeof(value_access) / sizeof(value_access[0]);
+    for (size_t i = 0; i < n; i++) {
+        if (strcmp(value_access[i].vr, vr) == 0) {
+            return &value_access[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Get the characters of a free text value without its trailing padding.
+ *
+ * Values such as those of Unlimited Characters are not terminated, so at
+ * most the length of the value is used.
+ */
+static const char *get_text(const struct ValueAccess *access,
+                            const DcmElement *element,
+                            size_t *length)
+{
+    const char *text = access->get.text(element);
+    if (text == NULL) {
+        *length = 0;
+        return "";
+    }
+    *length = dcm_element_get_length(element);
+    const char *end = memchr(text, '\0', *length);
+    if (end) {
+        *length = end - text;
+    }
+    while (*length > 0 && text[*length - 1] == ' ') {
+        *length -= 1;
+    }
+    return text;
+}
+
+
+static void dump_text_value(struct Output *output,
+                            const struct ValueAccess *access,
+                            const DcmElement *element,
+                            uint32_t index)
+{
+    const char *text;
+    size_t length;
+
+    switch (access->kind) {
+        case VALUE_STRING:
+        case VALUE_DECIMAL:
+        case VALUE_INTEGER:
+        case VALUE_PERSON_NAME:
+            output_printf(output, "%s", access->get.string(element, index));
+            break;
+        case VALUE_TEXT:
+            text = get_text(access, element, &length);
+            output_write(output, text, length);
+            break;
+        case VALUE_FLOAT:
+            output_printf(output, "%f", access->get.real(element, index));
+            break;
+        case VALUE_SIGNED:
+            output_printf(output, "%" PRId64, access->get.sint(element, index));
+            break;
+        case VALUE_UNSIGNED:
+            output_printf(output, "%" PRIu64, access->get.uint(element, index));
+            break;
+        case VALUE_TAG:
+            output_printf(output,
+                          "%08" PRIX64,
+                          access->get.uint(element, index));
+            break;
+        default:
+            break;
+    }
+}
+
+
+static void dump_text_dataset(struct Output *output,
+                              const struct Options *options,
+                              const DcmDataSet *dataset,
+                              uint32_t depth);
+
+
+static void dump_text_element(struct Output *output,
+                              const struct Options *options,
+                              const DcmElement *element,
+                              uint32_t depth)
+{
+    static const char spaces[] = "                                   ";
+    const int num_indent = depth * 2;
+    const int num_indent_next = (depth + 1) * 2;
+    uint32_t tag = dcm_element_get_tag(element);
+    const char *vr = dcm_element_get_vr(element);
+
+    // The layout is the same as that of dcm_element_print()
+    if (dcm_is_public_tag(tag)) {
+        output_printf(output, "%*.*s(%04X,%04X) %s | %s",
+                      num_indent, num_indent, spaces,
+                      tag >> 16, tag & 0xFFFF,
+                      dcm_dict_lookup_keyword(tag),
+                      vr);
+    } else {
+        output_printf(output, "%*.*s (%04X,%04X) | %s",
+                      num_indent, num_indent, spaces,
+                      tag >> 16, tag & 0xFFFF,
+                      vr);
+    }
+
+    const struct ValueAccess *access = lookup_value_access(vr);
+    if (access == NULL || access->kind != VALUE_SEQUENCE) {
+        uint32_t vm = dcm_element_get_vm(element);
+        output_printf(output, " | %u | ", dcm_element_get_length(element));
+        if (vm > 1) {
+            output_write(output, "[", 1);
+        }
+        for (uint32_t i = 0; i < vm; i++) {
+            if (access && access->is_printed) {
+                dump_text_value(output, access, element, i);
+            }
+            if (vm > 1) {
+                output_puts(output, i == vm - 1 ? "]" : ", ");
+            }
+        }
+        output_write(output, "\n", 1);
+        return;
+    }
+
+    DcmSequence *sequence = dcm_element_get_value_SQ(element);
+    uint32_t num_items = dcm_sequence_count(sequence);
+    if (depth >= options->max_depth) {
+        output_printf(output, " | [%u Items]\n", num_items);
+        return;
+    }
+    output_puts(output, num_items == 0 ? " | [" : " | [\n");
+    for (uint32_t i = 0; i < num_items; i++) {
+        output_printf(output, "%*.*s---Item #%d---\n",
+                      num_indent_next, num_indent_next, spaces,
+                      (int) i + 1);
+        DcmDataSet *item = dcm_sequence_get(sequence, i);
+        dump_text_dataset(output, options, item, depth + 1);
+    }
+    output_printf(output, "%*.*s]\n", num_indent, num_indent, spaces);
+}
+
+
+static bool is_selected(const struct Options *options,
+                        uint32_t depth,
+                        uint32_t tag)
+{
+    if (options->tags == NULL || depth > 0) {
+        return true;
+    }
+    for (uint32_t i = 0; i < options->num_tags; i++) {
+        if (options->tags[i] == tag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+ * Get the Tags of a Data Set in ascending order.
+ */
+static uint32_t *get_tags(const DcmDataSet *dataset, uint32_t *num_tags)
+{
+    *num_tags = dcm_dataset_count(dataset);
+    uint32_t *tags = malloc((*num_tags + 1) * sizeof(uint32_t));
+    if (tags == NULL) {
+        dcm_log_error("Dumping Data Set failed. Could not allocate memory.");
+        return NULL;
+    }
+    dcm_dataset_copy_tags(dataset, tags, *num_tags);
+    return tags;
+}
+
+
+static void dump_text_dataset(struct Output *output,
+                              const struct Options *options,
+                              const DcmDataSet *dataset,
+                              uint32_t depth)
+{
+    uint32_t num_tags;
+    uint32_t *tags = get_tags(dataset, &num_tags);
+    if (tags == NULL) {
+        output->failed = true;
+        return;
+    }
+    for (uint32_t i = 0; i < num_tags; i++) {
+        if (is_selected(options, depth, tags[i])) {
+            DcmElement *element = dcm_dataset_get(dataset, tags[i]);
+            dump_text_element(output, options, element, depth);
+        }
+    }
+    free(tags);
+}
+
+
+static void dump_json_characters(struct Output *output,
+                                 const char *value,
+                                 size_t length)
+{
+    const unsigned char *end = (const unsigned char *) value + length;
+    output_write(output, "\"", 1);
+    for (const unsigned char *c = (const unsigned char *) value; c < end; c++) {
+        if (*c == '"' || *c == '\\') {
+            char escaped[2] = {'\\', (char) *c};
+            output_write(output, escaped, 2);
+        } else if (*c < 0x20) {
+            output_printf(output, "\\u%04x", *c);
+        } else {
+            output_write(output, (const char *) c, 1);
+        }
+    }
+    output_write(output, "\"", 1);
+}
+
+
+static void dump_json_string(struct Output *output, const char *value)
+{
+    dump_json_characters(output, value, strlen(value));
+}
+
+
+// Whether a string follows the grammar of a JSON number
+static bool is_json_number(const char *value)
+{
+    const char *c = value;
+    if (*c == '-') {
+        c++;
+    }
+    if (*c == '0') {
+        c++;
+    } else if (*c >= '1' && *c <= '9') {
+        while (*c >= '0' && *c <= '9') {
+            c++;
+        }
+    } else {
+        return false;
+    }
+    if (*c == '.') {
+        c++;
+        if (!(*c >= '0' && *c <= '9')) {
+            return false;
+        }
+        while (*c >= '0' && *c <= '9') {
+            c++;
+        }
+    }
+    if (*c == 'e' || *c == 'E') {
+        c++;
+        if (*c == '+' || *c == '-') {
+            c++;
+        }
+        if (!(*c >= '0' && *c <= '9')) {
+            return false;
+        }
+        while (*c >= '0' && *c <= '9') {
+            c++;
+        }
+    }
+    return *c == '\0';
+}
+
+
+static void dump_json_number_string(struct Output *output, const char *value)
+{
+    while (*value == ' ') {
+        value++;
+    }
+    size_t length = strlen(value);
+    while (length > 0 && value[length - 1] == ' ') {
+        length--;
+    }
+    char number[64];
+    if (length == 0 || length >= sizeof(number)) {
+        output_puts(output, "null");
+        return;
+    }
+    memcpy(number, value, length);
+    number[length] = '\0';
+    if (is_json_number(number)) {
+        output_write(output, number, length);
+        return;
+    }
+
+    // Forms such as "+1" or ".5" are valid in DICOM, but not in JSON
+    char *end;
+    double real = strtod(number, &end);
+    if (*end == '\0' && isfinite(real)) {
+        output_printf(output, "%.17g", real);
+    } else {
+        output_puts(output, "null");
+    }
+}
+
+
+static void dump_json_base64(struct Output *output,
+                             const unsigned char *data,
+                             uint32_t length)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                   "abcdefghijklmnopqrstuvwxyz"
+                                   "0123456789+/";
+    output_write(output, "\"", 1);
+    for (uint32_t i = 0; i < length; i += 3) {
+        uint32_t n = (uint32_t) data[i] << 16;
+        if (i + 1 < length) {
+            n |= (uint32_t) data[i + 1] << 8;
+        }
+        if (i + 2 < length) {
+            n |= data[i + 2];
+        }
+        char encoded[4] = {
+            alphabet[(n >> 18) & 0x3F],
+            alphabet[(n >> 12) & 0x3F],
+            i + 1 < length ? alphabet[(n >> 6) & 0x3F] : '=',
+            i + 2 < length ? alphabet[n & 0x3F] : '=',
+        };
+        output_write(output, encoded, 4);
+    }
+    output_write(output, "\"", 1);
+}
+
+
+static void dump_json_value(struct Output *output,
+                            const struct ValueAccess *access,
+                            const DcmElement *element,
+                            uint32_t index)
+{
+    const char *string;
+    size_t length;
+    double real;
+
+    switch (access->kind) {
+        case VALUE_STRING:
+        case VALUE_PERSON_NAME:
+            string = access->get.string(element, index);
+            if (string == NULL || string[0] == '\0') {
+                output_puts(output, "null");
+            } else if (access->kind == VALUE_PERSON_NAME) {
+                output_printf(output, "{\"Alphabetic\":");
+                dump_json_string(output, string);
+                output_write(output, "}", 1);
+            } else {
+                dump_json_string(output, string);
+            }
+            break;
+        case VALUE_DECIMAL:
+        case VALUE_INTEGER:
+            dump_json_number_string(output,
+                                    access->get.string(element, index));
+            break;
+        case VALUE_TEXT:
+            string = get_text(access, element, &length);
+            dump_json_characters(output, string, length);
+            break;
+        case VALUE_FLOAT:
+            real = access->get.real(element, index);
+            if (isfinite(real)) {
+                output_printf(output, "%.17g", real);
+            } else {
+                output_puts(output, "null");
+            }
+            break;
+        case VALUE_SIGNED:
+            output_printf(output, "%" PRId64, access->get.sint(element, index));
+            break;
+        case VALUE_UNSIGNED:
+            output_printf(output, "%" PRIu64, access->get.uint(element, index));
+            break;
+        case VALUE_TAG:
+            output_printf(output,
+                          "\"%08" PRIX64 "\"",
+                          access->get.uint(element, index));
+            break;
+        default:
+            break;
+    }
+}
+
+
+static void dump_json_dataset(struct Output *output,
+                              const struct Options *options,
+                              const DcmDataSet *dataset,
+                              uint32_t depth,
+                              bool *is_first);
+
+
+static void dump_json_element(struct Output *output,
+                              const struct Options *options,
+                              const DcmElement *element,
+                              uint32_t depth)
+{
+    const char *vr = dcm_element_get_vr(element);
+    output_printf(output, "\"%08X\":{\"vr\":\"%s\"",
+                  dcm_element_get_tag(element),
+                  vr);
+
+    const struct ValueAccess *access = lookup_value_access(vr);
+    uint32_t vm = dcm_element_get_vm(element);
+    if (access == NULL || access->kind == VALUE_NONE) {
+        // Values that cannot be accessed are left out
+    } else if (access->kind == VALUE_SEQUENCE) {
+        DcmSequence *sequence = dcm_element_get_value_SQ(element);
+        uint32_t num_items = dcm_sequence_count(sequence);
+        if (depth < options->max_depth && num_items > 0) {
+            output_printf(output, ",\"Value\":[");
+            for (uint32_t i = 0; i < num_items; i++) {
+                bool is_first = true;
+                output_puts(output, i == 0 ? "{" : ",{");
+                dump_json_dataset(output,
+                                  options,
+                                  dcm_sequence_get(sequence, i),
+                                  depth + 1,
+                                  &is_first);
+                output_write(output, "}", 1);
+            }
+            output_write(output, "]", 1);
+        }
+    } else if (access->kind == VALUE_BINARY) {
+        uint32_t length = dcm_element_get_length(element);
+        const char *data = access->get.text(element);
+        if (data && length > 0) {
+            output_printf(output, ",\"InlineBinary\":");
+            dump_json_base64(output, (const unsigned char *) data, length);
+        }
+    } else if (vm > 0) {
+        output_printf(output, ",\"Value\":[");
+        for (uint32_t i = 0; i < vm; i++) {
+            if (i > 0) {
+                output_write(output, ",", 1);
+            }
+            dump_json_value(output, access, element, i);
+            if (access->kind == VALUE_TEXT) {
+                break;
+            }
+        }
+        output_write(output, "]", 1);
+    }
+    output_write(output, "}", 1);
+}
+
+
+static void dump_json_dataset(struct Output *output,
+                              const struct Options *options,
+                              const DcmDataSet *dataset,
+                              uint32_t depth,
+                              bool *is_first)
+{
+    uint32_t num_tags;
+    uint32_t *tags = get_tags(dataset, &num_tags);
+    if (tags == NULL) {
+        output->failed = true;
+        return;
+    }
+    for (uint32_t i = 0; i < num_tags; i++) {
+        if (is_selected(options, depth, tags[i])) {
+            if (!*is_first) {
+                output_write(output, ",", 1);
+            }
+            *is_first = false;
+            DcmElement *element = dcm_dataset_get(dataset, tags[i]);
+            dump_json_element(output, options, element, depth);
+        }
+    }
+    free(tags);
+}
+
+
+/**
+ * Whether the File Meta Information is dumped, which it is unless none of
+ * the selected Tags belongs to it.
+ */
+static bool has_file_meta_tags(const struct Options *options)
+{
+    if (options->tags == NULL) {
+        return true;
+    }
+    for (uint32_t i = 0; i < options->num_tags; i++) {
+        if ((options->tags[i] >> 16) == 0x0002) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+ * Dump a single file into an output buffer.
+ *
+ * :return: Whether the file could be read
+ */
+static bool dump_file(struct Output *output,
+                      const struct Options *options,
+                      const char *file_path)
+{
+    dcm_log_info("Read file '%s'", file_path);
+    DcmFile *file = dcm_file_create(file_path, 'r');
+    if (file == NULL) {
+        dcm_log_error("Reading file '%s' failed.", file_path);
+        return false;
+    }
+    dcm_file_set_read_flags(file, DCM_READ_ARENA);
+
+    dcm_log_info("Read File Meta Information");
+    DcmDataSet *file_meta = dcm_file_read_file_meta(file);
+    if (file_meta == NULL) {
+        dcm_log_error("Reading file '%s' failed. "
+                      "Could not read File Meta Information.", file_path);
+        dcm_file_destroy(file);
+        return false;
+    }
+
+    bool is_first = true;
+    if (options->print_names && !options->json) {
+        output_printf(output, "===File '%s'===\n", file_path);
+    }
+    if (options->json) {
+        output_write(output, "{", 1);
+        dump_json_dataset(output, options, file_meta, 0, &is_first);
+    } else if (has_file_meta_tags(options)) {
+        output_puts(output, "===File Meta Information===\n");
+        dump_text_dataset(output, options, file_meta, 0);
+    }
+
+    dcm_log_info("Read metadata");
+    DcmDataSet *metadata;
+    if (options->tags) {
+        metadata = dcm_file_read_metadata_tags(file,
+                                               options->tags,
+                                               options->num_tags,
+                                               0xFFFFFFFF);
+    } else {
+        metadata = dcm_file_read_metadata(file);
+    }
+    if (metadata == NULL) {
+        dcm_log_error("Reading file '%s' failed. "
+                      "Could not read Data Set.", file_path);
+        dcm_dataset_destroy(file_meta);
+        dcm_file_destroy(file);
+        // The JSON object would be incomplete
+        if (options->json) {
+            output->length = 0;
+        }
+        return false;
+    }
+
+    if (options->json) {
+        dump_json_dataset(output, options, metadata, 0, &is_first);
+        output_puts(output, "}\n");
+    } else {
+        output_puts(output, "===Dataset===\n");
+        dump_text_dataset(output, options, metadata, 0);
+    }
+
+    dcm_dataset_destroy(metadata);
+    dcm_dataset_destroy(file_meta);
+    dcm_file_destroy(file);
+
+    if (output->failed) {
+        dcm_log_error("Dumping file '%s' failed. "
+                      "Could not allocate memory.", file_path);
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Files that are dumped by several threads and written in the given order.
+ */
+struct Batch {
+    const struct Options *options;
+    char **file_paths;
+    uint32_t num_files;
+    struct Output *outputs;
+    bool *is_done;
+    bool *is_read;
+    uint32_t next_file;
+    uint32_t next_write;
+    uint32_t max_ahead;
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+#endif
+};
+
+
+#ifdef HAVE_PTHREAD_H
+static void *dump_worker(void *arg)
+{
+    struct Batch *batch = arg;
+
+    pthread_mutex_lock(&batch->lock);
+    while (batch->next_file < batch->num_files) {
+        // Bound the memory that is held by output waiting to be written
+        if (batch->next_file >= batch->next_write + batch->max_ahead) {
+            pthread_cond_wait(&batch->changed, &batch->lock);
+            continue;
+        }
+        uint32_t i = batch->next_file++;
+        pthread_mutex_unlock(&batch->lock);
+
+        struct Output output = {NULL, 0, 0, false};
+        bool is_read = dump_file(&output,
+                                 batch->options,
+                                 batch->file_paths[i]);
+
+        pthread_mutex_lock(&batch->lock);
+        batch->outputs[i] = output;
+        batch->is_read[i] = is_read;
+        batch->is_done[i] = true;
+        pthread_cond_broadcast(&batch->changed);
+    }
+    pthread_mutex_unlock(&batch->lock);
+
+    return NULL;
+}
+#endif
+
+
+/**
+ * Dump files on a number of threads and write their output in order.
+ *
+ * :return: Whether all files could be read
+ */
+static bool dump_files(const struct Options *options,
+                       char **file_paths,
+                       uint32_t num_files,
+                       uint32_t num_threads)
+{
+    bool result = true;
+
+#ifdef HAVE_PTHREAD_H
+    if (num_threads > 1 && num_files > 1) {
+        struct Batch batch = {
+            .options = options,
+            .file_paths = file_paths,
+            .num_files = num_files,
+            .outputs = calloc(num_files, sizeof(struct Output)),
+            .is_done = calloc(num_files, sizeof(bool)),
+            .is_read = calloc(num_files, sizeof(bool)),
+            .max_ahead = num_threads * FILES_AHEAD_PER_THREAD,
+        };
+        pthread_t *threads = calloc(num_threads, sizeof(pthread_t));
+        if (batch.outputs == NULL ||
+            batch.is_done == NULL ||
+            batch.is_read == NULL ||
+            threads == NULL) {
+            dcm_log_error("Dumping files failed. Could not allocate memory.");
+            free(batch.outputs);
+            free(batch.is_done);
+            free(batch.is_read);
+            free(threads);
+            return false;
+        }
+        pthread_mutex_init(&batch.lock, NULL);
+        pthread_cond_init(&batch.changed, NULL);
+
+        uint32_t num_started = 0;
+        while (num_started < num_threads &&
+               pthread_create(&threads[num_started],
+                              NULL,
+                              dump_worker,
+                              &batch) == 0) {
+            num_started++;
+        }
+        if (num_started == 0) {
+            // Without a worker, the calling thread dumps the files itself
+            batch.max_ahead = num_files;
+            dump_worker(&batch);
+        }
+
+        pthread_mutex_lock(&batch.lock);
+        while (batch.next_write < num_files) {
+            uint32_t i = batch.next_write;
+            if (!batch.is_done[i]) {
+                pthread_cond_wait(&batch.changed, &batch.lock);
+                continue;
+            }
+            pthread_mutex_unlock(&batch.lock);
+
+            fwrite(batch.outputs[i].data, 1, batch.outputs[i].length, stdout);
+            output_destroy(&batch.outputs[i]);
+            result &= batch.is_read[i];
+
+            pthread_mutex_lock(&batch.lock);
+            batch.next_write++;
+            pthread_cond_broadcast(&batch.changed);
+        }
+        pthread_mutex_unlock(&batch.lock);
+
+        for (uint32_t i = 0; i < num_started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        pthread_cond_destroy(&batch.changed);
+        pthread_mutex_destroy(&batch.lock);
+        free(batch.outputs);
+        free(batch.is_done);
+        free(batch.is_read);
+        free(threads);
+        return result;
+    }
+#else
+    (void) num_threads;
+#endif
+
+    struct Output output = {NULL, 0, 0, false};
+    for (uint32_t i = 0; i < num_files; i++) {
+        output.length = 0;
+        output.failed = false;
+        result &= dump_file(&output, options, file_paths[i]);
+        fwrite(output.data, 1, output.length, stdout);
+    }
+    output_destroy(&output);
+
+    return result;
+}
+
+
+/**
+ * Parse a comma-separated list of Tags in hexadecimal form or Keywords.
+ */
+static bool parse_tags(struct Options *options, const char *list)
+{
+    const char *start = list;
+    while (*start) {
+        const char *end = strchr(start, ',');
+        size_t length = end ? (size_t) (end - start) : strlen(start);
+        char item[128];
+        if (length == 0 || length >= sizeof(item)) {
+            fprintf(stderr, "Invalid tag list '%s'\n", list);
+            return false;
+        }
+        memcpy(item, start, length);
+        item[length] = '\0';
+
+        uint32_t tag;
+        char *rest;
+        unsigned long number = strtoul(item, &rest, 16);
+        if (length == 8 && *rest == '\0') {
+            tag = (uint32_t) number;
+        } else if (!dcm_dict_lookup_tag(item, &tag)) {
+            fprintf(stderr, "Unknown tag or keyword '%s'\n", item);
+            return false;
+        }
+
+        uint32_t *tags = realloc(options->tags,
+                                 (options->num_tags + 1) * sizeof(uint32_t));
+        if (tags == NULL) {
+            fprintf(stderr, "Could not allocate memory\n");
+            return false;
+        }
+        tags[options->num_tags++] = tag;
+        options->tags = tags;
+
+        start += length;
+        if (*start == ',') {
+            start++;
+        }
+    }
+    return true;
+}
+
+
+// Paths of the files to dump, which may be read from stdin
+struct FileList {
+    char **paths;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+
+static bool file_list_add(struct FileList *list, const char *path)
+{
+    if (list->count == list->capacity) {
+        uint32_t capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+        char **paths = realloc(list->paths, capacity * sizeof(char *));
+        if (paths == NULL) {
+            return false;
+        }
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+    size_t length = strlen(path);
+    list->paths[list->count] = malloc(length + 1);
+    if (list->paths[list->count] == NULL) {
+        return false;
+    }
+    memcpy(list->paths[list->count], path, length + 1);
+    list->count++;
+    return true;
+}
+
+
+static bool file_list_read(struct FileList *list, FILE *stream)
+{
+    char line[4096];
+    while (fgets(line, sizeof(line), stream)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0' && !file_list_add(list, line)) {
+            return false;
+        }
+    }
+    return !ferror(stream);
+}
+
+
+static void file_list_destroy(struct FileList *list)
+{
+    for (uint32_t i = 0; i < list->count; i++) {
+        free(list->paths[i]);
+    }
+    free(list->paths);
+}
+
+
+static bool parse_number(const char *value, uint32_t *number)
+{
+    char *end;
+    errno = 0;
+    unsigned long result = strtoul(value, &end, 10);
+    if (errno != 0 || end == value || *end != '\0' || result > UINT32_MAX) {
+        return false;
+    }
+    *number = (uint32_t) result;
+    return true;
+}
 
 
 int main(int argc, char *argv[]) {
 
     int i;
-    const char *file_path = NULL;
-    DcmDataSet *metadata = NULL;
-    DcmDataSet *file_meta = NULL;
-    DcmFile *file = NULL;
+    struct Options options = {false, false, NULL, 0, UINT32_MAX};
+    struct FileList files = {NULL, 0, 0};
+    uint32_t num_threads = 1;
+    bool is_valid = true;
 
     dcm_log_level = DCM_LOG_ERROR;
 
 
-    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
-        switch (argv[i][1]) {
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        const char option = argv[i][1];
+        const char *value = NULL;
+        if (strchr("tdp", option)) {
+            if (i + 1 == argc) {
+                fprintf(stderr, "%s\n", usage);
+                free(options.tags);
+                return EXIT_FAILURE;
+            }
+            value = argv[++i];
+        }
+        switch (option) {
             case 'h':
                 printf("%s\n", usage);
                 return EXIT_SUCCESS;
@@ -32,46 +1107,55 @@ int main(int argc, char *argv[]) {
             case 'v':
                 dcm_log_level = DCM_LOG_INFO;
                 break;
+            case 'j':
+                options.json = true;
+                break;
+            case 't':
+                is_valid = parse_tags(&options, value);
+                break;
+            case 'd':
+                is_valid = parse_number(value, &options.max_depth);
+                break;
+            case 'p':
+                is_valid = parse_number(value, &num_threads) &&
+                           num_threads > 0;
+                break;
             default:
-                fprintf(stderr, "%s\n", usage);
-                return EXIT_FAILURE;
+                is_valid = false;
+                break;
+        }
+        if (!is_valid) {
+            fprintf(stderr, "%s\n", usage);
+            free(options.tags);
+            return EXIT_FAILURE;
         }
     }
 
-    if ((i + 1) != argc) {
+    if (i == argc) {
         fprintf(stderr, "%s\n", usage);
+        free(options.tags);
         return EXIT_FAILURE;
     }
-    file_path = argv[i];
-
-    dcm_log_info("Read file '%s'", file_path);
-    file = dcm_file_create(file_path, 'r');
-    if (file == NULL) {
-        dcm_log_error("Reading file '%s' failed.", file_path);
-        return EXIT_FAILURE;
+    for (; i < argc; i++) {
+        // A single dash reads one path per line from stdin
+        bool is_added = strcmp(argv[i], "-") == 0 ?
+            file_list_read(&files, stdin) :
+            file_list_add(&files, argv[i]);
+        if (!is_added) {
+            fprintf(stderr, "Could not read the list of files\n");
+            file_list_destroy(&files);
+            free(options.tags);
+            return EXIT_FAILURE;
+        }
     }
-    dcm_log_info("Read File Meta Information");
-    file_meta = dcm_file_read_file_meta(file);
-
-    printf("===File Meta Information===\n");
-    dcm_dataset_print(file_meta, 0);
+    options.print_names = files.count > 1;
 
-    dcm_log_info("Read metadata");
-    metadata = dcm_file_read_metadata(file);
-    if (metadata == NULL) {
-        dcm_log_error("Reading file '%s' failed. "
-                      "Could not read Data Set.", file_path);
-        dcm_file_destroy(file);
-        dcm_dataset_destroy(file_meta);
-        return EXIT_FAILURE;
-    }
+    setvbuf(stdout, NULL, _IOFBF, STDOUT_BUFFER_SIZE);
 
-    printf("===Dataset===\n");
-    dcm_dataset_print(metadata, 0);
+    bool result = dump_files(&options, files.paths, files.count, num_threads);
 
-    dcm_file_destroy(file);
-    dcm_dataset_destroy(file_meta);
-    dcm_dataset_destroy(metadata);
+    file_list_destroy(&files);
+    free(options.tags);
 
-    return EXIT_SUCCESS;
+    return result ? EXIT_SUCCESS : EXIT_FAILURE;
 }